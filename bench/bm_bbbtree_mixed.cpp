@@ -0,0 +1,126 @@
+#include "bbbtree/bbbtree.h"
+#include "bbbtree/btree.h"
+#include "bbbtree/buffer_manager.h"
+#include "bbbtree/stats.h"
+#include "bbbtree/types.h"
+#include "helpers.h"
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+// -----------------------------------------------------------------
+using namespace bbbtree;
+// -----------------------------------------------------------------
+/// Benchmark for measuring the bytes written by BBBTree vs BTree for a stream
+/// of mixed inserts, updates and erases on a pre-filled index.
+namespace {
+// -----------------------------------------------------------------
+using KeyT = UInt64;
+using ValueT = TID;
+using BBBTreeIndex = BBBTree<KeyT, ValueT>;
+using BTreeIndex = BTree<KeyT, ValueT>;
+// -----------------------------------------------------------------
+static const constexpr size_t BENCH_PAGE_SIZE = 4096;
+static const constexpr size_t BENCH_NUM_PAGES = 500;
+static const constexpr size_t BENCH_NUM_OPERATIONS = 100'000;
+// -----------------------------------------------------------------
+struct MixedOperation {
+	enum class Type : uint8_t { Insert, Update, Erase };
+	Type type;
+	uint64_t key;
+	uint64_t value;
+};
+// -----------------------------------------------------------------
+/// Returns a stream of operations on the keys [0, `num_tuples`) of which even
+/// keys are preloaded. Inserts only use odd keys, erases only even keys.
+std::vector<MixedOperation> GetOperations(size_t num_tuples,
+										  size_t num_operations) {
+	std::mt19937_64 rng(42); // Fixed seed for reproducibility
+	std::uniform_int_distribution<uint64_t> key_dist(0, num_tuples / 2 - 1);
+	std::uniform_int_distribution<uint8_t> op_dist(0, 2);
+
+	std::vector<MixedOperation> ops;
+	ops.reserve(num_operations);
+	for (uint64_t i = 0; i < num_operations; ++i) {
+		auto type = static_cast<MixedOperation::Type>(op_dist(rng));
+		auto key = 2 * key_dist(rng);
+		if (type == MixedOperation::Type::Insert)
+			++key;
+		ops.push_back({type, key, i});
+	}
+	return ops;
+}
+// -----------------------------------------------------------------
+template <typename IndexUnderTest>
+static void BM_MixedOperations(benchmark::State &state) {
+	size_t num_tuples = state.range(0);
+	size_t num_pages = state.range(1);
+	float wa_threshold = static_cast<float>(state.range(2)) / 100.0;
+	uint16_t page_size = state.range(3);
+
+	BufferManager buffer_manager{page_size, num_pages, true};
+	IndexUnderTest index{2, buffer_manager, wa_threshold};
+
+	auto ops = GetOperations(num_tuples, BENCH_NUM_OPERATIONS);
+	for (auto _ : state) {
+		state.PauseTiming();
+		for (uint64_t key = 0; key < num_tuples; key += 2) {
+			[[maybe_unused]] auto success = index.insert(key, key);
+		}
+		buffer_manager.clear_all();
+		stats.clear();
+		state.ResumeTiming();
+
+		// Operations on absent keys are no-ops in both indexes.
+		for (const auto &op : ops) {
+			switch (op.type) {
+			case MixedOperation::Type::Insert: {
+				[[maybe_unused]] auto success = index.insert(op.key, op.value);
+				break;
+			}
+			case MixedOperation::Type::Update:
+				if (index.lookup(op.key).has_value())
+					index.update(op.key, op.value);
+				break;
+			case MixedOperation::Type::Erase:
+				index.erase(op.key, page_size);
+				break;
+			}
+		}
+		buffer_manager.clear_all();
+
+		state.PauseTiming();
+		index.set_height();
+		buffer_manager.clear_all(false);
+		index.clear();
+		state.ResumeTiming();
+	}
+
+	SetBenchmarkCounters(state, stats);
+}
+// -----------------------------------------------------------------
+} // namespace
+// -----------------------------------------------------------------
+// 0: Number of tuples
+// 1: Number of pages in memory
+// 2: Write Amplification Threshold
+// 3: Page Size
+// -----------------------------------------------------------------
+BENCHMARK_TEMPLATE(BM_MixedOperations, BTreeIndex)
+	->Args({100'000, BENCH_NUM_PAGES, 10, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK_TEMPLATE(BM_MixedOperations, BBBTreeIndex)
+	->Args({100'000, BENCH_NUM_PAGES, 10, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK_TEMPLATE(BM_MixedOperations, BTreeIndex)
+	->Args({100'000, BENCH_NUM_PAGES, 20, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK_TEMPLATE(BM_MixedOperations, BBBTreeIndex)
+	->Args({100'000, BENCH_NUM_PAGES, 20, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+// -----------------------------------------------------------------
@@ -16,6 +16,7 @@ namespace {
 using KeyT = UInt64;
 using OutOfMemoryDatabase = Database<BTree, KeyT>;
 using InMemoryDatabase = Database<Map, KeyT>;
+using ClusteredDatabase = Database<BTree, KeyT, true>;
 
 static const constexpr size_t BENCH_PAGE_SIZE = 1024;
 static const constexpr size_t BENCH_NUM_PAGES = 10;
@@ -115,10 +116,60 @@ static void BM_OutOfMemorySequentialLookup(benchmark::State &state) {
 		}
 	}
 }
+static void BM_ClusteredRandomLookup(benchmark::State &state) {
+	using DatabaseUnderTest = ClusteredDatabase;
+
+	DatabaseUnderTest db{BENCH_PAGE_SIZE, BENCH_NUM_PAGES, 0, true};
+	auto tuples = GetTuples<DatabaseUnderTest>(state.range(0));
+	db.insert(tuples);
+
+	auto rng = std::default_random_engine{};
+	std::ranges::shuffle(tuples, rng);
+
+	for (auto _ : state) {
+		for (auto &tuple : tuples) {
+			db.get(tuple.key);
+		}
+	}
+}
+static void BM_ClusteredRandomUpdate(benchmark::State &state) {
+	using DatabaseUnderTest = ClusteredDatabase;
+
+	DatabaseUnderTest db{BENCH_PAGE_SIZE, BENCH_NUM_PAGES, 0, true};
+	auto tuples = GetTuples<DatabaseUnderTest>(state.range(0));
+	db.insert(tuples);
+
+	auto rng = std::default_random_engine{};
+	std::ranges::shuffle(tuples, rng);
+
+	for (auto _ : state) {
+		for (auto &tuple : tuples) {
+			tuple.value = tuple.value + 1;
+			db.update(tuple);
+		}
+	}
+}
+static void BM_OutOfMemoryScan(benchmark::State &state) {
+	using DatabaseUnderTest = OutOfMemoryDatabase;
+
+	DatabaseUnderTest db{BENCH_PAGE_SIZE, BENCH_NUM_PAGES, 0, true};
+	auto tuples = GetTuples<DatabaseUnderTest>(state.range(0));
+	db.insert(tuples);
+
+	for (auto _ : state) {
+		size_t num_tuples = 0;
+		db.scan([&](const DatabaseUnderTest::Tuple &) { ++num_tuples; },
+				state.range(1));
+		benchmark::DoNotOptimize(num_tuples);
+	}
+}
 } // namespace
 
 BENCHMARK(BM_InMemoryRandomWrite)->Arg(1000);
 BENCHMARK(BM_OutOfMemoryRandomWrite)->Arg(1000);
 BENCHMARK(BM_OutOfMemorySequentialWrite)->Arg(1000);
 BENCHMARK(BM_OutOfMemoryRandomLookup)->Arg(1000);
-BENCHMARK(BM_OutOfMemorySequentialLookup)->Arg(1000);
\ No newline at end of file
+BENCHMARK(BM_OutOfMemorySequentialLookup)->Arg(1000);
+BENCHMARK(BM_ClusteredRandomLookup)->Arg(1000);
+BENCHMARK(BM_ClusteredRandomUpdate)->Arg(1000);
+BENCHMARK(BM_OutOfMemoryScan)->Args({10000, false})->Args({10000, true});
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "bbbtree/stats.h"
 #include "bbbtree/types.h"
 // -----------------------------------------------------------------
+#include <algorithm>
 #include <benchmark/benchmark.h>
 #include <cstdint>
 #include <random>
@@ -68,6 +69,9 @@ void SetBenchmarkCounters(benchmark::State &state, const Stats &stats) {
 		stats.btree_pages_write_deferred;
 	state.counters["pages_created"] = stats.pages_created;
 	state.counters["slotted_pages_created"] = stats.slotted_pages_created;
+	state.counters["record_pages_write_deferred"] =
+		stats.record_pages_write_deferred;
+	state.counters["record_deltas_applied"] = stats.record_deltas_applied;
 	// Add more as needed
 }
 // -----------------------------------------------------------------
@@ -116,6 +120,141 @@ static void BM_DatabaseBBBTreeIndexFromScratch(benchmark::State &state) {
 	SetBenchmarkCounters(state, stats);
 }
 // -----------------------------------------------------------------
+/// Updates the values of all tuples in random order. Most updated records
+/// belong to evicted slotted pages.
+static void BM_DatabaseBTreeIndexRandomUpdate(benchmark::State &state) {
+	using DatabaseUnderTest = BTreeIndexedDB;
+
+	size_t num_tuples = state.range(0);
+	size_t num_pages = state.range(1);
+	float wa_threshold = static_cast<float>(state.range(2)) / 100.0;
+	uint16_t page_size = state.range(3);
+
+	DatabaseUnderTest db{page_size, num_pages, wa_threshold, true};
+	auto tuples = GetTuples<DatabaseUnderTest>(num_tuples);
+	db.insert(tuples);
+
+	std::mt19937_64 rng(42);
+	for (auto _ : state) {
+		state.PauseTiming();
+		std::ranges::shuffle(tuples, rng);
+		for (auto &tuple : tuples)
+			tuple.value = tuple.value + 1;
+		stats.clear();
+		state.ResumeTiming();
+
+		db.update(tuples);
+	}
+	SetBenchmarkCounters(state, stats);
+}
+// -----------------------------------------------------------------
+/// Updates the values of a logged database in random order in batches of 100
+/// and commits each batch. Commits wait for the log only. The updated pages
+/// stay in memory until evicted.
+static void BM_DatabaseBTreeIndexLoggedUpdate(benchmark::State &state) {
+	using DatabaseUnderTest = BTreeIndexedDB;
+
+	size_t num_tuples = state.range(0);
+	size_t num_pages = state.range(1);
+	float wa_threshold = static_cast<float>(state.range(2)) / 100.0;
+	uint16_t page_size = state.range(3);
+
+	DatabaseUnderTest db{page_size, num_pages, wa_threshold, true, true};
+	auto tuples = GetTuples<DatabaseUnderTest>(num_tuples);
+	db.insert(tuples);
+	db.checkpoint();
+
+	std::mt19937_64 rng(42);
+	for (auto _ : state) {
+		state.PauseTiming();
+		std::ranges::shuffle(tuples, rng);
+		for (auto &tuple : tuples)
+			tuple.value = tuple.value + 1;
+		stats.clear();
+		state.ResumeTiming();
+
+		for (size_t i = 0; i < tuples.size(); i += 100) {
+			auto end = std::min(i + 100, tuples.size());
+			db.update(std::vector(tuples.begin() + i, tuples.begin() + end));
+			db.commit();
+		}
+	}
+	SetBenchmarkCounters(state, stats);
+	state.counters["log_groups_written"] = stats.log_groups_written;
+	state.counters["log_bytes_written"] = stats.log_bytes_written;
+}
+// -----------------------------------------------------------------
+/// Checkpoints a database after updating 1% of its tuples at random. The
+/// checkpoint writes out pages with many changes and buffers the changes of
+/// the others as deltas. The pages stay buffered.
+static void BM_DatabaseBBBTreeIndexCheckpoint(benchmark::State &state) {
+	using DatabaseUnderTest = BBBTreeIndexedDB;
+
+	size_t num_tuples = state.range(0);
+	size_t num_pages = state.range(1);
+	float wa_threshold = static_cast<float>(state.range(2)) / 100.0;
+	uint16_t page_size = state.range(3);
+
+	DatabaseUnderTest db{page_size, num_pages, wa_threshold, true};
+	auto tuples = GetTuples<DatabaseUnderTest>(num_tuples);
+	db.insert(tuples);
+	db.checkpoint();
+
+	std::mt19937_64 rng(42);
+	for (auto _ : state) {
+		state.PauseTiming();
+		std::ranges::shuffle(tuples, rng);
+		std::vector updates(tuples.begin(), tuples.begin() + num_tuples / 100);
+		for (auto &tuple : updates)
+			tuple.value = tuple.value + 1;
+		db.update(updates);
+		stats.clear();
+		state.ResumeTiming();
+
+		db.checkpoint();
+	}
+	SetBenchmarkCounters(state, stats);
+	state.counters["checkpoint_pages_written"] = stats.checkpoint_pages_written;
+	state.counters["checkpoint_pages_deferred"] =
+		stats.checkpoint_pages_deferred;
+}
+// -----------------------------------------------------------------
+/// Opens a database whose index buffered the deltas of random updates. Opening
+/// reads the last checkpoint and scans the delta tree instead of reloading the
+/// index.
+static void BM_DatabaseBBBTreeIndexOpen(benchmark::State &state) {
+	using DatabaseUnderTest = BBBTreeIndexedDB;
+
+	size_t num_tuples = state.range(0);
+	size_t num_pages = state.range(1);
+	float wa_threshold = static_cast<float>(state.range(2)) / 100.0;
+	uint16_t page_size = state.range(3);
+
+	auto tuples = GetTuples<DatabaseUnderTest>(num_tuples);
+	{
+		DatabaseUnderTest db{page_size, num_pages, wa_threshold, true};
+		db.insert(tuples);
+		std::mt19937_64 rng(42);
+		std::ranges::shuffle(tuples, rng);
+		tuples.resize(num_tuples / 10);
+		for (auto &tuple : tuples)
+			tuple.value = tuple.value + 1;
+		db.update(tuples);
+	}
+
+	for (auto _ : state) {
+		stats.clear();
+		DatabaseUnderTest db{page_size, num_pages, wa_threshold, false};
+
+		state.PauseTiming();
+		SetBenchmarkCounters(state, stats);
+		state.counters["pages_loaded"] = stats.pages_loaded;
+		state.counters["deltas_dropped_on_recovery"] =
+			stats.deltas_dropped_on_recovery;
+		state.ResumeTiming();
+	}
+}
+// -----------------------------------------------------------------
 } // namespace
 // -----------------------------------------------------------------
 // 0: Number of tuples
@@ -233,3 +372,42 @@ BENCHMARK(BM_DatabaseBBBTreeIndexFromScratch)
 	->Iterations(1)
 	->Repetitions(1);
 // -----------------------------------------------------------------
+// -----------------------------------------------------------------
+// Updates with buffered records (WA Threshold of 0, 5 and 10)
+BENCHMARK(BM_DatabaseBTreeIndexRandomUpdate)
+	->Args({100'000, BENCH_NUM_PAGES, 0, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK(BM_DatabaseBTreeIndexRandomUpdate)
+	->Args({100'000, BENCH_NUM_PAGES, 5, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK(BM_DatabaseBTreeIndexRandomUpdate)
+	->Args({100'000, BENCH_NUM_PAGES, 10, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+// -----------------------------------------------------------------
+// Logged updates with buffered records (WA Threshold of 0 and 5)
+BENCHMARK(BM_DatabaseBTreeIndexLoggedUpdate)
+	->Args({100'000, BENCH_NUM_PAGES, 0, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK(BM_DatabaseBTreeIndexLoggedUpdate)
+	->Args({100'000, BENCH_NUM_PAGES, 5, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
+// -----------------------------------------------------------------
+// Checkpoints after sparse updates (WA Threshold of 0 and 10)
+BENCHMARK(BM_DatabaseBBBTreeIndexCheckpoint)
+	->Args({100'000, BENCH_NUM_PAGES, 0, BENCH_PAGE_SIZE})
+	->Iterations(10)
+	->Repetitions(1);
+BENCHMARK(BM_DatabaseBBBTreeIndexCheckpoint)
+	->Args({100'000, BENCH_NUM_PAGES, 10, BENCH_PAGE_SIZE})
+	->Iterations(10)
+	->Repetitions(1);
+// -----------------------------------------------------------------
+BENCHMARK(BM_DatabaseBBBTreeIndexOpen)
+	->Args({100'000, BENCH_NUM_PAGES, 5, BENCH_PAGE_SIZE})
+	->Iterations(1)
+	->Repetitions(1);
@@ -0,0 +1,167 @@
+#include "bbbtree/bbbtree.h"
+#include "bbbtree/buffer_manager.h"
+#include "bbbtree/delta_log.h"
+#include "bbbtree/stats.h"
+#include "bbbtree/types.h"
+#include "helpers.h"
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+// -----------------------------------------------------------------
+using namespace bbbtree;
+// -----------------------------------------------------------------
+/// Benchmark for comparing the delta stores of the BBBTree. Sweeps the ratio
+/// of updates among lookups on a pre-filled index and measures the bytes
+/// written physically and the latency of loading nodes with buffered deltas.
+/// The delta tree is measured with and without a delta cache and with deltas
+/// applied eagerly or lazily on load. The delta log is measured with its tail
+/// in a buffered page or packed in memory.
+namespace {
+// -----------------------------------------------------------------
+using KeyT = UInt64;
+using ValueT = TID;
+using DeltaTreeIndex = BBBTree<KeyT, ValueT>;
+using DeltaLogIndex = BBBTree<KeyT, ValueT, false, DeltaLog<KeyT, ValueT>>;
+// -----------------------------------------------------------------
+static const constexpr size_t BENCH_PAGE_SIZE = 4096;
+static const constexpr size_t BENCH_NUM_PAGES = 500;
+static const constexpr size_t BENCH_NUM_TUPLES = 100'000;
+static const constexpr size_t BENCH_NUM_OPERATIONS = 100'000;
+static const constexpr size_t BENCH_WA_THRESHOLD = 10;
+// -----------------------------------------------------------------
+struct Operation {
+	bool is_update;
+	uint64_t key;
+};
+// -----------------------------------------------------------------
+/// Returns a stream of lookups and updates on the keys [0, `num_tuples`).
+/// `update_ratio` is the percentage of updates.
+std::vector<Operation> GetOperations(size_t num_tuples, size_t num_operations,
+									 size_t update_ratio) {
+	std::mt19937_64 rng(42); // Fixed seed for reproducibility
+	std::uniform_int_distribution<uint64_t> key_dist(0, num_tuples - 1);
+	std::uniform_int_distribution<size_t> op_dist(0, 99);
+
+	std::vector<Operation> ops;
+	ops.reserve(num_operations);
+	for (uint64_t i = 0; i < num_operations; ++i) {
+		auto is_update = op_dist(rng) < update_ratio;
+		ops.push_back({is_update, key_dist(rng)});
+	}
+	return ops;
+}
+// -----------------------------------------------------------------
+template <typename IndexUnderTest>
+static void BM_DeltaStore(benchmark::State &state) {
+	size_t num_tuples = state.range(0);
+	size_t num_pages = state.range(1);
+	float wa_threshold = static_cast<float>(state.range(2)) / 100.0;
+	uint16_t page_size = state.range(3);
+	size_t update_ratio = state.range(4);
+	size_t delta_cache_pages = state.range(5);
+	bool is_lazy = state.range(6);
+	bool is_grouped = state.range(7);
+
+	BufferManager buffer_manager{page_size, num_pages, true};
+	std::unique_ptr<IndexUnderTest> index;
+	if constexpr (std::constructible_from<IndexUnderTest, SegmentID,
+										  BufferManager &, float, size_t>)
+		index = std::make_unique<IndexUnderTest>(2, buffer_manager,
+												 wa_threshold, delta_cache_pages);
+	else
+		index = std::make_unique<IndexUnderTest>(2, buffer_manager, wa_threshold);
+	if (is_lazy)
+		index->enable_lazy_apply();
+	if constexpr (requires { index->enable_delta_grouping(); })
+		if (is_grouped)
+			index->enable_delta_grouping();
+
+	auto ops = GetOperations(num_tuples, BENCH_NUM_OPERATIONS, update_ratio);
+	double load_ns = 0;
+	size_t num_loads = 0;
+	for (auto _ : state) {
+		state.PauseTiming();
+		for (uint64_t key = 0; key < num_tuples; ++key) {
+			[[maybe_unused]] auto success = index->insert(key, key);
+		}
+		buffer_manager.clear_all();
+		stats.clear();
+		state.ResumeTiming();
+
+		for (const auto &op : ops) {
+			if (op.is_update)
+				index->update(op.key, op.key + 1);
+			else
+				benchmark::DoNotOptimize(index->lookup(op.key));
+		}
+		buffer_manager.clear_all();
+
+		// Reading every leaf once from a cold buffer applies all buffered
+		// deltas, unless they are applied lazily.
+		state.PauseTiming();
+		auto pages_loaded = stats.pages_loaded;
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t key = 0; key < num_tuples; ++key)
+			benchmark::DoNotOptimize(index->lookup(key));
+		load_ns += std::chrono::duration<double, std::nano>(
+					   std::chrono::steady_clock::now() - start)
+					   .count();
+		num_loads += stats.pages_loaded - pages_loaded;
+
+		index->set_height();
+		buffer_manager.clear_all(false);
+		index->clear();
+		state.ResumeTiming();
+	}
+
+	// Frames reference the index. Drop them before destroying it.
+	buffer_manager.clear_all(false);
+	index.reset();
+
+	SetBenchmarkCounters(state, stats);
+	state.counters["update_ratio"] = update_ratio;
+	state.counters["delta_cache_pages"] = delta_cache_pages;
+	state.counters["is_lazy"] = is_lazy;
+	state.counters["is_grouped"] = is_grouped;
+	state.counters["load_latency_ns"] = num_loads ? load_ns / num_loads : 0;
+}
+// -----------------------------------------------------------------
+} // namespace
+// -----------------------------------------------------------------
+// 0: Number of tuples
+// 1: Number of pages in memory
+// 2: Write Amplification Threshold
+// 3: Page Size
+// 4: Update Ratio
+// 5: Delta Cache Pages, taken from the pages in memory
+// 6: Apply deltas lazily
+// 7: Pack the delta log's tail in memory
+// -----------------------------------------------------------------
+BENCHMARK_TEMPLATE(BM_DeltaStore, DeltaTreeIndex)
+	->ArgsProduct({{BENCH_NUM_TUPLES},
+				   {BENCH_NUM_PAGES},
+				   {BENCH_WA_THRESHOLD},
+				   {BENCH_PAGE_SIZE},
+				   {1, 5, 10, 20, 50},
+				   {0, BENCH_NUM_PAGES / 10},
+				   {0, 1},
+				   {0}})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK_TEMPLATE(BM_DeltaStore, DeltaLogIndex)
+	->ArgsProduct({{BENCH_NUM_TUPLES},
+				   {BENCH_NUM_PAGES},
+				   {BENCH_WA_THRESHOLD},
+				   {BENCH_PAGE_SIZE},
+				   {1, 5, 10, 20, 50},
+				   {0},
+				   {0},
+				   {0, 1}})
+	->Iterations(1)
+	->Repetitions(1);
+// -----------------------------------------------------------------
@@ -0,0 +1,137 @@
+#include "bbbtree/delta.h"
+#include "bbbtree/types.h"
+
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+// -----------------------------------------------------------------
+using namespace bbbtree;
+// -----------------------------------------------------------------
+/// Microbenchmark for the cost of extracting and applying the deltas of a
+/// node. Compares materializing `Deltas` with encoding the changed slots
+/// straight into reused memory and decoding them in place.
+namespace {
+// -----------------------------------------------------------------
+/// The changed slots of a leaf. Keys are strings or integers.
+template <typename KeyT> struct Slots {
+	explicit Slots(size_t num_deltas) {
+		for (size_t i = 0; i < num_deltas; ++i) {
+			if constexpr (std::is_same_v<KeyT, String>)
+				strings.push_back("key_" + std::to_string(1000 + i * 7));
+			else
+				keys.emplace_back(1000 + i * 7);
+			ops.push_back(static_cast<OperationType>(1 + i % 3));
+			values.emplace_back(i);
+		}
+		if constexpr (std::is_same_v<KeyT, String>)
+			for (const auto &string : strings)
+				keys.emplace_back(string);
+	}
+
+	std::vector<std::string> strings;
+	std::vector<KeyT> keys;
+	std::vector<OperationType> ops;
+	std::vector<TID> values;
+};
+// -----------------------------------------------------------------
+/// Extracts the deltas by building `Deltas` and serializing them.
+template <typename KeyT>
+static void BM_ExtractMaterialized(benchmark::State &state) {
+	Slots<KeyT> slots(state.range(0));
+	std::vector<std::byte> buffer;
+	for (auto _ : state) {
+		typename Deltas<KeyT, TID>::LeafDeltas values;
+		for (size_t i = 0; i < slots.keys.size(); ++i)
+			values.emplace_back(slots.ops[i], slots.keys[i], slots.values[i]);
+		Deltas<KeyT, TID> deltas{std::move(values), 100};
+		buffer.resize(deltas.size());
+		deltas.serialize(buffer.data());
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	state.counters["bytes"] = buffer.size();
+}
+// -----------------------------------------------------------------
+/// Extracts the deltas by encoding the slots into reused memory.
+template <typename KeyT>
+static void BM_ExtractInPlace(benchmark::State &state) {
+	Slots<KeyT> slots(state.range(0));
+	std::vector<std::byte> arena;
+	DeltasHeader header{static_cast<uint16_t>(slots.keys.size()), 100, true};
+	size_t size = 0;
+	for (auto _ : state) {
+		// Bound the bytes to encode the slots in one pass.
+		size_t num_entry_bytes = 0;
+		for (size_t i = 0; i < slots.keys.size(); ++i)
+			num_entry_bytes += slots.keys[i].size() + slots.values[i].size();
+		auto max_size = DeltaEncoder<KeyT, TID>::get_max_size(
+			header.num_deltas, num_entry_bytes);
+		if (arena.size() < max_size)
+			arena.resize(max_size);
+
+		DeltaEncoder<KeyT, TID> encoder(arena.data(), header);
+		for (size_t i = 0; i < slots.keys.size(); ++i)
+			encoder.add(slots.ops[i], slots.keys[i], slots.values[i]);
+		size = encoder.size();
+		benchmark::DoNotOptimize(arena.data());
+	}
+	state.counters["bytes"] = size;
+}
+// -----------------------------------------------------------------
+/// Returns the serialized deltas of the slots.
+template <typename KeyT>
+std::vector<std::byte> Serialize(const Slots<KeyT> &slots) {
+	typename Deltas<KeyT, TID>::LeafDeltas values;
+	for (size_t i = 0; i < slots.keys.size(); ++i)
+		values.emplace_back(slots.ops[i], slots.keys[i], slots.values[i]);
+	Deltas<KeyT, TID> deltas{std::move(values), 100};
+	std::vector<std::byte> buffer(deltas.size());
+	deltas.serialize(buffer.data());
+	return buffer;
+}
+// -----------------------------------------------------------------
+/// Applies the deltas by deserializing `Deltas` first.
+template <typename KeyT>
+static void BM_ApplyMaterialized(benchmark::State &state) {
+	auto buffer = Serialize(Slots<KeyT>(state.range(0)));
+	for (auto _ : state) {
+		auto deltas = Deltas<KeyT, TID>::deserialize(buffer.data(),
+													 buffer.size());
+		benchmark::DoNotOptimize(&deltas);
+	}
+}
+// -----------------------------------------------------------------
+/// Applies the deltas by decoding them from the serialized bytes.
+template <typename KeyT> static void BM_ApplyInPlace(benchmark::State &state) {
+	auto buffer = Serialize(Slots<KeyT>(state.range(0)));
+	std::string key_buffer;
+	for (auto _ : state) {
+		auto view = DeltasView<KeyT, TID>::deserialize(buffer.data(),
+													   buffer.size());
+		const auto *src = view.get_bytes().data();
+		auto header = DeltasHeader::decode(src);
+		DeltaDecoder<KeyT, TID> decoder(src, header.num_deltas, key_buffer);
+		size_t checksum = decoder.count(OperationType::Inserted);
+		while (!decoder.done()) {
+			auto delta = decoder.next();
+			checksum += delta.entry.key.size() + delta.entry.value.get_slot_id();
+		}
+		benchmark::DoNotOptimize(checksum);
+	}
+}
+// -----------------------------------------------------------------
+} // namespace
+// -----------------------------------------------------------------
+// 0: Number of deltas
+// -----------------------------------------------------------------
+BENCHMARK_TEMPLATE(BM_ExtractMaterialized, UInt64)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(BM_ExtractInPlace, UInt64)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(BM_ExtractMaterialized, String)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(BM_ExtractInPlace, String)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(BM_ApplyMaterialized, UInt64)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(BM_ApplyInPlace, UInt64)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(BM_ApplyMaterialized, String)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK_TEMPLATE(BM_ApplyInPlace, String)->Arg(16)->Arg(64)->Arg(256);
+// -----------------------------------------------------------------
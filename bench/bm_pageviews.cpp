@@ -8,7 +8,10 @@
 #include "bbbtree/types.h"
 #include "helpers.h"
 // -----------------------------------------------------------------
+#include <algorithm>
 #include <benchmark/benchmark.h>
+#include <utility>
+#include <vector>
 // -----------------------------------------------------------------
 using namespace bbbtree;
 // -----------------------------------------------------------------
@@ -95,8 +98,8 @@ static void BM_PageViews_Lookup_DB(benchmark::State &state) {
 	// Propagate the database with pageview keys
 	static std::vector<Operation> ops = LoadPageviewOps(OPERATIONS_FILE);
 
-	// Clear buffer manager to force write-backs.
-	db.clear_bm(true);
+	// Checkpoint to force write-backs. The pages stay buffered.
+	db.checkpoint();
 	stats.clear();
 
 	for (auto _ : state) {
@@ -129,8 +132,8 @@ static void BM_PageViews_Mixed_DB(benchmark::State &state) {
 	// Propagate the database with pageview keys
 	static std::vector<Operation> ops = LoadPageviewOps(OPERATIONS_FILE);
 
-	// Clear buffer manager to force write-backs.
-	db.clear_bm(true);
+	// Checkpoint to force write-backs. The pages stay buffered.
+	db.checkpoint();
 	stats.clear();
 
 	for (auto _ : state) {
@@ -180,8 +183,8 @@ static void BM_PageViews_Mixed_Index(benchmark::State &state) {
 	// Get the workload
 	std::vector<Operation> ops = LoadPageviewOps(ops_filename);
 
-	// Clear buffer manager to force write-backs.
-	buffer_manager.clear_all(true);
+	// Force write-backs. The pages stay buffered.
+	buffer_manager.flush_all();
 	stats.clear();
 	logger.clear();
 	index.enable_buffering();
@@ -211,6 +214,73 @@ static void BM_PageViews_Mixed_Index(benchmark::State &state) {
 }
 // -----------------------------------------------------------------
 template <typename IndexUnderTest>
+static void BM_PageViews_Mixed_Index_Batch(benchmark::State &state) {
+	size_t num_pages = state.range(0);
+	uint16_t page_size = state.range(1);
+	float wa_threshold = static_cast<float>(state.range(2)) / 100.0;
+	size_t update_ratio = state.range(3);
+	size_t window_size = state.range(4);
+	auto ops_filename = update_ratio_to_ops_filename(update_ratio);
+
+	BufferManager buffer_manager{page_size, num_pages, true};
+	IndexUnderTest index{BENCH_SEGMENT_ID, buffer_manager, wa_threshold};
+	index.disable_buffering();
+	// Propagate the database with pageview keys
+	static std::vector<uint64_t> keys =
+		LoadPageviewKeys(sample_size_to_dataset_filename());
+
+	for (auto key : keys) {
+		auto success = index.insert(key, 0); // Value is dummy
+		assert(success);
+	}
+
+	// Get the workload
+	std::vector<Operation> ops = LoadPageviewOps(ops_filename);
+
+	// Force write-backs. The pages stay buffered.
+	buffer_manager.flush_all();
+	stats.clear();
+	logger.clear();
+	index.enable_buffering();
+
+	std::vector<KeyT> lookups;
+	std::vector<std::pair<KeyT, TID>> updates;
+	for (auto _ : state) {
+		// Process the operations in windows. Values are dummies, so the order
+		// of lookups and updates within a window does not matter.
+		for (size_t begin = 0; begin < ops.size(); begin += window_size) {
+			auto end = std::min(begin + window_size, ops.size());
+			lookups.clear();
+			updates.clear();
+			for (size_t i = begin; i < end; ++i) {
+				const auto &op = ops[i];
+				switch (op.op_type) {
+				case 'L':
+					lookups.push_back(op.row_number);
+					break;
+				case 'U': {
+					TID value = 0; // Value is dummy
+					KeyT key = op.row_number;
+
+					updates.emplace_back(key, value);
+					stats.bytes_written_logically += key.size() + value.size();
+					break;
+				}
+				default:
+					throw std::logic_error(
+						"Unknown operation type in workload.");
+				}
+			}
+			benchmark::DoNotOptimize(index.lookup_batch(lookups));
+			index.update_batch(updates);
+		}
+	}
+
+	index.set_height();
+	SetBenchmarkCounters(state, stats);
+}
+// -----------------------------------------------------------------
+template <typename IndexUnderTest>
 static void BM_PageViews_Insert_Index(benchmark::State &state) {
 	stats.clear();
 	logger.clear();
@@ -269,8 +339,8 @@ static void BM_PageViews_Lookup_Index(benchmark::State &state) {
 	// Get the workload
 	static std::vector<Operation> ops = LoadPageviewOps(OPERATIONS_FILE);
 
-	// Clear buffer manager to force write-backs.
-	buffer_manager.clear_all(true);
+	// Force write-backs. The pages stay buffered.
+	buffer_manager.flush_all();
 	stats.clear();
 	index.enable_buffering();
 
@@ -343,8 +413,8 @@ static void BM_PageViews_Mixed_Index_Var(benchmark::State &state) {
 	// Get the workload
 	std::vector<Operation> ops = LoadPageviewOps(ops_filename);
 
-	// Clear buffer manager to force write-backs.
-	buffer_manager.clear_all(true);
+	// Force write-backs. The pages stay buffered.
+	buffer_manager.flush_all();
 	stats.clear();
 	logger.clear();
 	index.enable_buffering();
@@ -425,6 +495,20 @@ BENCHMARK_TEMPLATE(BM_PageViews_Mixed_Index, BBBTreeIndex)
 	->Iterations(1)
 	->Repetitions(1);
 // -----------------------------------------------------------------
+// 3: Update ratio in percent
+// 4: Number of operations per batch
+// -----------------------------------------------------------------
+BENCHMARK_TEMPLATE(BM_PageViews_Mixed_Index_Batch, BTreeIndex)
+	->Args({BENCH_NUM_PAGES, BENCH_PAGE_SIZE, BENCH_WA_THRESHOLD, 5, 64})
+	->Args({BENCH_NUM_PAGES, BENCH_PAGE_SIZE, BENCH_WA_THRESHOLD, 5, 1024})
+	->Iterations(1)
+	->Repetitions(1);
+BENCHMARK_TEMPLATE(BM_PageViews_Mixed_Index_Batch, BBBTreeIndex)
+	->Args({BENCH_NUM_PAGES, BENCH_PAGE_SIZE, BENCH_WA_THRESHOLD, 5, 64})
+	->Args({BENCH_NUM_PAGES, BENCH_PAGE_SIZE, BENCH_WA_THRESHOLD, 5, 1024})
+	->Iterations(1)
+	->Repetitions(1);
+// -----------------------------------------------------------------
 BENCHMARK_TEMPLATE(BM_PageViews_Insert_Index, BTreeIndex)
 	->Args({200, BENCH_PAGE_SIZE, BENCH_UPDATE_RATIO})
 	->Iterations(1)
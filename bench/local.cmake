@@ -3,6 +3,9 @@ set(BENCH_CC
         # bench/bm_bbbtree_insert.cpp
         bench/bm_database_from_scratch.cpp
         bench/bm_bbbtree_from_scratch.cpp
+        bench/bm_bbbtree_mixed.cpp
+        bench/bm_delta_store.cpp
+        bench/bm_deltas.cpp
         bench/bm_pageviews.cpp
         bench/helpers.cpp
 )
@@ -3,39 +3,208 @@
 #include "bbbtree/btree.h"
 #include "bbbtree/buffer_manager.h"
 #include "bbbtree/delta.h"
+#include "bbbtree/delta_cache.h"
 #include "bbbtree/types.h"
 
+#include <concepts>
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
 #include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace bbbtree {
 
 // -----------------------------------------------------------------
-template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree,
+		  typename DeltaStoreT>
 class BBBTree;
-template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
-std::ostream &operator<<(std::ostream &os,
-						 const BBBTree<KeyT, ValueT, UseDeltaTree> &type);
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree,
+		  typename DeltaStoreT>
+std::ostream &
+operator<<(std::ostream &os,
+		   const BBBTree<KeyT, ValueT, UseDeltaTree, DeltaStoreT> &type);
 // -----------------------------------------------------------------
-/// A delta tree is a BTree that maps from PIDs of the corresponding BTree
-/// nodes to deltas on that node.
+/// A delta store buffers the changes of evicted BTree nodes instead of
+/// writing the nodes out. It is the page logic of the BTree. This base class
+/// extracts and replays the deltas of nodes. The derived stores decide where
+/// the deltas of a PID are kept.
 template <KeyIndexable KeyT, ValueIndexable ValueT>
-class DeltaTree : public PageLogic, public BTree<PID, Deltas<KeyT, ValueT>> {
-	using LeafDeltas = typename Deltas<KeyT, ValueT>::LeafDeltas;
-	using InnerNodeDeltas = typename Deltas<KeyT, ValueT>::InnerNodeDeltas;
+class DeltaStore : public PageLogic {
+  protected:
+	using DeltasT = DeltasView<KeyT, ValueT>;
 
 	using Node = BTree<KeyT, ValueT, true>::Node;
 	using LeafNode = BTree<KeyT, ValueT, true>::LeafNode;
 	using InnerNode = BTree<KeyT, ValueT, true>::InnerNode;
 
-  public:
 	/// Constructor.
+	explicit DeltaStore(float wa_threshold) : wa_threshold(wa_threshold) {}
+
+	/// Returns true if the node changed too much to buffer its deltas.
+	bool has_many_updates(const Node *node, size_t page_size) const {
+		return node->get_update_ratio(page_size) > wa_threshold;
+	}
+	/// Counts an unload. If adaptive, moves the threshold by `adapt_step`
+	/// every `adapt_interval` unloads. The threshold keeps moving in the same
+	/// direction while the page I/O per unload decreases and turns otherwise.
+	/// Page I/O counts the written nodes of this tree and the written and
+	/// loaded pages of this store, so that other trees sharing the buffer do
+	/// not skew it.
+	void adapt_threshold();
+	/// Returns the number of pages of the store itself loaded or written so
+	/// far.
+	virtual size_t get_store_page_io() const = 0;
+	/// Cleans the node before it is written out and counts the write. Returns
+	/// true to continue the unload.
+	bool write_out(Node *node) {
+		clean_node(node);
+		++num_nodes_written;
+		return true;
+	}
+
+	/// Cleans the slots of a node of their dirty state. Done to reset the state
+	/// of a node when we want to actually write it out. The delta tracking
+	/// should only be kept in memory.
+	template <typename NodeT> static void clean_node(NodeT *node);
+	/// Calls the correct cleaning codefor the node type.
+	static void clean_node(Node *node);
+	/// Serializes the deltas of the node into the arena. The view is valid
+	/// until the next extraction.
+	DeltasT extract_deltas(const Node *node);
+	/// Applies the serialized deltas to the node that was just loaded from
+	/// disk. Decodes them in place.
+	void apply_deltas(Node *node, DeltasT deltas, size_t page_size);
+	/// Applies the deltas to the node that was just loaded from disk. In lazy
+	/// mode, the deltas of leaves are kept pending instead.
+	void load_deltas(Node *node, PageID page_id, DeltasT deltas,
+					 size_t page_size);
+	/// Forgets the deltas pending for the page, e.g. before it is loaded anew.
+	void drop_pending(PageID page_id) {
+		if (!pending.empty())
+			pending.erase(page_id);
+	}
+	/// Forgets all pending deltas.
+	void clear_pending() { pending.clear(); }
+	/// Returns true if deltas are pending for the page.
+	bool has_pending(PageID page_id) const { return pending.contains(page_id); }
+
+	/// The write amplification threshold. When the ratio of bytes changed
+	/// in a node is below this threshold, we buffer the changes in this store.
+	float wa_threshold;
+
+  public:
+	/// Applies the deltas pending for the leaf before it is modified.
+	void prepare(char *data, PageID page_id, size_t page_size) override;
+	/// Returns the deltas pending for the leaf. Empty if none are pending.
+	/// Leaves read often apply them instead.
+	std::span<const std::byte> get_pending(char *data, PageID page_id,
+										   size_t page_size) override;
+
+	/// Keeps the deltas of loaded leaves pending until the leaf is modified.
+	/// Lookups consult them on top of the leaf, so read-mostly workloads skip
+	/// applying them. Leaves evicted clean drop them, the store still holds
+	/// them.
+	void enable_lazy_apply() { is_lazy = true; }
+
+	/// Pending deltas are applied once they served this many lookups. Then
+	/// reading them costs about as much as applying them.
+	static constexpr uint16_t max_pending_lookups = 4;
+
+	/// Enables adapting the threshold online toward minimum page I/O.
+	void enable_adaptive_threshold() { is_adaptive = true; }
+	/// Returns the effective write amplification threshold.
+	float get_wa_threshold() const { return wa_threshold; }
+
+	/// The number of unloads between adapting the threshold.
+	static constexpr size_t adapt_interval = 256;
+	/// The change of the threshold per adaption.
+	static constexpr float adapt_step = 0.05;
+
+	/// Returns the page I/O of this tree so far: its written nodes and the
+	/// page I/O of the store.
+	size_t get_page_io() const {
+		return num_nodes_written + get_store_page_io();
+	}
+
+  private:
+	/// Whether the threshold is adapted.
+	bool is_adaptive = false;
+	/// The number of nodes of the tree written out so far.
+	size_t num_nodes_written = 0;
+	/// The number of unloads in the current interval.
+	size_t num_unloads = 0;
+	/// The page I/O at the start of the current interval.
+	size_t interval_page_io = 0;
+	/// The page I/O per unload in the last interval.
+	double last_cost = std::numeric_limits<double>::max();
+	/// Whether the threshold was raised last.
+	bool is_raising = true;
+
+	/// Serializes the deltas from the node into the arena.
+	template <typename NodeT>
+	DeltasT extract_deltas(const NodeT *node, const DeltasHeader &header);
+	/// Applies the deltas following the header at `src` to the node.
+	template <typename NodeT>
+	void apply_deltas(NodeT *node, const std::byte *src,
+					  const DeltasHeader &header, size_t page_size);
+
+	/// Whether the deltas of loaded leaves are kept pending.
+	bool is_lazy = false;
+	/// The deltas pending for a loaded leaf.
+	struct PendingDeltas {
+		/// The serialized deltas. Copied, since the store may evict them
+		/// meanwhile.
+		std::vector<std::byte> bytes;
+		/// The number of lookups that read them so far.
+		uint16_t num_lookups = 0;
+	};
+	/// The deltas pending for loaded leaves. Entries of leaves evicted clean
+	/// are replaced when the leaf is loaded again.
+	std::unordered_map<PageID, PendingDeltas> pending;
+	/// Scratch memory that deltas are extracted into. Re-used for every
+	/// eviction.
+	std::vector<std::byte> arena;
+	/// Holds the decoded string keys while applying deltas.
+	std::string key_buffer;
+};
+// -----------------------------------------------------------------
+/// A delta tree is a BTree that maps from PIDs of the corresponding BTree
+/// nodes to deltas on that node. Optionally, a bounded cache in front of the
+/// tree keeps the deltas of recently evicted or loaded nodes in memory. Deltas
+/// are only stored in the tree when they are evicted from the cache. A bitmap
+/// over the PIDs tracks which nodes have deltas in the tree, so that loading a
+/// node without deltas does not traverse the tree. Deltas of cold nodes are
+/// folded back into their nodes by `merge_deltas`. The tree stores the
+/// serialized deltas, which are copied from and applied straight from its
+/// leaves.
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+class DeltaTree : public DeltaStore<KeyT, ValueT>,
+				  public BTree<PID, DeltasView<KeyT, ValueT>> {
+	using Node = DeltaStore<KeyT, ValueT>::Node;
+	using DeltasT = DeltaStore<KeyT, ValueT>::DeltasT;
+
+  public:
+	/// Constructor. The delta cache may use the memory of `cache_pages`
+	/// frames, which are taken out of the buffer pool. Deltas that an opened
+	/// tree holds already are tracked again.
 	DeltaTree(SegmentID segment_id, BufferManager &buffer_manager,
-			  float wa_threshold)
-		: PageLogic(),
-		  BTree<PID, Deltas<KeyT, ValueT>>(segment_id, buffer_manager, nullptr),
-		  wa_threshold(wa_threshold) {
-		this->is_delta_tree = true;
+			  float wa_threshold, size_t cache_pages = 0)
+		: DeltaStore<KeyT, ValueT>(wa_threshold),
+		  BTree<PID, DeltasView<KeyT, ValueT>>(segment_id, buffer_manager,
+											   nullptr, true),
+		  cache(cache_pages * buffer_manager.page_size) {
+		buffer_manager.reserve_frames(cache_pages);
+		is_locked = true;
+		this->for_each(
+			[&](const PID &pid, const DeltasView<KeyT, ValueT> &deltas) {
+				track_deltas(pid, deltas.size());
+			});
+		is_locked = false;
 	}
 
 	/// Scans the given BTree node for dirty entries and buffers them in the
@@ -47,22 +216,58 @@ class DeltaTree : public PageLogic, public BTree<PID, Deltas<KeyT, ValueT>> {
 	/// Looks up the deltas for the given node and applies them.
 	void after_load(char *data, PageID page_id) override;
 
+	/// Clears the delta tree and the delta cache.
+	void clear() {
+		cache.clear();
+		this->clear_pending();
+		pid_filter.clear();
+		stored_deltas.clear();
+		BTree<PID, DeltasView<KeyT, ValueT>>::clear();
+	}
+
+	/// Folds the deltas in the tree back into their nodes in segment
+	/// `segment_id` until this tree did `io_budget` pages of I/O. Large
+	/// deltas that were not replaced for long are merged first. Each node is
+	/// loaded, written out with its deltas applied and its deltas are erased.
+	/// Returns the number of merged nodes.
+	size_t merge_deltas(SegmentID segment_id, size_t io_budget);
+
+	/// Tracks the deltas in the tree again after it was opened, e.g. by
+	/// recovery. Deltas of nodes that are not among the `num_pages` allocated
+	/// ones are dropped. Returns the number of dropped deltas.
+	size_t validate_deltas(PageID num_pages);
+	/// Stores the dirty deltas of the cache in the tree, e.g. before a
+	/// checkpoint. They stay cached.
+	void flush_cache();
+	/// Drops the deltas of the cache without storing them, e.g. on a crash.
+	void discard_cache() { cache.clear(); }
+
+	/// Returns the cache in front of the delta tree.
+	const DeltaCache<KeyT, ValueT> &get_cache() const { return cache; }
+
+  protected:
+	size_t get_store_page_io() const override {
+		return this->buffer_manager.get_page_io(this->segment_id);
+	}
+
   private:
-	/// Cleans the slots of a node of their dirty state. Done to reset the state
-	/// of a node when we want to actually write it out. The delta tracking
-	/// should only be kept in memory.
-	template <typename NodeT> void clean_node(NodeT *node);
-	/// Extracts the deltas from the node.
-	template <typename NodeT, typename DeltasT>
-	void extract_deltas(const NodeT *node, DeltasT &deltas);
-	/// Applies the deltas to the node. TODO: Also remove from the tree?
-	template <typename NodeT, typename DeltasT>
-	void apply_deltas(NodeT *node, const DeltasT &deltas, uint16_t slot_count);
+	/// Upserts the extracted deltas of the node, replacing those buffered
+	/// before.
+	void store_deltas(PageID page_id, DeltasT deltas);
+	/// Evicts the least recently used deltas from the cache until it fits its
+	/// budget. Dirty deltas are upserted into the tree.
+	void evict_cached_deltas();
+	/// Erases the deltas of the node from the tree.
+	void erase_deltas(PageID page_id);
 
-	/// Calls the correct cleaning codefor the node type.
-	void clean_node(Node *node);
-	/// Calls the correct extraction code for the node type.
-	void store_deltas(PageID page_id, const Node *node);
+	/// Returns true if the tree may hold deltas for the node.
+	bool may_have_deltas(PageID page_id) const {
+		return page_id < pid_filter.size() && pid_filter[page_id];
+	}
+	/// Marks that the tree holds deltas of `size` bytes for the node.
+	void track_deltas(PageID page_id, uint16_t size);
+	/// Marks that the tree holds no deltas for the node.
+	void untrack_deltas(PageID page_id);
 
 	/// Erase deferred deletions when the tree is unlocked.
 	void erase_deferred_deletions();
@@ -75,25 +280,72 @@ class DeltaTree : public PageLogic, public BTree<PID, Deltas<KeyT, ValueT>> {
 	/// to indicate that this node cannot be evicted at this time.
 	/// During `after_load`, the tree should never be locked.
 	bool is_locked = false;
-	/// The write amplification threshold. When the ratio of bytes changed
-	/// in a node is below this threshold, we buffer the changes in this tree.
-	const float wa_threshold;
 	/// A queue of deletions to be processed after splitting a node.
 	std::vector<PID> deferred_deletions;
+	/// The deltas of recently evicted or loaded nodes.
+	DeltaCache<KeyT, ValueT> cache;
+	/// Marks the PIDs of nodes with deltas in the tree.
+	std::vector<bool> pid_filter;
+
+	/// The deltas stored in the tree for a node.
+	struct StoredDeltas {
+		/// The serialized size of the deltas.
+		uint16_t size;
+		/// When the deltas were stored, counted in stores.
+		size_t stored_at;
+	};
+	/// The deltas stored in the tree, to pick nodes to merge.
+	std::unordered_map<PageID, StoredDeltas> stored_deltas;
+	/// The number of deltas stored in the tree so far.
+	size_t num_stores = 0;
+	/// The node that is written out by `merge_deltas`.
+	std::optional<PageID> merging_page;
 };
 // -----------------------------------------------------------------
 /// A B-Tree that can buffer its deltas. Cannot just inherit from `BTree`
-/// because the `DeltaTree` member must be initialized first but the constructor
-/// must fulfill certain requirements to be a database's index.
-template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree = false>
-class BBBTree {
+/// because the delta store member must be initialized first but the
+/// constructor must fulfill certain requirements to be a database's index.
+/// `DeltaStoreT` is the `DeltaStore` buffering the deltas, e.g. a `DeltaTree`
+/// or a `DeltaLog`.
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree = false,
+		  typename DeltaStoreT = DeltaTree<KeyT, ValueT>>
+class BBBTree : public BufferClient {
   public:
-	/// Constructor. The Delta Tree is stored in `segment_id` + 1.
+	/// Constructor. The delta store is stored in `segment_id` + 1.
 	BBBTree(SegmentID segment_id, BufferManager &buffer_manager,
 			float wa_threshold)
-		: delta_tree(segment_id + 1, buffer_manager, wa_threshold),
-		  btree(segment_id, buffer_manager, &delta_tree) {
+		: buffer_manager(buffer_manager),
+		  delta_store(segment_id + 1, buffer_manager, wa_threshold),
+		  btree(segment_id, buffer_manager, &delta_store) {
+		stats.wa_threshold = wa_threshold;
+		buffer_manager.register_client(*this);
+	}
+	/// Constructor for delta stores with a cache. The cache uses the memory of
+	/// `delta_cache_pages` frames of the buffer pool.
+	BBBTree(SegmentID segment_id, BufferManager &buffer_manager,
+			float wa_threshold, size_t delta_cache_pages)
+		requires std::constructible_from<DeltaStoreT, SegmentID,
+										 BufferManager &, float, size_t>
+		: buffer_manager(buffer_manager),
+		  delta_store(segment_id + 1, buffer_manager, wa_threshold,
+					  delta_cache_pages),
+		  btree(segment_id, buffer_manager, &delta_store) {
 		stats.wa_threshold = wa_threshold;
+		buffer_manager.register_client(*this);
+	}
+	/// Destructor. Writes back the tree unless the buffer manager was
+	/// destroyed first.
+	~BBBTree() override {
+		if (is_detached)
+			return;
+		buffer_manager.unregister_client(*this);
+		write_back();
+	}
+
+	/// Writes back the tree before the buffer manager is destroyed.
+	void detach() override {
+		write_back();
+		is_detached = true;
 	}
 
 	/// Lookup an entry in the tree. Returns `nullopt` if key was not found.
@@ -114,6 +366,38 @@ class BBBTree {
 		btree.update(key, value);
 	}
 
+	/// Insert an entry or replace its value if the key exists.
+	inline void upsert(const KeyT &key, const ValueT &value) {
+		btree.upsert(key, value);
+	}
+
+	/// Lookup a batch of keys sharing traversals. Results are in the order of
+	/// `keys`.
+	inline std::vector<std::optional<ValueT>>
+	lookup_batch(std::span<const KeyT> keys) {
+		return btree.lookup_batch(keys);
+	}
+
+	/// Update a batch of entries sharing traversals.
+	inline void update_batch(std::span<const std::pair<KeyT, ValueT>> entries) {
+		btree.update_batch(entries);
+	}
+
+	/// Builds the empty B-tree bottom-up from entries sorted by unique keys.
+	inline void bulk_load(std::span<const std::pair<KeyT, ValueT>> entries,
+						  float fill_factor = 1.0) {
+		btree.bulk_load(entries, fill_factor);
+	}
+
+	/// Returns true if the B-tree has no entries.
+	inline bool empty() { return btree.empty(); }
+
+	/// Calls `visit(key, value)` for each entry in key order.
+	inline void
+	for_each(const std::function<void(const KeyT &, const ValueT &)> &visit) {
+		btree.for_each(visit);
+	}
+
 	/// Returns the number of key/value pairs stored in the B-tree.
 	inline size_t size() { return btree.size(); }
 
@@ -123,28 +407,93 @@ class BBBTree {
 	/// Sets the height in the stats.
 	void set_height() {
 		stats.b_tree_height = height();
-		stats.delta_tree_height = delta_tree.height();
+		if constexpr (requires { delta_store.height(); })
+			stats.delta_tree_height = delta_store.height();
 	}
 
 	size_t get_average_num_entries_per_node() {
 		return btree.get_average_num_entries_per_node();
 	}
 
-	/// Clears the trees.
+	/// Clears the B-tree and the delta store.
 	void clear() {
 		btree.clear();
-		delta_tree.clear();
+		delta_store.clear();
 	}
 
-	/// Disables buffering if this is a delta tree.
-	void disable_buffering() { delta_tree.disable_buffering(); }
-	/// Enables buffering if this is a delta tree.
-	void enable_buffering() { delta_tree.enable_buffering(); }
+	/// Disables buffering of deltas.
+	void disable_buffering() { delta_store.disable_buffering(); }
+	/// Enables buffering of deltas.
+	void enable_buffering() { delta_store.enable_buffering(); }
+	/// Lets the delta store adapt the write amplification threshold online.
+	void enable_adaptive_threshold() {
+		delta_store.enable_adaptive_threshold();
+	}
+	/// Lets the delta store apply the deltas of loaded leaves only once they
+	/// are modified.
+	void enable_lazy_apply() { delta_store.enable_lazy_apply(); }
+	/// Returns the effective write amplification threshold.
+	float get_wa_threshold() const { return delta_store.get_wa_threshold(); }
+
+	/// Folds buffered deltas back into their nodes within `io_budget` pages
+	/// of I/O of this tree. Meant to run while I/O is idle. Returns the number
+	/// of merged nodes.
+	size_t merge_deltas(size_t io_budget)
+		requires requires(DeltaStoreT store) {
+			store.merge_deltas(SegmentID{}, size_t{});
+		}
+	{
+		return delta_store.merge_deltas(btree.segment_id, io_budget);
+	}
+
+	/// Moves the deltas that the delta store keeps in memory to its pages, so
+	/// that writing out all pages persists them.
+	void flush_deltas()
+		requires requires(DeltaStoreT store) { store.flush_cache(); }
+	{
+		delta_store.flush_cache();
+	}
+	/// Drops the deltas that the delta store keeps in memory without storing
+	/// them, e.g. when the database crashed.
+	void discard_deltas()
+		requires requires(DeltaStoreT store) { store.discard_cache(); }
+	{
+		delta_store.discard_cache();
+	}
+	/// Stores the state of the B-tree and the delta tree for the next
+	/// checkpoint. All pages must have been written out before.
+	void checkpoint(MetadataSegment &metadata) const
+		requires requires(DeltaStoreT store) {
+			store.validate_deltas(PageID{});
+		}
+	{
+		btree.checkpoint(metadata);
+		delta_store.checkpoint(metadata);
+	}
+	/// Opens the B-tree and the delta tree in their state as of the last
+	/// checkpoint. Buffered deltas are validated against the allocated nodes.
+	void recover(const MetadataSegment &metadata)
+		requires requires(DeltaStoreT store) {
+			store.validate_deltas(PageID{});
+		}
+	{
+		btree.recover(metadata);
+		delta_store.recover(metadata);
+		delta_store.validate_deltas(btree.next_free_page);
+	}
+
+	/// Lets the delta store pack the deltas of many nodes into a page in
+	/// memory and write each page once.
+	void enable_delta_grouping()
+		requires requires(DeltaStoreT store) { store.enable_grouping(); }
+	{
+		delta_store.enable_grouping();
+	}
 
 	/// Prints the tree.
 	friend std::ostream &
 	operator<< <>(std::ostream &os,
-				  const BBBTree<KeyT, ValueT, UseDeltaTree> &tree);
+				  const BBBTree<KeyT, ValueT, UseDeltaTree, DeltaStoreT> &tree);
 	/// Converts the tree to a string.
 	operator std::string() const {
 		std::stringstream ss;
@@ -153,12 +502,30 @@ class BBBTree {
 	}
 
   protected:
-	/// The delta tree that stores changes to entries of the `btree` nodes,
+	/// The buffer manager of both trees.
+	BufferManager &buffer_manager;
+	/// The delta store that keeps changes to entries of the `btree` nodes,
 	/// identified through their PID.
-	DeltaTree<KeyT, ValueT> delta_tree;
+	DeltaStoreT delta_store;
 	/// The actual index tree that stores the key-value pairs.
 	BTree<KeyT, ValueT, true> btree;
 
+  private:
+	/// Writes out the pages of both trees and the deltas that the delta store
+	/// keeps in memory, so that the tree can be opened again. Pages of other
+	/// segments stay buffered. Frames of the tree do not outlive it.
+	void write_back() {
+		if constexpr (requires { delta_store.write_back(SegmentID{}); })
+			delta_store.write_back(btree.segment_id);
+		buffer_manager.clear_segment(btree.segment_id);
+		if constexpr (requires { delta_store.flush_cache(); })
+			delta_store.flush_cache();
+		buffer_manager.clear_segment(btree.segment_id + 1);
+	}
+
+	/// Whether the buffer manager was destroyed first.
+	bool is_detached = false;
+
 	static_assert(!UseDeltaTree);
 };
 // -----------------------------------------------------------------
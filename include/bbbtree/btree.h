@@ -6,16 +6,18 @@
 #include "bbbtree/types.h"
 
 #include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <string>
 #include <concepts>
 #include <cstring>
+#include <functional>
 #include <optional>
+#include <span>
 #include <sys/types.h>
+#include <utility>
 #include <vector>
 
-// TODO: We currently do not persist the tree object while
-// running the B-Tree (e.g. root page id). We only persist the state on
-// destruction. Might want to maintain state through the buffer manager during
-// runtime though.
 // TODO: Made everything public for the delta tree to access intrinsics of the
 // BTree. Friend declaration did not work, because it instantiated illegal code
 // of the DeltaTree expecting the slot to have the `state` member. Try with
@@ -90,16 +92,18 @@ std::ostream &operator<<(std::ostream &os,
 /// of each).
 /// Values can also be deltas of a delta tree.
 /// TODO: Single threaded for now.
-/// TODO: Does not implement delete yet. When deleting keys, we do not
-/// re-use/compactify the space nor merge nodes. We leave nodes fragmented.
+/// Deleted entries leave holes in nodes that are compactified lazily. Underfull
+/// nodes are merged and their pages re-used.
 /// TODO: We should not use one file per index if we want to have several trees
 /// later.
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree = false>
 struct BTree : public Segment {
 
-	/// Constructor. Not thread-safe.
+	/// Constructor. Not thread-safe. `is_delta_tree` marks the pages of a
+	/// tree that buffers the deltas of another one, starting with its
+	/// meta-data and root page.
 	BTree(SegmentID segment_id, BufferManager &buffer_manager,
-		  PageLogic *page_logic = nullptr);
+		  PageLogic *page_logic = nullptr, bool is_delta_tree = false);
 	/// Constructor. Not thread-safe.
 	BTree(SegmentID segment_id, BufferManager &buffer_manager)
 		: BTree(segment_id, buffer_manager, nullptr) {}
@@ -119,7 +123,9 @@ struct BTree : public Segment {
 	/// modfying the tree again.
 	std::optional<ValueT> lookup(const KeyT &key);
 
-	/// Erase an entry in the tree.
+	/// Erase an entry in the tree. Merges underfull nodes with a sibling and
+	/// frees the emptied pages for re-use. Trees tracking deltas only leave
+	/// a tombstone in the leaf.
 	void erase(const KeyT &key, size_t page_size);
 
 	/// Inserts a new entry into the tree. Returns false if key already exists.
@@ -129,12 +135,35 @@ struct BTree : public Segment {
 	/// and of the same size.
 	void update(const KeyT &key, const ValueT &value);
 
+	/// Inserts a new entry or replaces the value of an existing key. Values
+	/// are overwritten in place when they fit and relocated otherwise.
+	void upsert(const KeyT &key, const ValueT &value);
+
+	/// Looks up a batch of keys. Returns the results in the order of `keys`.
+	/// Keys are served in ascending order. Consecutive keys share the inner
+	/// nodes on their path and all keys of a leaf are served with a single
+	/// fix. Values are views into nodes just like for `lookup`.
+	std::vector<std::optional<ValueT>> lookup_batch(std::span<const KeyT> keys);
+
+	/// Updates a batch of existing entries. Shares traversals like
+	/// `lookup_batch`. Values must be of the same size as before.
+	void update_batch(std::span<const std::pair<KeyT, ValueT>> entries);
+
+	/// Builds the tree bottom-up from key/value pairs sorted by unique keys.
+	/// The tree must be empty. Nodes are filled up to `fill_factor` of their
+	/// space and every page is written only once. Not thread-safe.
+	void bulk_load(std::span<const std::pair<KeyT, ValueT>> entries,
+				   float fill_factor = 1.0);
+
+	/// Returns true if the tree has no entries. Not thread-safe.
+	bool empty();
+
 	/// Print tree. Not thread-safe.
 	void print();
 
 	/// Returns the number of key/value pairs stored in the tree.
-	/// Do not use for production, only for testing. Traverses whole tree.
-	/// Not thread-safe.
+	/// Do not use for production, only for testing. Traverses whole tree. The
+	/// loaded nodes are evicted first. Not thread-safe.
 	size_t size() const;
 
 	/// Returns the number of levels in the tree.
@@ -144,6 +173,23 @@ struct BTree : public Segment {
 	/// Resets the tree to an empty state. Not thread-safe.
 	void clear();
 
+	/// Calls `visit(key, value)` for each entry in key order. The loaded nodes
+	/// are evicted in the order they were loaded, before the others. Not
+	/// thread-safe.
+	void for_each(const std::function<void(const KeyT &, const ValueT &)> &visit);
+
+	/// Returns the state needed to open the tree again.
+	TreeMetadata get_metadata() const {
+		return {root, next_free_page, first_free_page};
+	}
+	/// Stores the state of the tree for the next checkpoint.
+	void checkpoint(MetadataSegment &metadata) const {
+		metadata.set(segment_id, get_metadata());
+	}
+	/// Opens the tree in its state as of the last checkpoint, if any. Its
+	/// nodes must have been rolled back to the checkpoint. Not thread-safe.
+	void recover(const MetadataSegment &metadata);
+
 	/// Sets the height in the stats.
 	void set_height() { stats.b_tree_height = height(); }
 
@@ -153,9 +199,8 @@ struct BTree : public Segment {
 	/// Make sure to call this only if the delta tree is empty.
 	void enable_buffering() { buffering_enabled = true; }
 
-	/// TODO: Find a more elegant solution for persistency:
-	/// State is persisted at page 0 of this segment.
-	/// Read and written out at construction/destruction time.
+	/// State is kept at page 0 of this segment and updated with every change.
+	/// A `MetadataSegment` holds the versions written at checkpoints.
 
 	/// A generic tree node. Always consists of a header, a slot
 	/// section and the data section. Only construct these on buffered pages
@@ -259,6 +304,15 @@ struct BTree : public Segment {
 		/// Updates the child pointer for a given key.
 		void update(const KeyT &key, PageID new_child);
 
+		/// Moves all pivots of the right neighbor `right` into this node if
+		/// they fit. `separator` is the pivot between both nodes in the
+		/// parent. Returns false if they do not fit.
+		[[nodiscard]] bool merge(InnerNode &right, const KeyT &separator,
+								 uint32_t page_size);
+
+		/// Get the number of bytes used by slots and keys.
+		size_t get_used_space() const;
+
 		/// Returns all children of this node.
 		std::vector<PageID> get_children();
 
@@ -335,6 +389,22 @@ struct BTree : public Segment {
 		[[nodiscard]] bool insert(const KeyT &pivot, PageID child,
 								  bool allow_duplicates = false);
 
+		/// Removes `separator` after its child absorbed its right neighbor.
+		/// The pointer to the right neighbor is replaced by the child.
+		void erase_merged(Pivot *separator);
+
+		/// Moves pivots between this node and its right neighbor `right`
+		/// through `separator` in `parent` until both use about the same
+		/// space. Returns false if the parent cannot hold the new separator.
+		[[nodiscard]] bool balance(InnerNode &right, InnerNode &parent,
+								   Pivot *separator, uint32_t page_size);
+
+		/// Returns true if the key of `slot` can be replaced by `key`.
+		bool can_replace_key(const Pivot *slot, const KeyT &key,
+							 uint32_t page_size) const;
+		/// Replaces the key of `slot` by `key`. Keeps the child.
+		void replace_key(Pivot *slot, const KeyT &key, uint32_t page_size);
+
 		/// Get begin of slots section.
 		Pivot *slots_begin() {
 			return reinterpret_cast<Pivot *>(this->get_data() +
@@ -416,6 +486,13 @@ struct BTree : public Segment {
 				assert(UseDeltaTree);
 				return static_cast<OperationType>(state_and_offset.get_state());
 			}
+			/// Returns true if the entry was erased but the erase is not on
+			/// disk yet. Such tombstones are skipped by all lookups.
+			inline bool is_erased() const {
+				if constexpr (UseDeltaTree)
+					return get_state() == OperationType::Deleted;
+				return false;
+			}
 
 			/// The upper 2 bits represent the state for delta tracking.
 			/// The lower 30 bits represent the offset.
@@ -447,9 +524,14 @@ struct BTree : public Segment {
 		/// node is released. Use with care and copy the value if necessary
 		/// e.g. when multithreading.
 		std::optional<ValueT> lookup(const KeyT &key);
+		/// Looks up the key on top of the serialized deltas that are `pending`
+		/// for this leaf. The deltas take precedence over the leaf's entries.
+		std::optional<ValueT> lookup(const KeyT &key,
+									 std::span<const std::byte> pending);
 
 		/// Inserts a key, value pair into this leaf. Returns true if key
 		/// was actually inserted. Returns false if key already exists.
+		/// Inserting an erased key revives its tombstone as an update.
 		/// Caller must ensure that there is enough space.
 		[[nodiscard]] bool insert(const KeyT &key, const ValueT &value,
 								  bool allow_duplicates = false);
@@ -457,15 +539,54 @@ struct BTree : public Segment {
 		/// Updates the value for a given key. Not implemented yet.
 		void update(const KeyT &key, const ValueT &value);
 
+		/// Inserts the key/value pair or replaces the value of an existing
+		/// key. Compactifies the leaf if required. Returns false if the
+		/// entry does not fit even then.
+		[[nodiscard]] bool upsert(const KeyT &key, const ValueT &value,
+								  uint32_t page_size);
+		/// Whether `upsert` succeeds for the key/value pair, counting the
+		/// space of erased entries and of the key's current entry as free.
+		bool can_upsert(const KeyT &key, const ValueT &value,
+						uint32_t page_size);
+
 		/// Erases the key/value pair for the given key. Returns true if the
-		/// key was found and removed. Otherwise false.
-		bool erase(const KeyT &key, size_t page_size);
+		/// key was found and removed. Otherwise false. Leaves a hole in the
+		/// data section that is compactified once the space is needed.
+		/// With delta tracking, entries that are on disk are kept as
+		/// tombstones until the node is written out.
+		bool erase(const KeyT &key);
+		/// Physically removes all tombstones.
+		void remove_erased();
+		/// Overwrites the tombstone `slot` of `key` with `value` and tracks it
+		/// as an update. Caller must ensure that there is enough space.
+		void revive(LeafSlot &slot, const KeyT &key, const ValueT &value);
+
+		/// Returns the number of entries that are not erased.
+		uint16_t get_num_entries() const;
+
+		/// Moves all entries of the right neighbor `right` into this leaf if
+		/// they fit. Returns false if they do not fit.
+		[[nodiscard]] bool merge(LeafNode &right, uint32_t page_size);
+
+		/// Moves entries between this leaf and its right neighbor `right`
+		/// until both use about the same space. Updates `separator` in
+		/// `parent`. Returns false if the parent cannot hold the new
+		/// separator.
+		[[nodiscard]] bool balance(LeafNode &right, InnerNode &parent,
+								   typename InnerNode::Pivot *separator,
+								   uint32_t page_size);
+
+		/// Get the number of bytes used by slots, keys and values.
+		size_t get_used_space() const;
 
 		/// Splits the leaf and returns the resulting pivotal key to be
 		/// inserted into the parent. `this` leaf is guaranteed to be the
 		/// left node and `new_node` the right node after splitting.
+		/// With `is_append`, `key` must be bigger than all keys on this leaf.
+		/// This leaf is then left unchanged and `new_node` stays empty.
 		[[nodiscard]] const KeyT split(LeafNode &new_node, const KeyT &key,
-									   size_t page_size);
+									   size_t page_size,
+									   bool is_append = false);
 
 		/// Print leaf to standard output.
 		void print(std::ostream &os);
@@ -517,6 +638,8 @@ struct BTree : public Segment {
 	PageID root;
 	/// The next free, unique page ID.
 	PageID next_free_page;
+	/// The first page of the list of freed pages. Zero if empty.
+	PageID first_free_page;
 	/// The page logic specific to this tree. Called back by the buffer
 	/// manager when loading/unloading pages.
 	PageLogic *page_logic;
@@ -524,19 +647,76 @@ struct BTree : public Segment {
 	bool is_delta_tree = false;
 	/// If buffering of delta trees is enabled. Only relevant for delta trees.
 	bool buffering_enabled = true;
+	/// The leaf the last insert appended to as its right-most entry. Zero if
+	/// the last insert was not an append. Detects sequential inserts on
+	/// splits.
+	PageID last_append_leaf = 0;
+
+	/// Returns the pages of all leaves from left to right. Inner nodes are
+	/// fixed with `hint`.
+	std::vector<PageID> get_leaves(AccessHint hint) const;
 
 	/// Returns the appropriate leaf page for a given key.
 	/// Potentially splits nodes if full.
 	BufferFrame &get_leaf(const KeyT &key, bool exclusive);
 
+	/// Calls `visit(leaf_frame, i)` for `num_keys` keys given in ascending
+	/// order by `get_key(i)`. Keeps the nodes on the path fixed as long as the
+	/// following keys fall into them.
+	template <typename GetKey, typename Visit>
+	void for_each_leaf(size_t num_keys, GetKey &&get_key, bool exclusive,
+					   Visit &&visit);
+
+	/// Returns the deltas that the page logic keeps pending for the fixed
+	/// leaf. Lookups consult them on top of the leaf.
+	std::span<const std::byte> get_pending(BufferFrame &frame) const {
+		if constexpr (UseDeltaTree)
+			if (page_logic && frame.is_clean())
+				return page_logic->get_pending(frame.get_data(),
+											   frame.get_page_id(),
+											   buffer_manager.page_size);
+		return {};
+	}
+	/// Applies the deltas that the page logic keeps pending for the fixed
+	/// leaf, so that all of its entries can be read.
+	void apply_pending(BufferFrame &frame) const {
+		if constexpr (UseDeltaTree)
+			if (page_logic && frame.is_clean())
+				page_logic->prepare(frame.get_data(), frame.get_page_id(),
+									buffer_manager.page_size);
+	}
+
+	/// Throws if the key/value pair does not fit into an empty node.
+	void check_entry_size(const KeyT &key, const ValueT &value) const;
 	/// Traverses tree for given key and splits corresponding leaf.
 	/// Only splits if leaf is full. Another thread might have triggered
 	/// split already. Holds all locks on the path for cascading splits.
-	void split(const KeyT &key, const ValueT &value);
+	/// With `is_upsert`, the leaf is full only if it cannot replace the
+	/// existing entry of the key either.
+	void split(const KeyT &key, const ValueT &value, bool is_upsert = false);
 
-	/// Returns the next free page ID.
+	/// Returns the next free page ID. Re-uses freed pages first.
 	PageID get_new_page();
 
+	/// Adds the fixed page to the list of free pages.
+	void free_page(BufferFrame &frame);
+
+	/// A freed page. Links to the next free page.
+	struct FreePage {
+		PageID next;
+	};
+
+	/// Merges underfull nodes on the `path` to `key` with a sibling,
+	/// bottom-up, or balances them with the sibling if both do not fit a
+	/// single node. `path` holds the fixed nodes with the root in front.
+	/// Shrinks the tree while the root has a single child.
+	void merge(const std::vector<BufferFrame *> &path, const KeyT &key);
+
+	/// Nodes using less than this fraction of their space are merged.
+	static constexpr float merge_threshold = 0.25;
+
+	/// Returns the average number of entries per node. Traverses the whole
+	/// tree. The loaded nodes are evicted first.
 	size_t get_average_num_entries_per_node();
 
 	/// Prints the tree.
@@ -551,4 +731,40 @@ struct BTree : public Segment {
 	}
 };
 // -----------------------------------------------------------------
+template <typename LeafT> std::string dbg_key(LeafT *leaf, uint64_t k) {
+	if (!std::getenv("DBG881")) return "";
+	std::string out = " sc=" + std::to_string(leaf->slot_count) + " k" + std::to_string(k) + "=";
+	bool found = false;
+	for (auto *slot = leaf->slots_begin(); slot < leaf->slots_end(); ++slot) {
+		if constexpr (requires { uint64_t(slot->get_key(leaf->get_data())); }) {
+			if (uint64_t(slot->get_key(leaf->get_data())) == k) {
+				found = true;
+				out += "st" + std::to_string((int)slot->state_and_offset.get_state());
+			}
+		}
+	}
+	if (!found) out += "none";
+	return out;
+}
+template <typename InnerT> std::string dbg_child(InnerT *inner, uint64_t c) {
+	std::string out;
+	for (auto *slot = inner->slots_begin(); slot < inner->slots_end(); ++slot)
+		if (slot->child == c) {
+			out += " child" + std::to_string(c) + " st" + std::to_string((int)slot->state_and_offset.get_state());
+			if constexpr (requires { uint64_t(slot->get_key(inner->get_data())); })
+				out += " key" + std::to_string(uint64_t(slot->get_key(inner->get_data())));
+		}
+	if (inner->upper == c) out += " upper" + std::to_string(c);
+	return out;
+}
+template <typename InnerT> std::string dbg_inner(InnerT *inner) {
+	std::string out = " lvl" + std::to_string(inner->level) + " sc=" + std::to_string(inner->slot_count) + " [";
+	for (auto *slot = inner->slots_begin(); slot < inner->slots_end(); ++slot) {
+		if constexpr (requires { uint64_t(slot->get_key(inner->get_data())); })
+			out += std::to_string(uint64_t(slot->get_key(inner->get_data())));
+		out += ":p" + std::to_string(slot->child) + "/st" + std::to_string((int)slot->state_and_offset.get_state()) + " ";
+	}
+	out += "] upper p" + std::to_string(inner->upper);
+	return out;
+}
 } // namespace bbbtree
\ No newline at end of file
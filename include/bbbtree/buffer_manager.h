@@ -3,8 +3,10 @@
 #include "bbbtree/file.h"
 #include "bbbtree/types.h"
 // -----------------------------------------------------------------
+#include <deque>
 #include <exception>
 #include <map>
+#include <span>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
@@ -20,7 +22,20 @@ enum class State {
 			   // overwrite NEW state.
 };
 // -----------------------------------------------------------------
+/// How a page is going to be accessed. Pages loaded by scans or one-time
+/// traversals are cold and evicted before the others, so that the pages of the
+/// working set stay buffered.
+enum class AccessHint {
+	NORMAL,		// The page may be accessed again soon.
+	SEQUENTIAL, // The page is part of a scan. Cold pages are evicted in the
+				// order they were loaded, so a scan recycles few frames.
+	ONCE,		// The page is not accessed again soon, e.g. by statistics.
+				// Evicted first.
+};
+// -----------------------------------------------------------------
 class BufferFrame;
+class PageJournal;
+class WriteAheadLog;
 // -----------------------------------------------------------------
 /// User-specific page logic that is called when a page is loaded or unloaded by
 /// the buffer manager.
@@ -33,10 +48,35 @@ class PageLogic {
 							   size_t page_size) = 0;
 	/// The function to call after the page was loaded from disk.
 	virtual void after_load(char *data, PageID page_id) = 0;
+	/// The function to call before a clean page is fixed exclusively, i.e.
+	/// before it may be modified. Finishes changes deferred by `after_load`.
+	virtual void prepare(char * /*data*/, PageID /*page_id*/,
+						 size_t /*page_size*/) {}
+	/// Returns the changes to the buffered page that `after_load` deferred.
+	/// Readers consult them on top of the page. The page logic may apply them
+	/// now instead and return none. Empty by default.
+	virtual std::span<const std::byte>
+	get_pending(char * /*data*/, PageID /*page_id*/, size_t /*page_size*/) {
+		return {};
+	}
 	/// Virtual destructor.
 	virtual ~PageLogic() = default;
 };
 // -----------------------------------------------------------------
+/// A user of the buffer manager that keeps changes to its pages in memory on
+/// its own, e.g. a tree that caches its deltas. The buffer manager detaches
+/// its clients before it is destroyed, so that they can write their pages
+/// back while it still exists.
+class BufferClient {
+  public:
+	/// The function to call before the buffer manager is destroyed. Writes
+	/// back the pages of the client. The client must not use the buffer
+	/// manager afterwards.
+	virtual void detach() = 0;
+	/// Virtual destructor.
+	virtual ~BufferClient() = default;
+};
+// -----------------------------------------------------------------
 class BufferFrame {
   private:
 	/// The segment's ID.
@@ -55,6 +95,12 @@ class BufferFrame {
 	PageLogic *page_logic = nullptr;
 	/// Whether this frame belongs to a delta tree.
 	bool is_delta_tree = false;
+	/// The LSN of the last log record that may have changed the page. The
+	/// page is not written out before the log is flushed up to it.
+	LSN lsn = 0;
+	/// Whether the page was loaded with a hint other than `NORMAL` and not
+	/// fixed normally since. Cold pages are evicted first.
+	bool is_cold = false;
 
 	friend class BufferManager;
 
@@ -120,7 +166,7 @@ class BufferManager {
 	/// @param[in] clear Resets all files before loading.
 	explicit BufferManager(size_t page_size, size_t page_count,
 						   bool clear = false);
-	/// Destructor. Writes all dirty pages to disk.
+	/// Destructor. Detaches all clients and writes all dirty pages to disk.
 	~BufferManager();
 
 	/// Copy Constructor.
@@ -135,17 +181,78 @@ class BufferManager {
 	/// Get a page from the buffer by page ID and segment ID.
 	/// Expects a pure page ID, not a tuple ID (TID).
 	/// If given, page_logic is stored in the frame and called after
-	/// loading/before unloading the page again.
+	/// loading/before unloading the page again. Clean pages are prepared by
+	/// the page logic when fixed exclusively. Unless `hint` is `NORMAL`, a
+	/// page that is loaded is cold. A cold page fixed normally becomes warm.
 	BufferFrame &fix_page(SegmentID segment_id, PageID page_id, bool exclusive,
-						  PageLogic *page_logic, bool is_delta_tree);
+						  PageLogic *page_logic, bool is_delta_tree,
+						  AccessHint hint = AccessHint::NORMAL);
 
 	/// Releases a page. If dirty, its written to disk eventually.
 	void unfix_page(BufferFrame &frame, bool is_dirty);
+	/// Loads the pages of a segment from `first_page` on that are not buffered
+	/// yet with a single read, e.g. ahead of a sequential scan. The pages are
+	/// not fixed and cold as if loaded with `SEQUENTIAL`. Loads at most a
+	/// quarter of the frames, so that the pages are still buffered when they
+	/// are fixed. Returns the number of pages covered, at most `num_pages`.
+	size_t prefetch(SegmentID segment_id, PageID first_page, size_t num_pages,
+					PageLogic *page_logic);
+	/// Copies `num_pages` pages of a segment from `first_page` on into `dst`
+	/// with a single read, without buffering them. Buffered pages stay and are
+	/// copied from their frames, since they may be newer. The page logic is
+	/// called on the pages read from disk as after loading. Pages that do not
+	/// exist yet are zeroed.
+	void read_pages(SegmentID segment_id, PageID first_page, size_t num_pages,
+					char *dst, PageLogic *page_logic);
+
+	/// Writes a dirty page to disk now and keeps it buffered as clean. The
+	/// page logic is called as on eviction. The page must not be fixed.
+	void flush_page(BufferFrame &frame);
+
+	/// Writes all dirty pages to disk and keeps them buffered as clean, e.g.
+	/// for a checkpoint. Pages dirtied by the page logic meanwhile are written
+	/// as well. No page must be fixed.
+	void flush_all();
+	/// Blocks until all pages written out so far are on stable storage, e.g.
+	/// before a checkpoint refers to them.
+	void sync_all();
+
+	/// Takes `num_frames` frames out of the buffer pool, e.g. to account for
+	/// memory that a page logic caches on its own. Evicts pages if necessary.
+	/// The frames stay reserved for the lifetime of the buffer manager.
+	void reserve_frames(size_t num_frames);
 
 	/// Clears the buffer.
 	/// If write_back is true, all dirty pages are written to disk first.
 	/// Otherwise, all data is lost, e.g. for benchmarking.
 	void clear_all(bool write_back = true);
+	/// Clears the pages of segment `segment_id` from the buffer and writes the
+	/// dirty ones to disk first. Pages of other segments stay buffered unless
+	/// evicted meanwhile. No page of the segment must be fixed.
+	void clear_segment(SegmentID segment_id);
+	/// Drops all pages without writing them back and keeps the files, as if
+	/// the process crashed. The page logic is not called. No page must be
+	/// fixed.
+	void discard_all();
+	/// Returns the number of pages of segment `segment_id` loaded or written
+	/// so far.
+	size_t get_page_io(SegmentID segment_id) const {
+		auto it = segment_page_io.find(segment_id);
+		return it == segment_page_io.end() ? 0 : it->second;
+	}
+	/// Registers a client that is detached before the buffer manager is
+	/// destroyed.
+	void register_client(BufferClient &client) { clients.push_back(&client); }
+	/// Unregisters a client, e.g. when it is destroyed first.
+	void unregister_client(BufferClient &client) {
+		std::erase(clients, &client);
+	}
+	/// Sets the write-ahead log that is flushed before a changed page is
+	/// written out. Unset with nullptr.
+	void set_write_ahead_log(WriteAheadLog *log) { this->log = log; }
+	/// Sets the page journal that saves the image of a page on disk before
+	/// the page is overwritten. Unset with nullptr.
+	void set_page_journal(PageJournal *journal) { this->journal = journal; }
 	/// The size of each page in the buffer.
 	const size_t page_size;
 
@@ -164,8 +271,14 @@ class BufferManager {
 	BufferFrame &get_free_frame();
 	/// Evicts a page from the buffer. Assumes that no frame is free. Returns
 	/// true if a page was evicted successfully. Eviction could fail e.g. when
-	/// all pages are currently fixed. TODO: Not thread-safe.
+	/// all pages are currently fixed. Cold pages are evicted first, the others
+	/// at random. TODO: Not thread-safe.
 	bool evict();
+	/// Evicts the first cold page that is not fixed. Returns false if there is
+	/// none.
+	bool evict_cold();
+	/// Marks a loaded page as cold according to `hint`.
+	void make_cold(BufferFrame &frame, AccessHint hint);
 	/// Write a page to disk.
 	void write();
 
@@ -174,6 +287,11 @@ class BufferManager {
 	File &get_segment(SegmentID segment_id);
 	/// Loads a page into a frame.
 	void load(BufferFrame &frame, SegmentID segment_id, PageID page_id);
+	/// Reads the pages of a segment from `first_page` on that exist on disk
+	/// with a single read into `dst`. Returns the number of pages read, at most
+	/// `num_pages`.
+	size_t read_run(SegmentID segment_id, PageID first_page, size_t num_pages,
+					char *dst);
 	/// Unloads a frame's page do disk.
 	/// Returns false when unloading was not allowed by the page logic.
 	bool unload(BufferFrame &frame);
@@ -195,11 +313,25 @@ class BufferManager {
 	std::unordered_map<PageID, BufferFrame *> id_to_frame;
 	// Tracks pointers to unused BufferFrames.
 	std::vector<BufferFrame *> free_buffer_frames;
+	// Tracks pointers to BufferFrames taken out of the pool.
+	std::vector<BufferFrame *> reserved_buffer_frames;
+	// The cold frames in eviction order with the page (including segment ID)
+	// they were cold for. Entries of frames that were evicted or fixed normally
+	// since are skipped.
+	std::deque<std::pair<BufferFrame *, PageID>> cold_frames;
 	// Maps a Segment to its corresponding file. We use a `map` for pointer
 	// stability.
 	std::map<SegmentID, std::unique_ptr<File>> segment_to_file;
 	// Whether a file is reset before loaded.
 	bool clear;
+	// The number of pages loaded or written per segment.
+	std::unordered_map<SegmentID, size_t> segment_page_io;
+	// The write-ahead log of the changes to the pages, if any.
+	WriteAheadLog *log = nullptr;
+	// The journal of the pages overwritten since the last checkpoint, if any.
+	PageJournal *journal = nullptr;
+	// The clients to detach before the buffer manager is destroyed.
+	std::vector<BufferClient *> clients;
 };
 // -----------------------------------------------------------------
 inline std::ostream &operator<<(std::ostream &os, const BufferFrame &frame) {
@@ -228,7 +360,8 @@ inline std::ostream &operator<<(std::ostream &os, const BufferFrame &frame) {
 inline std::ostream &operator<<(std::ostream &os, const BufferManager &bm) {
 	os << "BufferManager: page_size=" << bm.page_size
 	   << ", page_count=" << bm.page_frames.size()
-	   << ", free_frames=" << bm.free_buffer_frames.size() << "\n";
+	   << ", free_frames=" << bm.free_buffer_frames.size()
+	   << ", reserved_frames=" << bm.reserved_buffer_frames.size() << "\n";
 	os << "Buffer Pool:\n";
 	for (const auto &[segment_page_id, frame_ptr] : bm.id_to_frame) {
 		assert(frame_ptr->is_defined());
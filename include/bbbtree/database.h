@@ -1,18 +1,24 @@
 #pragma once
 
 #include "bbbtree/buffer_manager.h"
+#include "bbbtree/journal.h"
+#include "bbbtree/record_delta_tree.h"
 #include "bbbtree/segment.h"
 #include "bbbtree/types.h"
+#include "bbbtree/wal.h"
 // -----------------------------------------------------------------
 #include <concepts>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
 #include <vector>
 // -----------------------------------------------------------------
 // TODO: Rethink `logic_errors` and which error makes more sense to throw.
-// TODO: Maybe store tuples directly in B-Tree and do not redirect via TID.
-// TODO: Create a metadata page that stores all state for all segments. That
-// way, not each BTree has to store its state on its own page, wasting space in
-// the buffer.
+// TODO: The metadata segment keeps the state of all trees at checkpoints. Drop
+// the state each BTree keeps on its own page, wasting space in the buffer.
 // -----------------------------------------------------------------
 namespace bbbtree {
 // -----------------------------------------------------------------
@@ -28,17 +34,26 @@ static const constexpr SegmentID FSI_SEGMENT_ID = 0;
 static const constexpr SegmentID SP_SEGMENT_ID = 1;
 static const constexpr SegmentID INDEX_SEGMENT_ID = 2;
 static const constexpr SegmentID DELTA_SEGMENT_ID = 3;
+static const constexpr SegmentID RECORD_DELTA_SEGMENT_ID = 4;
+static const constexpr SegmentID METADATA_SEGMENT_ID = 5;
+static const constexpr SegmentID LOG_SEGMENT_ID = 6;
+static const constexpr SegmentID JOURNAL_SEGMENT_ID = 7;
+// -----------------------------------------------------------------
+/// The values of a database's index: TIDs of the records or, if clustered, the
+/// value and payload of the tuples themselves.
+template <bool IsClustered>
+using IndexValue = std::conditional_t<IsClustered, String, TID>;
 // -----------------------------------------------------------------
 /// A concept that requires some member functions from an index mapping a key to
-/// TIDs.
+/// `IndexValueT`.
 template <template <typename, typename, bool = false> class IndexT,
-		  typename KeyT>
+		  typename KeyT, typename IndexValueT>
 concept IndexInterface =
-	requires(IndexT<KeyT, TID> index, const KeyT &key, const TID &value,
-			 size_t page_size, SegmentID segment_id,
+	requires(IndexT<KeyT, IndexValueT> index, const KeyT &key,
+			 const IndexValueT &value, size_t page_size, SegmentID segment_id,
 			 BufferManager &buffer_manager, float wa_threshold) {
-		{ IndexT<KeyT, TID>(segment_id, buffer_manager, wa_threshold) };
-		{ index.lookup(key) } -> std::same_as<std::optional<TID>>;
+		{ IndexT<KeyT, IndexValueT>(segment_id, buffer_manager, wa_threshold) };
+		{ index.lookup(key) } -> std::same_as<std::optional<IndexValueT>>;
 		{ index.erase(key, page_size) } -> std::same_as<void>;
 		{ index.insert(key, value) } -> std::same_as<bool>;
 		{ index.update(key, value) } -> std::same_as<void>;
@@ -46,40 +61,86 @@ concept IndexInterface =
 // -----------------------------------------------------------------
 /// A Database maintains a single table of keys and values. The schema is
 /// fixated at compile-time. It is templated on its index, which maps `KeyT` to
-/// TIDs. The value type is always the same.
+/// TIDs. The value type is always the same. If `IsClustered`, the index stores
+/// the tuples in its leaves instead and the slotted pages stay empty. Point
+/// operations then access only the index and buffered index deltas cover the
+/// changed tuples as well. The index must support `upsert`.
 template <template <typename, typename, bool = false> typename IndexT,
-		  typename KeyT>
-	requires IndexInterface<IndexT, KeyT>
+		  typename KeyT, bool IsClustered = false>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
 class Database {
   public:
-	/// A Tuple with key and value that are stored in the database.
-	/// TODO: Make keys variable-sized.
+	/// A Tuple with key, value and a payload of variable size that are stored
+	/// in the database. A tuple must fit on a page, or into a quarter of a page
+	/// if clustered so that index leaves hold several tuples.
 	struct Tuple {
 		KeyT key;
 		ValueT value;
+		std::string payload{};
 
 		/// Spaceship operator.
 		auto operator<=>(const Tuple &) const = default;
-		size_t size() const { return sizeof(key) + sizeof(value); }
+		/// The size of the stored record: the key's size, the key, the value
+		/// and the payload.
+		size_t size() const {
+			return sizeof(uint16_t) + key.size() + sizeof(value) +
+				   payload.size();
+		}
 	};
 
-	/// Constructor.
+	/// Constructor. Changed records of slotted pages are buffered if they
+	/// make up less than `wa_threshold` of the page. Unless `reset`, the
+	/// database is opened as of its last checkpoint. Pages overwritten since
+	/// are restored from the page journal first. If `is_logged`, inserts,
+	/// updates and erases are logged in a write-ahead log and the committed
+	/// ones are redone on open. A logged database must always be opened
+	/// logged.
 	Database(size_t page_size, size_t num_pages, float wa_threshold,
-			 bool reset);
+			 bool reset, bool is_logged = false);
+	/// Destructor. Writes out the pages with buffered records and checkpoints.
+	~Database();
+
+	/// Persists all changes and then the state of all trees as a new version.
+	/// Pages stay buffered. Only pages with many changes are written out. The
+	/// changes of the others are buffered as deltas. After a crash, the
+	/// database is opened as of the last checkpoint. The log is truncated.
+	void checkpoint();
+	/// Blocks until the logged operations so far are durable. Concurrent
+	/// commits share a single log write. Changed pages stay in memory.
+	void commit();
+	/// Drops everything that is not durable, as if the process crashed. The
+	/// database must not be used afterwards. For testing.
+	void crash();
 
 	/// Inserts a tuple into the database.
-	/// TODO: Allow insert of variable sized tuples.
 	void insert(const Tuple &tuple);
 	/// Inserts tuples into the database.
-	/// Tuple keys must not be already present in database.
+	/// Tuple keys must not be already present in database. An empty index is
+	/// bulk loaded if it supports it.
 	void insert(const std::vector<Tuple> &tuples);
-	/// Reads a value by key from the database.
+	/// Reads a value by key from the database. The tuple's key is `key`.
 	Tuple get(const KeyT &key);
-	/// Deletes a tuple by key from the database.
-	/// TODO: Implement erase.
+	/// Reads the tuples for the given keys in the same order. Index lookups
+	/// share their traversals if the index supports batches.
+	std::vector<Tuple> get(const std::vector<KeyT> &keys);
+	/// Deletes a tuple by key from the database. Its record's space and slot
+	/// are reused by later inserts.
 	void erase(const KeyT &key);
-	/// Updates a tuple by key in the database.
+	/// Updates a tuple by key in the database. Its payload may change its
+	/// size. The record is resized and keeps its TID. A clustered index
+	/// replaces the tuple in its leaf.
 	void update(const Tuple &tuple);
+	/// Updates tuples by key in the database. Index accesses share their
+	/// traversals if the index supports batches.
+	void update(const std::vector<Tuple> &tuples);
+	/// Calls `visit(tuple)` for each tuple in the order of the slotted pages
+	/// without using the index. The pages are read ahead sequentially. If
+	/// `bypass_buffer`, they are not buffered, so that the buffered pages
+	/// stay. The tuple's key may refer to a page and is only valid during the
+	/// call. A clustered database visits its index leaves in key order
+	/// instead. `visit` must not change the database.
+	void scan(const std::function<void(const Tuple &)> &visit,
+			  bool bypass_buffer = false);
 	/// Returns the number of tuples stored in the database.
 	size_t size() { return index.size(); }
 	/// Sets the heights of the underlying index in the stats.
@@ -87,8 +148,12 @@ class Database {
 
 	void clear(bool write_back = false) {
 		buffer_manager.clear_all(write_back);
+		journal.truncate(metadata.get_version());
 		space_inventory.clear();
+		record_deltas.clear();
 		index.clear();
+		if (log)
+			log->truncate();
 	}
 	void clear_bm(bool write_back) { buffer_manager.clear_all(write_back); }
 
@@ -97,12 +162,50 @@ class Database {
 	/// member to ensure that it is destructed last. Other members might have
 	/// pages to persist in their destructor.
 	BufferManager buffer_manager;
+	/// The state of all trees as of the last checkpoint.
+	MetadataSegment metadata;
+	/// The log of the operations since the last checkpoint, if logged.
+	std::unique_ptr<WriteAheadLog> log;
+	/// Saves the pages overwritten since the last checkpoint. Constructed
+	/// before the segments, so that it rolls them back before they are read.
+	PageJournal journal;
 	/// The Free-Space-Inventory segment.
 	FSISegment space_inventory;
+	/// Buffers the changed records of evicted slotted pages.
+	RecordDeltaTree record_deltas;
 	/// The Slotted Pages segment.
 	SPSegment records;
-	/// The access path. Maps keys to their tuple IDs (`TID`).
-	IndexT<KeyT, TID> index;
+	/// The access path. Maps keys to their tuple IDs (`TID`), or to the
+	/// serialized tuples without their keys if clustered.
+	IndexT<KeyT, IndexValue<IsClustered>> index;
+
+	/// Opens the trees as of the last checkpoint and validates the buffered
+	/// deltas against the allocated pages. Then redoes the logged operations.
+	void recover();
+	/// Serializes the tuple into `buffer` as its stored record.
+	std::span<const std::byte> serialize(const Tuple &tuple);
+	/// Deserializes a stored record. The key refers to `record`.
+	static Tuple deserialize(std::span<const std::byte> record);
+	/// Returns the part of a serialized tuple that a clustered index stores:
+	/// the value and the payload. Refers to `record`.
+	static String get_index_value(std::span<const std::byte> record);
+	/// Reads the tuple of `key` from its value in a clustered index.
+	static Tuple from_index_value(const KeyT &key, const String &value);
+	/// Reads the tuple of `key` stored at `tid`.
+	Tuple read(const KeyT &key, TID tid);
+	/// Returns whether the record `tid` holds the tuple of `key`.
+	bool holds(TID tid, const KeyT &key);
+	/// Logs an operation on the serialized tuple unless it is being redone.
+	void log_tuple(LogRecordType type, std::span<const std::byte> record);
+	/// Redoes a logged operation.
+	void redo(LogRecordType type, std::span<const std::byte> payload);
+
+	/// Holds a serialized tuple or a read record.
+	std::vector<std::byte> buffer;
+	/// Whether logged operations are being redone.
+	bool is_replaying = false;
+	/// Whether the database crashed. Nothing is written out anymore.
+	bool is_crashed = false;
 };
 
 } // namespace bbbtree
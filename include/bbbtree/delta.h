@@ -3,8 +3,14 @@
 #include "bbbtree/btree.h"
 #include "bbbtree/types.h"
 
+#include <cassert>
 #include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 
 namespace bbbtree {
 // -----------------------------------------------------------------
@@ -15,12 +21,17 @@ using PID = UInt64;
 /// Forward declarations.
 template <KeyIndexable KeyT, ValueIndexable ValueT> struct Delta;
 template <KeyIndexable KeyT, ValueIndexable ValueT> struct Deltas;
+template <KeyIndexable KeyT, ValueIndexable ValueT> struct DeltasView;
+template <KeyIndexable KeyT, ValueIndexable ValueT> class DeltaStore;
 template <KeyIndexable KeyT, ValueIndexable ValueT> class DeltaTree;
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
 std::ostream &operator<<(std::ostream &os, const Delta<KeyT, ValueT> &type);
 template <KeyIndexable KeyT, ValueIndexable ValueT>
 std::ostream &operator<<(std::ostream &os, const Deltas<KeyT, ValueT> &type);
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+std::ostream &operator<<(std::ostream &os,
+						 const DeltasView<KeyT, ValueT> &type);
 // -----------------------------------------------------------------
 /// A Delta is a change that was applied to an entry.
 template <KeyIndexable KeyT, ValueIndexable ValueT> struct Delta {
@@ -44,13 +55,18 @@ template <KeyIndexable KeyT, ValueIndexable ValueT> struct Delta {
 	/// Constructor for leaf deltas.
 	Delta(OperationType op, KeyT key, ValueT value)
 		: entry{std::move(key), std::move(value)}, op(op) {}
+	/// Constructor for delete deltas. Only the key is stored.
+	Delta(OperationType op, KeyT key)
+		: entry{std::move(key), ValueT{}}, op(op) {
+		assert(op == OperationType::Deleted);
+	}
 
 	/// The entry that was changed.
 	Entry entry;
 	/// The type of operation.
 	OperationType op;
 
-	/// Size of the serialized value.
+	/// Size of the serialized value. Delete deltas omit the value.
 	uint16_t size() const;
 	/// Serializes this type into bytes to store on pages.
 	void serialize(std::byte *dst) const;
@@ -64,7 +80,13 @@ template <KeyIndexable KeyT, ValueIndexable ValueT> struct Delta {
 									   const Delta<KeyT, ValueT> &);
 };
 // -----------------------------------------------------------------
-/// Deltas to be stored as values in a delta BTree.
+/// Deltas to be stored as values in a delta BTree. Serialized compactly: the
+/// header's integers are varints and the operations are packed into a bitmap
+/// of two bits each. Keys are encoded against the previous key, integer keys
+/// as zigzag varint differences and string keys as the length of the prefix
+/// shared with the previous key and the remaining suffix. Integer values are
+/// varints. Deserialized deltas own their strings and do not point into the
+/// serialized bytes.
 template <KeyIndexable KeyT, ValueIndexable ValueT> struct Deltas {
 	using LeafDelta = Delta<KeyT, ValueT>;
 	using InnerNodeDelta = Delta<KeyT, PID>;
@@ -92,17 +114,26 @@ template <KeyIndexable KeyT, ValueIndexable ValueT> struct Deltas {
 
 	bool is_leaf() const { return std::holds_alternative<LeafDeltas>(deltas); }
 
-	/// Spaceship operator.
-	auto operator<=>(const Deltas &) const = default;
+	/// Equality operator. Ignores where strings are stored.
+	bool operator==(const Deltas &other) const {
+		return deltas == other.deltas && upper == other.upper &&
+			   slot_count == other.slot_count &&
+			   cached_size == other.cached_size;
+	}
 	/// Prints the deltas.
 	friend std::ostream &operator<< <>(std::ostream &os,
 									   const Deltas<KeyT, ValueT> &);
 
-	friend DeltaTree<KeyT, ValueT>;
-
   private:
 	/// Returns the number of deltas.
 	uint16_t num_deltas() const;
+	/// Encodes the deltas into `dst` and returns the number of bytes. Only
+	/// counts the bytes if `dst` is nullptr.
+	uint16_t encode(std::byte *dst) const;
+	/// Decodes `num_deltas` entries. Strings are stored in `strings`.
+	template <typename NodeDeltasT>
+	static NodeDeltasT decode(const std::byte *src, uint16_t num_deltas,
+							  std::vector<std::string> &strings);
 
 	/// The deltas extracted from BTree nodes. May be from leaf or inner nodes.
 	/// Leaf nodes store keys and values, inner nodes store keys and PIDs.
@@ -114,6 +145,136 @@ template <KeyIndexable KeyT, ValueIndexable ValueT> struct Deltas {
 
 	/// Cached size of the serialized deltas.
 	uint16_t cached_size;
+	/// Owns the strings of deserialized deltas. Shared between copies.
+	std::shared_ptr<const std::vector<std::string>> strings;
+};
+// -----------------------------------------------------------------
+/// The header of serialized deltas.
+struct DeltasHeader {
+	/// The number of deltas.
+	uint16_t num_deltas;
+	/// The number of slots in the node at evict time.
+	uint16_t slot_count;
+	/// Whether the deltas belong to a leaf.
+	bool is_leaf;
+	/// Inner nodes store the upper page ID.
+	PageID upper{0};
+
+	/// Encodes the header into `dst` and returns the number of bytes. Only
+	/// counts the bytes if `dst` is nullptr.
+	size_t encode(std::byte *dst) const;
+	/// Decodes a header and advances `src` past it.
+	static DeltasHeader decode(const std::byte *&src);
+};
+// -----------------------------------------------------------------
+/// Encodes deltas one at a time in the format of `Deltas`, e.g. straight from
+/// the slots of a node. Only counts the bytes if `dst` is nullptr. Keys and
+/// values must stay valid until the next delta is added.
+template <KeyIndexable KeyT, ValueIndexable EntryValueT> class DeltaEncoder {
+  public:
+	/// Encodes the header. Exactly `header.num_deltas` deltas must be added.
+	DeltaEncoder(std::byte *dst, const DeltasHeader &header);
+
+	/// Encodes the next delta. Deletes do not store the value.
+	void add(OperationType op, const KeyT &key, const EntryValueT &value);
+	/// Returns the number of bytes encoded so far.
+	size_t size() const { return n; }
+	/// Returns an upper bound of the bytes for `num_deltas` deltas whose keys
+	/// and values take `num_entry_bytes` bytes unencoded.
+	static size_t get_max_size(uint16_t num_deltas, size_t num_entry_bytes) {
+		// Varints take up to 10 bytes. The header has three and each delta
+		// at most two besides the bytes of its key and value.
+		return 3 * 10 + 1 + (num_deltas + 3) / 4 + num_deltas * 2 * 10 +
+			   num_entry_bytes;
+	}
+
+  private:
+	/// Returns the position of the next byte or nullptr if only counting.
+	std::byte *at() const { return dst ? dst + n : nullptr; }
+
+	/// The encoded bytes or nullptr.
+	std::byte *dst;
+	/// The bitmap of operations, two bits each.
+	std::byte *ops;
+	/// The number of bytes encoded so far.
+	size_t n;
+	/// The number of deltas added so far.
+	uint16_t num_added = 0;
+	/// The previous integer key.
+	uint64_t prev_key = 0;
+	/// The previous string key.
+	std::string_view prev_view;
+};
+// -----------------------------------------------------------------
+/// Decodes the entries of serialized deltas one at a time without
+/// materializing them. Decoded string keys live in `key_buffer` and are only
+/// valid until the next delta is decoded. Decoded string values point into the
+/// serialized bytes.
+template <KeyIndexable KeyT, ValueIndexable EntryValueT> class DeltaDecoder {
+  public:
+	/// Decodes the `num_deltas` entries at `src`, which follow the header.
+	DeltaDecoder(const std::byte *src, uint16_t num_deltas,
+				 std::string &key_buffer);
+
+	/// Decodes the next delta. Deletes have a default value.
+	Delta<KeyT, EntryValueT> next();
+	/// Returns true if all deltas were decoded.
+	bool done() const { return num_decoded == num_deltas; }
+	/// Returns the number of deltas with the given operation.
+	uint16_t count(OperationType op) const;
+	/// Returns the position behind the deltas decoded so far.
+	const std::byte *get_position() const { return src; }
+
+  private:
+	/// The bitmap of operations, two bits each.
+	const std::byte *ops;
+	/// The next delta to decode.
+	const std::byte *src;
+	/// The number of deltas.
+	uint16_t num_deltas;
+	/// The number of deltas decoded so far.
+	uint16_t num_decoded = 0;
+	/// The previous integer key.
+	uint64_t prev_key = 0;
+	/// Holds the previous string key.
+	std::string &key_buffer;
+};
+// -----------------------------------------------------------------
+/// A view on serialized deltas. Serves as the value of delta trees so that
+/// deltas are copied into and applied straight from their leaves. Does not own
+/// the bytes, just like `String`.
+template <KeyIndexable KeyT, ValueIndexable ValueT> struct DeltasView {
+	/// Default Constructor.
+	DeltasView() = default;
+	/// Constructor.
+	explicit DeltasView(std::span<const std::byte> bytes) : bytes(bytes) {}
+
+	/// Number of bytes of the serialized deltas.
+	uint16_t size() const { return bytes.size(); }
+	/// Copies the serialized deltas into `dst`.
+	void serialize(std::byte *dst) const;
+	/// Returns a view on the serialized deltas at `src`.
+	static DeltasView deserialize(const std::byte *src, uint16_t n) {
+		return DeltasView({src, n});
+	}
+
+	/// Returns the serialized deltas.
+	std::span<const std::byte> get_bytes() const { return bytes; }
+	/// Decodes the header.
+	DeltasHeader get_header() const {
+		const auto *src = bytes.data();
+		return DeltasHeader::decode(src);
+	}
+
+	/// Equality operator. Compares the serialized deltas.
+	bool operator==(const DeltasView &other) const;
+	/// Prints the deltas.
+	friend std::ostream &operator<< <>(std::ostream &os,
+									   const DeltasView<KeyT, ValueT> &);
+
+  private:
+	/// The serialized deltas.
+	std::span<const std::byte> bytes;
 };
 // -----------------------------------------------------------------
-} // namespace bbbtree
\ No newline at end of file
+} // namespace bbbtree
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "bbbtree/delta.h"
+#include "bbbtree/types.h"
+
+#include <cstddef>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+/// A bounded in-memory cache of the deltas of BTree nodes, keyed by the
+/// nodes' PIDs. Once the cached deltas exceed the capacity, the least recently
+/// used entries are popped by the owner. Dirty entries hold deltas that are
+/// not stored anywhere else yet. Entries keep the serialized deltas.
+template <KeyIndexable KeyT, ValueIndexable ValueT> class DeltaCache {
+	using DeltasT = DeltasView<KeyT, ValueT>;
+
+  public:
+	/// A cached entry.
+	struct Entry {
+		/// The PID of the node the deltas belong to.
+		PageID page_id;
+		/// The serialized deltas of the node.
+		std::vector<std::byte> bytes;
+		/// Whether the deltas must be stored when the entry is popped.
+		bool is_dirty;
+	};
+
+	/// Constructor. `capacity` is the budget in bytes.
+	explicit DeltaCache(size_t capacity) : capacity(capacity) {}
+
+	/// Returns the cached deltas of the node, if any. Marks them as most
+	/// recently used. The view is valid until the cache is modified.
+	std::optional<DeltasT> find(PageID page_id);
+	/// Caches a copy of the deltas of the node, replacing those cached before.
+	/// A clean entry does not turn a dirty one clean.
+	void put(PageID page_id, DeltasT deltas, bool is_dirty);
+	/// Drops the cached deltas of the node, if any.
+	void erase(PageID page_id);
+	/// Removes and returns the least recently used entry. The cache must not
+	/// be empty.
+	Entry pop();
+	/// Drops all entries.
+	void clear();
+	/// Marks all entries as clean. Returns copies of the entries that were
+	/// dirty, e.g. to store them before a checkpoint.
+	std::vector<Entry> clean();
+
+	/// Returns true if the cached entries exceed the capacity.
+	bool is_full() const { return num_bytes > capacity; }
+	/// Returns true if the cache may hold any entries.
+	bool is_enabled() const { return capacity > 0; }
+	/// Returns the number of cached entries.
+	size_t size() const { return entries.size(); }
+	/// Returns the number of bytes accounted for the cached entries.
+	size_t get_num_bytes() const { return num_bytes; }
+
+	/// The budget of the cache in bytes.
+	const size_t capacity;
+
+  private:
+	/// Returns the number of bytes accounted for an entry.
+	static size_t get_size(const Entry &entry) {
+		return sizeof(Entry) + entry.bytes.size();
+	}
+
+	/// The cached entries. The most recently used entry is in front.
+	std::list<Entry> entries;
+	/// Locates the cached entry of each PID.
+	std::unordered_map<PageID, typename std::list<Entry>::iterator> index;
+	/// The number of bytes accounted for all cached entries.
+	size_t num_bytes = 0;
+};
+// -----------------------------------------------------------------
+} // namespace bbbtree
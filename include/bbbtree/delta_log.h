@@ -0,0 +1,174 @@
+#pragma once
+
+#include "bbbtree/bbbtree.h"
+#include "bbbtree/buffer_manager.h"
+#include "bbbtree/delta.h"
+#include "bbbtree/segment.h"
+#include "bbbtree/types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT> class DeltaLog;
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+std::ostream &operator<<(std::ostream &os, const DeltaLog<KeyT, ValueT> &log);
+// -----------------------------------------------------------------
+/// A delta log appends the serialized deltas of evicted BTree nodes to the
+/// pages of its segment. A deferred eviction only dirties the log's tail
+/// instead of a random delta tree leaf, so log pages are written out
+/// sequentially and once they are full. An in-memory map locates the latest
+/// record of each PID. Records that were superseded by a newer record or by
+/// writing out their node are garbage. Garbage is collected incrementally
+/// while appending by moving the live records of the emptiest log page to the
+/// tail and re-using the page. In grouped mode, the tail is packed in memory
+/// and written out once as a whole page, so deltas of many evicted nodes share
+/// a single page write. The map is not persisted, so the deltas are written
+/// back into their nodes before the log is closed.
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+class DeltaLog : public DeltaStore<KeyT, ValueT>, public Segment {
+	using DeltasT = DeltaStore<KeyT, ValueT>::DeltasT;
+	using Node = DeltaStore<KeyT, ValueT>::Node;
+
+  public:
+	/// Constructor.
+	DeltaLog(SegmentID segment_id, BufferManager &buffer_manager,
+			 float wa_threshold)
+		: DeltaStore<KeyT, ValueT>(wa_threshold),
+		  Segment(segment_id, buffer_manager) {}
+
+	/// Appends the deltas of the given BTree node to the log instead of
+	/// writing the node out. Returns true if the node must be written out.
+	bool before_unload(char *data, const State &state, PageID page_id,
+					   size_t page_size) override;
+	/// Reads the latest record for the given node and applies its deltas.
+	void after_load(char *data, PageID page_id) override;
+
+	/// Moves the live records of the log page with the fewest live bytes to
+	/// the tail and frees the page. Returns false if no page was freed.
+	bool collect_garbage();
+
+	/// Returns the number of bytes of records that are still in use.
+	size_t get_live_bytes() const { return live_bytes; }
+	/// Returns the number of bytes of superseded records.
+	size_t get_garbage_bytes() const { return log_bytes - live_bytes; }
+	/// Returns the number of pages holding records.
+	size_t get_num_pages() const { return pages.size(); }
+
+	/// Drops all records. Log pages are re-used from the start.
+	void clear();
+	/// Writes out all nodes of segment `segment_id` with buffered deltas and
+	/// disables buffering. Called before the buffer is written back for good,
+	/// since the records are only located in memory.
+	void write_back(SegmentID segment_id);
+
+	/// Packs the tail in memory instead of a buffered page. The memory of one
+	/// frame is taken out of the buffer pool. Each log page is written once
+	/// it is full.
+	void enable_grouping();
+	/// Writes the records of the group packed so far out as a page. Appends
+	/// continue on the same page.
+	void flush();
+
+	/// Disables buffering. Nodes are always written out.
+	void disable_buffering() { buffering_enabled = false; }
+	/// Enables buffering.
+	void enable_buffering() { buffering_enabled = true; }
+
+	/// Prints the log.
+	friend std::ostream &operator<< <>(std::ostream &os,
+									   const DeltaLog<KeyT, ValueT> &log);
+
+	/// Garbage is collected while it makes up more than this fraction of the
+	/// bytes in the log.
+	static constexpr float gc_threshold = 0.5;
+
+  protected:
+	size_t get_store_page_io() const override {
+		return buffer_manager.get_page_io(segment_id);
+	}
+
+  private:
+	/// The header of each log page. Records follow it back to back.
+	struct LogPage {
+		/// The number of bytes used on the page, including this header.
+		uint32_t used;
+	};
+	/// A record is the PID, the size of its deltas and the deltas.
+	static constexpr size_t record_header_size =
+		sizeof(PageID) + sizeof(uint16_t);
+	/// The bytes of records on a log page.
+	struct PageUsage {
+		/// The number of bytes of all records on the page.
+		size_t num_bytes = 0;
+		/// The number of bytes of live records on the page.
+		size_t live_bytes = 0;
+	};
+	/// The location of a record in the log.
+	struct Record {
+		/// Offset of the record in the log's segment.
+		uint64_t offset;
+		/// The size of the record including its header.
+		uint16_t size;
+	};
+
+	/// Appends a record with the given deltas for `page_id` to the tail.
+	/// Starts a new tail page if the record does not fit. Returns its
+	/// location. The caller must make the record live.
+	Record append(PageID page_id, std::span<const std::byte> deltas);
+	/// Makes `record` the latest record of `page_id`.
+	void set_record(PageID page_id, Record record);
+	/// Turns the latest record of `page_id` into garbage, if any.
+	void drop_record(PageID page_id);
+	/// Returns a log page to write a new tail to. Re-uses freed pages first.
+	PageID get_new_page();
+	/// Writes the packed tail out as a page.
+	void write_group();
+	/// Returns true if the log page is the tail packed in memory.
+	bool is_grouped_tail(PageID log_page) const {
+		return is_grouped && has_tail && log_page == tail_page;
+	}
+
+	/// Returns the log page holding the given offset.
+	PageID get_log_page(uint64_t offset) const {
+		return offset / buffer_manager.page_size;
+	}
+
+	/// The latest record of each PID with buffered deltas.
+	std::unordered_map<PageID, Record> records;
+	/// The usage of each log page holding records.
+	std::unordered_map<PageID, PageUsage> pages;
+	/// Log pages that can be re-used.
+	std::vector<PageID> free_pages;
+	/// The next log page that was never used.
+	PageID next_page = 0;
+	/// The page records are appended to. Only valid if `has_tail`.
+	PageID tail_page = 0;
+	/// The number of bytes used on the tail page.
+	uint32_t tail_used = 0;
+	/// Whether there is a tail page to append to.
+	bool has_tail = false;
+	/// The number of bytes of all records on log pages.
+	size_t log_bytes = 0;
+	/// The number of bytes of live records.
+	size_t live_bytes = 0;
+	/// Scratch space to move records.
+	std::vector<std::byte> buffer;
+	/// Whether the tail is packed in memory.
+	bool is_grouped = false;
+	/// The tail packed in memory in grouped mode.
+	std::vector<std::byte> group;
+
+	/// Prevents re-entrant (un)loads while the log is modified. Nodes evicted
+	/// meanwhile are written out.
+	bool is_locked = false;
+	/// If buffering is enabled.
+	bool buffering_enabled = true;
+};
+// -----------------------------------------------------------------
+} // namespace bbbtree
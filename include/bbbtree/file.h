@@ -64,6 +64,11 @@ class File {
 	/// @param[in] size   The size of the block.
 	virtual void write_block(const char *block, size_t offset, size_t size) = 0;
 
+	/// Blocks until all blocks written so far and the file's size are on
+	/// stable storage.
+	/// This function must not be used when the file was opened in `READ` mode.
+	virtual void sync() = 0;
+
 	/// Opens a file with the given mode. Existing files are never overwritten.
 	/// @param[in] filename Path to the file.
 	/// @param[in] mode     `Mode` that should be used to open the file.
@@ -102,6 +107,8 @@ class PosixFile : public File {
 	void read_block(size_t offset, size_t, char *block) override;
 
 	void write_block(const char *block, size_t offset, size_t size) override;
+
+	void sync() override;
 };
 
 } // namespace bbbtree
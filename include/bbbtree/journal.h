@@ -0,0 +1,90 @@
+#pragma once
+
+#include "bbbtree/file.h"
+#include "bbbtree/types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+class BufferManager;
+// -----------------------------------------------------------------
+/// A rollback journal in its own segment (file) that keeps the segments as
+/// of the last checkpoint recoverable. Pages are written out in place. Before
+/// a page of a journaled segment is overwritten for the first time since the
+/// checkpoint, its image on disk is appended to the journal and synced. On
+/// open, the images saved since the last checkpoint are written back and the
+/// pages allocated since are cut off, so that all journaled segments match
+/// the checkpoint again. Each entry carries the version of the checkpoint it
+/// belongs to and a checksum. A torn entry ends the journal.
+class PageJournal {
+  public:
+	/// Constructor. Journals the writes of the buffer manager to the segments
+	/// `segment_ids` from now on. Unless `reset`, first rolls the segments
+	/// back to the checkpoint `version`.
+	PageJournal(SegmentID segment_id, BufferManager &buffer_manager,
+				std::vector<SegmentID> segment_ids, uint64_t version,
+				bool reset);
+	/// Destructor. Stops journaling the writes of the buffer manager.
+	~PageJournal();
+
+	/// Copy Constructor.
+	PageJournal(const PageJournal &) = delete;
+	/// Copy Assignment.
+	PageJournal &operator=(const PageJournal &) = delete;
+
+	/// Saves the image of the page on disk before it is overwritten, unless
+	/// it was saved since the checkpoint or allocated since. Called by the
+	/// buffer manager with the segment's file before writing a page.
+	void before_write(SegmentID segment_id, PageID page_id, File &segment);
+	/// Drops all entries once the checkpoint `version` is durable. The pages
+	/// written so far belong to it.
+	void truncate(uint64_t version);
+
+  private:
+	/// Precedes the page image of each entry.
+	struct Header {
+		/// The checksum of the entry with this field set to zero.
+		uint64_t checksum;
+		/// The version of the checkpoint that the image belongs to.
+		uint64_t version;
+		/// The size of the segment as of the checkpoint.
+		uint64_t segment_size;
+		/// The page of the image.
+		PageID page_id;
+		/// The number of bytes of the page image following. Zero if the
+		/// entry only carries the size of the segment.
+		uint32_t image_size;
+		/// The segment of the page.
+		SegmentID segment_id;
+	};
+
+	/// Restores the images and sizes of the segments as of the checkpoint
+	/// `version` and drops all entries. Returns the number of restored pages.
+	size_t roll_back(uint64_t version);
+
+	/// The journal's file.
+	std::unique_ptr<File> file;
+	/// The end of the entries in the file.
+	size_t file_end = 0;
+	/// The buffer manager whose writes are journaled.
+	BufferManager &buffer_manager;
+	/// The journaled segments.
+	std::vector<SegmentID> segment_ids;
+	/// The version of the last checkpoint.
+	uint64_t version;
+	/// The size of each segment written since the checkpoint as of the
+	/// checkpoint.
+	std::unordered_map<SegmentID, size_t> segment_sizes;
+	/// The pages (including segment ID) saved since the checkpoint.
+	std::unordered_set<uint64_t> journaled_pages;
+	/// Holds the entry being appended.
+	std::vector<char> buffer;
+};
+// -----------------------------------------------------------------
+} // namespace bbbtree
@@ -3,6 +3,7 @@
 #include "bbbtree/buffer_manager.h"
 #include "bbbtree/stats.h"
 
+#include <optional>
 #include <unordered_map>
 
 namespace bbbtree {
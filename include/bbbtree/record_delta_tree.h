@@ -0,0 +1,117 @@
+#pragma once
+
+#include "bbbtree/btree.h"
+#include "bbbtree/buffer_manager.h"
+#include "bbbtree/delta.h"
+#include "bbbtree/slotted_page.h"
+#include "bbbtree/types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+/// A record delta tree is the page logic of slotted pages. It tracks the
+/// records changed on each slotted page in memory. When a page with few
+/// changed bytes is evicted, the changed records are buffered in a BTree that
+/// maps from the page's PID to the page header, the changed slots and their
+/// records, instead of writing the page out. They are replayed when the page is
+/// loaded again. The deltas are stored as raw bytes.
+class RecordDeltaTree : public PageLogic, public BTree<PID, String> {
+  public:
+	/// Constructor.
+	RecordDeltaTree(SegmentID segment_id, BufferManager &buffer_manager,
+					float wa_threshold)
+		: BTree<PID, String>(segment_id, buffer_manager, nullptr, true),
+		  wa_threshold(wa_threshold) {}
+
+	/// Buffers the changed records of the given slotted page instead of
+	/// writing it out. Returns true if the page must be written out.
+	bool before_unload(char *data, const State &state, PageID page_id,
+					   size_t page_size) override;
+	/// Replays the buffered records of the given slotted page.
+	void after_load(char *data, PageID page_id) override;
+
+	/// Marks the record in `slot_id` of the page as changed.
+	void track(PageID page_id, SlotID slot_id);
+	/// Marks the whole page as changed, e.g. when it is initialized. It is
+	/// written out when evicted.
+	void track_page(PageID page_id);
+
+	/// Writes out all pages of segment `segment_id` with buffered records and
+	/// disables buffering. Called before the buffer is written back for good.
+	void write_back(SegmentID segment_id);
+	/// Drops all buffered records.
+	void clear();
+	/// Tracks the records in the tree again after it was opened, e.g. by
+	/// recovery. Records of pages that are not among the `num_pages` allocated
+	/// ones or that do not fit their page are dropped. Returns the number of
+	/// dropped pages.
+	size_t validate_deltas(PageID num_pages);
+
+	/// Disables buffering. Pages are always written out.
+	void disable_buffering() { buffering_enabled = false; }
+	/// Enables buffering.
+	void enable_buffering() { buffering_enabled = true; }
+
+	/// Returns true if the records of the page are buffered in the tree.
+	bool has_deltas(PageID page_id) const {
+		auto it = pages.find(page_id);
+		return it != pages.end() && it->second.is_buffered;
+	}
+
+	/// Deltas larger than this fraction of the page size are not buffered.
+	/// Keeps several deltas per leaf.
+	static constexpr float max_delta_fraction = 0.25;
+
+  private:
+	/// The changes of a slotted page since it was last written out.
+	struct ChangedPage {
+		/// The changed slots, sorted.
+		std::vector<SlotID> slots;
+		/// Whether the page must be written out.
+		bool is_changed_entirely = false;
+		/// Whether the tree holds records of the page.
+		bool is_buffered = false;
+	};
+
+	/// Returns the number of bytes changed on the page.
+	static size_t get_num_bytes_changed(const SlottedPage &page,
+										const ChangedPage &changes);
+	/// Serializes the header and the changed records of the page into
+	/// `buffer`.
+	void serialize(const SlottedPage &page, const ChangedPage &changes);
+	/// Replays the serialized header and records on the page.
+	static void apply(SlottedPage &page, const String &deltas);
+	/// Parses the slots of the serialized records. Returns false if they do
+	/// not fit a page of `page_size` bytes.
+	static bool parse(const String &deltas, size_t page_size,
+					  std::vector<SlotID> &slots);
+
+	/// Erases the buffered records of the page from the tree.
+	void erase_deltas(PageID page_id);
+	/// Erase deferred deletions when the tree is unlocked.
+	void erase_deferred_deletions();
+
+	/// The write amplification threshold. Changed records of pages with fewer
+	/// changed bytes than this fraction are buffered.
+	const float wa_threshold;
+	/// The changes of each slotted page that was changed since it was last
+	/// written out.
+	std::unordered_map<PageID, ChangedPage> pages;
+	/// Pages written out while the tree was locked. Their buffered records are
+	/// erased once it is unlocked.
+	std::vector<PageID> deferred_deletions;
+	/// Scratch space to serialize deltas.
+	std::vector<std::byte> buffer;
+
+	/// Prevents re-entrant (un)loads while the tree is modified. Pages evicted
+	/// meanwhile are written out.
+	bool is_locked = false;
+	/// If buffering is enabled.
+	bool buffering_enabled = true;
+};
+// -----------------------------------------------------------------
+} // namespace bbbtree
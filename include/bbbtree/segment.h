@@ -3,9 +3,17 @@
 #include "bbbtree/buffer_manager.h"
 #include "bbbtree/slotted_page.h"
 
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <optional>
+#include <span>
+#include <vector>
 
 namespace bbbtree {
+class MetadataSegment;
+class RecordDeltaTree;
+
 /// A segment manages a collection of corresponding pages, e.g. a collection of
 /// slotted pages. It currently maps to a single file.
 class Segment {
@@ -22,19 +30,19 @@ class Segment {
 	BufferManager &buffer_manager;
 };
 
-/// Encodes the free space left in a slotted page segment. Tracks the amount of
-/// existing slotted pages. Caller must ensure that a new page's bytes are set
-/// to 0. Otherwise its undefined behaviour.
-/// TODO: For now, we append-only. Therefore we merely track the
-///       last slotted page's space and the total amount of allocated pages.
-/// TODO: Only a dummy, append-only FSI Segment. Do not use it for index
-/// bootstrapping. Do not maintain it in its own file.
+/// The free-space inventory (FSI) of a slotted page segment. Stores a 4-bit
+/// free-space class for each slotted page, two per byte, on the pages after
+/// the first one. The classes scale logarithmically, so that small free
+/// spaces are distinguished finely. A class guarantees at least its lower
+/// bound of free space. The first page holds the number of slotted pages and,
+/// for each class, the lowest page that may have that class. Searches start
+/// there, so that holes are filled first and full pages are not scanned again.
 class FSISegment : public Segment {
   public:
-	/// Constructor. TODO: When segment (file) was not allocated so far, set the
-	/// header of the first page to 0.
+	/// Constructor. Initializes the inventory if the segment is new.
 	FSISegment(SegmentID segment_id, BufferManager &buffer_manager);
-	/// Find a free page. Optionally returns the page ID.
+	/// Finds the lowest page with at least `required_space` free bytes.
+	/// Optionally returns the page ID.
 	std::optional<PageID> find(uint32_t required_space);
 	/// Updates the amount of free space on the target page. Updated by the
 	/// Slotted Pages Segment.
@@ -43,37 +51,155 @@ class FSISegment : public Segment {
 	PageID create_new_page(size_t initial_free_space);
 	/// Resets the segment to an empty state.
 	void clear();
+	/// Returns the number of allocated slotted pages.
+	PageID get_num_pages();
+
+	/// Stores the number of slotted pages for the next checkpoint. All pages
+	/// must have been written out before.
+	void checkpoint(MetadataSegment &metadata);
+	/// Drops the slotted pages allocated after the last checkpoint, if any.
+	/// Their pages may never have been written. Classes of the other pages
+	/// may be stale until the pages are updated again.
+	void recover(const MetadataSegment &metadata);
+
+	/// The number of free-space classes.
+	static constexpr uint8_t num_classes = 16;
 
   private:
 	struct Header {
 		/// The number of allocated slotted pages so far.
 		size_t allocated_pages;
-		/// The free space on the last slotted page.
-		size_t free_space;
+		/// For each class, no page below this one has at least this class.
+		PageID first_pages[num_classes];
+	};
+
+	/// Returns the class of a page with `free_space` free bytes.
+	uint8_t get_class(size_t free_space) const;
+	/// Returns the lowest class whose pages have at least `required_space`
+	/// free bytes. Returns `num_classes` if no class guarantees it.
+	uint8_t get_min_class(size_t required_space) const;
+	/// Sets the class of the target page on its FSI page. Returns the previous
+	/// class.
+	uint8_t set_class(PageID target_page, uint8_t free_space_class);
+
+	/// The number of slotted pages whose classes fit on one FSI page.
+	const size_t entries_per_page;
+	/// The lower bound of free bytes of each class.
+	size_t lower_bounds[num_classes];
+};
+
+/// The state of a BTree that is needed to open it again.
+struct TreeMetadata {
+	/// The page of the root.
+	PageID root;
+	/// The next free, unique page ID.
+	PageID next_free_page;
+	/// The first page of the list of freed pages. Zero if empty.
+	PageID first_free_page;
+};
+
+/// Keeps the state of all trees of a database on a single page. It is only
+/// written at checkpoints, after all pages it refers to were written out.
+/// Versions alternate between pages 0 and 1, so that a torn write leaves the
+/// previous version intact. The valid version with the highest number is read
+/// on construction.
+class MetadataSegment : public Segment {
+  public:
+	/// Constructor. Reads the last checkpointed version, if any.
+	MetadataSegment(SegmentID segment_id, BufferManager &buffer_manager);
+
+	/// Returns the state of the tree in segment `tree_segment_id` as of the
+	/// last checkpoint.
+	std::optional<TreeMetadata> get(SegmentID tree_segment_id) const;
+	/// Sets the state of the tree in segment `tree_segment_id` for the next
+	/// checkpoint.
+	void set(SegmentID tree_segment_id, const TreeMetadata &metadata);
+	/// Writes the states of all trees as a new version. The pages they refer
+	/// to must have been written out before.
+	void write();
+	/// Returns the version of the last checkpoint. Zero if there was none.
+	uint64_t get_version() const { return version; }
+	/// Returns the LSN of the last log record reflected by the last checkpoint.
+	LSN get_lsn() const { return lsn; }
+	/// Sets the LSN of the last log record reflected by the next checkpoint.
+	void set_lsn(LSN lsn) { this->lsn = lsn; }
+
+  private:
+	struct Header {
+		/// Identifies a written version.
+		uint64_t magic;
+		/// The version. Incremented with every checkpoint.
+		uint64_t version;
+		/// The checksum of the version with this field set to zero.
+		uint64_t checksum;
+		/// The number of trees following the header.
+		uint64_t num_trees;
+		/// The LSN of the last log record reflected by the version.
+		LSN lsn;
 	};
+	struct Tree {
+		/// The tree's segment.
+		SegmentID segment_id;
+		/// The tree's state.
+		TreeMetadata metadata;
+	};
+
+	/// Reads the version on the page if it is valid and newer.
+	void read(PageID page_id);
+
+	/// Marks pages that hold a version.
+	static constexpr uint64_t magic = 0x3B3B3B3B4D455441;
+
+	/// The state of each tree.
+	std::map<SegmentID, TreeMetadata> trees;
+	/// The version of the last checkpoint.
+	uint64_t version = 0;
+	/// The LSN of the last log record reflected by the last checkpoint.
+	LSN lsn = 0;
 };
 
 /// A segment (here equivalent to a file) containing all the slotted pages.
 class SPSegment : public Segment {
   public:
 	/// Constructor. The segment_id is also the name of the file containing the
+	/// pages. If given, `record_deltas` buffers the changed records of evicted
 	/// pages.
 	SPSegment(SegmentID segment_id, BufferManager &buffer_manager,
-			  FSISegment &fsi)
-		: Segment(segment_id, buffer_manager), space_inventory(fsi) {}
+			  FSISegment &fsi, RecordDeltaTree *record_deltas = nullptr)
+		: Segment(segment_id, buffer_manager), space_inventory(fsi),
+		  record_deltas(record_deltas) {}
 
-	/// Uses the free-space inventory to allocate space for a new tuple on a
-	/// page.
-	TID allocate(uint32_t size);
-	/// Reads data of the tuple into the buffer.
+	/// Uses the free-space inventory to allocate space for a new tuple on the
+	/// lowest page with enough space, so that holes are filled first.
+	TID allocate(uint32_t size) { return allocate(size, false); }
+	/// Reads data of the tuple into the buffer. Follows redirects. Returns
+	/// the number of bytes read, which is the tuple's size if it fits.
 	uint32_t read(TID tid, std::byte *record, uint32_t capacity) const;
 	/// Writes a tuple into the given tuple id.
 	/// Only allows writes of the exact size allocated for this tuple id.
 	uint32_t write(TID tid, const std::byte *record, uint32_t record_size);
-	/// TODO: Resizes a tuple.
+	/// Writes a tuple into the given tuple id. Resizes it first if its size
+	/// changed.
+	uint32_t update(TID tid, const std::byte *record, uint32_t record_size);
+	/// Resizes a tuple and keeps its first bytes. It grows on its page if the
+	/// page has enough space after compaction. Otherwise, it is moved to
+	/// another page and its slot redirects there. The TID stays the same.
 	void resize(TID tid, uint32_t new_length);
-	/// Erases a tuple from the slotted page.
+	/// Erases a tuple from the slotted page. Its space is reclaimed when the
+	/// page is compacted. Its slot is reused.
 	void erase(TID tid);
+	/// Calls `visit(record)` for each tuple in page order. Moved tuples are
+	/// visited on the page they were moved to. Pages are read ahead in runs of
+	/// `read_ahead` pages with a single read. Unless `bypass_buffer`, they are
+	/// buffered as cold pages that are evicted before the others. Otherwise,
+	/// they are read without buffering them, so that the buffered pages stay.
+	/// The record is only valid during the call. `visit` must not change the
+	/// segment.
+	void scan(const std::function<void(std::span<const std::byte>)> &visit,
+			  bool bypass_buffer = false) const;
+
+	/// The number of pages that a scan reads at once.
+	static constexpr size_t read_ahead = 16;
 
   private:
 	// Cast a Page to a SlottedPage
@@ -81,7 +207,43 @@ class SPSegment : public Segment {
 		return *(reinterpret_cast<SlottedPage *>(buffer_frame.get_data()));
 	}
 
+	/// Allocates space for a new tuple. `is_moved` marks records moved from
+	/// another page.
+	TID allocate(uint32_t size, bool is_moved);
+	/// Writes a tuple if it has the given size. Returns false otherwise.
+	bool write_if_sized(TID tid, const std::byte *record, uint32_t record_size);
+	/// Resizes the record `tid` on its fixed page. Returns false if it does not
+	/// fit.
+	bool resize_on_page(BufferFrame &frame, TID tid, uint32_t new_length);
+	/// Copies the first bytes of the record `tid` on its fixed page that fit
+	/// into `new_length`, and erases it. Its place becomes a hole.
+	void take_out(BufferFrame &frame, TID tid, uint32_t new_length,
+				  std::vector<std::byte> &record);
+	/// Returns the free space of a page including its holes, which is tracked
+	/// by the free-space inventory.
+	size_t get_free_space(const SlottedPage &page) const {
+		return page.get_compacted_free_space(buffer_manager.page_size);
+	}
+	/// Returns the largest tuple that fits on a page.
+	size_t get_max_size() const {
+		return buffer_manager.page_size - sizeof(SlottedPage::Slot) -
+			   sizeof(SlottedPage::Header);
+	}
+
+	/// Calls `visit(record)` for each tuple stored on the page. Skips
+	/// redirects.
+	static void
+	visit_records(const SlottedPage &page,
+				  const std::function<void(std::span<const std::byte>)> &visit);
+	/// Fixes a slotted page with the record delta tree as its page logic.
+	BufferFrame &fix_page(PageID page_id, bool exclusive,
+						  AccessHint hint = AccessHint::NORMAL) const;
+	/// Marks the record as changed in the record delta tree, if any.
+	void track(TID tid);
+
 	/// Free space inventory
 	FSISegment &space_inventory;
+	/// Buffers the changed records of evicted pages. Optional.
+	RecordDeltaTree *record_deltas;
 };
 } // namespace bbbtree
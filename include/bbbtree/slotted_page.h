@@ -2,56 +2,80 @@
 
 #include "bbbtree/types.h"
 
+#include <cassert>
 #include <cstddef>
 
 namespace bbbtree {
 /// @brief A SlottedPage contains Records identified through Tuple IDs (`TID`).
 /// Slots grow from the front of the page, after the heading. Data grow from the
-/// end. The page is full when slots and data meets.
-/// TODO: Does not handle redirect tuples. No deletions, compactification &
-/// relocation for now. Append-Only.
+/// end. The page is full when slots and data meets. Records that outgrow their
+/// page are moved to another page. Their slot redirects to the new TID, so that
+/// TIDs stay stable. Shrunk and moved records leave holes, which compaction
+/// reclaims. Erased records leave holes as well. Their slots are reused.
 struct SlottedPage {
 	struct Header {
 		/// Constructor
 		explicit Header(uint32_t page_size);
 
-		/// Number of currently used slots. Indicates the next free slot due to
-		/// append-only design.
+		/// Number of currently used slots, including erased ones.
 		uint16_t slot_count;
+		/// No slot before this one is erased.
+		uint16_t first_free_slot;
 		/// Upper end of the data. Where new data can be prepended.
 		uint32_t data_start;
 	};
 
 	/// @brief A slot indicates the offset and length of the corresponding
-	/// tuple. No redirects for now.
+	/// tuple or redirects to the TID of a record on another page.
 	struct Slot {
 		/// Constructor
 		Slot() = default;
 
 		/// Clear the slot.
 		void clear() { value = 0; }
-		/// Get the size.
-		[[nodiscard]] uint32_t get_size() const { return value & 0xFFFFFFull; }
+		/// Get the size. Redirects have no data on this page.
+		[[nodiscard]] uint32_t get_size() const {
+			return is_redirect() ? 0 : value & 0xFFFFFFull;
+		}
 		/// Get the offset.
 		[[nodiscard]] uint32_t get_offset() const {
-			return (value >> 24) & 0xFFFFFFull;
+			return is_redirect() ? 0 : (value >> 24) & 0xFFFFFFull;
 		}
 		/// Is empty?
 		[[nodiscard]] bool is_empty() const { return value == 0; }
+		/// Does the slot redirect to a record on another page?
+		[[nodiscard]] bool is_redirect() const { return (value >> 56) == 0xFF; }
+		/// Was the record moved here from another page?
+		[[nodiscard]] bool is_moved() const {
+			return !is_redirect() && (value >> 48) != 0;
+		}
+		/// Get the TID that the slot redirects to.
+		[[nodiscard]] TID get_redirect() const {
+			return TID(value & 0xFFFFFFFFFFFFFFull);
+		}
 
 		/// Set the slot.
-		void set_slot(uint32_t offset, uint32_t size) {
+		void set_slot(uint32_t offset, uint32_t size, bool is_moved = false) {
 			value = 0;
 			value ^= size & 0xFFFFFFull;
 			value ^= (offset & 0xFFFFFFull) << 24;
+			if (is_moved)
+				value ^= 0x01ull << 48;
+		}
+		/// Redirect the slot to the record `tid` on another page.
+		void set_redirect(TID tid) {
+			assert(tid.get_page_id() < (1ull << 40));
+			value = (0xFFull << 56) ^ (static_cast<uint64_t>(tid.get_page_id())
+									   << 16) ^
+					tid.get_slot_id();
 		}
 
 	  private:
 		/// The slot value: T (1 byte) | S (1 byte) | O (3 byte) | L (3 byte)
-		/// T: If != 0xFF, the slot points to another record. The value is the
-		/// TID. S: If = 0, the tuple is at offset O with length L. Otherwise,
-		/// the tuple was moved from another page, placed at offset O with
-		/// length L. The first 8 bytes contain the original TID.
+		/// T: If = 0xFF, the slot redirects to a record on another page. The
+		/// other 7 bytes are its TID. S: If = 0, the tuple is at offset O with
+		/// length L. Otherwise, the tuple was moved from another page, placed
+		/// at offset O with length L.
 		uint64_t value{0};
 	};
 
@@ -88,13 +112,31 @@ struct SlottedPage {
 	static size_t get_initial_free_space(uint32_t page_size) {
 		return page_size - sizeof(SlottedPage);
 	}
+	/// Get the free space after compaction, including the holes.
+	[[nodiscard]] size_t get_compacted_free_space(uint32_t page_size) const;
 
-	// Allocate a slot. Throws if not enough space left on page.
+	// Allocate a slot. Reuses the first erased slot. Throws if not enough
+	// space left on page.
 	/// @param[in] data_size    The slot that should be allocated.
+	/// @param[in] is_moved     Whether the record was moved from another page.
 	/// @return                 The new slot's ID.
-	SlotID allocate(uint32_t data_size);
+	SlotID allocate(uint32_t data_size, bool is_moved = false);
+
+	/// Resize the record of a slot. Keeps the first bytes that fit. A shrunk
+	/// record leaves a hole. A grown record is placed in the free space. The
+	/// page is compacted if the holes are needed.
+	/// @param[in] slot_id      The slot that should be resized.
+	/// @param[in] data_size    The new size.
+	/// @param[in] page_size    The size of the page.
+	/// @return                 False if the record does not fit on the page.
+	bool resize(SlotID slot_id, uint32_t data_size, uint32_t page_size);
+
+	/// Move all records towards the end of the page, so that the holes
+	/// become free space.
+	/// @param[in] page_size    The size of the page.
+	void compactify(uint32_t page_size);
 
-	/// Erase a slot. Throws if `slot_id` invalid.
+	/// Erase a slot. Its record becomes a hole. Throws if `slot_id` invalid.
 	/// @param[in] slot_id      The slot that should be erased
 	void erase(SlotID slot_id);
 
@@ -14,6 +14,11 @@ struct Stats {
 	size_t inner_node_splits = 0;
 	// Counts the number of split leaf node in a B-Tree.
 	size_t leaf_node_splits = 0;
+	// Counts the number of leaf splits that detected sequential appends and
+	// kept the left leaf full.
+	size_t append_splits = 0;
+	// Counts the number of underfull nodes merged into a sibling.
+	size_t node_merges = 0;
 
 	// The number of bytes that were changed by a user logically.
 	size_t bytes_written_logically = 0;
@@ -22,10 +27,22 @@ struct Stats {
 
 	// Counts every time a new page is created in the system.
 	size_t pages_created = 0;
+	// Counts every time a page is freed by merging nodes.
+	size_t pages_freed = 0;
+	// Counts every time a freed page is re-used for a new node.
+	size_t pages_reused = 0;
 	// Counts every time a slotted page is created in the system.
 	size_t slotted_pages_created = 0;
 	// Counts every time a page is loaded from disk.
 	size_t pages_loaded = 0;
+	// Counts the pages loaded ahead of a sequential scan.
+	size_t pages_prefetched = 0;
+	// Counts the pages loaded from disk without buffering them, e.g. by scans
+	// that bypass the buffer.
+	size_t pages_read_unbuffered = 0;
+	// Counts the evicted pages that were loaded by scans or one-time
+	// traversals.
+	size_t cold_pages_evicted = 0;
 	// Counts every time a page is removed from the buffer. May have been
 	// written to disk or not. E.g. a clean page is removed but not written or a
 	// dirty page whose writes are deferred.
@@ -59,6 +76,66 @@ struct Stats {
 	// Counts the number of times a page's changed were extracted and buffered
 	// in-memory instead of written to disk.
 	size_t btree_pages_write_deferred = 0;
+	// Counts the number of delta records appended to a delta log.
+	size_t delta_log_appends = 0;
+	// Counts the number of delta log pages freed by garbage collection.
+	size_t delta_log_pages_cleaned = 0;
+	// Counts the number of log pages packed in memory and written as a whole.
+	size_t delta_groups_written = 0;
+	// Counts the number of loaded nodes whose deltas were found in the delta
+	// cache.
+	size_t delta_cache_hits = 0;
+	// Counts the number of loaded nodes whose deltas were looked up in the
+	// delta tree behind the delta cache.
+	size_t delta_cache_misses = 0;
+	// Counts the number of entries evicted from the delta cache.
+	size_t delta_cache_evictions = 0;
+	// Counts the number of loaded nodes whose delta tree lookup was skipped
+	// because the PID filter had no deltas for them.
+	size_t delta_filter_skips = 0;
+	// Counts the number of delta tree lookups that the PID filter allowed but
+	// that found no deltas.
+	size_t delta_filter_false_positives = 0;
+	// Counts the number of nodes whose deltas were merged back into them.
+	size_t delta_merges = 0;
+	// Counts the number of loaded leaves whose deltas were kept pending
+	// instead of applying them.
+	size_t delta_loads_deferred = 0;
+	// Counts the number of leaves whose pending deltas were applied later.
+	size_t deferred_deltas_applied = 0;
+	// Counts the number of slotted pages whose changed records were buffered
+	// instead of writing the page out.
+	size_t record_pages_write_deferred = 0;
+	// Counts the number of loaded slotted pages with buffered records.
+	size_t record_deltas_applied = 0;
+	// Counts the number of records moved to another page because they
+	// outgrew their page.
+	size_t records_moved = 0;
+	// Counts the number of slotted pages compacted to reclaim their holes.
+	size_t slotted_pages_compacted = 0;
+	// Counts the number of checkpoints written.
+	size_t checkpoints_written = 0;
+	// Counts the number of pages written out by checkpoints.
+	size_t checkpoint_pages_written = 0;
+	// Counts the number of pages whose changes checkpoints buffered as deltas
+	// instead of writing them out.
+	size_t checkpoint_pages_deferred = 0;
+	// Counts the number of buffered deltas dropped by recovery because they
+	// do not belong to an allocated page.
+	size_t deltas_dropped_on_recovery = 0;
+	// Counts the number of records appended to the write-ahead log.
+	size_t log_records_appended = 0;
+	// Counts the number of groups of log records written at once.
+	size_t log_groups_written = 0;
+	// Counts the number of bytes written to the write-ahead log.
+	size_t log_bytes_written = 0;
+	// Counts the number of log records redone on open.
+	size_t log_records_replayed = 0;
+	// Counts the number of page images saved in the page journal before the
+	// pages were overwritten.
+	size_t journal_pages_written = 0;
+	// Counts the number of page images restored from the page journal on open.
+	size_t journal_pages_rolled_back = 0;
 
 	// Counts the number of buffer hits.
 	size_t buffer_hits = 0;
@@ -70,8 +147,11 @@ struct Stats {
 	// Tracks the maximum height of the Delta Tree.
 	size_t delta_tree_height = 0;
 
-	// Threshold to trigger write-out of a dirty page.
+	// Threshold to trigger write-out of a dirty page. The effective one if the
+	// threshold is adapted.
 	float wa_threshold = 0;
+	// Counts the number of times an adaptive threshold was moved.
+	size_t wa_threshold_adaptions = 0;
 	// The maximum bytes changes we see.
 	size_t max_bytes_changed = 0;
 	// The pages' size in bytes.
@@ -95,6 +175,8 @@ struct Stats {
 	size_t num_lookups_index = 0;
 	// The number of updates performed on the index.
 	size_t num_updates_index = 0;
+	// The number of upserts performed on the index.
+	size_t num_upserts_index = 0;
 
 	// Resets all stats to zero.
 	void clear();
@@ -15,6 +15,12 @@ using SegmentID = uint16_t;
 using PageID = uint64_t;
 /// A Slot within a Page.
 using SlotID = uint16_t;
+/// A log sequence number. Identifies a record of the write-ahead log. Zero if
+/// there is none.
+using LSN = uint64_t;
+// -----------------------------------------------------------------
+/// Returns the FNV-1a checksum of `size` bytes.
+uint64_t get_checksum(const void *data, size_t size);
 // -----------------------------------------------------------------
 struct UInt64 {
 	/// Default Constructor.
@@ -97,6 +103,8 @@ struct String {
 
 	/// Size of the wrapped value.
 	uint16_t size() const { return view.size(); }
+	/// Returns the wrapped bytes.
+	std::string_view get_view() const { return view; }
 	/// Serializes this type into bytes to store on pages.
 	void serialize(std::byte *dst) const {
 		std::memcpy(dst, view.data(), view.size());
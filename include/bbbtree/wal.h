@@ -0,0 +1,137 @@
+#pragma once
+
+#include "bbbtree/file.h"
+#include "bbbtree/types.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+/// The operation that a log record redoes.
+enum class LogRecordType : uint8_t {
+	Insert = 1, // Inserts a tuple.
+	Update = 2, // Updates the value and payload of a tuple.
+	Erase = 3	// Erases a tuple.
+};
+// -----------------------------------------------------------------
+/// A redo write-ahead log in its own segment (file). Records are appended to a
+/// buffer in memory. A background flusher appends all buffered records to the
+/// file with a single write, so that the records of many operations share one
+/// write (group commit). Each group is synced before its records count as
+/// flushed, so records are durable once flushed. Pages must not be written
+/// out before the records of their changes were flushed. Each record carries
+/// a checksum. A torn record ends the log.
+class WriteAheadLog {
+  public:
+	/// Constructor. Starts the flusher. Unless `reset`, the records in the file
+	/// are kept. Call `replay` before appending to them.
+	WriteAheadLog(SegmentID segment_id, bool reset);
+	/// Destructor. Flushes all records and stops the flusher.
+	~WriteAheadLog();
+
+	/// Copy Constructor.
+	WriteAheadLog(const WriteAheadLog &) = delete;
+	/// Copy Assignment.
+	WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+	/// Appends a record and returns its LSN. It is durable once flushed.
+	LSN append(LogRecordType type, std::span<const std::byte> payload);
+	/// Blocks until the records up to `lsn` are durable. All records appended
+	/// by then are flushed together.
+	void flush(LSN lsn);
+	/// Blocks until all records appended so far are durable.
+	void flush() { flush(last_lsn); }
+	/// Drops the records that were not flushed yet, as if the process crashed.
+	void discard();
+
+	/// Calls `redo(type, payload)` for each record after `lsn` in LSN order.
+	/// Cuts off a torn tail. Following records are appended after the last
+	/// valid one. Returns the number of replayed records.
+	size_t replay(
+		LSN lsn,
+		const std::function<void(LogRecordType, std::span<const std::byte>)>
+			&redo);
+	/// Drops all records, e.g. once a checkpoint reflects them. LSNs keep
+	/// counting.
+	void truncate();
+
+	/// Returns the LSN of the last appended record.
+	LSN get_last_lsn() const { return last_lsn; }
+	/// Returns the LSN up to which records are durable.
+	LSN get_flushed_lsn() const { return flushed_lsn; }
+
+	/// Buffered records are flushed at least this often.
+	static constexpr std::chrono::milliseconds flush_interval{1};
+	/// The flusher is woken up early once this many bytes are buffered.
+	static constexpr size_t group_size = 64 * 1024;
+
+  private:
+	/// Precedes the payload of each record.
+	struct Header {
+		/// The checksum of the record with this field set to zero.
+		uint64_t checksum;
+		/// The record's LSN.
+		LSN lsn;
+		/// The number of bytes of the payload.
+		uint32_t payload_size;
+		/// The operation.
+		LogRecordType type;
+	};
+
+	/// Flushes the buffered records until stopped.
+	void run_flusher();
+	/// Writes the buffered records as one group. Releases `lock` while
+	/// writing.
+	void write_group(std::unique_lock<std::mutex> &lock);
+	/// Adds the groups written by the flusher to the stats. Called by the
+	/// owning thread with `mutex` held.
+	void update_stats();
+
+	/// The log's file.
+	std::unique_ptr<File> file;
+	/// The end of the durable records in the file.
+	size_t file_end = 0;
+
+	/// Guards the members below.
+	std::mutex mutex;
+	/// Wakes up the flusher.
+	std::condition_variable flusher_wakeup;
+	/// Notifies that records were flushed.
+	std::condition_variable group_written;
+	/// The records appended since the last flush.
+	std::vector<std::byte> buffer;
+	/// The records that the flusher currently writes.
+	std::vector<std::byte> group;
+	/// Whether a group is being written.
+	bool is_writing = false;
+	/// Whether someone waits for the buffered records.
+	bool is_flush_requested = false;
+	/// Whether the flusher shall stop.
+	bool is_stopped = false;
+	/// The number of groups and bytes written by the flusher.
+	size_t num_groups_written = 0;
+	size_t num_bytes_written = 0;
+	/// The number of groups and bytes already added to the stats.
+	size_t num_groups_counted = 0;
+	size_t num_bytes_counted = 0;
+
+	/// The LSN of the last appended record.
+	std::atomic<LSN> last_lsn = 0;
+	/// The LSN up to which records are durable.
+	std::atomic<LSN> flushed_lsn = 0;
+
+	/// The background flusher. Started last.
+	std::thread flusher;
+};
+// -----------------------------------------------------------------
+} // namespace bbbtree
@@ -14,6 +14,11 @@ set(
     include/bbbtree/slotted_page.h
     include/bbbtree/btree.h
     include/bbbtree/bbbtree.h
+    include/bbbtree/delta_log.h
+    include/bbbtree/delta_cache.h
+    include/bbbtree/record_delta_tree.h
+    include/bbbtree/wal.h
+    include/bbbtree/journal.h
     include/bbbtree/btree_with_tracking.h
     include/bbbtree/delta.h
     include/bbbtree/map.h
@@ -1,11 +1,17 @@
 #include "bbbtree/bbbtree.h"
 #include "bbbtree/btree.h"
 #include "bbbtree/buffer_manager.h"
+#include "bbbtree/delta_log.h"
 #include "bbbtree/logger.h"
 #include "bbbtree/stats.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <iostream>
+#include <functional>
+#include <limits>
+#include <type_traits>
 
 namespace bbbtree {
 // -----------------------------------------------------------------
@@ -20,15 +26,27 @@ bool DeltaTree<KeyT, ValueT>::before_unload(char *data, const State &state,
 					: (state == State::NEW ? "NEW" : "CLEAN")));
 #endif
 
+	this->adapt_threshold();
+
 	// Clean the slots of their dirty state when writing the node out.
 	auto *node = reinterpret_cast<const Node *>(data);
+	if (std::getenv("DBG881") && !node->is_leaf()) {
+		auto str = dbg_child(reinterpret_cast<const typename DeltaStore<KeyT, ValueT>::InnerNode *>(node), 238);
+		if (page_id == 132 || page_id == 124) std::cout << "  UNLOAD-INNER p" << page_id << " state " << (int)state << dbg_inner(reinterpret_cast<const typename DeltaStore<KeyT, ValueT>::InnerNode *>(node)) << std::endl;
+		if (!str.empty()) std::cout << "  unload-inner p" << page_id << " state " << (int)state << " sc=" << node->slot_count << str << std::endl;
+	}
+	if (std::getenv("DBG881") && node->is_leaf())
+		std::cout << "  unload p" << page_id << " state " << (int)state << " locked " << is_locked << " merging " << (merging_page == page_id) << dbg_key(reinterpret_cast<const typename DeltaStore<KeyT, ValueT>::LeafNode *>(node), 881) << std::endl;
 	// New pages are always written out.
 	// Pages with many updates are always written out.
-	bool has_many_updates = node->get_update_ratio(page_size) > wa_threshold;
+	bool has_many_updates = this->has_many_updates(node, page_size);
+
+	// Nodes merged with their deltas are written out.
+	bool is_merged = merging_page == page_id;
 
 	bool is_new = (state == State::NEW);
-	bool force_write_out =
-		!this->buffering_enabled || is_new || has_many_updates || is_locked;
+	bool force_write_out = !this->buffering_enabled || is_new ||
+						   has_many_updates || is_locked || is_merged;
 	// logger.log(std::to_string(wa_threshold * 100) + "," +
 	// 		   std::to_string(node->get_update_ratio(page_size) * 100) + "," +
 	// 		   std::to_string(page_id) + "," + (force_write_out ? "1" : "0"));
@@ -36,31 +54,49 @@ bool DeltaTree<KeyT, ValueT>::before_unload(char *data, const State &state,
 	// Erase any buffered deltas for this page, since we are going to write it
 	// out now. If the tree is already locked, we cannot modify it now.
 	if (is_locked) {
+		if (std::getenv("DBG881") && page_id == 132) std::cout << "  DEFER p132" << std::endl;
 		deferred_deletions.push_back(page_id);
-	} else if (has_many_updates) {
+	} else if ((has_many_updates || is_merged) && may_have_deltas(page_id)) {
 		is_locked = true;
-		this->erase(page_id, page_size);
+		erase_deltas(page_id);
+		// Deletions deferred meanwhile must not outlive the lock.
+		erase_deferred_deletions();
 		is_locked = false;
 	}
 
 	// Remove any tracking information on the node, since we are going to write
-	// it out now.
+	// it out now. Cached deltas are superseded as well.
 	if (force_write_out) {
-		clean_node(reinterpret_cast<Node *>(data));
-		return true;
+		cache.erase(page_id);
+		return this->write_out(reinterpret_cast<Node *>(data));
 	}
 
 	is_locked = true;
 
 	assert(state == State::DIRTY);
-	assert(node->num_bytes_changed > 0);
+	// Modified leaves were prepared.
+	assert(!this->has_pending(page_id));
 
-	// TODO: Do not erase when there is nothing. Just allow making an insert
-	// that updates the value if the key exists already i.e. upsert.
-	this->erase(page_id, page_size);
+	auto deltas = this->extract_deltas(node);
+	// Changes that cancelled out, e.g. an insert that was erased again, leave
+	// no deltas. The node is written out instead of buffering an empty record.
+	if (deltas.get_header().num_deltas == 0) {
+		cache.erase(page_id);
+		if (may_have_deltas(page_id))
+			erase_deltas(page_id);
+		erase_deferred_deletions();
+		is_locked = false;
+		return this->write_out(reinterpret_cast<Node *>(data));
+	}
 
-	//  Scan all slots in the node and insert the deltas in the delta tree.
-	store_deltas(page_id, reinterpret_cast<const Node *>(data));
+	if (cache.is_enabled()) {
+		// Keep the deltas in memory. Only evicted deltas reach the tree.
+		cache.put(page_id, deltas, true);
+		evict_cached_deltas();
+	} else {
+		// Upsert the deltas in the delta tree.
+		store_deltas(page_id, deltas);
+	}
 
 	// Apply any deferred deletions now.
 	erase_deferred_deletions();
@@ -74,30 +110,52 @@ template <KeyIndexable KeyT, ValueIndexable ValueT>
 void DeltaTree<KeyT, ValueT>::after_load(char *data, PageID page_id) {
 	// TODO: Return if after_load
 	assert(!is_locked);
+	// Deltas left pending by an earlier load are looked up again.
+	this->drop_pending(page_id);
+
+	struct Dbg { char *d; PageID p; ~Dbg() { if (std::getenv("DBG881") && !reinterpret_cast<Node *>(d)->is_leaf()) { auto str = dbg_child(reinterpret_cast<typename DeltaStore<KeyT, ValueT>::InnerNode *>(d), 238); std::cout << "  load-inner p" << p << " sc=" << reinterpret_cast<Node *>(d)->slot_count << str << std::endl; if (p == 132 || p == 124) std::cout << "  LOAD-INNER p" << p << dbg_inner(reinterpret_cast<typename DeltaStore<KeyT, ValueT>::InnerNode *>(d)) << std::endl; }
+	if (std::getenv("DBG881") && reinterpret_cast<Node *>(d)->is_leaf()) std::cout << "  load p" << p << dbg_key(reinterpret_cast<typename DeltaStore<KeyT, ValueT>::LeafNode *>(d), 881) << std::endl; } } dbg{data, page_id};
+	if (std::getenv("DBG881") && (page_id == 132 || page_id == 124)) std::cout << "  LOAD-RAW p" << page_id << " mayhave " << may_have_deltas(page_id) << " cached " << cache.find(page_id).has_value() << dbg_inner(reinterpret_cast<typename DeltaStore<KeyT, ValueT>::InnerNode *>(data)) << std::endl;
+	if (std::getenv("DBG881") && reinterpret_cast<Node *>(data)->is_leaf()) std::cout << "  load-raw p" << page_id << " mayhave " << may_have_deltas(page_id) << dbg_key(reinterpret_cast<typename DeltaStore<KeyT, ValueT>::LeafNode *>(data), 881) << std::endl;
+	// Cached deltas are the latest ones. Apply them without touching the tree.
+	if (auto cached_deltas = cache.find(page_id)) {
+		++stats.delta_cache_hits;
+		this->load_deltas(reinterpret_cast<Node *>(data), page_id,
+						  *cached_deltas, this->buffer_manager.page_size);
+		return;
+	}
+	if (cache.is_enabled())
+		++stats.delta_cache_misses;
+
+	// Most nodes have no deltas. Skip traversing the tree for them.
+	if (!may_have_deltas(page_id)) {
+		++stats.delta_filter_skips;
+		return;
+	}
 
 	is_locked = true;
 	// Load the deltas for this page
 	auto maybe_deltas = this->lookup(page_id);
+	if (std::getenv("DBG881") && page_id == 132) std::cout << "  LOOKUP p132 found " << maybe_deltas.has_value() << std::endl;
 	// No deltas found. Do nothing.
 	if (!maybe_deltas.has_value()) {
+		++stats.delta_filter_false_positives;
 		// Apply any deferred deletions now.
 		erase_deferred_deletions();
 		is_locked = false;
 		return;
 	}
 
-	// Apply the deltas to the node.
-	auto deltas = maybe_deltas.value();
-	auto *node = reinterpret_cast<Node *>(data);
+	// Apply the deltas straight from the tree's leaf. It stays in memory since
+	// nothing is fixed meanwhile.
+	this->load_deltas(reinterpret_cast<Node *>(data), page_id,
+					  maybe_deltas.value(), this->buffer_manager.page_size);
 
-	if (node->is_leaf()) {
-		apply_deltas(reinterpret_cast<LeafNode *>(node),
-					 std::get<LeafDeltas>(deltas.deltas), deltas.slot_count);
-	} else {
-		auto *inner_node = reinterpret_cast<InnerNode *>(node);
-		apply_deltas(inner_node, std::get<InnerNodeDeltas>(deltas.deltas),
-					 deltas.slot_count);
-		inner_node->upper = deltas.upper;
+	// Cache the deltas in case the node is evicted clean and loaded again.
+	// The tree holds them already.
+	if (cache.is_enabled()) {
+		cache.put(page_id, maybe_deltas.value(), false);
+		evict_cached_deltas();
 	}
 
 	// Apply any deferred deletions now.
@@ -106,146 +164,448 @@ void DeltaTree<KeyT, ValueT>::after_load(char *data, PageID page_id) {
 	is_locked = false;
 }
 
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaStore<KeyT, ValueT>::adapt_threshold() {
+	if (!is_adaptive || ++num_unloads < adapt_interval)
+		return;
+
+	auto page_io = get_page_io();
+	// Turn if the last step did not reduce the I/O.
+	auto cost = static_cast<double>(page_io - interval_page_io) / num_unloads;
+	if (cost > last_cost)
+		is_raising = !is_raising;
+	last_cost = cost;
+
+	wa_threshold += is_raising ? adapt_step : -adapt_step;
+	wa_threshold = std::clamp(wa_threshold, 0.0f, 1.0f);
+	stats.wa_threshold = wa_threshold;
+	++stats.wa_threshold_adaptions;
+
+	num_unloads = 0;
+	interval_page_io = page_io;
+}
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
 template <typename NodeT>
-void DeltaTree<KeyT, ValueT>::clean_node(NodeT *node) {
+void DeltaStore<KeyT, ValueT>::clean_node(NodeT *node) {
 	node->num_bytes_changed = 0;
 	for (auto *slot = node->slots_begin(); slot < node->slots_end(); ++slot)
 		slot->set_state(OperationType::Unchanged);
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
-void DeltaTree<KeyT, ValueT>::clean_node(Node *node) {
-	if (node->is_leaf())
-		clean_node(reinterpret_cast<LeafNode *>(node));
-	else
+void DeltaStore<KeyT, ValueT>::clean_node(Node *node) {
+	if (node->is_leaf()) {
+		// Erases are written out now. Drop their tombstones.
+		auto *leaf = reinterpret_cast<LeafNode *>(node);
+		leaf->remove_erased();
+		clean_node(leaf);
+	} else
 		clean_node(reinterpret_cast<InnerNode *>(node));
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
-template <typename NodeT, typename DeltasT>
-void DeltaTree<KeyT, ValueT>::extract_deltas(const NodeT *node,
-											 DeltasT &deltas) {
+DeltasView<KeyT, ValueT>
+DeltaStore<KeyT, ValueT>::extract_deltas(const Node *node) {
+	if (node->is_leaf()) {
+		auto *leaf = reinterpret_cast<const LeafNode *>(node);
+		return extract_deltas(leaf, {0, leaf->slot_count, true});
+	}
+	auto *inner_node = reinterpret_cast<const InnerNode *>(node);
+	return extract_deltas(inner_node, {0, inner_node->slot_count, false,
+									   inner_node->upper});
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaStore<KeyT, ValueT>::apply_deltas(Node *node, DeltasT deltas,
+											size_t page_size) {
+	const auto *src = deltas.get_bytes().data();
+	auto header = DeltasHeader::decode(src);
+	if (node->is_leaf()) {
+		apply_deltas(reinterpret_cast<LeafNode *>(node), src, header,
+					 page_size);
+	} else {
+		auto *inner_node = reinterpret_cast<InnerNode *>(node);
+		apply_deltas(inner_node, src, header, page_size);
+		inner_node->upper = header.upper;
+	}
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaStore<KeyT, ValueT>::load_deltas(Node *node, PageID page_id,
+										   DeltasT deltas, size_t page_size) {
+	// Lookups route through inner nodes. Only leaves keep deltas pending.
+	if (!is_lazy || !node->is_leaf()) {
+		apply_deltas(node, deltas, page_size);
+		return;
+	}
+	auto bytes = deltas.get_bytes();
+	auto &entry = pending[page_id];
+	entry.bytes.assign(bytes.begin(), bytes.end());
+	entry.num_lookups = 0;
+	++stats.delta_loads_deferred;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaStore<KeyT, ValueT>::prepare(char *data, PageID page_id,
+									   size_t page_size) {
+	if (pending.empty())
+		return;
+	auto it = pending.find(page_id);
+	if (it == pending.end())
+		return;
+
+	apply_deltas(reinterpret_cast<Node *>(data), DeltasT(it->second.bytes),
+				 page_size);
+	pending.erase(it);
+	++stats.deferred_deltas_applied;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+std::span<const std::byte>
+DeltaStore<KeyT, ValueT>::get_pending(char *data, PageID page_id,
+									  size_t page_size) {
+	if (pending.empty())
+		return {};
+	auto it = pending.find(page_id);
+	if (it == pending.end())
+		return {};
+	if (++it->second.num_lookups <= max_pending_lookups)
+		return it->second.bytes;
+
+	prepare(data, page_id, page_size);
+	return {};
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+template <typename NodeT>
+DeltasView<KeyT, ValueT>
+DeltaStore<KeyT, ValueT>::extract_deltas(const NodeT *node,
+										 const DeltasHeader &header) {
+	using EntryValueT =
+		std::conditional_t<std::is_same_v<NodeT, LeafNode>, ValueT, PID>;
+
+	// Count the deltas and bound their bytes to encode them into the arena in
+	// one pass. The arena only grows.
+	auto counted = header;
+	counted.num_deltas = 0;
+	size_t num_entry_bytes = 0;
+	for (const auto *slot = node->slots_begin(); slot < node->slots_end();
+		 ++slot) {
+		if (slot->get_state() == OperationType::Unchanged)
+			continue;
+		++counted.num_deltas;
+		num_entry_bytes += slot->get_key(node->get_data()).size();
+		if constexpr (std::is_same_v<NodeT, LeafNode>)
+			num_entry_bytes += slot->value_size;
+		else
+			num_entry_bytes += sizeof(PageID);
+	}
+	auto max_size = DeltaEncoder<KeyT, EntryValueT>::get_max_size(
+		counted.num_deltas, num_entry_bytes);
+	if (arena.size() < max_size)
+		arena.resize(max_size);
+
+	DeltaEncoder<KeyT, EntryValueT> encoder(arena.data(), counted);
 	for (const auto *slot = node->slots_begin(); slot < node->slots_end();
 		 ++slot) {
 		switch (slot->get_state()) {
 		case OperationType::Unchanged:
 			continue;
 		case OperationType::Inserted:
-			deltas.emplace_back(slot->get_state(),
-								slot->get_key(node->get_data()),
-								slot->get_value(node->get_data()));
-			break;
 		case OperationType::Updated:
-			deltas.emplace_back(slot->get_state(),
-								slot->get_key(node->get_data()),
-								slot->get_value(node->get_data()));
+			encoder.add(slot->get_state(), slot->get_key(node->get_data()),
+						slot->get_value(node->get_data()));
+			break;
+		case OperationType::Deleted:
+			encoder.add(slot->get_state(), slot->get_key(node->get_data()),
+						EntryValueT{});
 			break;
 		default:
-			throw std::logic_error("DeltaTree::extract_deltas(): Unknown "
+			throw std::logic_error("DeltaStore::extract_deltas(): Unknown "
 								   "operation type in slot.");
 		}
 	}
+	auto size = encoder.size();
+	assert(size <= max_size);
+	assert(size <= std::numeric_limits<uint16_t>::max());
+
+	return DeltasT({arena.data(), size});
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
-void DeltaTree<KeyT, ValueT>::store_deltas(PageID page_id, const Node *node) {
-	bool success = false;
-	if (node->is_leaf()) {
-		LeafDeltas deltas{};
-		auto *leaf = reinterpret_cast<const LeafNode *>(node);
-		extract_deltas(leaf, deltas);
-		success = this->insert(std::move(page_id),
-							   {std::move(deltas), leaf->slot_count});
-	} else {
-		InnerNodeDeltas deltas{};
-		auto *inner_node = reinterpret_cast<const InnerNode *>(node);
-		extract_deltas(inner_node, deltas);
-		success = this->insert(
-			std::move(page_id),
-			{std::move(deltas), inner_node->upper, inner_node->slot_count});
-	}
-	assert(success);
-}
-// -----------------------------------------------------------------
-template <KeyIndexable KeyT, ValueIndexable ValueT>
-template <typename NodeT, typename DeltasT>
-void DeltaTree<KeyT, ValueT>::apply_deltas(NodeT *node, const DeltasT &deltas,
-										   uint16_t slot_count) {
+template <typename NodeT>
+void DeltaStore<KeyT, ValueT>::apply_deltas(NodeT *node, const std::byte *src,
+											const DeltasHeader &header,
+											size_t page_size) {
+	using EntryValueT =
+		std::conditional_t<std::is_same_v<NodeT, LeafNode>, ValueT, PID>;
+
 	auto apply_delta = [](const auto &delta, NodeT *node, size_t page_size) {
 		auto &[entry, op_type] = delta;
 		auto &[key, value] = entry;
 		switch (op_type) {
-		case OperationType::Inserted: {
+		case OperationType::Inserted:
 			if (!node->has_space(key, value))
 				node->compactify(page_size);
-			assert(node->has_space(key, value));
-			auto success = node->insert(key, value);
-			assert(success);
+			if (!node->has_space(key, value) || !node->insert(key, value))
+				throw std::logic_error("DeltaStore::apply_deltas(): Inserted "
+									   "entry does not fit the node.");
 			break;
-		}
 		case OperationType::Updated:
-			node->update(key, value);
+			// Leaf values may have been relocated by an upsert.
+			if constexpr (std::is_same_v<NodeT, LeafNode>) {
+				if (!node->upsert(key, value, page_size))
+					throw std::logic_error("DeltaStore::apply_deltas(): "
+										   "Updated entry does not fit the "
+										   "node.");
+			} else {
+				node->update(key, value);
+			}
 			break;
+		case OperationType::Deleted:
+			// Only leaves erase entries while tracking deltas.
+			if constexpr (std::is_same_v<NodeT, LeafNode>) {
+				auto success = node->erase(key);
+				assert(success);
+				break;
+			}
+			[[fallthrough]];
 		default:
-			throw std::logic_error("DeltaTree::after_load(): "
+			throw std::logic_error("DeltaStore::apply_deltas(): "
 								   "Operation Type not implemented "
 								   "yet.");
 		}
 	};
 
+	DeltaDecoder<KeyT, EntryValueT> decoder(src, header.num_deltas,
+											key_buffer);
+
 	// Sanity Check: There must have been either deltas or node splits.
-	assert(!deltas.empty() || node->slot_count != slot_count);
+	assert(header.num_deltas > 0 || node->slot_count != header.slot_count);
 
-	// Analyze delta stream to determine cut-off point.
-	auto cut_off = slot_count;
-	for (size_t i = 0; i < deltas.size(); ++i) {
-		auto &[entry, op] = deltas[i];
-		switch (op) {
-		case OperationType::Inserted:
-			--cut_off;
-			break;
-		default:
-			break;
-		}
-	}
+	// Analyze delta stream to determine cut-off point. Erased entries are kept
+	// as tombstones in `slot_count`, so they are part of the on-disk prefix.
+	// Inserts are counted on the operation bitmap without decoding.
+	auto cut_off = header.slot_count - decoder.count(OperationType::Inserted);
 
 	// Remove split off slots.
 	node->slot_count = cut_off;
 
-	// Apply deltas to the node.
-	for (size_t i = 0; i < deltas.size(); ++i) {
-		auto &[entry, op] = deltas[i];
-		apply_delta(deltas[i], node, this->buffer_manager.page_size);
+	// Deltas are applied to the node as they are decoded, in two rounds. On
+	// leaves, the deletes and the updates that do not grow an entry come
+	// first. They free the space that the inserts and growing updates took on
+	// the node the deltas were extracted from. Inner nodes keep the original
+	// order in the second round: a child pointer may only be updated once the
+	// pivot that holds it was inserted.
+	auto needs_space = [&](const auto &delta) {
+		if constexpr (std::is_same_v<NodeT, LeafNode>) {
+			if (delta.op == OperationType::Updated) {
+				auto old_value = node->lookup(delta.entry.key);
+				return !old_value ||
+					   old_value->size() < delta.entry.value.size();
+			}
+			return delta.op == OperationType::Inserted;
+		}
+		return true;
+	};
+	while (!decoder.done()) {
+		auto delta = decoder.next();
+		if (!needs_space(delta))
+			apply_delta(delta, node, page_size);
+	}
+	DeltaDecoder<KeyT, EntryValueT> growing(src, header.num_deltas,
+											key_buffer);
+	while (!growing.done()) {
+		auto delta = growing.next();
+		if (needs_space(delta))
+			apply_delta(delta, node, page_size);
 	}
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaTree<KeyT, ValueT>::store_deltas(PageID page_id,
+										   DeltasT deltas) {
+	// Replaces any deltas buffered for the node before. The arena is copied
+	// into the tree's leaf.
+	if (std::getenv("DBG881") && page_id == 132) std::cout << "  STORE p132 size " << deltas.size() << std::endl;
+	track_deltas(page_id, deltas.size());
+	this->upsert(page_id, deltas);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaTree<KeyT, ValueT>::evict_cached_deltas() {
+	assert(is_locked);
+	while (cache.is_full()) {
+		// Popped first. Upserting may evict nodes that drop their entries.
+		auto entry = cache.pop();
+		++stats.delta_cache_evictions;
+		if (entry.is_dirty) {
+			DeltasView<KeyT, ValueT> deltas(entry.bytes);
+			track_deltas(entry.page_id, deltas.size());
+			this->upsert(entry.page_id, deltas);
+		}
+	}
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaTree<KeyT, ValueT>::erase_deltas(PageID page_id) {
+	assert(is_locked);
+	if (std::getenv("DBG881") && page_id == 132) std::cout << "  ERASE p132" << std::endl;
+	this->erase(page_id, this->buffer_manager.page_size);
+	untrack_deltas(page_id);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaTree<KeyT, ValueT>::track_deltas(PageID page_id, uint16_t size) {
+	if (page_id >= pid_filter.size())
+		pid_filter.resize(page_id + 1);
+	pid_filter[page_id] = true;
+	stored_deltas[page_id] = {size, num_stores++};
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaTree<KeyT, ValueT>::untrack_deltas(PageID page_id) {
+	if (page_id < pid_filter.size())
+		pid_filter[page_id] = false;
+	stored_deltas.erase(page_id);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+size_t DeltaTree<KeyT, ValueT>::merge_deltas(SegmentID segment_id,
+											 size_t io_budget) {
+	assert(!is_locked);
+
+	// Prefer large deltas that were not replaced for long.
+	std::vector<std::pair<size_t, PageID>> candidates;
+	candidates.reserve(stored_deltas.size());
+	for (const auto &[page_id, info] : stored_deltas)
+		candidates.emplace_back(info.size * (num_stores - info.stored_at),
+								page_id);
+	std::sort(candidates.begin(), candidates.end(), std::greater<>());
+
+	size_t num_merged = 0;
+	// Only count the I/O of this tree. Other trees may share the buffer.
+	const auto page_io = this->get_page_io();
+	for (const auto &[weight, page_id] : candidates) {
+		if (this->get_page_io() - page_io >= io_budget)
+			break;
+		// Merging another node may have written this one out already.
+		if (!may_have_deltas(page_id))
+			continue;
+
+		// Loading the node applies its deltas. Writing it out erases them.
+		auto &frame = this->buffer_manager.fix_page(segment_id, page_id, true,
+													this, false);
+		this->buffer_manager.unfix_page(frame, true);
+		merging_page = page_id;
+		this->buffer_manager.flush_page(frame);
+		merging_page.reset();
+
+		assert(!may_have_deltas(page_id));
+		++stats.delta_merges;
+		++num_merged;
+	}
+
+	return num_merged;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+size_t DeltaTree<KeyT, ValueT>::validate_deltas(PageID num_pages) {
+	assert(!is_locked);
+	cache.clear();
+	this->clear_pending();
+	pid_filter.clear();
+	stored_deltas.clear();
+	num_stores = 0;
+
+	// Nodes evicted while scanning are written out.
+	is_locked = true;
+	std::vector<PageID> invalid;
+	this->for_each([&](const PID &pid, const DeltasView<KeyT, ValueT> &deltas) {
+		// Page 0 holds the tree's state. Nodes past the last allocated one
+		// were never written.
+		PageID page_id = pid;
+		if (page_id == 0 || page_id >= num_pages || deltas.size() == 0)
+			invalid.push_back(page_id);
+		else
+			track_deltas(page_id, deltas.size());
+	});
+	for (auto page_id : invalid) {
+		this->erase(page_id, this->buffer_manager.page_size);
+		++stats.deltas_dropped_on_recovery;
+	}
+	erase_deferred_deletions();
+	is_locked = false;
+
+	return invalid.size();
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaTree<KeyT, ValueT>::flush_cache() {
+	assert(!is_locked);
+	is_locked = true;
+	// Copied first. Upserting may evict nodes that drop their entries.
+	for (const auto &entry : cache.clean()) {
+		DeltasView<KeyT, ValueT> deltas(entry.bytes);
+		track_deltas(entry.page_id, deltas.size());
+		this->upsert(entry.page_id, deltas);
+	}
+	erase_deferred_deletions();
+	is_locked = false;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
 void DeltaTree<KeyT, ValueT>::erase_deferred_deletions() {
 	assert(is_locked);
 	while (!deferred_deletions.empty()) {
 		auto page_id = deferred_deletions.back();
 		deferred_deletions.pop_back();
-		this->erase(page_id, this->buffer_manager.page_size);
+		if (may_have_deltas(page_id))
+			erase_deltas(page_id);
 	}
 }
 // -----------------------------------------------------------------
-template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
-std::ostream &operator<<(std::ostream &os,
-						 const BBBTree<KeyT, ValueT, UseDeltaTree> &type) {
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree,
+		  typename DeltaStoreT>
+std::ostream &
+operator<<(std::ostream &os,
+		   const BBBTree<KeyT, ValueT, UseDeltaTree, DeltaStoreT> &type) {
 	os << "B-Tree:" << std::endl;
 	os << type.btree << std::endl;
-	os << "Delta Tree" << std::endl;
-	os << type.delta_tree << std::endl;
+	os << "Delta Store" << std::endl;
+	os << type.delta_store << std::endl;
 
 	return os;
 }
 // -----------------------------------------------------------------
 // Explicit instantiations
+template class DeltaStore<UInt64, TID>;
+template class DeltaStore<String, TID>;
+template class DeltaStore<UInt64, String>;
+template class DeltaStore<String, String>;
+template class DeltaTree<UInt64, TID>;
+template class DeltaTree<String, TID>;
+template class DeltaTree<UInt64, String>;
+template class DeltaTree<String, String>;
 template class BBBTree<UInt64, TID>;
 template class BBBTree<String, TID>;
+template class BBBTree<UInt64, String>;
+template class BBBTree<String, String>;
+template class BBBTree<UInt64, TID, false, DeltaLog<UInt64, TID>>;
+template class BBBTree<String, TID, false, DeltaLog<String, TID>>;
 template std::ostream &operator<<(std::ostream &, const BBBTree<UInt64, TID> &);
 template std::ostream &operator<<(std::ostream &, const BBBTree<String, TID> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BBBTree<UInt64, String> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BBBTree<String, String> &);
+template std::ostream &
+operator<<(std::ostream &,
+		   const BBBTree<UInt64, TID, false, DeltaLog<UInt64, TID>> &);
+template std::ostream &
+operator<<(std::ostream &,
+		   const BBBTree<String, TID, false, DeltaLog<String, TID>> &);
 // -----------------------------------------------------------------
 } // namespace bbbtree
@@ -11,8 +11,13 @@
 #include <cstring>
 #include <deque>
 #include <iostream>
+#include <iterator>
+#include <numeric>
 #include <optional>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace bbbtree {
@@ -20,8 +25,10 @@ namespace bbbtree {
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 BTree<KeyT, ValueT, UseDeltaTree>::BTree(SegmentID segment_id,
 										 BufferManager &buffer_manager,
-										 PageLogic *page_logic)
-	: Segment(segment_id, buffer_manager), page_logic(page_logic) {
+										 PageLogic *page_logic,
+										 bool is_delta_tree)
+	: Segment(segment_id, buffer_manager), page_logic(page_logic),
+	  is_delta_tree(is_delta_tree) {
 
 	// Sanity Check.
 	if constexpr (UseDeltaTree) {
@@ -39,6 +46,7 @@ BTree<KeyT, ValueT, UseDeltaTree>::BTree(SegmentID segment_id,
 	// Load meta-data into memory.
 	root = state.root;
 	next_free_page = state.next_free_page;
+	first_free_page = state.first_free_page;
 
 	bool is_dirty = false;
 
@@ -46,8 +54,10 @@ BTree<KeyT, ValueT, UseDeltaTree>::BTree(SegmentID segment_id,
 	if (next_free_page == 0) {
 		root = 1;
 		next_free_page = 2;
+		first_free_page = 0;
 		state.root = root;
 		state.next_free_page = next_free_page;
+		state.first_free_page = first_free_page;
 		// Intialize root node.
 		auto &root_page = buffer_manager.fix_page(segment_id, root, true,
 												  page_logic, is_delta_tree);
@@ -72,8 +82,11 @@ void BTree<KeyT, ValueT, UseDeltaTree>::clear() {
 
 	root = 1;
 	next_free_page = 2;
+	first_free_page = 0;
 	state.root = root;
 	state.next_free_page = next_free_page;
+	state.first_free_page = first_free_page;
+	last_append_leaf = 0;
 
 	// Intialize root node.
 	auto &root_page = buffer_manager.fix_page(segment_id, root, true,
@@ -92,7 +105,7 @@ BTree<KeyT, ValueT, UseDeltaTree>::lookup(const KeyT &key) {
 	auto &leaf = *reinterpret_cast<LeafNode *>(leaf_frame.get_data());
 
 	// TODO: Not thread-safe.
-	auto result = leaf.lookup(key);
+	auto result = leaf.lookup(key, get_pending(leaf_frame));
 
 	buffer_manager.unfix_page(leaf_frame, false);
 
@@ -102,16 +115,31 @@ BTree<KeyT, ValueT, UseDeltaTree>::lookup(const KeyT &key) {
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 void BTree<KeyT, ValueT, UseDeltaTree>::erase(const KeyT &key,
 											  size_t page_size) {
-	assert(!UseDeltaTree && "Erase not supported with delta tree yet.");
+	assert(page_size == buffer_manager.page_size);
 	++stats.num_deletions_index;
 
-	auto &leaf_frame = get_leaf(key, true);
-	auto &leaf = *reinterpret_cast<LeafNode *>(leaf_frame.get_data());
+	// Collect all nodes on path to leaf for given key. Root in front.
+	std::vector<BufferFrame *> path{&buffer_manager.fix_page(
+		segment_id, root, true, page_logic, is_delta_tree)};
+	auto *node = reinterpret_cast<InnerNode *>(path.back()->get_data());
+	while (!node->is_leaf()) {
+		path.push_back(&buffer_manager.fix_page(
+			segment_id, node->lookup(key), true, page_logic, is_delta_tree));
+		node = reinterpret_cast<InnerNode *>(path.back()->get_data());
+	}
 
 	// TODO: Not thread-safe.
-	leaf.erase(key, page_size);
+	auto &leaf = *reinterpret_cast<LeafNode *>(node);
+	if (leaf.erase(key)) {
+		path.back()->set_dirty();
+		// Pages of delta-tracked trees cannot be freed yet.
+		if constexpr (!UseDeltaTree)
+			merge(path, key);
+	}
 
-	buffer_manager.unfix_page(leaf_frame, true);
+	for (auto *frame : path)
+		// Don't mark dirty here. Done while erasing.
+		buffer_manager.unfix_page(*frame, false);
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
@@ -125,9 +153,14 @@ BufferFrame &BTree<KeyT, ValueT, UseDeltaTree>::get_leaf(const KeyT &key,
 										   page_logic, is_delta_tree);
 	auto *node = reinterpret_cast<InnerNode *>(frame->get_data());
 
+	bool dbg = false;
+	if constexpr (std::is_same_v<KeyT, UInt64>)
+		dbg = std::getenv("DBG881") && uint64_t(key) == (is_delta_tree ? 132 : 881);
+	if (dbg) std::cout << "  path p" << frame->get_page_id();
 	while (!node->is_leaf()) {
 		// Acquire child.
 		auto child_id = node->lookup(key);
+		if (dbg) std::cout << dbg_inner(node) << " -> p" << child_id;
 		auto *child_frame = &buffer_manager.fix_page(
 			segment_id, child_id, exclusive, page_logic, is_delta_tree);
 
@@ -138,26 +171,35 @@ BufferFrame &BTree<KeyT, ValueT, UseDeltaTree>::get_leaf(const KeyT &key,
 		node = reinterpret_cast<InnerNode *>(child_frame->get_data());
 	}
 
+	if (dbg) std::cout << std::endl;
 	// Returns the leaf's locked frame.
 	return *frame;
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::check_entry_size(
+	const KeyT &key, const ValueT &value) const {
+	size_t page_size = buffer_manager.page_size;
+	size_t required_leaf_size = key.size() + value.size();
+	size_t required_node_size = key.size();
+	if ((required_leaf_size > page_size - LeafNode::min_space) ||
+		(required_node_size > page_size - InnerNode::min_space))
+		throw std::logic_error("BTree::insert(): Key too large.");
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 bool BTree<KeyT, ValueT, UseDeltaTree>::insert(const KeyT &key,
 											   const ValueT &value) {
 	// Sanity check
-	{
-		size_t page_size = buffer_manager.page_size;
-		size_t required_leaf_size = key.size() + value.size();
-		size_t required_node_size = key.size();
-		if ((required_leaf_size > page_size - LeafNode::min_space) ||
-			(required_node_size > page_size - InnerNode::min_space))
-			throw std::logic_error("BTree::insert(): Key too large.");
-	}
+	check_entry_size(key, value);
 restart:
 	auto &leaf_frame = get_leaf(key, true);
 	auto &leaf = *reinterpret_cast<LeafNode *>(leaf_frame.get_data());
 
+	// Reclaim space of erased entries first.
+	if (!leaf.has_space(key, value))
+		leaf.compactify(buffer_manager.page_size);
+
 	// Node split?
 	if (!leaf.has_space(key, value)) {
 		// Release locks. Split will acquire its own. Re-acquire lock after
@@ -173,6 +215,12 @@ restart:
 		return false;
 	}
 
+	// Remember appends to the end of a leaf to detect sequential inserts.
+	const auto &last_slot = *(leaf.slots_end() - 1);
+	last_append_leaf = (last_slot.get_key(leaf.get_data()) == key)
+						   ? leaf_frame.get_page_id()
+						   : 0;
+
 	buffer_manager.unfix_page(leaf_frame, true);
 	assert(lookup(key).has_value());
 	assert(lookup(key).value() == value);
@@ -194,12 +242,280 @@ void BTree<KeyT, ValueT, UseDeltaTree>::update(const KeyT &key,
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::upsert(const KeyT &key,
+											   const ValueT &value) {
+	// Sanity check
+	check_entry_size(key, value);
+restart:
+	auto &leaf_frame = get_leaf(key, true);
+	auto &leaf = *reinterpret_cast<LeafNode *>(leaf_frame.get_data());
+
+	// Node split?
+	if (!leaf.upsert(key, value, buffer_manager.page_size)) {
+		// Release locks. Split will acquire its own.
+		buffer_manager.unfix_page(leaf_frame, false);
+		split(key, value, true);
+		goto restart;
+	}
+
+	// Remember appends to the end of a leaf to detect sequential inserts.
+	const auto &last_slot = *(leaf.slots_end() - 1);
+	last_append_leaf = (last_slot.get_key(leaf.get_data()) == key)
+						   ? leaf_frame.get_page_id()
+						   : 0;
+
+	buffer_manager.unfix_page(leaf_frame, true);
+	assert(lookup(key).has_value());
+	assert(lookup(key).value() == value);
+
+	++stats.num_upserts_index;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+std::vector<std::optional<ValueT>>
+BTree<KeyT, ValueT, UseDeltaTree>::lookup_batch(std::span<const KeyT> keys) {
+	stats.num_lookups_index += keys.size();
+
+	// Serve keys in ascending order.
+	std::vector<size_t> order(keys.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return keys[a] < keys[b];
+	});
+
+	std::vector<std::optional<ValueT>> results(keys.size());
+	for_each_leaf(
+		order.size(),
+		[&](size_t i) -> const KeyT & { return keys[order[i]]; }, false,
+		[&](BufferFrame &frame, size_t i) {
+			auto &leaf = *reinterpret_cast<LeafNode *>(frame.get_data());
+			// TODO: Not thread-safe.
+			auto result = leaf.lookup(keys[order[i]], get_pending(frame));
+			if (result.has_value())
+				results[order[i]].emplace(std::move(result.value()));
+		});
+
+	return results;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::update_batch(
+	std::span<const std::pair<KeyT, ValueT>> entries) {
+	stats.num_updates_index += entries.size();
+
+	// Serve keys in ascending order. Later updates of the same key win.
+	std::vector<size_t> order(entries.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return entries[a].first < entries[b].first;
+	});
+
+	for_each_leaf(
+		order.size(),
+		[&](size_t i) -> const KeyT & { return entries[order[i]].first; },
+		true,
+		[&](BufferFrame &frame, size_t i) {
+			auto &leaf = *reinterpret_cast<LeafNode *>(frame.get_data());
+			const auto &[key, value] = entries[order[i]];
+			leaf.update(key, value);
+		});
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+template <typename GetKey, typename Visit>
+void BTree<KeyT, ValueT, UseDeltaTree>::for_each_leaf(size_t num_keys,
+													  GetKey &&get_key,
+													  bool exclusive,
+													  Visit &&visit) {
+	// The fixed nodes from the root down to the current leaf. Each node
+	// covers all keys up to its fence. Nodes on the right-most path have no
+	// fence.
+	struct FixedNode {
+		BufferFrame *frame;
+		std::optional<KeyT> fence;
+	};
+	std::vector<FixedNode> path;
+
+	auto release = [&]() {
+		auto *frame = path.back().frame;
+		auto *node = reinterpret_cast<Node *>(frame->get_data());
+		// Only leaves are modified.
+		buffer_manager.unfix_page(*frame, exclusive && node->is_leaf());
+		path.pop_back();
+	};
+
+	for (size_t i = 0; i < num_keys; ++i) {
+		const KeyT &key = get_key(i);
+
+		// Move up until the node covers the key.
+		while (!path.empty() && path.back().fence.has_value() &&
+			   *path.back().fence < key)
+			release();
+		if (path.empty())
+			path.push_back({&buffer_manager.fix_page(segment_id, root, exclusive,
+													 page_logic, is_delta_tree),
+							std::nullopt});
+
+		// Move down to the leaf.
+		auto *node = reinterpret_cast<InnerNode *>(path.back().frame->get_data());
+		while (!node->is_leaf()) {
+			auto fence = path.back().fence;
+			auto child_id = node->upper;
+			auto *slot = node->lower_bound(key);
+			if (slot != node->slots_end()) {
+				child_id = slot->child;
+				fence = slot->get_key(node->get_data());
+			}
+			auto *child_frame = &buffer_manager.fix_page(
+				segment_id, child_id, exclusive, page_logic, is_delta_tree);
+			path.push_back({child_frame, fence});
+			node = reinterpret_cast<InnerNode *>(child_frame->get_data());
+		}
+
+		visit(*path.back().frame, i);
+	}
+
+	while (!path.empty())
+		release();
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::bulk_load(
+	std::span<const std::pair<KeyT, ValueT>> entries, float fill_factor) {
+	const size_t page_size = buffer_manager.page_size;
+
+	// Sanity checks. Do not touch the tree before the input is validated.
+	if (fill_factor <= 0 || fill_factor > 1)
+		throw std::logic_error(
+			"BTree::bulk_load(): Fill factor must be in (0, 1].");
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const auto &[key, value] = entries[i];
+		size_t key_size = key.size();
+		if ((key_size + value.size() > page_size - LeafNode::min_space) ||
+			(key_size > page_size - InnerNode::min_space))
+			throw std::logic_error("BTree::bulk_load(): Key too large.");
+		if (i > 0 && !(entries[i - 1].first < key))
+			throw std::logic_error(
+				"BTree::bulk_load(): Keys must be sorted and unique.");
+	}
+	if (!empty())
+		throw std::logic_error("BTree::bulk_load(): Tree must be empty.");
+	if (entries.empty())
+		return;
+
+	// The nodes of the level below with their biggest key.
+	std::vector<std::pair<KeyT, PageID>> children;
+
+	// Fill the leaves. The first leaf re-uses the page of the empty root.
+	const size_t leaf_capacity = fill_factor * (page_size - sizeof(LeafNode));
+	auto entry = entries.begin();
+	PageID pid = root;
+	while (entry != entries.end()) {
+		auto &frame = buffer_manager.fix_page(segment_id, pid, true, page_logic,
+											  is_delta_tree);
+		auto *leaf = new (frame.get_data()) LeafNode(page_size);
+		while (entry != entries.end()) {
+			const auto &[key, value] = *entry;
+			auto used = page_size - sizeof(LeafNode) - leaf->get_free_space();
+			// Always take at least one entry.
+			if (leaf->slot_count > 0 &&
+				(!leaf->has_space(key, value) ||
+				 used + leaf->required_space(key, value) > leaf_capacity))
+				break;
+			auto success = leaf->insert(key, value);
+			assert(success);
+			++entry;
+		}
+		children.emplace_back(std::prev(entry)->first, pid);
+		buffer_manager.unfix_page(frame, true);
+
+		if (entry != entries.end())
+			pid = get_new_page();
+	}
+
+	// Build the inner levels bottom-up until a single node is left.
+	const size_t node_capacity = fill_factor * (page_size - sizeof(InnerNode));
+	uint16_t level = 1;
+	while (children.size() > 1) {
+		std::vector<std::pair<KeyT, PageID>> parents;
+		size_t i = 0;
+		while (i < children.size()) {
+			auto pid = get_new_page();
+			auto &frame = buffer_manager.fix_page(segment_id, pid, true,
+												  page_logic, is_delta_tree);
+			// The last child of a node becomes its `upper`. Each further child
+			// turns the current `upper` into a pivot.
+			auto *node = new (frame.get_data())
+				InnerNode(page_size, level, children[i].second);
+			++i;
+			while (i < children.size()) {
+				const auto &[pivot, child] = children[i - 1];
+				auto used =
+					page_size - sizeof(InnerNode) - node->get_free_space();
+				// Always take at least two children to reduce the level.
+				if (!node->has_space(pivot, child) ||
+					(node->slot_count > 0 &&
+					 used + node->required_space(pivot, child) > node_capacity))
+					break;
+				auto success = node->insert(pivot, child);
+				assert(success);
+				node->upper = children[i].second;
+				++i;
+			}
+			parents.emplace_back(children[i - 1].first, pid);
+			buffer_manager.unfix_page(frame, true);
+		}
+		children = std::move(parents);
+		++level;
+	}
+
+	// Install the new root.
+	auto &frame =
+		buffer_manager.fix_page(segment_id, 0, true, nullptr, is_delta_tree);
+	auto &state = *(reinterpret_cast<BTree<KeyT, ValueT, UseDeltaTree> *>(
+		frame.get_data()));
+	root = children.front().second;
+	state.root = root;
+	buffer_manager.unfix_page(frame, true);
+
+	stats.num_insertions_index += entries.size();
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::empty() {
+	auto &frame = buffer_manager.fix_page(segment_id, root, false, page_logic,
+										  is_delta_tree);
+	apply_pending(frame);
+	auto &node = *reinterpret_cast<Node *>(frame.get_data());
+	bool result =
+		node.is_leaf() &&
+		reinterpret_cast<LeafNode &>(node).get_num_entries() == 0;
+	buffer_manager.unfix_page(frame, false);
+	return result;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 PageID BTree<KeyT, ValueT, UseDeltaTree>::get_new_page() {
 	auto &frame =
 		buffer_manager.fix_page(segment_id, 0, true, nullptr, is_delta_tree);
 	auto &state = *(reinterpret_cast<BTree<KeyT, ValueT, UseDeltaTree> *>(
 		frame.get_data()));
 
+	// Re-use a freed page.
+	if (first_free_page) {
+		auto page_id = first_free_page;
+		auto &free_frame = buffer_manager.fix_page(segment_id, page_id, true,
+												   page_logic, is_delta_tree);
+		first_free_page =
+			reinterpret_cast<FreePage *>(free_frame.get_data())->next;
+		state.first_free_page = first_free_page;
+		buffer_manager.unfix_page(free_frame, false);
+		buffer_manager.unfix_page(frame, true);
+
+		++stats.pages_reused;
+		return page_id;
+	}
+
 	auto page_id = next_free_page;
 	++next_free_page;
 	state.next_free_page = next_free_page;
@@ -215,10 +531,132 @@ PageID BTree<KeyT, ValueT, UseDeltaTree>::get_new_page() {
 	return page_id;
 }
 
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::free_page(BufferFrame &frame) {
+	auto &meta_frame =
+		buffer_manager.fix_page(segment_id, 0, true, nullptr, is_delta_tree);
+	auto &state = *(reinterpret_cast<BTree<KeyT, ValueT, UseDeltaTree> *>(
+		meta_frame.get_data()));
+
+	// Link the page into the list of free pages.
+	new (frame.get_data()) FreePage{first_free_page};
+	frame.set_dirty();
+	first_free_page = frame.get_page_id();
+	state.first_free_page = first_free_page;
+
+	buffer_manager.unfix_page(meta_frame, true);
+
+	++stats.pages_freed;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::merge(
+	const std::vector<BufferFrame *> &path, const KeyT &key) {
+	const auto page_size = buffer_manager.page_size;
+
+	// Merge bottom-up. A parent only changes if its children were merged.
+	for (size_t level = path.size() - 1; level > 0; --level) {
+		auto *frame = path.at(level);
+		auto *node = reinterpret_cast<Node *>(frame->get_data());
+		auto *parent_frame = path.at(level - 1);
+		auto *parent = reinterpret_cast<InnerNode *>(parent_frame->get_data());
+
+		// Underfull?
+		if (node->is_leaf()) {
+			auto *leaf = reinterpret_cast<LeafNode *>(node);
+			if (leaf->get_used_space() >=
+				merge_threshold * (page_size - sizeof(LeafNode)))
+				break;
+		} else {
+			auto *inner_node = reinterpret_cast<InnerNode *>(node);
+			if (inner_node->get_used_space() >=
+				merge_threshold * (page_size - sizeof(InnerNode)))
+				break;
+		}
+		// No sibling to merge with. The parent is underfull then.
+		if (parent->slot_count == 0)
+			continue;
+
+		// Merge with the right sibling. The right-most child merges with its
+		// left sibling.
+		auto *separator = parent->lower_bound(key);
+		if (separator == parent->slots_end())
+			--separator;
+		auto left_pid = separator->child;
+		auto right_pid = (separator + 1 < parent->slots_end())
+							 ? (separator + 1)->child
+							 : parent->upper;
+		bool is_left = (left_pid == frame->get_page_id());
+		auto &sibling_frame =
+			buffer_manager.fix_page(segment_id, is_left ? right_pid : left_pid,
+									true, page_logic, is_delta_tree);
+		auto *left_frame = is_left ? frame : &sibling_frame;
+		auto *right_frame = is_left ? &sibling_frame : frame;
+
+		bool merged, balanced = false;
+		if (node->is_leaf()) {
+			auto *left = reinterpret_cast<LeafNode *>(left_frame->get_data());
+			auto *right = reinterpret_cast<LeafNode *>(right_frame->get_data());
+			if (std::getenv("DBG881")) std::cout << "  DMERGE-before L p" << left_frame->get_page_id() << dbg_key(left, 132) << " R p" << right_frame->get_page_id() << dbg_key(right, 132) << std::endl;
+			merged = left->merge(*right, page_size);
+			if (!merged)
+				balanced = left->balance(*right, *parent, separator, page_size);
+			if (std::getenv("DBG881")) std::cout << "  DMERGE-after merged " << merged << " balanced " << balanced << " L" << dbg_key(left, 132) << " R" << dbg_key(right, 132) << std::endl;
+		} else {
+			auto *left = reinterpret_cast<InnerNode *>(left_frame->get_data());
+			auto *right =
+				reinterpret_cast<InnerNode *>(right_frame->get_data());
+			merged = left->merge(
+				*right, separator->get_key(parent->get_data()), page_size);
+			if (!merged)
+				balanced = left->balance(*right, *parent, separator, page_size);
+		}
+
+		if (merged) {
+			parent->erase_merged(separator);
+			free_page(*right_frame);
+			++stats.node_merges;
+		}
+		if (merged || balanced) {
+			left_frame->set_dirty();
+			right_frame->set_dirty();
+			parent_frame->set_dirty();
+		}
+		buffer_manager.unfix_page(sibling_frame, false);
+
+		// Only a merge removes a pivot from the parent.
+		if (!merged)
+			break;
+	}
+
+	// Shrink the tree while the root has a single child.
+	auto *root_frame = path.front();
+	auto *root_node = reinterpret_cast<InnerNode *>(root_frame->get_data());
+	std::vector<BufferFrame *> locked_nodes;
+	while (!root_node->is_leaf() && root_node->slot_count == 0) {
+		auto &frame = buffer_manager.fix_page(segment_id, 0, true, nullptr,
+											  is_delta_tree);
+		auto &state = *(reinterpret_cast<BTree<KeyT, ValueT, UseDeltaTree> *>(
+			frame.get_data()));
+		root = root_node->upper;
+		state.root = root;
+		buffer_manager.unfix_page(frame, true);
+
+		free_page(*root_frame);
+		root_frame = &buffer_manager.fix_page(segment_id, root, true,
+											  page_logic, is_delta_tree);
+		locked_nodes.push_back(root_frame);
+		root_node = reinterpret_cast<InnerNode *>(root_frame->get_data());
+	}
+	for (auto *frame : locked_nodes)
+		buffer_manager.unfix_page(*frame, false);
+}
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 void BTree<KeyT, ValueT, UseDeltaTree>::split(const KeyT &key,
-											  const ValueT &value) {
+											  const ValueT &value,
+											  bool is_upsert) {
 	using Pivot = std::pair<const KeyT, const PageID>;
 	// logger.log("### Splitting node to insert key " + std::string(key));
 	//  No frames are to be held at this point.
@@ -248,7 +686,8 @@ void BTree<KeyT, ValueT, UseDeltaTree>::split(const KeyT &key,
 		// We stop when the target leaf fits the new key-value-pair.
 		auto *leaf_frame = path.at(0);
 		auto *leaf = reinterpret_cast<LeafNode *>(leaf_frame->get_data());
-		if (leaf->has_space(key, value)) {
+		if (is_upsert ? leaf->can_upsert(key, value, buffer_manager.page_size)
+					  : leaf->has_space(key, value)) {
 			for (auto *frame : locked_nodes)
 				// Don't mark dirty here. Done while splitting.
 				buffer_manager.unfix_page(*frame, false);
@@ -256,18 +695,32 @@ void BTree<KeyT, ValueT, UseDeltaTree>::split(const KeyT &key,
 		}
 		assert(leaf->slot_count > 0);
 
+		// Sequential inserts? The previous insert appended to this leaf and
+		// the new key goes behind its last key as well. Then keep the leaf
+		// full and continue on an empty right node instead of leaving two
+		// half-full nodes behind that never receive keys again.
+		const auto &last_slot = *(leaf->slots_end() - 1);
+		const bool is_append =
+			(leaf_frame->get_page_id() == last_append_leaf) &&
+			(last_slot.get_key(leaf->get_data()) < key);
+
 		// Split leaf.
 		const auto new_pid = get_new_page();
 		auto *new_leaf_frame = &buffer_manager.fix_page(
 			segment_id, new_pid, true, page_logic, is_delta_tree);
-		assert(new_leaf_frame->is_new());
 		auto *new_leaf = (new (new_leaf_frame->get_data())
 							  LeafNode(buffer_manager.page_size));
 		const auto pivot =
-			leaf->split(*new_leaf, key, buffer_manager.page_size);
+			leaf->split(*new_leaf, key, buffer_manager.page_size, is_append);
 
+		if (is_delta_tree && std::getenv("DBG881"))
+			std::cout << "  DSPLIT p" << leaf_frame->get_page_id() << " -> p" << new_pid << " append " << is_append << " upsert " << is_upsert << dbg_key(leaf, 132) << " |" << dbg_key(new_leaf, 132) << std::endl;
+		if (!is_delta_tree && std::getenv("DBG881"))
+			std::cout << "  split p" << leaf_frame->get_page_id() << " -> p" << new_pid << " append " << is_append << dbg_key(leaf, 881) << " |" << dbg_key(new_leaf, 881) << std::endl;
 		new_leaf_frame->set_dirty();
-		leaf_frame->set_dirty();
+		// An append split leaves the left leaf untouched.
+		if (!is_append)
+			leaf_frame->set_dirty();
 
 		locked_nodes.push_back(new_leaf_frame);
 		std::vector<Pivot> insertion_queue{{pivot, new_pid}};
@@ -291,7 +744,6 @@ void BTree<KeyT, ValueT, UseDeltaTree>::split(const KeyT &key,
 
 				auto *root_frame = &buffer_manager.fix_page(
 					segment_id, root, true, page_logic, is_delta_tree);
-				assert(root_frame->is_new());
 				new (root_frame->get_data())
 					InnerNode(buffer_manager.page_size, ++max_level, old_root);
 				root_frame->set_dirty();
@@ -305,13 +757,37 @@ void BTree<KeyT, ValueT, UseDeltaTree>::split(const KeyT &key,
 			curr_node = reinterpret_cast<InnerNode *>(curr_frame->get_data());
 			auto [curr_key, curr_pid] = insertion_queue.back();
 
+			// Reclaim space of erased pivots first.
+			if (!curr_node->has_space(curr_key, curr_pid))
+				curr_node->compactify(buffer_manager.page_size);
+
 			// Split inner node. Moving up.
 			if (!curr_node->has_space(curr_key, curr_pid)) {
+				// Appending to the right-most child? Keep this node as is and
+				// start a new node holding only the new child.
+				if (is_append &&
+					curr_node->lower_bound(curr_key) == curr_node->slots_end()) {
+					++stats.inner_node_splits;
+					const auto new_pid = get_new_page();
+					auto *new_frame = &buffer_manager.fix_page(
+						segment_id, new_pid, true, page_logic, is_delta_tree);
+					new (new_frame->get_data()) InnerNode(
+						buffer_manager.page_size, curr_node->level, curr_pid);
+					new_frame->set_dirty();
+					locked_nodes.push_back(new_frame);
+
+					// The split's pivot now separates this node and the new
+					// one in the parent.
+					insertion_queue.pop_back();
+					insertion_queue.push_back({curr_key, new_pid});
+					++curr_level;
+					continue;
+				}
+
 				// Create new node.
 				const auto new_pid = get_new_page();
 				auto *new_frame = &buffer_manager.fix_page(
 					segment_id, new_pid, true, page_logic, is_delta_tree);
-				assert(new_frame->is_new());
 				auto *new_node = (new (new_frame->get_data()) InnerNode(
 					buffer_manager.page_size, curr_node->level,
 					curr_node->get_upper()));
@@ -350,8 +826,9 @@ void BTree<KeyT, ValueT, UseDeltaTree>::split(const KeyT &key,
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 size_t BTree<KeyT, ValueT, UseDeltaTree>::get_average_num_entries_per_node() {
 	// Acquire root to get height of tree.
-	auto &root_frame = buffer_manager.fix_page(segment_id, root, false,
-											   page_logic, is_delta_tree);
+	auto &root_frame =
+		buffer_manager.fix_page(segment_id, root, false, page_logic,
+								is_delta_tree, AccessHint::ONCE);
 	auto *node = reinterpret_cast<
 		typename BTree<KeyT, ValueT, UseDeltaTree>::InnerNode *>(
 		root_frame.get_data());
@@ -367,8 +844,9 @@ size_t BTree<KeyT, ValueT, UseDeltaTree>::get_average_num_entries_per_node() {
 		std::vector<PageID> children{};
 		for (auto pid : nodes_on_current_level) {
 			// Acquire page.
-			auto &frame = buffer_manager.fix_page(segment_id, pid, false,
-												  page_logic, is_delta_tree);
+			auto &frame =
+				buffer_manager.fix_page(segment_id, pid, false, page_logic,
+										is_delta_tree, AccessHint::ONCE);
 			auto *node = reinterpret_cast<
 				typename BTree<KeyT, ValueT, UseDeltaTree>::InnerNode *>(
 				frame.get_data());
@@ -395,8 +873,10 @@ size_t BTree<KeyT, ValueT, UseDeltaTree>::get_average_num_entries_per_node() {
 
 	// Traverse leaf level
 	for (auto pid : nodes_on_current_level) {
-		auto &frame = buffer_manager.fix_page(segment_id, pid, false,
-											  page_logic, is_delta_tree);
+		auto &frame =
+			buffer_manager.fix_page(segment_id, pid, false, page_logic,
+									is_delta_tree, AccessHint::ONCE);
+		apply_pending(frame);
 		auto &leaf = *reinterpret_cast<
 			typename BTree<KeyT, ValueT, UseDeltaTree>::LeafNode *>(
 			frame.get_data());
@@ -419,7 +899,8 @@ std::ostream &operator<<(std::ostream &os,
 	auto size = type.size();
 	// Acquire root to get height of tree.
 	auto &root_frame = type.buffer_manager.fix_page(
-		type.segment_id, type.root, false, type.page_logic, type.is_delta_tree);
+		type.segment_id, type.root, false, type.page_logic, type.is_delta_tree,
+		AccessHint::ONCE);
 	auto *node = reinterpret_cast<
 		typename BTree<KeyT, ValueT, UseDeltaTree>::InnerNode *>(
 		root_frame.get_data());
@@ -442,9 +923,9 @@ std::ostream &operator<<(std::ostream &os,
 		std::vector<PageID> children{};
 		for (auto pid : nodes_on_current_level) {
 			// Acquire page.
-			auto &frame = type.buffer_manager.fix_page(type.segment_id, pid,
-													   false, type.page_logic,
-													   type.is_delta_tree);
+			auto &frame = type.buffer_manager.fix_page(
+				type.segment_id, pid, false, type.page_logic,
+				type.is_delta_tree, AccessHint::ONCE);
 			auto *node = reinterpret_cast<
 				typename BTree<KeyT, ValueT, UseDeltaTree>::InnerNode *>(
 				frame.get_data());
@@ -474,7 +955,9 @@ std::ostream &operator<<(std::ostream &os,
 	os << "################ LEVEL " << level << " ###############" << std::endl;
 	for (auto pid : nodes_on_current_level) {
 		auto &frame = type.buffer_manager.fix_page(
-			type.segment_id, pid, false, type.page_logic, type.is_delta_tree);
+			type.segment_id, pid, false, type.page_logic, type.is_delta_tree,
+			AccessHint::ONCE);
+		type.apply_pending(frame);
 
 		auto *leaf = reinterpret_cast<
 			typename BTree<KeyT, ValueT, UseDeltaTree>::LeafNode *>(
@@ -497,10 +980,11 @@ std::ostream &operator<<(std::ostream &os,
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
-size_t BTree<KeyT, ValueT, UseDeltaTree>::size() const {
+std::vector<PageID>
+BTree<KeyT, ValueT, UseDeltaTree>::get_leaves(AccessHint hint) const {
 	// Acquire root to get height of tree.
 	auto &root_frame = buffer_manager.fix_page(segment_id, root, false,
-											   page_logic, is_delta_tree);
+											   page_logic, is_delta_tree, hint);
 	auto *node = reinterpret_cast<
 		typename BTree<KeyT, ValueT, UseDeltaTree>::InnerNode *>(
 		root_frame.get_data());
@@ -514,8 +998,8 @@ size_t BTree<KeyT, ValueT, UseDeltaTree>::size() const {
 		std::vector<PageID> children{};
 		for (auto pid : nodes_on_current_level) {
 			// Acquire page.
-			auto &frame = buffer_manager.fix_page(segment_id, pid, false,
-												  page_logic, is_delta_tree);
+			auto &frame = buffer_manager.fix_page(
+				segment_id, pid, false, page_logic, is_delta_tree, hint);
 			auto *node = reinterpret_cast<
 				typename BTree<KeyT, ValueT, UseDeltaTree>::InnerNode *>(
 				frame.get_data());
@@ -537,18 +1021,25 @@ size_t BTree<KeyT, ValueT, UseDeltaTree>::size() const {
 		--level;
 	}
 
+	return nodes_on_current_level;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+size_t BTree<KeyT, ValueT, UseDeltaTree>::size() const {
 	// Traverse leaf level
 	size_t result = 0;
-	for (auto pid : nodes_on_current_level) {
-		auto &frame = buffer_manager.fix_page(segment_id, pid, false,
-											  page_logic, is_delta_tree);
+	for (auto pid : get_leaves(AccessHint::ONCE)) {
+		auto &frame =
+			buffer_manager.fix_page(segment_id, pid, false, page_logic,
+									is_delta_tree, AccessHint::ONCE);
+		apply_pending(frame);
 		auto &leaf = *reinterpret_cast<
 			typename BTree<KeyT, ValueT, UseDeltaTree>::LeafNode *>(
 			frame.get_data());
 		// Sanity Check.
-		assert(leaf.level == level);
+		assert(leaf.level == 0);
 
-		result += leaf.slot_count;
+		result += leaf.get_num_entries();
 		buffer_manager.unfix_page(frame, false);
 	}
 
@@ -556,6 +1047,52 @@ size_t BTree<KeyT, ValueT, UseDeltaTree>::size() const {
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::for_each(
+	const std::function<void(const KeyT &, const ValueT &)> &visit) {
+	for (auto pid : get_leaves(AccessHint::SEQUENTIAL)) {
+		auto &frame =
+			buffer_manager.fix_page(segment_id, pid, false, page_logic,
+									is_delta_tree, AccessHint::SEQUENTIAL);
+		apply_pending(frame);
+		auto &leaf = *reinterpret_cast<LeafNode *>(frame.get_data());
+		assert(leaf.level == 0);
+
+		for (const auto *slot = leaf.slots_begin(); slot != leaf.slots_end();
+			 ++slot)
+			if (!slot->is_erased())
+				visit(slot->get_key(leaf.get_data()),
+					  slot->get_value(leaf.get_data()));
+
+		buffer_manager.unfix_page(frame, false);
+	}
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::recover(
+	const MetadataSegment &metadata) {
+	auto maybe_metadata = metadata.get(segment_id);
+	if (!maybe_metadata.has_value())
+		return;
+
+	// The page journal of the database rolled page 0 and the nodes back to
+	// the checkpoint. The state of the tree as of the checkpoint matches them.
+	auto &frame =
+		buffer_manager.fix_page(segment_id, 0, true, nullptr, is_delta_tree);
+	auto &state = *(reinterpret_cast<BTree<KeyT, ValueT, UseDeltaTree> *>(
+		frame.get_data()));
+
+	root = maybe_metadata->root;
+	next_free_page = maybe_metadata->next_free_page;
+	first_free_page = maybe_metadata->first_free_page;
+	state.root = root;
+	state.next_free_page = next_free_page;
+	state.first_free_page = first_free_page;
+	last_append_leaf = 0;
+
+	buffer_manager.unfix_page(frame, true);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 size_t BTree<KeyT, ValueT, UseDeltaTree>::height() {
 	auto &frame = buffer_manager.fix_page(segment_id, root, false, page_logic,
 										  is_delta_tree);
@@ -751,6 +1288,149 @@ void BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::update(const KeyT &key,
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::merge(
+	InnerNode &right, const KeyT &separator, uint32_t page_size) {
+	assert(upper && right.upper);
+
+	// Both nodes and the separator pulled down from the parent must fit.
+	if (get_used_space() + right.get_used_space() +
+			required_space(separator, upper) >
+		page_size - sizeof(InnerNode))
+		return false;
+
+	compactify(page_size);
+
+	// The old `upper` is now bounded by the separator.
+	auto success = insert(separator, upper);
+	assert(success);
+	for (const auto *slot = right.slots_begin(); slot < right.slots_end();
+		 ++slot) {
+		success = insert(slot->get_key(right.get_data()), slot->child);
+		assert(success);
+	}
+	upper = right.upper;
+
+	return true;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::erase_merged(
+	Pivot *separator) {
+	assert(separator < slots_end());
+
+	// The right neighbor was merged into the separator's child.
+	if (separator + 1 == slots_end())
+		upper = separator->child;
+	else
+		(separator + 1)->child = separator->child;
+
+	// Remove slot by shifting all following slots down.
+	for (auto *slot = separator; slot < slots_end() - 1; ++slot)
+		*slot = *(slot + 1);
+	--this->slot_count;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+size_t BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::get_used_space() const {
+	size_t used_space = this->slot_count * sizeof(Pivot);
+	for (const auto *slot = slots_begin(); slot < slots_end(); ++slot)
+		used_space += slot->key_size;
+	return used_space;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::balance(
+	InnerNode &right, InnerNode &parent, Pivot *separator,
+	uint32_t page_size) {
+	auto left_used = get_used_space();
+	auto right_used = right.get_used_space();
+	const auto separator_key = separator->get_key(parent.get_data());
+	const bool to_left = left_used < right_used;
+
+	// Count the pivots to rotate through the parent. Each rotation moves one
+	// pivot up into the parent and the old separator down.
+	auto &donor = to_left ? right : *this;
+	uint16_t count = 0;
+	size_t receiver_used = to_left ? left_used : right_used;
+	size_t donor_used = to_left ? right_used : left_used;
+	while (count + 1 < donor.slot_count) {
+		const auto &slot = to_left
+							   ? *(donor.slots_begin() + count)
+							   : *(donor.slots_end() - count - 1);
+		size_t moved = sizeof(Pivot) + slot.key_size;
+		if (receiver_used + moved > donor_used - moved)
+			break;
+		receiver_used += moved;
+		donor_used -= moved;
+		++count;
+	}
+	if (count == 0)
+		return true;
+
+	// The last rotated pivot becomes the new separator.
+	auto *new_separator = to_left ? donor.slots_begin() + count - 1
+								  : donor.slots_end() - count;
+	auto new_separator_key = new_separator->get_key(donor.get_data());
+	if (!parent.can_replace_key(separator, new_separator_key, page_size))
+		return false;
+
+	auto insert_pivot = [&](InnerNode &node, const KeyT &key, PageID child) {
+		if (!node.has_space(key, child))
+			node.compactify(page_size);
+		auto success = node.insert(key, child);
+		assert(success);
+	};
+
+	if (to_left) {
+		// Pull the separator down onto the old `upper`.
+		insert_pivot(*this, separator_key, upper);
+		for (auto *slot = right.slots_begin(); slot < new_separator; ++slot)
+			insert_pivot(*this, slot->get_key(right.get_data()), slot->child);
+		upper = new_separator->child;
+	} else {
+		insert_pivot(right, separator_key, upper);
+		for (auto *slot = new_separator + 1; slot < slots_end(); ++slot)
+			insert_pivot(right, slot->get_key(this->get_data()), slot->child);
+		upper = new_separator->child;
+	}
+	parent.replace_key(separator, new_separator_key, page_size);
+
+	// Remove the rotated pivots from the donor. Data is compactified lazily.
+	if (to_left) {
+		for (auto *slot = right.slots_begin(); slot + count < right.slots_end();
+			 ++slot)
+			*slot = *(slot + count);
+	}
+	donor.slot_count -= count;
+
+	return true;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::can_replace_key(
+	const Pivot *slot, const KeyT &key, uint32_t page_size) const {
+	return get_used_space() - slot->key_size + key.size() <=
+		   page_size - sizeof(InnerNode);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::replace_key(
+	Pivot *slot, const KeyT &key, uint32_t page_size) {
+	assert(can_replace_key(slot, key, page_size));
+	auto child = slot->child;
+
+	// Remove slot by shifting all following slots down.
+	for (auto *s = slot; s < slots_end() - 1; ++s)
+		*s = *(s + 1);
+	--this->slot_count;
+
+	if (!has_space(key, child))
+		compactify(page_size);
+	auto success = insert(key, child);
+	assert(success);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 bool BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::insert(
 	const KeyT &new_pivot, PageID new_child, bool allow_duplicates) {
 	// Sanity checks.
@@ -909,12 +1589,21 @@ void BTree<KeyT, ValueT, UseDeltaTree>::InnerNode::shrink(
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 const KeyT BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::split(
-	LeafNode &new_node, const KeyT &key, size_t page_size) {
+	LeafNode &new_node, const KeyT &key, size_t page_size, bool is_append) {
 
 	++stats.leaf_node_splits;
 	assert(this->slot_count >= 1);
 	assert(page_size > 0);
 
+	// Appending: Keep all entries on this leaf. The new key starts the new,
+	// empty right leaf.
+	if (is_append) {
+		++stats.append_splits;
+		const auto &last_slot = *(slots_begin() + this->slot_count - 1);
+		assert(last_slot.get_key(this->get_data()) < key);
+		return last_slot.get_key(this->get_data());
+	}
+
 	// logger.log("leaf," + std::to_string(this->slot_count) + "," +
 	// 		   std::to_string(sizeof(LeafSlot)) + "," +
 	// 		   std::to_string(UseDeltaTree));
@@ -930,21 +1619,25 @@ const KeyT BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::split(
 	uint16_t num_slots_left =
 		skew_left ? (this->slot_count + 1) / 2 : (this->slot_count / 2);
 
-	// Second half of slots is inserted into new, right leaf.
+	// Second half of slots is inserted into new, right leaf. Tombstones are
+	// dropped since the new leaf is written out as a whole.
 	for (const auto *slot_to_copy = this->slots_begin() + num_slots_left;
 		 slot_to_copy < this->slots_end(); ++slot_to_copy) {
+		if (slot_to_copy->is_erased())
+			continue;
 		auto key = slot_to_copy->get_key(this->get_data());
 		auto value = slot_to_copy->get_value(this->get_data());
-		auto success = new_node.insert(key, value);
-		assert(success);
 
 		// Track delta.
 		if constexpr (UseDeltaTree) {
 			if (slot_to_copy->get_state() == OperationType::Unchanged)
 				this->num_bytes_changed += required_space(key, value);
 		}
+
+		auto success = new_node.insert(key, value);
+		assert(success);
 	}
-	assert(new_node.slot_count == this->slot_count - num_slots_left);
+	assert(new_node.slot_count <= this->slot_count - num_slots_left);
 
 	// Cut off right half from this node and compactify space.
 	this->slot_count = num_slots_left;
@@ -980,13 +1673,51 @@ BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::lookup(const KeyT &key) {
 		return {};
 
 	const auto found_key = slot->get_key(this->get_data());
-	if (found_key != key)
+	if (found_key != key || slot->is_erased())
 		return {};
 
 	return {slot->get_value(this->get_data())};
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+std::optional<ValueT> BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::lookup(
+	const KeyT &key, std::span<const std::byte> pending) {
+	if constexpr (UseDeltaTree) {
+		if (!pending.empty()) {
+			const auto *src = pending.data();
+			auto header = DeltasHeader::decode(src);
+			std::string key_buffer;
+			DeltaDecoder<KeyT, ValueT> decoder(src, header.num_deltas,
+											   key_buffer);
+			// Slots behind the cut-off were split off since the leaf was
+			// written out.
+			auto cut_off =
+				header.slot_count - decoder.count(OperationType::Inserted);
+
+			// Deltas are ordered by key like the slots they were taken from.
+			while (!decoder.done()) {
+				auto delta = decoder.next();
+				if (key < delta.entry.key)
+					break;
+				if (delta.entry.key != key)
+					continue;
+				if (delta.op == OperationType::Deleted)
+					return {};
+				return {delta.entry.value};
+			}
+
+			auto *slot = lower_bound(key);
+			if (slot >= slots_begin() + cut_off)
+				return {};
+			if (slot->get_key(this->get_data()) != key || slot->is_erased())
+				return {};
+			return {slot->get_value(this->get_data())};
+		}
+	}
+	return lookup(key);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
 bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::insert(
 	const KeyT &key, const ValueT &value, bool allow_duplicates) {
 	assert(has_space(key, value));
@@ -998,8 +1729,12 @@ bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::insert(
 		const auto &found_key = slot_target->get_key(this->get_data());
 		// Keys must be unique. We don't throw here because we don't manage
 		// the lock.
-		if (found_key == key)
-			return false;
+		if (found_key == key) {
+			if (!slot_target->is_erased())
+				return false;
+			revive(*slot_target, key, value);
+			return true;
+		}
 	}
 
 	// Move each slot up by one to make space for new one.
@@ -1033,7 +1768,7 @@ void BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::update(const KeyT &key,
 		throw std::runtime_error("LeafNode::update: Key not found");
 
 	auto &found_key = slot->get_key(this->get_data());
-	if (found_key != key)
+	if (found_key != key || slot->is_erased())
 		throw std::runtime_error("LeafNode::update: Key not found");
 
 	// Overwrite value in place if it has the same size.
@@ -1053,23 +1788,111 @@ void BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::update(const KeyT &key,
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
-bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::erase(const KeyT &key,
-														size_t page_size) {
+bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::upsert(const KeyT &key,
+														 const ValueT &value,
+														 uint32_t page_size) {
+	auto *slot = lower_bound(key);
+
+	// New key or erased key. Insert it.
+	if (slot == slots_end() || slot->get_key(this->get_data()) != key ||
+		slot->is_erased()) {
+		if (!has_space(key, value))
+			compactify(page_size);
+		if (!has_space(key, value))
+			return false;
+		auto success = insert(key, value);
+		assert(success);
+		return true;
+	}
+
+	// Track delta.
+	auto track_update = [&](LeafSlot &slot) {
+		if constexpr (UseDeltaTree) {
+			if (slot.get_state() == OperationType::Unchanged) {
+				this->num_bytes_changed += value.size();
+				slot.set_state(OperationType::Updated);
+			}
+		}
+	};
+
+	// Overwrite the value in place if it fits.
+	if (value.size() <= slot->value_size) {
+		value.serialize(this->get_data() + slot->get_offset() + slot->key_size);
+		slot->value_size = value.size();
+		track_update(*slot);
+		return true;
+	}
+
+	// Otherwise relocate the entry. The old data is reclaimed lazily.
+	if (!can_upsert(key, value, page_size))
+		return false;
+	const size_t entry_size = key.size() + value.size();
+	if (get_free_space() < entry_size)
+		compactify(page_size);
+	if (get_free_space() < entry_size) {
+		// Only fits when reclaiming the space of the old entry right away.
+		slot->key_size = 0;
+		slot->value_size = 0;
+		compactify(page_size);
+	}
+	auto state_and_offset = slot->state_and_offset;
+	this->data_start -= entry_size;
+	*slot = LeafSlot{this->get_data(), this->data_start, key, value};
+	slot->state_and_offset.set_state(state_and_offset.get_state());
+	track_update(*slot);
+
+	return true;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::can_upsert(
+	const KeyT &key, const ValueT &value, uint32_t page_size) {
+	const auto free_space = page_size - sizeof(LeafNode) - get_used_space();
+	auto *slot = lower_bound(key);
+
+	// New key or erased key. Needs a new entry.
+	if (slot == slots_end() || slot->get_key(this->get_data()) != key ||
+		slot->is_erased())
+		return free_space >= required_space(key, value);
+
+	// The existing entry is replaced.
+	return value.size() <= slot->value_size ||
+		   free_space + slot->key_size + slot->value_size >=
+			   static_cast<size_t>(key.size()) + value.size();
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::erase(const KeyT &key) {
 	auto *slot = lower_bound(key);
 
 	// Key not found.
 	if (slot == slots_end())
 		return false;
-	if (slot->get_key(this->get_data()) != key)
+	if (slot->get_key(this->get_data()) != key || slot->is_erased())
 		return false;
 
 	// Track delta.
 	if constexpr (UseDeltaTree) {
 		// Only count changed bytes if they have not already been changed by
-		// a previous operation.
-		if (slot->get_state() == OperationType::Unchanged)
-			this->num_bytes_changed +=
-				required_space(key, slot->get_value(this->get_data()));
+		// a previous operation. An inserted entry is removed entirely, so its
+		// bytes are no longer changed.
+		auto state = slot->get_state();
+		auto entry_space =
+			required_space(key, slot->get_value(this->get_data()));
+		if (state == OperationType::Unchanged)
+			this->num_bytes_changed += entry_space;
+		else if (state == OperationType::Inserted)
+			this->num_bytes_changed -=
+				std::min<size_t>(this->num_bytes_changed, entry_space);
+
+		// The entry is on disk. Keep a tombstone to track the delete. Only
+		// its key is needed, so the space of its value is reclaimed. Replayed
+		// deletes then leave the same space as when the deltas were taken.
+		if (state != OperationType::Inserted) {
+			slot->set_state(OperationType::Deleted);
+			slot->value_size = 0;
+			return true;
+		}
 	}
 
 	// Remove slot by shifting all following slots down.
@@ -1078,10 +1901,134 @@ bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::erase(const KeyT &key,
 	}
 	--this->slot_count;
 
-	// TODO: Only temporarily compactify here. We want to track free
-	// space and only compactify when we need the space.
+	return true;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::remove_erased() {
+	auto *target = slots_begin();
+	for (auto *slot = slots_begin(); slot < slots_end(); ++slot) {
+		if (slot->is_erased())
+			continue;
+		*target = *slot;
+		++target;
+	}
+	this->slot_count = target - slots_begin();
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+void BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::revive(LeafSlot &slot,
+														 const KeyT &key,
+														 const ValueT &value) {
+	assert(slot.is_erased());
+	if (value.size() == slot.value_size) {
+		value.serialize(this->get_data() + slot.get_offset() + slot.key_size);
+	} else {
+		assert(has_space(key, value));
+		this->data_start -= (key.size() + value.size());
+		slot = LeafSlot{this->get_data(), this->data_start, key, value};
+	}
+
+	// Track delta. The entry is still on disk.
+	if constexpr (UseDeltaTree) {
+		slot.set_state(OperationType::Updated);
+		this->num_bytes_changed += value.size();
+	}
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+uint16_t BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::get_num_entries() const {
+	if constexpr (!UseDeltaTree)
+		return this->slot_count;
+
+	uint16_t num_entries = 0;
+	for (const auto *slot = slots_begin(); slot < slots_end(); ++slot)
+		num_entries += !slot->is_erased();
+	return num_entries;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::merge(LeafNode &right,
+														uint32_t page_size) {
+	if (get_used_space() + right.get_used_space() >
+		page_size - sizeof(LeafNode))
+		return false;
+
 	compactify(page_size);
 
+	// All keys of the right neighbor are bigger. Append them.
+	for (const auto *slot = right.slots_begin(); slot < right.slots_end();
+		 ++slot) {
+		auto success = insert(slot->get_key(right.get_data()),
+							  slot->get_value(right.get_data()));
+		assert(success);
+	}
+
+	return true;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+size_t BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::get_used_space() const {
+	size_t used_space = this->slot_count * sizeof(LeafSlot);
+	for (const auto *slot = slots_begin(); slot < slots_end(); ++slot)
+		used_space += slot->key_size + slot->value_size;
+	return used_space;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT, bool UseDeltaTree>
+bool BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::balance(
+	LeafNode &right, InnerNode &parent, typename InnerNode::Pivot *separator,
+	uint32_t page_size) {
+	auto left_used = get_used_space();
+	auto right_used = right.get_used_space();
+	const bool to_left = left_used < right_used;
+
+	// Count the entries to move from the fuller to the emptier leaf.
+	auto &donor = to_left ? right : *this;
+	uint16_t count = 0;
+	size_t receiver_used = to_left ? left_used : right_used;
+	size_t donor_used = to_left ? right_used : left_used;
+	while (count + 1 < donor.slot_count) {
+		const auto &slot = to_left ? *(donor.slots_begin() + count)
+								   : *(donor.slots_end() - count - 1);
+		size_t moved = sizeof(LeafSlot) + slot.key_size + slot.value_size;
+		if (receiver_used + moved > donor_used - moved)
+			break;
+		receiver_used += moved;
+		donor_used -= moved;
+		++count;
+	}
+	if (count == 0)
+		return true;
+
+	// The new separator is the last key remaining on the left.
+	const auto *last_left =
+		to_left ? donor.slots_begin() + count - 1 : slots_end() - count - 1;
+	const auto new_separator_key =
+		last_left->get_key(to_left ? right.get_data() : this->get_data());
+	if (!parent.can_replace_key(separator, new_separator_key, page_size))
+		return false;
+
+	auto &receiver = to_left ? *this : right;
+	auto *begin = to_left ? donor.slots_begin() : donor.slots_end() - count;
+	for (auto *slot = begin; slot < begin + count; ++slot) {
+		auto key = slot->get_key(donor.get_data());
+		auto value = slot->get_value(donor.get_data());
+		if (!receiver.has_space(key, value))
+			receiver.compactify(page_size);
+		auto success = receiver.insert(key, value);
+		assert(success);
+	}
+	parent.replace_key(separator, new_separator_key, page_size);
+
+	// Remove the moved entries from the donor. Data is compactified lazily.
+	if (to_left) {
+		for (auto *slot = right.slots_begin(); slot + count < right.slots_end();
+			 ++slot)
+			*slot = *(slot + count);
+	}
+	donor.slot_count -= count;
+
 	return true;
 }
 // -----------------------------------------------------------------
@@ -1193,7 +2140,9 @@ void BTree<KeyT, ValueT, UseDeltaTree>::LeafNode::LeafSlot::print(
 	os << ", value_size: " << value_size;
 
 	os << ", key: " << this->get_key(begin);
-	os << ", value: " << get_value(begin) << std::endl;
+	if (value_size)
+		os << ", value: " << get_value(begin);
+	os << std::endl;
 
 	if constexpr (UseDeltaTree) {
 		os << "    state: " << this->get_state() << std::endl;
@@ -1230,8 +2179,16 @@ template struct BTree<String, UInt64>;
 template struct BTree<String, String>;
 template struct BTree<UInt64, TID, true>;
 template struct BTree<String, TID, true>;
+template struct BTree<UInt64, String, true>;
+template struct BTree<String, String, true>;
 template struct BTree<PID, Deltas<UInt64, TID>>;
 template struct BTree<PID, Deltas<String, TID>>;
+template struct BTree<PID, DeltasView<UInt64, TID>>;
+template struct BTree<PID, DeltasView<String, TID>>;
+template struct BTree<PID, Deltas<UInt64, String>>;
+template struct BTree<PID, Deltas<String, String>>;
+template struct BTree<PID, DeltasView<UInt64, String>>;
+template struct BTree<PID, DeltasView<String, String>>;
 template std::ostream &operator<<(std::ostream &, const BTree<UInt64, TID> &);
 template std::ostream &operator<<(std::ostream &,
 								  const BTree<UInt64, UInt64> &);
@@ -1246,9 +2203,25 @@ template std::ostream &operator<<(std::ostream &,
 								  const BTree<UInt64, TID, true> &);
 template std::ostream &operator<<(std::ostream &,
 								  const BTree<String, TID, true> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BTree<UInt64, String, true> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BTree<String, String, true> &);
 template std::ostream &operator<<(std::ostream &,
 								  const BTree<PID, Deltas<UInt64, TID>> &);
 template std::ostream &operator<<(std::ostream &,
 								  const BTree<PID, Deltas<String, TID>> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BTree<PID, DeltasView<UInt64, TID>> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BTree<PID, DeltasView<String, TID>> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BTree<PID, Deltas<UInt64, String>> &);
+template std::ostream &operator<<(std::ostream &,
+								  const BTree<PID, Deltas<String, String>> &);
+template std::ostream &
+operator<<(std::ostream &, const BTree<PID, DeltasView<UInt64, String>> &);
+template std::ostream &
+operator<<(std::ostream &, const BTree<PID, DeltasView<String, String>> &);
 // -----------------------------------------------------------------
 } // namespace bbbtree
\ No newline at end of file
@@ -1,13 +1,17 @@
 // -----------------------------------------------------------------
 #include "bbbtree/buffer_manager.h"
+#include "bbbtree/journal.h"
 #include "bbbtree/logger.h"
 #include "bbbtree/stats.h"
 #include "bbbtree/types.h"
+#include "bbbtree/wal.h"
 // -----------------------------------------------------------------
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
 // -----------------------------------------------------------------
 namespace bbbtree {
 // -----------------------------------------------------------------
@@ -38,13 +42,24 @@ BufferManager::BufferManager(size_t page_size, size_t page_count, bool clear)
 	stats.num_pages = page_count;
 }
 // -----------------------------------------------------------------
-BufferManager::~BufferManager() { clear_all(); }
+BufferManager::~BufferManager() {
+	// Clients write their pages back while the buffer still exists. Detaching
+	// one might unregister others.
+	while (!clients.empty()) {
+		auto *client = clients.back();
+		clients.pop_back();
+		client->detach();
+	}
+	clear_all();
+}
 // ----------------------------------------------------------------
 void BufferManager::reset(BufferFrame &frame) {
 	assert(!frame.in_use_by);
 	frame.state = State::UNDEFINED;
 	frame.page_logic = nullptr;
 	frame.is_delta_tree = false;
+	frame.lsn = 0;
+	frame.is_cold = false;
 }
 // ----------------------------------------------------------------
 bool BufferManager::unload(BufferFrame &frame) {
@@ -66,15 +81,23 @@ bool BufferManager::unload(BufferFrame &frame) {
 	size_t page_begin = frame.page_id * page_size;
 	size_t page_end = page_begin + page_size;
 	auto &file = get_segment(frame.segment_id);
+	// Rollback: The page as of the checkpoint is saved before it is
+	// overwritten.
+	if (journal)
+		journal->before_write(frame.segment_id, frame.page_id, file);
 	// TODO: Resizing is not thread safe. Must lock the whole file before
 	// doing so.
 	if (file.size() < page_end)
 		// Sets new bytes to 0
 		file.resize(page_end);
+	// Write-ahead: The records of the page's changes are durable first.
+	if (log)
+		log->flush(frame.lsn);
 	// TODO: Make sure everything was written out by getting bytes.
 	file.write_block(frame.data, page_begin, page_size);
 	stats.bytes_written_physically += page_size;
 	stats.pages_written += 1;
+	++segment_page_io[frame.segment_id];
 
 	if (frame.is_delta_tree)
 		++stats.delta_pages_written;
@@ -104,15 +127,30 @@ void BufferManager::load(BufferFrame &frame, SegmentID segment_id,
 	// TODO: Throw an error when not enough was read/written.
 	file.read_block(page_begin, page_size, frame.data);
 	stats.pages_loaded++;
+	++segment_page_io[segment_id];
 
 	if (frame.page_logic)
 		// Call the page logic after loading.
 		frame.page_logic->after_load(frame.data, frame.page_id);
 }
 // -----------------------------------------------------------------
+size_t BufferManager::read_run(SegmentID segment_id, PageID first_page,
+							   size_t num_pages, char *dst) {
+	auto &file = get_segment(segment_id);
+	size_t run_begin = first_page * page_size;
+	size_t file_size = file.size();
+	if (file_size <= run_begin)
+		return 0;
+
+	num_pages = std::min(num_pages, (file_size - run_begin) / page_size);
+	if (num_pages > 0)
+		file.read_block(run_begin, num_pages * page_size, dst);
+	return num_pages;
+}
+// -----------------------------------------------------------------
 BufferFrame &BufferManager::fix_page(SegmentID segment_id, PageID page_id,
-									 bool /*exclusive*/, PageLogic *page_logic,
-									 bool is_delta_tree) {
+									 bool exclusive, PageLogic *page_logic,
+									 bool is_delta_tree, AccessHint hint) {
 #ifndef NDEBUG
 	logger.log("Fixing page " + std::to_string(segment_id) + "." +
 			   std::to_string(page_id) + " {");
@@ -139,6 +177,10 @@ BufferFrame &BufferManager::fix_page(SegmentID segment_id, PageID page_id,
 			++stats.delta_pages_hit;
 		else
 			++stats.btree_pages_hit;
+		if (hint == AccessHint::NORMAL)
+			frame->is_cold = false;
+		if (exclusive && frame->page_logic && frame->is_clean())
+			frame->page_logic->prepare(frame->data, page_id, page_size);
 		return *(frame_it->second);
 	}
 
@@ -162,6 +204,9 @@ BufferFrame &BufferManager::fix_page(SegmentID segment_id, PageID page_id,
 	logger.log("Loading page into buffer.");
 #endif
 	load(frame, segment_id, page_id);
+	make_cold(frame, hint);
+	if (exclusive && frame.page_logic && frame.is_clean())
+		frame.page_logic->prepare(frame.data, page_id, page_size);
 #ifndef NDEBUG
 	logger.log(*this);
 #endif
@@ -180,12 +225,144 @@ void BufferManager::unfix_page(BufferFrame &frame, bool is_dirty) {
 	// TODO: Check if is_dirty, lock must have been exclusive.
 	assert(frame.in_use_by > 0);
 
-	if (is_dirty)
+	if (is_dirty) {
 		frame.set_dirty(); // Does not overwrite NEW state.
+		if (log)
+			frame.lsn = log->get_last_lsn();
+	}
 
 	--frame.in_use_by;
 }
 // ----------------------------------------------------------------
+size_t BufferManager::prefetch(SegmentID segment_id, PageID first_page,
+							   size_t num_pages, PageLogic *page_logic) {
+	num_pages =
+		std::min(num_pages, std::max<size_t>(page_frames.size() / 4, 1));
+	auto is_buffered = [&](PageID page_id) {
+		return id_to_frame.contains(page_id ^
+									(static_cast<uint64_t>(segment_id) << 48));
+	};
+
+	// Buffered pages may be newer than on disk. Only load the others.
+	std::vector<bool> is_missing(num_pages);
+	for (size_t i = 0; i < num_pages; ++i)
+		is_missing[i] = !is_buffered(first_page + i);
+	if (std::find(is_missing.begin(), is_missing.end(), true) ==
+		is_missing.end())
+		return num_pages;
+
+	std::vector<char> pages(num_pages * page_size);
+	auto num_read = read_run(segment_id, first_page, num_pages, pages.data());
+	// The loaded pages stay fixed until all are loaded, so that they do not
+	// evict each other as cold pages.
+	std::vector<BufferFrame *> loaded;
+	for (size_t i = 0; i < num_read; ++i) {
+		PageID page_id = first_page + i;
+		// Pages written out while the others are loaded are not read again.
+		if (!is_missing[i] || is_buffered(page_id))
+			continue;
+
+		auto &frame = get_free_frame();
+		assert(frame.in_use_by == 0);
+		id_to_frame[page_id ^ (static_cast<uint64_t>(segment_id) << 48)] =
+			&frame;
+		frame.segment_id = segment_id;
+		frame.page_id = page_id;
+		frame.state = State::CLEAN;
+		frame.page_logic = page_logic;
+		std::memcpy(frame.data, pages.data() + i * page_size, page_size);
+		make_cold(frame, AccessHint::SEQUENTIAL);
+		++stats.pages_loaded;
+		++stats.pages_prefetched;
+		++segment_page_io[segment_id];
+
+		frame.in_use_by = 1;
+		loaded.push_back(&frame);
+		if (frame.page_logic)
+			frame.page_logic->after_load(frame.data, page_id);
+	}
+	for (auto *frame : loaded)
+		frame->in_use_by = 0;
+	assert(validate());
+
+	return num_pages;
+}
+// ----------------------------------------------------------------
+void BufferManager::read_pages(SegmentID segment_id, PageID first_page,
+							   size_t num_pages, char *dst,
+							   PageLogic *page_logic) {
+	auto num_read = read_run(segment_id, first_page, num_pages, dst);
+	for (size_t i = 0; i < num_pages; ++i) {
+		PageID page_id = first_page + i;
+		auto *data = dst + i * page_size;
+		auto segment_page_id =
+			page_id ^ (static_cast<uint64_t>(segment_id) << 48);
+		auto frame_it = id_to_frame.find(segment_page_id);
+		if (frame_it != id_to_frame.end()) {
+			std::memcpy(data, frame_it->second->data, page_size);
+			continue;
+		}
+		if (i >= num_read) {
+			std::memset(data, 0, page_size);
+			continue;
+		}
+
+		++stats.pages_loaded;
+		++stats.pages_read_unbuffered;
+		++segment_page_io[segment_id];
+		if (page_logic)
+			page_logic->after_load(data, page_id);
+	}
+}
+// ----------------------------------------------------------------
+void BufferManager::flush_page(BufferFrame &frame) {
+	assert(frame.in_use_by == 0);
+	if (frame.state != State::DIRTY && frame.state != State::NEW)
+		return;
+
+	frame.in_use_by = 1; // Prevent recursive eviction.
+	unload(frame);
+	frame.in_use_by = 0;
+	frame.state = State::CLEAN;
+}
+// ----------------------------------------------------------------
+void BufferManager::flush_all() {
+	// Flushing a page may dirty others, e.g. a delta tree's pages. Go another
+	// round until all pages are clean.
+	bool has_flushed = true;
+	while (has_flushed) {
+		has_flushed = false;
+		std::vector<BufferFrame *> frames;
+		frames.reserve(id_to_frame.size());
+		for (const auto &[page_id, frame] : id_to_frame)
+			if (frame->is_dirty() || frame->is_new())
+				frames.push_back(frame);
+		for (auto *frame : frames) {
+			// A frame might have been evicted while flushing another one.
+			if (!frame->is_dirty() && !frame->is_new())
+				continue;
+			assert(!frame->in_use_by);
+			flush_page(*frame);
+			has_flushed = true;
+		}
+	}
+}
+// ----------------------------------------------------------------
+void BufferManager::sync_all() {
+	for (auto &[segment_id, file] : segment_to_file)
+		file->sync();
+}
+// ----------------------------------------------------------------
+void BufferManager::reserve_frames(size_t num_frames) {
+	for (size_t i = 0; i < num_frames; ++i) {
+		auto &frame = get_free_frame();
+		// Reserved frames are never chosen for eviction.
+		frame.in_use_by = 1;
+		reserved_buffer_frames.push_back(&frame);
+	}
+	assert(validate());
+}
+// ----------------------------------------------------------------
 bool BufferManager::remove(BufferFrame &frame, bool write_back) {
 	// Sanity Check: Must not be in use.
 	assert(frame.in_use_by == 0);
@@ -222,6 +399,9 @@ bool BufferManager::evict() {
 	logger.log(*this);
 #endif
 	assert(validate());
+	if (evict_cold())
+		return true;
+
 	// Select random page for eviction.
 	size_t i = std::rand() % page_frames.size();
 	auto *frame = &(page_frames[i]);
@@ -259,6 +439,49 @@ bool BufferManager::evict() {
 	return true;
 }
 // ----------------------------------------------------------------
+bool BufferManager::evict_cold() {
+	size_t i = 0;
+	while (i < cold_frames.size()) {
+		auto [frame, segment_page_id] = cold_frames[i];
+		// Skip frames that were evicted or fixed normally since.
+		if (!frame->is_cold ||
+			(frame->page_id ^ (static_cast<uint64_t>(frame->segment_id)
+							   << 48)) != segment_page_id) {
+			cold_frames.erase(cold_frames.begin() + i);
+			continue;
+		}
+		if (frame->in_use_by) {
+			++i;
+			continue;
+		}
+
+		// Removing the page may evict others and change the cold frames.
+		cold_frames.erase(cold_frames.begin() + i);
+		if (remove(*frame)) {
+			++stats.cold_pages_evicted;
+			return true;
+		}
+		// The page logic keeps the page. Evict it like the others.
+		frame->is_cold = false;
+		i = 0;
+	}
+	return false;
+}
+// ----------------------------------------------------------------
+void BufferManager::make_cold(BufferFrame &frame, AccessHint hint) {
+	if (hint == AccessHint::NORMAL)
+		return;
+
+	frame.is_cold = true;
+	auto segment_page_id =
+		frame.page_id ^ (static_cast<uint64_t>(frame.segment_id) << 48);
+	auto entry = std::make_pair(&frame, segment_page_id);
+	if (hint == AccessHint::ONCE)
+		cold_frames.push_front(entry);
+	else
+		cold_frames.push_back(entry);
+}
+// ----------------------------------------------------------------
 BufferFrame &BufferManager::get_free_frame() {
 	// TODO: Synchronize when multi-threading.
 
@@ -307,22 +530,67 @@ void BufferManager::clear_all(bool write_back) {
 		// reopening them.
 	}
 restart:
+	// `remove` erases from `id_to_frame`. Collect the frames first.
+	std::vector<BufferFrame *> frames;
+	frames.reserve(id_to_frame.size());
 	for (const auto &[page_id, frame] : id_to_frame)
-		remove(*frame, write_back);
+		frames.push_back(frame);
+	for (auto *frame : frames)
+		// A frame might have been evicted while unloading another one.
+		if (frame->is_defined())
+			remove(*frame, write_back);
 
 	// During `unload` of BTree nodes, some pages might have been loaded
 	// into the buffer to store the deltas. Therefore we might have to go
 	// another round to also clear all delta tree pages from the buffer.
 	if (!id_to_frame.empty())
 		goto restart;
-	assert(free_buffer_frames.size() == page_frames.size());
+	cold_frames.clear();
+	assert(free_buffer_frames.size() + reserved_buffer_frames.size() ==
+		   page_frames.size());
+}
+// ------------------------------------------------------------------
+void BufferManager::clear_segment(SegmentID segment_id) {
+	// Unloading a page might load pages of the segment again, e.g. to store
+	// deltas. Go another round then.
+	bool has_removed = true;
+	while (has_removed) {
+		has_removed = false;
+		// `remove` erases from `id_to_frame`. Collect the frames first.
+		std::vector<BufferFrame *> frames;
+		for (const auto &[page_id, frame] : id_to_frame)
+			if (frame->segment_id == segment_id)
+				frames.push_back(frame);
+		for (auto *frame : frames) {
+			// A frame might have been evicted while unloading another one.
+			if (!frame->is_defined() || frame->segment_id != segment_id ||
+				frame->in_use_by)
+				continue;
+			remove(*frame);
+			has_removed = true;
+		}
+	}
+	assert(validate());
+}
+// ------------------------------------------------------------------
+void BufferManager::discard_all() {
+	for (const auto &[page_id, frame] : id_to_frame) {
+		assert(!frame->in_use_by);
+		reset(*frame);
+		free_buffer_frames.push_back(frame);
+	}
+	id_to_frame.clear();
+	cold_frames.clear();
+	assert(validate());
 }
 // ------------------------------------------------------------------
 bool BufferManager::validate() const {
 
 	// Check that the number of free frames and used frames adds up to the
 	// total number of frames.
-	if (free_buffer_frames.size() + id_to_frame.size() != page_frames.size()) {
+	if (free_buffer_frames.size() + reserved_buffer_frames.size() +
+			id_to_frame.size() !=
+		page_frames.size()) {
 		// logger.log("Validating BufferManager...");
 		// logger.log("Inconsistent state: free_buffer_frames.size() + "
 		// 		   "id_to_frame.size() != page_frames.size()");
@@ -2,94 +2,594 @@
 #include "bbbtree/bbbtree.h"
 #include "bbbtree/btree.h"
 #include "bbbtree/map.h"
+#include "bbbtree/slotted_page.h"
 #include "bbbtree/stats.h"
 #include "bbbtree/types.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace bbbtree {
 // -----------------------------------------------------------------
-template <template <typename, typename, bool> typename IndexT, typename KeyT>
-	requires IndexInterface<IndexT, KeyT>
-Database<IndexT, KeyT>::Database(size_t page_size, size_t num_pages,
-								 float wa_threshold, bool reset)
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+Database<IndexT, KeyT, IsClustered>::Database(size_t page_size,
+											  size_t num_pages,
+											  float wa_threshold, bool reset,
+											  bool is_logged)
 	: buffer_manager(page_size, num_pages, reset),
+	  metadata(METADATA_SEGMENT_ID, buffer_manager),
+	  log(is_logged ? std::make_unique<WriteAheadLog>(LOG_SEGMENT_ID, reset)
+					: nullptr),
+	  journal(JOURNAL_SEGMENT_ID, buffer_manager,
+			  {FSI_SEGMENT_ID, SP_SEGMENT_ID, INDEX_SEGMENT_ID, DELTA_SEGMENT_ID,
+			   RECORD_DELTA_SEGMENT_ID},
+			  metadata.get_version(), reset),
 	  space_inventory(FSI_SEGMENT_ID, buffer_manager),
-	  records(SP_SEGMENT_ID, buffer_manager, space_inventory),
-	  index(INDEX_SEGMENT_ID, buffer_manager, wa_threshold) {}
-// -----------------------------------------------------------------
-template <template <typename, typename, bool> typename IndexT, typename KeyT>
-	requires IndexInterface<IndexT, KeyT>
-void Database<IndexT, KeyT>::insert(const Tuple &tuple) {
-	// Get a new TID
-	auto tid = records.allocate(tuple.size());
-	// Add TID to index
-	auto success = index.insert(tuple.key, tid);
-	if (!success) {
-		records.erase(tid);
+	  record_deltas(RECORD_DELTA_SEGMENT_ID, buffer_manager, wa_threshold),
+	  records(SP_SEGMENT_ID, buffer_manager, space_inventory, &record_deltas),
+	  index(INDEX_SEGMENT_ID, buffer_manager, wa_threshold),
+	  buffer(page_size) {
+	buffer_manager.set_write_ahead_log(log.get());
+	try {
+		recover();
+	} catch (...) {
+		// The members are destroyed before the buffer. Write nothing.
+		buffer_manager.set_write_ahead_log(nullptr);
+		buffer_manager.discard_all();
+		throw;
+	}
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+Database<IndexT, KeyT, IsClustered>::~Database() {
+	buffer_manager.set_write_ahead_log(nullptr);
+	if (is_crashed)
+		return;
+	// Buffered records do not outlive the database. Write them out while the
+	// record delta tree still exists.
+	record_deltas.write_back(SP_SEGMENT_ID);
+	checkpoint();
+	buffer_manager.clear_all();
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::checkpoint() {
+	// The checkpoint reflects all operations logged so far.
+	LSN lsn = log ? log->get_last_lsn() : 0;
+	auto pages_written = stats.pages_written;
+	auto pages_deferred = stats.btree_pages_write_deferred;
+
+	// Pages stay buffered. Pages with many changes are written out. The page
+	// logic buffers the changes of the others as deltas. Deltas kept in memory
+	// are moved to their pages, which are written out as well.
+	buffer_manager.flush_all();
+	if constexpr (requires { index.flush_deltas(); }) {
+		index.flush_deltas();
+		buffer_manager.flush_all();
+	}
+	stats.checkpoint_pages_written += stats.pages_written - pages_written;
+	stats.checkpoint_pages_deferred +=
+		stats.btree_pages_write_deferred - pages_deferred;
+
+	// The metadata refers only to pages on disk now. They must be durable
+	// before it is.
+	buffer_manager.sync_all();
+	space_inventory.checkpoint(metadata);
+	record_deltas.checkpoint(metadata);
+	if constexpr (requires { index.checkpoint(metadata); })
+		index.checkpoint(metadata);
+	if (log)
+		metadata.set_lsn(lsn);
+	metadata.write();
+	buffer_manager.sync_all();
+	// The pages written so far belong to the new checkpoint.
+	journal.truncate(metadata.get_version());
+
+	// A crash before truncating replays logged operations that the checkpoint
+	// reflects already. Redoing them again is idempotent.
+	if (log)
+		log->truncate();
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::commit() {
+	if (log)
+		log->flush();
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::crash() {
+	buffer_manager.discard_all();
+	if constexpr (requires { index.discard_deltas(); })
+		index.discard_deltas();
+	if (log)
+		log->discard();
+	is_crashed = true;
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::recover() {
+	// The journal rolled the segments back to the checkpoint. The trees are
+	// opened in their state as of then.
+	space_inventory.recover(metadata);
+	record_deltas.recover(metadata);
+	if constexpr (requires { index.recover(metadata); })
+		index.recover(metadata);
+
+	// The buffered deltas are only tracked in memory. Track them again.
+	record_deltas.validate_deltas(space_inventory.get_num_pages());
+
+	if (!log)
+		return;
+	is_replaying = true;
+	log->replay(metadata.get_lsn(),
+				[&](LogRecordType type, std::span<const std::byte> payload) {
+					redo(type, payload);
+				});
+	is_replaying = false;
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+std::span<const std::byte>
+Database<IndexT, KeyT, IsClustered>::serialize(const Tuple &tuple) {
+	// Reject tuples before they are logged. Leaves of a clustered index hold
+	// several tuples.
+	size_t max_size = buffer_manager.page_size - sizeof(SlottedPage::Header) -
+					  sizeof(SlottedPage::Slot);
+	if constexpr (IsClustered)
+		max_size = buffer_manager.page_size / 4;
+	if (tuple.size() > max_size)
+		throw std::logic_error("Database::serialize(): Tuple must fit on a "
+							   "page.");
+
+	// The key's size, the key, the value and the payload.
+	uint16_t key_size = tuple.key.size();
+	buffer.resize(tuple.size());
+	auto *dst = buffer.data();
+	std::memcpy(dst, &key_size, sizeof(key_size));
+	dst += sizeof(key_size);
+	tuple.key.serialize(dst);
+	dst += key_size;
+	std::memcpy(dst, &tuple.value, sizeof(tuple.value));
+	dst += sizeof(tuple.value);
+	std::memcpy(dst, tuple.payload.data(), tuple.payload.size());
+	return buffer;
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+Database<IndexT, KeyT, IsClustered>::Tuple
+Database<IndexT, KeyT, IsClustered>::deserialize(
+	std::span<const std::byte> record) {
+	uint16_t key_size;
+	if (record.size() < sizeof(key_size))
+		throw std::runtime_error("Database::deserialize(): Corrupted record.");
+	std::memcpy(&key_size, record.data(), sizeof(key_size));
+	auto payload_start = sizeof(key_size) + key_size + sizeof(ValueT);
+	if (record.size() < payload_start)
+		throw std::runtime_error("Database::deserialize(): Corrupted record.");
+
+	Tuple tuple{KeyT::deserialize(record.data() + sizeof(key_size), key_size),
+				0};
+	std::memcpy(&tuple.value, record.data() + sizeof(key_size) + key_size,
+				sizeof(tuple.value));
+	tuple.payload.assign(
+		reinterpret_cast<const char *>(record.data() + payload_start),
+		record.size() - payload_start);
+	return tuple;
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+String Database<IndexT, KeyT, IsClustered>::get_index_value(
+	std::span<const std::byte> record) {
+	uint16_t key_size;
+	std::memcpy(&key_size, record.data(), sizeof(key_size));
+	auto value_start = sizeof(key_size) + key_size;
+	return String::deserialize(record.data() + value_start,
+							   record.size() - value_start);
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+Database<IndexT, KeyT, IsClustered>::Tuple
+Database<IndexT, KeyT, IsClustered>::from_index_value(const KeyT &key,
+													  const String &value) {
+	if (value.size() < sizeof(ValueT))
+		throw std::runtime_error("Database::get(): Corrupted tuple.");
+	auto bytes = value.get_view();
+	Tuple tuple{key, 0};
+	std::memcpy(&tuple.value, bytes.data(), sizeof(tuple.value));
+	tuple.payload.assign(bytes.substr(sizeof(ValueT)));
+	return tuple;
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+Database<IndexT, KeyT, IsClustered>::Tuple
+Database<IndexT, KeyT, IsClustered>::read(const KeyT &key, TID tid) {
+	buffer.resize(buffer_manager.page_size);
+	auto bytes_read = records.read(tid, buffer.data(), buffer.size());
+	auto tuple = deserialize({buffer.data(), bytes_read});
+	if (tuple.key != key)
+		throw std::logic_error("Database<IndexT>::get(): Read corrupted.");
+
+	// The caller's key outlives the buffer.
+	tuple.key = key;
+	return tuple;
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+bool Database<IndexT, KeyT, IsClustered>::holds(TID tid, const KeyT &key) {
+	buffer.resize(buffer_manager.page_size);
+	auto bytes_read = records.read(tid, buffer.data(), buffer.size());
+	uint16_t key_size;
+	if (bytes_read < sizeof(key_size))
+		return false;
+	std::memcpy(&key_size, buffer.data(), sizeof(key_size));
+	return key_size == key.size() &&
+		   bytes_read >= sizeof(key_size) + key_size + sizeof(ValueT) &&
+		   KeyT::deserialize(buffer.data() + sizeof(key_size), key_size) == key;
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::log_tuple(
+	LogRecordType type, std::span<const std::byte> record) {
+	if (!log || is_replaying)
+		return;
+	log->append(type, record);
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::redo(
+	LogRecordType type, std::span<const std::byte> payload) {
+	// The payload is the serialized tuple.
+	auto tuple = deserialize(payload);
+
+	// A clustered index holds the tuples itself. Its entry is the state of
+	// the tuple.
+	if constexpr (IsClustered) {
+		bool is_stored = index.lookup(tuple.key).has_value();
+		switch (type) {
+		case LogRecordType::Insert:
+		case LogRecordType::Update:
+			if (is_stored)
+				update(tuple);
+			else
+				insert(tuple);
+			break;
+		case LogRecordType::Erase:
+			if (is_stored)
+				erase(tuple.key);
+			break;
+		default:
+			throw std::runtime_error("Database::redo(): Unknown log record.");
+		}
+	} else {
+		// The operations are redone in order on the state as of the
+		// checkpoint. A record that does not hold its key is stored anew
+		// nonetheless.
+		auto maybe_tid = index.lookup(tuple.key);
+		bool is_stored =
+			maybe_tid.has_value() && holds(maybe_tid.value(), tuple.key);
+		switch (type) {
+		case LogRecordType::Insert:
+		case LogRecordType::Update:
+			if (is_stored) {
+				update(tuple);
+			} else if (maybe_tid.has_value()) {
+				auto record = serialize(tuple);
+				auto tid = records.allocate(record.size());
+				records.write(tid, record.data(), record.size());
+				index.update(tuple.key, tid);
+			} else {
+				insert(tuple);
+			}
+			break;
+		case LogRecordType::Erase:
+			if (maybe_tid.has_value()) {
+				index.erase(tuple.key, buffer_manager.page_size);
+				if (is_stored)
+					records.erase(maybe_tid.value());
+			}
+			break;
+		default:
+			throw std::runtime_error("Database::redo(): Unknown log record.");
+		}
+	}
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::insert(const Tuple &tuple) {
+	// Only successful inserts are logged. Their redo cannot tell them apart.
+	if (log && !is_replaying && index.lookup(tuple.key).has_value())
 		throw std::logic_error(
 			"Database<IndexT>::insert(): Key already in database.");
+	auto record = serialize(tuple);
+	log_tuple(LogRecordType::Insert, record);
+	if constexpr (IsClustered) {
+		// Store the tuple in the index
+		if (!index.insert(tuple.key, get_index_value(record)))
+			throw std::logic_error(
+				"Database<IndexT>::insert(): Key already in database.");
+	} else {
+		// Get a new TID
+		auto tid = records.allocate(record.size());
+		// Add TID to index
+		auto success = index.insert(tuple.key, tid);
+		if (!success) {
+			records.erase(tid);
+			throw std::logic_error(
+				"Database<IndexT>::insert(): Key already in database.");
+		}
+		// Insert tuple in records
+		records.write(tid, record.data(), record.size());
 	}
-	// Insert tuple in records
-	records.write(tid, reinterpret_cast<const std::byte *>(&tuple),
-				  tuple.size());
 	stats.num_insertions_db++;
 }
 // -----------------------------------------------------------------
-template <template <typename, typename, bool> typename IndexT, typename KeyT>
-	requires IndexInterface<IndexT, KeyT>
-void Database<IndexT, KeyT>::insert(const std::vector<Tuple> &tuples) {
-	// TODO: Detect sequential inserts?
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::insert(
+	const std::vector<Tuple> &tuples) {
+	using Entry = std::pair<KeyT, IndexValue<IsClustered>>;
+
+	// Bulk load an empty index bottom-up instead of traversing and splitting
+	// for every single tuple.
+	if constexpr (requires(std::span<const Entry> entries) {
+					  index.bulk_load(entries);
+					  index.empty();
+				  }) {
+		if (tuples.size() > 1 && index.empty()) {
+			// Sort by key and reject duplicates before changing any state.
+			std::vector<const Tuple *> sorted;
+			sorted.reserve(tuples.size());
+			for (auto &tuple : tuples)
+				sorted.push_back(&tuple);
+			std::sort(sorted.begin(), sorted.end(),
+					  [](const Tuple *a, const Tuple *b) {
+						  return a->key < b->key;
+					  });
+			auto duplicate = std::adjacent_find(
+				sorted.begin(), sorted.end(),
+				[](const Tuple *a, const Tuple *b) { return a->key == b->key; });
+			if (duplicate != sorted.end())
+				throw std::logic_error(
+					"Database<IndexT>::insert(): Key already in database.");
+
+			std::vector<Entry> entries;
+			entries.reserve(sorted.size());
+			if constexpr (IsClustered) {
+				// The entries refer to the serialized tuples until loaded.
+				std::vector<std::vector<std::byte>> values;
+				values.reserve(sorted.size());
+				for (auto *tuple : sorted) {
+					auto record = serialize(*tuple);
+					log_tuple(LogRecordType::Insert, record);
+					auto value = get_index_value(record).get_view();
+					auto *bytes =
+						reinterpret_cast<const std::byte *>(value.data());
+					auto &stored =
+						values.emplace_back(bytes, bytes + value.size());
+					entries.emplace_back(
+						tuple->key,
+						String::deserialize(stored.data(), stored.size()));
+					stats.num_insertions_db++;
+				}
+				index.bulk_load(entries);
+			} else {
+				// Insert tuples in key order to keep the records clustered.
+				for (auto *tuple : sorted) {
+					auto record = serialize(*tuple);
+					log_tuple(LogRecordType::Insert, record);
+					auto tid = records.allocate(record.size());
+					records.write(tid, record.data(), record.size());
+					entries.emplace_back(tuple->key, tid);
+					stats.num_insertions_db++;
+				}
+				index.bulk_load(entries);
+			}
+			return;
+		}
+	}
+
 	for (auto &tuple : tuples)
 		insert(tuple);
 }
 // -----------------------------------------------------------------
-template <template <typename, typename, bool> typename IndexT, typename KeyT>
-	requires IndexInterface<IndexT, KeyT>
-Database<IndexT, KeyT>::Tuple Database<IndexT, KeyT>::get(const KeyT &key) {
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+Database<IndexT, KeyT, IsClustered>::Tuple
+Database<IndexT, KeyT, IsClustered>::get(const KeyT &key) {
 	stats.num_lookups_db++;
 
-	// Get TID for key
-	auto maybe_tid = index.lookup(key);
-	if (!maybe_tid.has_value())
+	// Get TID or tuple for key
+	auto maybe_value = index.lookup(key);
+	if (!maybe_value.has_value())
 		throw std::logic_error("Database::get(): Key not found.");
-	auto tid = maybe_tid.value();
 
 	// Get Tuple
-	Tuple tuple{};
-	auto bytes_read =
-		records.read(tid, reinterpret_cast<std::byte *>(&tuple), tuple.size());
+	if constexpr (IsClustered)
+		return from_index_value(key, maybe_value.value());
+	else
+		return read(key, maybe_value.value());
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::update(const Tuple &tuple) {
+	// Get TID or tuple for key
+	auto maybe_value = index.lookup(tuple.key);
+	if (!maybe_value.has_value())
+		throw std::logic_error("Database::update(): Key not found.");
+	auto record = serialize(tuple);
+	log_tuple(LogRecordType::Update, record);
+	if constexpr (IsClustered) {
+		// Replace the tuple in the index. Its size may change.
+		index.upsert(tuple.key, get_index_value(record));
+		stats.num_updates_db++;
+	} else {
+		auto tid = maybe_value.value();
+		// Update tuple in records
+		records.update(tid, record.data(), record.size());
+		stats.num_updates_db++;
+		// Update index
+		index.update(tuple.key, tid);
+	}
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+std::vector<typename Database<IndexT, KeyT, IsClustered>::Tuple>
+Database<IndexT, KeyT, IsClustered>::get(const std::vector<KeyT> &keys) {
+	// Values of a clustered index refer to its nodes, which a later lookup of
+	// the batch may evict.
+	if constexpr (IsClustered) {
+		std::vector<Tuple> tuples;
+		tuples.reserve(keys.size());
+		for (auto &key : keys)
+			tuples.push_back(get(key));
+		return tuples;
+	} else {
+		// Get TIDs for keys
+		std::vector<std::optional<TID>> tids;
+		if constexpr (requires(std::span<const KeyT> keys) {
+						  index.lookup_batch(keys);
+					  }) {
+			tids = index.lookup_batch(keys);
+		} else {
+			tids.reserve(keys.size());
+			for (auto &key : keys)
+				tids.push_back(index.lookup(key));
+		}
 
-	if (bytes_read != tuple.size())
-		throw std::logic_error("Database<IndexT>::get(): Read corrupted.");
+		// Get Tuples
+		std::vector<Tuple> tuples;
+		tuples.reserve(keys.size());
+		for (size_t i = 0; i < keys.size(); ++i) {
+			stats.num_lookups_db++;
+			if (!tids[i].has_value())
+				throw std::logic_error("Database::get(): Key not found.");
+			tuples.push_back(read(keys[i], tids[i].value()));
+		}
 
-	return tuple;
+		return tuples;
+	}
 }
 // -----------------------------------------------------------------
-template <template <typename, typename, bool> typename IndexT, typename KeyT>
-	requires IndexInterface<IndexT, KeyT>
-void Database<IndexT, KeyT>::update(const Tuple &tuple) {
-	// Get TID for key
-	auto maybe_tid = index.lookup(tuple.key);
-	if (!maybe_tid.has_value())
-		throw std::logic_error("Database::update(): Key not found.");
-	auto tid = maybe_tid.value();
-	// Update tuple in records
-	records.write(tid, reinterpret_cast<const std::byte *>(&tuple),
-				  tuple.size());
-	stats.num_updates_db++;
-	// Update index
-	index.update(tuple.key, tid);
-}
-// -----------------------------------------------------------------
-template <template <typename, typename, bool> typename IndexT, typename KeyT>
-	requires IndexInterface<IndexT, KeyT>
-void Database<IndexT, KeyT>::erase(const KeyT & /*key*/) {
-	// TODO. Also update stats here.
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::update(
+	const std::vector<Tuple> &tuples) {
+	using Entry = std::pair<KeyT, TID>;
+
+	if constexpr (!IsClustered &&
+				  requires(std::span<const KeyT> keys,
+						   std::span<const Entry> entries) {
+					  index.lookup_batch(keys);
+					  index.update_batch(entries);
+				  }) {
+		// Get TIDs for keys
+		std::vector<KeyT> keys;
+		keys.reserve(tuples.size());
+		for (auto &tuple : tuples)
+			keys.push_back(tuple.key);
+		auto tids = index.lookup_batch(keys);
+
+		// Update tuples in records
+		std::vector<Entry> entries;
+		entries.reserve(tuples.size());
+		for (size_t i = 0; i < tuples.size(); ++i) {
+			if (!tids[i].has_value())
+				throw std::logic_error("Database::update(): Key not found.");
+			auto record = serialize(tuples[i]);
+			log_tuple(LogRecordType::Update, record);
+			records.update(tids[i].value(), record.data(), record.size());
+			stats.num_updates_db++;
+			entries.emplace_back(tuples[i].key, tids[i].value());
+		}
+
+		// Update index
+		index.update_batch(entries);
+		return;
+	}
+
+	for (auto &tuple : tuples)
+		update(tuple);
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::erase(const KeyT &key) {
+	// Get TID or tuple for key
+	auto maybe_value = index.lookup(key);
+	if (!maybe_value.has_value())
+		throw std::logic_error("Database::erase(): Key not found.");
+	// Only the key is logged.
+	log_tuple(LogRecordType::Erase, serialize({key, 0}));
+
+	index.erase(key, buffer_manager.page_size);
+	if constexpr (!IsClustered)
+		records.erase(maybe_value.value());
 	++stats.num_deletions_db;
-	throw std::logic_error("Database<IndexT>::erase(): Not implemented yet.");
+}
+// -----------------------------------------------------------------
+template <template <typename, typename, bool> typename IndexT, typename KeyT,
+		  bool IsClustered>
+	requires IndexInterface<IndexT, KeyT, IndexValue<IsClustered>>
+void Database<IndexT, KeyT, IsClustered>::scan(
+	const std::function<void(const Tuple &)> &visit, bool bypass_buffer) {
+	if constexpr (IsClustered) {
+		// The leaves hold the tuples.
+		index.for_each([&](const KeyT &key, const String &value) {
+			visit(from_index_value(key, value));
+		});
+	} else {
+		records.scan(
+			[&](std::span<const std::byte> record) {
+				visit(deserialize(record));
+			},
+			bypass_buffer);
+	}
 }
 // -----------------------------------------------------------------
 // Explicit instantiations
@@ -99,4 +599,8 @@ template class Database<Map, UInt64>;
 template class Database<Map, String>;
 template class Database<BBBTree, UInt64>;
 template class Database<BBBTree, String>;
-} // namespace bbbtree
\ No newline at end of file
+template class Database<BTree, UInt64, true>;
+template class Database<BTree, String, true>;
+template class Database<BBBTree, UInt64, true>;
+template class Database<BBBTree, String, true>;
+} // namespace bbbtree
@@ -1,15 +1,20 @@
 #include "bbbtree/delta.h"
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
 #include <cstring>
+#include <limits>
+#include <string_view>
 
 namespace bbbtree {
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
 uint16_t Delta<KeyT, ValueT>::size() const {
 	auto key_size = entry.key.size();
-	auto value_size = entry.value.size();
-	assert(key_size > 0 && value_size > 0);
+	uint16_t value_size =
+		(op == OperationType::Deleted) ? 0 : entry.value.size();
+	assert(key_size > 0 && (value_size > 0 || op == OperationType::Deleted));
 	return sizeof(op) + sizeof(key_size) + key_size + sizeof(value_size) +
 		   value_size;
 }
@@ -24,15 +29,17 @@ void Delta<KeyT, ValueT>::serialize(std::byte *dst) const {
 	auto key_size = entry.key.size();
 	std::memcpy(dst, &key_size, sizeof(key_size));
 	dst += sizeof(key_size);
-	// Serialize the value size.
-	auto value_size = entry.value.size();
+	// Serialize the value size. Deletes do not store a value.
+	uint16_t value_size =
+		(op == OperationType::Deleted) ? 0 : entry.value.size();
 	std::memcpy(dst, &value_size, sizeof(value_size));
 	dst += sizeof(value_size);
 	// Serialize the key.
 	entry.key.serialize(dst);
 	dst += entry.key.size();
 	// Serialize the value.
-	entry.value.serialize(dst);
+	if (value_size > 0)
+		entry.value.serialize(dst);
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
@@ -49,12 +56,13 @@ void Delta<KeyT, ValueT>::deserialize(const std::byte *src) {
 	uint16_t value_size;
 	std::memcpy(&value_size, src, sizeof(value_size));
 	src += sizeof(value_size);
-	assert(value_size > 0);
+	assert(value_size > 0 || op == OperationType::Deleted);
 	// Deserialize the key.
 	entry.key = KeyT::deserialize(src, key_size);
 	src += key_size;
 	// Deserialize the value.
-	entry.value = ValueT::deserialize(src, value_size);
+	if (value_size > 0)
+		entry.value = ValueT::deserialize(src, value_size);
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
@@ -65,20 +73,216 @@ std::ostream &operator<<(std::ostream &os, const Delta<KeyT, ValueT> &type) {
 	return os;
 }
 // -----------------------------------------------------------------
+namespace {
+// -----------------------------------------------------------------
+/// Writes `value` as a varint of 7 bits per byte. Returns the number of bytes.
+/// Only counts them if `dst` is nullptr.
+size_t put_varint(std::byte *dst, uint64_t value) {
+	size_t n = 1;
+	for (; value >= 0x80; value >>= 7, ++n)
+		if (dst)
+			*dst++ = std::byte((value & 0x7F) | 0x80);
+	if (dst)
+		*dst = std::byte(value);
+	return n;
+}
+// -----------------------------------------------------------------
+/// Reads a varint and advances `src` past it.
+uint64_t get_varint(const std::byte *&src) {
+	uint64_t value = 0;
+	for (unsigned shift = 0;; shift += 7) {
+		auto byte = std::to_integer<uint64_t>(*src++);
+		value |= (byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+}
+// -----------------------------------------------------------------
+/// Writes `num_bytes` bytes unless counting only.
+size_t put_bytes(std::byte *dst, const void *src, size_t num_bytes) {
+	if (dst)
+		std::memcpy(dst, src, num_bytes);
+	return num_bytes;
+}
+// -----------------------------------------------------------------
+/// Integer types are stored as 8 bytes. Reads them as an integer.
+template <typename T> uint64_t to_integer(const T &value) {
+	static_assert(T::size() == sizeof(uint64_t));
+	uint64_t integer;
+	value.serialize(reinterpret_cast<std::byte *>(&integer));
+	return integer;
+}
+// -----------------------------------------------------------------
+/// Converts an integer back into an integer type.
+template <typename T> T from_integer(uint64_t integer) {
+	return T::deserialize(reinterpret_cast<const std::byte *>(&integer),
+						  sizeof(integer));
+}
+// -----------------------------------------------------------------
+/// Encodes a string as its length and its bytes.
+size_t put_string(std::byte *dst, std::string_view view) {
+	size_t n = put_varint(dst, view.size());
+	return n + put_bytes(dst ? dst + n : nullptr, view.data(), view.size());
+}
+// -----------------------------------------------------------------
+/// Stores a decoded string in `strings` and returns a view on it.
+String keep_string(std::vector<std::string> &strings, std::string string) {
+	// `strings` is reserved upfront. Views stay valid.
+	assert(strings.size() < strings.capacity());
+	return String(strings.emplace_back(std::move(string)));
+}
+// -----------------------------------------------------------------
+} // namespace
+// -----------------------------------------------------------------
+size_t DeltasHeader::encode(std::byte *dst) const {
+	auto at = [&](size_t n) { return dst ? dst + n : nullptr; };
+
+	size_t n = put_varint(dst, num_deltas);
+	n += put_varint(at(n), slot_count);
+	n += put_bytes(at(n), &is_leaf, sizeof(is_leaf));
+	if (!is_leaf)
+		n += put_varint(at(n), upper);
+	return n;
+}
+// -----------------------------------------------------------------
+DeltasHeader DeltasHeader::decode(const std::byte *&src) {
+	DeltasHeader header;
+	header.num_deltas = get_varint(src);
+	header.slot_count = get_varint(src);
+	std::memcpy(&header.is_leaf, src, sizeof(header.is_leaf));
+	src += sizeof(header.is_leaf);
+	if (!header.is_leaf)
+		header.upper = get_varint(src);
+	return header;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable EntryValueT>
+DeltaEncoder<KeyT, EntryValueT>::DeltaEncoder(std::byte *dst,
+											  const DeltasHeader &header)
+	: dst(dst) {
+	n = header.encode(dst);
+	ops = at();
+	// The operations of all deltas, two bits each.
+	auto num_bytes = (header.num_deltas + 3) / 4;
+	if (dst)
+		std::memset(ops, 0, num_bytes);
+	n += num_bytes;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable EntryValueT>
+void DeltaEncoder<KeyT, EntryValueT>::add(OperationType op, const KeyT &key,
+										  const EntryValueT &value) {
+	if (dst)
+		ops[num_added / 4] |=
+			std::byte(static_cast<uint8_t>(op) << (num_added % 4 * 2));
+	++num_added;
+
+	// Keys are encoded against the previous one.
+	if constexpr (std::is_same_v<KeyT, String>) {
+		auto view = key.get_view();
+		auto shared =
+			std::ranges::mismatch(view, prev_view).in1 - view.begin();
+		n += put_varint(at(), shared);
+		n += put_string(at(), view.substr(shared));
+		prev_view = view;
+	} else {
+		auto integer = to_integer(key);
+		auto diff = static_cast<int64_t>(integer - prev_key);
+		n += put_varint(at(), (diff << 1) ^ (diff >> 63));
+		prev_key = integer;
+	}
+	// Deletes do not store a value.
+	if (op == OperationType::Deleted)
+		return;
+	if constexpr (std::is_same_v<EntryValueT, String>)
+		n += put_string(at(), value.get_view());
+	else
+		n += put_varint(at(), to_integer(value));
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable EntryValueT>
+DeltaDecoder<KeyT, EntryValueT>::DeltaDecoder(const std::byte *src,
+											  uint16_t num_deltas,
+											  std::string &key_buffer)
+	: ops(src), src(src + (num_deltas + 3) / 4), num_deltas(num_deltas),
+	  key_buffer(key_buffer) {
+	key_buffer.clear();
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable EntryValueT>
+Delta<KeyT, EntryValueT> DeltaDecoder<KeyT, EntryValueT>::next() {
+	assert(!done());
+	Delta<KeyT, EntryValueT> delta{};
+	delta.op = static_cast<OperationType>(
+		(std::to_integer<uint8_t>(ops[num_decoded / 4]) >>
+		 (num_decoded % 4 * 2)) &
+		0x3);
+	++num_decoded;
+
+	if constexpr (std::is_same_v<KeyT, String>) {
+		auto shared = get_varint(src);
+		auto suffix_size = get_varint(src);
+		key_buffer.resize(shared);
+		key_buffer.append(reinterpret_cast<const char *>(src), suffix_size);
+		src += suffix_size;
+		delta.entry.key = String(key_buffer);
+	} else {
+		auto zigzag = get_varint(src);
+		prev_key += (zigzag >> 1) ^ -(zigzag & 1);
+		delta.entry.key = from_integer<KeyT>(prev_key);
+	}
+	if (delta.op == OperationType::Deleted)
+		return delta;
+	if constexpr (std::is_same_v<EntryValueT, String>) {
+		auto size = get_varint(src);
+		delta.entry.value = String({reinterpret_cast<const char *>(src), size});
+		src += size;
+	} else {
+		delta.entry.value = from_integer<EntryValueT>(get_varint(src));
+	}
+	return delta;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable EntryValueT>
+uint16_t DeltaDecoder<KeyT, EntryValueT>::count(OperationType op) const {
+	// Compares four operations per byte. The padding of the last byte is
+	// `Unchanged`.
+	auto code = static_cast<uint8_t>(op);
+	uint8_t pattern = code * 0x55;
+	uint16_t count = 0;
+	for (uint16_t i = 0; i < (num_deltas + 3) / 4; ++i) {
+		// Both bits of matching operations are set.
+		auto equal = static_cast<uint8_t>(
+			~(std::to_integer<uint8_t>(ops[i]) ^ pattern));
+		count += std::popcount(static_cast<uint8_t>(equal & (equal >> 1) & 0x55));
+	}
+	if (op == OperationType::Unchanged)
+		count -= 4 * ((num_deltas + 3) / 4) - num_deltas;
+	return count;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltasView<KeyT, ValueT>::serialize(std::byte *dst) const {
+	std::memcpy(dst, bytes.data(), bytes.size());
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+bool DeltasView<KeyT, ValueT>::operator==(const DeltasView &other) const {
+	return std::ranges::equal(bytes, other.bytes);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+std::ostream &operator<<(std::ostream &os,
+						 const DeltasView<KeyT, ValueT> &type) {
+	auto bytes = type.get_bytes();
+	return os << Deltas<KeyT, ValueT>::deserialize(bytes.data(),
+												   bytes.size());
+}
+// -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
 Deltas<KeyT, ValueT>::Deltas(LeafDeltas &&deltas, uint16_t slot_count)
 	: deltas(std::move(deltas)), slot_count(slot_count) {
-	// Add size of header to serialized size.
-	cached_size = sizeof(num_deltas());
-	cached_size += sizeof(slot_count);
-	cached_size += sizeof(bool); // is_leaf marker
-	// Calculate the size of the deltas.
-	std::visit(
-		[&](auto &&arg) {
-			for (const auto &delta : arg)
-				cached_size += delta.size();
-		},
-		this->deltas);
+	cached_size = encode(nullptr);
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
@@ -91,18 +295,7 @@ template <KeyIndexable KeyT, ValueIndexable ValueT>
 Deltas<KeyT, ValueT>::Deltas(InnerNodeDeltas &&deltas, PageID upper,
 							 uint16_t slot_count)
 	: deltas(std::move(deltas)), upper(upper), slot_count(slot_count) {
-	// Add size of header to serialized size.
-	cached_size = sizeof(num_deltas());
-	cached_size += sizeof(upper);
-	cached_size += sizeof(slot_count);
-	cached_size += sizeof(bool); // is_leaf marker
-	// Calculate the size of the deltas.
-	std::visit(
-		[&](auto &&arg) {
-			for (const auto &delta : arg)
-				cached_size += delta.size();
-		},
-		this->deltas);
+	cached_size = encode(nullptr);
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
@@ -113,76 +306,77 @@ Deltas<KeyT, ValueT>::Deltas(InnerNodeDeltas &&deltas, PageID upper,
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
 void Deltas<KeyT, ValueT>::serialize(std::byte *dst) const {
-	// Serialize the number of deltas.
-	auto n = num_deltas();
-	std::memcpy(dst, &n, sizeof(n));
-	dst += sizeof(n);
-	// Serialize the slot count.
-	std::memcpy(dst, &slot_count, sizeof(slot_count));
-	dst += sizeof(slot_count);
-	// Serialize leaf/inner node marker.
-	bool is_leaf = std::holds_alternative<LeafDeltas>(deltas);
-	std::memcpy(dst, &is_leaf, sizeof(is_leaf));
-	dst += sizeof(is_leaf);
-	// Serialize upper for inner nodes.
-	if (!is_leaf) {
-		std::memcpy(dst, &upper, sizeof(upper));
-		dst += sizeof(upper);
-	}
-	// Serialize the deltas.
-	std::visit(
-		[&](auto &&arg) {
-			for (const auto &delta : arg) {
-				delta.serialize(dst);
-				dst += delta.size();
-			}
+	[[maybe_unused]] auto n = encode(dst);
+	assert(n == cached_size);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+uint16_t Deltas<KeyT, ValueT>::encode(std::byte *dst) const {
+	DeltasHeader header{num_deltas(), slot_count, is_leaf(), upper};
+	auto n = std::visit(
+		[&](const auto &deltas) {
+			using EntryValueT = decltype(deltas.front().entry.value);
+			DeltaEncoder<KeyT, EntryValueT> encoder(dst, header);
+			for (const auto &[entry, op] : deltas)
+				encoder.add(op, entry.key, entry.value);
+			return encoder.size();
 		},
 		this->deltas);
+	assert(n <= std::numeric_limits<uint16_t>::max());
+	return n;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+template <typename NodeDeltasT>
+NodeDeltasT
+Deltas<KeyT, ValueT>::decode(const std::byte *src, uint16_t num_deltas,
+							 std::vector<std::string> &strings) {
+	using EntryValueT = decltype(NodeDeltasT{}.front().entry.value);
+
+	std::string key_buffer;
+	DeltaDecoder<KeyT, EntryValueT> decoder(src, num_deltas, key_buffer);
+	NodeDeltasT deltas{};
+	deltas.reserve(num_deltas);
+	while (!decoder.done()) {
+		auto &delta = deltas.emplace_back(decoder.next());
+		// Keep copies of the strings that point into the key buffer or the
+		// serialized bytes.
+		if constexpr (std::is_same_v<KeyT, String>)
+			delta.entry.key = keep_string(strings, key_buffer);
+		if constexpr (std::is_same_v<EntryValueT, String>)
+			if (delta.op != OperationType::Deleted)
+				delta.entry.value =
+					keep_string(strings, std::string(delta.entry.value));
+	}
+	return deltas;
 }
 // -----------------------------------------------------------------
 template <KeyIndexable KeyT, ValueIndexable ValueT>
 Deltas<KeyT, ValueT> Deltas<KeyT, ValueT>::deserialize(const std::byte *src,
 													   uint16_t n) {
-	// TODO: We deserialize LeafDeltas here. Serialize a bool to indicate if
-	// this is a leaf or inner node's deltas.
-	assert(n >= sizeof(uint16_t));
-	// Deserialize the number of deltas.
-	uint16_t num_deltas;
-	std::memcpy(&num_deltas, src, sizeof(num_deltas));
-	uint16_t cached_size = sizeof(num_deltas);
-	// Deserialize the slot count on the node.
-	uint16_t slot_count;
-	std::memcpy(&slot_count, src + cached_size, sizeof(slot_count));
-	cached_size += sizeof(slot_count);
-	// Deserialize the leaf/inner node marker.
-	bool is_leaf;
-	std::memcpy(&is_leaf, src + cached_size, sizeof(is_leaf));
-	cached_size += sizeof(is_leaf);
-	if (is_leaf) {
-		// Deserialize the deltas.
-		LeafDeltas deltas{};
-		deltas.resize(num_deltas);
-		for (auto &delta : deltas) {
-			delta.deserialize(src + cached_size);
-			cached_size += delta.size();
-		}
-		return {std::move(deltas), slot_count, cached_size};
+	[[maybe_unused]] const auto *begin = src;
+	auto header = DeltasHeader::decode(src);
 
-	} else {
-		// Deserialize upper.
-		// TODO: Don't always store `upper`. Only when it's actually updated.
-		PageID upper;
-		std::memcpy(&upper, src + cached_size, sizeof(upper));
-		cached_size += sizeof(upper);
-		// Deserialize the deltas.
-		InnerNodeDeltas deltas{};
-		deltas.resize(num_deltas);
-		for (auto &delta : deltas) {
-			delta.deserialize(src + cached_size);
-			cached_size += delta.size();
-		}
-		return {std::move(deltas), upper, slot_count, cached_size};
+	// Keys and at most one value per delta are strings.
+	std::shared_ptr<std::vector<std::string>> strings;
+	std::vector<std::string> no_strings;
+	if constexpr (std::is_same_v<KeyT, String> ||
+				  std::is_same_v<ValueT, String>) {
+		strings = std::make_shared<std::vector<std::string>>();
+		strings->reserve(2 * header.num_deltas);
 	}
+	auto &decoded_strings = strings ? *strings : no_strings;
+
+	auto result =
+		header.is_leaf
+			? Deltas{decode<LeafDeltas>(src, header.num_deltas,
+										decoded_strings),
+					 header.slot_count, n}
+			: Deltas{decode<InnerNodeDeltas>(src, header.num_deltas,
+											 decoded_strings),
+					 header.upper, header.slot_count, n};
+	result.strings = std::move(strings);
+	return result;
 }
 
 // -----------------------------------------------------------------
@@ -218,11 +412,47 @@ template struct Delta<UInt64, TID>;
 template struct Delta<UInt64, PID>;
 template struct Delta<String, TID>;
 template struct Delta<String, PID>;
+template struct Delta<UInt64, String>;
+template struct Delta<String, String>;
 template struct Deltas<UInt64, TID>;
 template struct Deltas<String, TID>;
+template struct Deltas<UInt64, String>;
+template struct Deltas<String, String>;
+template class DeltaEncoder<UInt64, TID>;
+template class DeltaEncoder<UInt64, PID>;
+template class DeltaEncoder<String, TID>;
+template class DeltaEncoder<String, PID>;
+template class DeltaEncoder<UInt64, String>;
+template class DeltaEncoder<String, String>;
+template class DeltaDecoder<UInt64, TID>;
+template class DeltaDecoder<UInt64, PID>;
+template class DeltaDecoder<String, TID>;
+template class DeltaDecoder<String, PID>;
+template class DeltaDecoder<UInt64, String>;
+template class DeltaDecoder<String, String>;
+template struct DeltasView<UInt64, TID>;
+template struct DeltasView<String, TID>;
+template struct DeltasView<UInt64, String>;
+template struct DeltasView<String, String>;
 template std::ostream &operator<<(std::ostream &, const Delta<UInt64, TID> &);
 template std::ostream &operator<<(std::ostream &, const Delta<String, TID> &);
 template std::ostream &operator<<(std::ostream &, const Deltas<UInt64, TID> &);
 template std::ostream &operator<<(std::ostream &, const Deltas<String, TID> &);
+template std::ostream &operator<<(std::ostream &,
+								  const Delta<UInt64, String> &);
+template std::ostream &operator<<(std::ostream &,
+								  const Delta<String, String> &);
+template std::ostream &operator<<(std::ostream &,
+								  const Deltas<UInt64, String> &);
+template std::ostream &operator<<(std::ostream &,
+								  const Deltas<String, String> &);
+template std::ostream &operator<<(std::ostream &,
+								  const DeltasView<UInt64, TID> &);
+template std::ostream &operator<<(std::ostream &,
+								  const DeltasView<String, TID> &);
+template std::ostream &operator<<(std::ostream &,
+								  const DeltasView<UInt64, String> &);
+template std::ostream &operator<<(std::ostream &,
+								  const DeltasView<String, String> &);
 // -----------------------------------------------------------------
 } // namespace bbbtree
@@ -0,0 +1,89 @@
+#include "bbbtree/delta_cache.h"
+
+#include <cassert>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+std::optional<DeltasView<KeyT, ValueT>>
+DeltaCache<KeyT, ValueT>::find(PageID page_id) {
+	auto it = index.find(page_id);
+	if (it == index.end())
+		return std::nullopt;
+
+	entries.splice(entries.begin(), entries, it->second);
+	return DeltasT(it->second->bytes);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaCache<KeyT, ValueT>::put(PageID page_id, DeltasT deltas,
+								   bool is_dirty) {
+	auto bytes = deltas.get_bytes();
+	auto it = index.find(page_id);
+	if (it != index.end()) {
+		// Re-use the memory of the replaced entry.
+		auto &entry = *(it->second);
+		num_bytes -= get_size(entry);
+		entry.bytes.assign(bytes.begin(), bytes.end());
+		entry.is_dirty |= is_dirty;
+		num_bytes += get_size(entry);
+		entries.splice(entries.begin(), entries, it->second);
+		return;
+	}
+
+	entries.emplace_front(
+		page_id, std::vector<std::byte>(bytes.begin(), bytes.end()), is_dirty);
+	index.emplace(page_id, entries.begin());
+	num_bytes += get_size(entries.front());
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaCache<KeyT, ValueT>::erase(PageID page_id) {
+	auto it = index.find(page_id);
+	if (it == index.end())
+		return;
+
+	num_bytes -= get_size(*(it->second));
+	entries.erase(it->second);
+	index.erase(it);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+typename DeltaCache<KeyT, ValueT>::Entry DeltaCache<KeyT, ValueT>::pop() {
+	assert(!entries.empty());
+
+	auto entry = std::move(entries.back());
+	num_bytes -= get_size(entry);
+	index.erase(entry.page_id);
+	entries.pop_back();
+
+	return entry;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaCache<KeyT, ValueT>::clear() {
+	entries.clear();
+	index.clear();
+	num_bytes = 0;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+std::vector<typename DeltaCache<KeyT, ValueT>::Entry>
+DeltaCache<KeyT, ValueT>::clean() {
+	std::vector<Entry> dirty_entries;
+	for (auto &entry : entries) {
+		if (!entry.is_dirty)
+			continue;
+		dirty_entries.push_back(entry);
+		entry.is_dirty = false;
+	}
+	return dirty_entries;
+}
+// -----------------------------------------------------------------
+// Explicit instantiations
+template class DeltaCache<UInt64, TID>;
+template class DeltaCache<String, TID>;
+template class DeltaCache<UInt64, String>;
+template class DeltaCache<String, String>;
+// -----------------------------------------------------------------
+} // namespace bbbtree
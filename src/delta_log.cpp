@@ -0,0 +1,321 @@
+#include "bbbtree/delta_log.h"
+#include "bbbtree/buffer_manager.h"
+#include "bbbtree/logger.h"
+#include "bbbtree/stats.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+bool DeltaLog<KeyT, ValueT>::before_unload(char *data, const State &state,
+										   PageID page_id, size_t page_size) {
+#ifndef NDEBUG
+	logger.log("DeltaLog::before_unload(): page " + std::to_string(page_id));
+#endif
+	this->adapt_threshold();
+
+	auto *node = reinterpret_cast<Node *>(data);
+
+	// New pages and pages with many updates are always written out. While
+	// the log is modified, evicted nodes are written out as well.
+	bool force_write_out = !buffering_enabled || state == State::NEW ||
+						   this->has_many_updates(node, page_size) || is_locked;
+
+	// Buffered deltas are superseded by the written out node.
+	if (force_write_out) {
+		drop_record(page_id);
+		return this->write_out(node);
+	}
+
+	assert(state == State::DIRTY);
+
+	is_locked = true;
+
+	// Records never span pages. Write out nodes with too many deltas. Nodes
+	// whose changes cancelled out, e.g. an insert that was erased again, have
+	// no deltas and are written out as well.
+	auto deltas = this->extract_deltas(node);
+	if (deltas.get_header().num_deltas == 0 ||
+		record_header_size + deltas.size() > page_size - sizeof(LogPage)) {
+		is_locked = false;
+		drop_record(page_id);
+		return this->write_out(node);
+	}
+
+	set_record(page_id, append(page_id, deltas.get_bytes()));
+
+	// Collect garbage incrementally. At most one page per append.
+	if (get_garbage_bytes() > gc_threshold * log_bytes)
+		collect_garbage();
+
+	is_locked = false;
+
+	return false;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::after_load(char *data, PageID page_id) {
+	assert(!is_locked);
+
+	auto it = records.find(page_id);
+	// No deltas buffered. Do nothing.
+	if (it == records.end())
+		return;
+	const auto record = it->second;
+
+	is_locked = true;
+
+	// Apply the deltas straight from the log page. The record stays live
+	// until the node is written out.
+	const auto page_size = buffer_manager.page_size;
+	const auto log_page = get_log_page(record.offset);
+	BufferFrame *frame = nullptr;
+	const std::byte *page = group.data();
+	if (!is_grouped_tail(log_page)) {
+		frame = &buffer_manager.fix_page(segment_id, log_page, false, nullptr,
+										 true);
+		page = reinterpret_cast<const std::byte *>(frame->get_data());
+	}
+	const auto *src = page + record.offset % page_size + record_header_size;
+	auto deltas = DeltasT::deserialize(src, record.size - record_header_size);
+	this->apply_deltas(reinterpret_cast<Node *>(data), deltas, page_size);
+	if (frame)
+		buffer_manager.unfix_page(*frame, false);
+
+	is_locked = false;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+bool DeltaLog<KeyT, ValueT>::collect_garbage() {
+	const auto page_size = buffer_manager.page_size;
+
+	// Pick the full page with the fewest live bytes.
+	auto victim = pages.end();
+	for (auto it = pages.begin(); it != pages.end(); ++it) {
+		if (has_tail && it->first == tail_page)
+			continue;
+		if (victim == pages.end() ||
+			it->second.live_bytes < victim->second.live_bytes)
+			victim = it;
+	}
+	if (victim == pages.end())
+		return false;
+	// Moving a mostly live page does not free space.
+	const auto victim_page = victim->first;
+	if (victim->second.live_bytes > (page_size - sizeof(LogPage)) / 2)
+		return false;
+
+	// Copy the live records. Appending them might evict the page.
+	uint32_t used = 0;
+	if (victim->second.live_bytes > 0) {
+		auto &frame = buffer_manager.fix_page(segment_id, victim_page, false,
+											  nullptr, true);
+		used = reinterpret_cast<const LogPage *>(frame.get_data())->used;
+		buffer.resize(used);
+		std::memcpy(buffer.data(), frame.get_data(), used);
+		buffer_manager.unfix_page(frame, false);
+	}
+
+	// Move the live records to the tail.
+	for (uint32_t pos = sizeof(LogPage); pos < used;) {
+		PageID pid;
+		uint16_t size;
+		std::memcpy(&pid, buffer.data() + pos, sizeof(pid));
+		std::memcpy(&size, buffer.data() + pos + sizeof(pid), sizeof(size));
+		const uint64_t offset = victim_page * page_size + pos;
+		pos += record_header_size + size;
+
+		auto it = records.find(pid);
+		if (it == records.end() || it->second.offset != offset)
+			continue;
+		auto record =
+			append(pid, {buffer.data() + offset % page_size + record_header_size,
+						 size});
+		// The node might have been written out while appending. The moved
+		// record is garbage then.
+		it = records.find(pid);
+		if (it != records.end() && it->second.offset == offset)
+			set_record(pid, record);
+	}
+
+	// Free the page. All of its records are garbage now.
+	victim = pages.find(victim_page);
+	assert(victim->second.live_bytes == 0);
+	log_bytes -= victim->second.num_bytes;
+	pages.erase(victim);
+	free_pages.push_back(victim_page);
+	++stats.delta_log_pages_cleaned;
+
+	return true;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::clear() {
+	records.clear();
+	pages.clear();
+	free_pages.clear();
+	next_page = 0;
+	tail_page = 0;
+	tail_used = 0;
+	has_tail = false;
+	log_bytes = 0;
+	live_bytes = 0;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::write_back(SegmentID segment_id) {
+	assert(!is_locked);
+	disable_buffering();
+
+	std::vector<PageID> buffered;
+	buffered.reserve(records.size());
+	for (const auto &[page_id, record] : records)
+		buffered.push_back(page_id);
+
+	// Loading a node applies its deltas. Writing it out drops its record.
+	for (auto page_id : buffered) {
+		auto &frame =
+			buffer_manager.fix_page(segment_id, page_id, true, this, false);
+		buffer_manager.unfix_page(frame, true);
+		buffer_manager.flush_page(frame);
+		assert(!records.contains(page_id));
+	}
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::enable_grouping() {
+	if (is_grouped)
+		return;
+	buffer_manager.reserve_frames(1);
+	group.resize(buffer_manager.page_size);
+	// The current tail stays a buffered page. Records go to a new one.
+	has_tail = false;
+	is_grouped = true;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::flush() {
+	if (is_grouped && has_tail)
+		write_group();
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::write_group() {
+	assert(is_grouped && has_tail);
+	// Fixing the page might evict nodes. They are written out while locked.
+	bool was_locked = is_locked;
+	is_locked = true;
+
+	auto &frame =
+		buffer_manager.fix_page(segment_id, tail_page, true, nullptr, true);
+	std::memcpy(frame.get_data(), group.data(), tail_used);
+	buffer_manager.unfix_page(frame, true);
+	buffer_manager.flush_page(frame);
+	++stats.delta_groups_written;
+
+	is_locked = was_locked;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+typename DeltaLog<KeyT, ValueT>::Record
+DeltaLog<KeyT, ValueT>::append(PageID page_id,
+							   std::span<const std::byte> deltas) {
+	const auto page_size = buffer_manager.page_size;
+	const uint16_t record_size = record_header_size + deltas.size();
+	assert(sizeof(LogPage) + record_size <= page_size);
+
+	// Start a new tail page if the record does not fit. A full group is
+	// written out first.
+	bool is_new_tail = !has_tail || tail_used + record_size > page_size;
+	if (is_new_tail) {
+		if (is_grouped && has_tail)
+			write_group();
+		tail_page = get_new_page();
+		tail_used = sizeof(LogPage);
+		has_tail = true;
+		pages[tail_page] = {};
+	}
+
+	BufferFrame *frame = nullptr;
+	auto *data = group.data();
+	if (!is_grouped) {
+		frame =
+			&buffer_manager.fix_page(segment_id, tail_page, true, nullptr, true);
+		data = reinterpret_cast<std::byte *>(frame->get_data());
+	}
+
+	// Write the record behind the previous one.
+	Record record{tail_page * page_size + tail_used, record_size};
+	const uint16_t size = deltas.size();
+	std::memcpy(data + tail_used, &page_id, sizeof(page_id));
+	std::memcpy(data + tail_used + sizeof(page_id), &size, sizeof(size));
+	std::memcpy(data + tail_used + record_header_size, deltas.data(),
+				deltas.size());
+	tail_used += record_size;
+	reinterpret_cast<LogPage *>(data)->used = tail_used;
+
+	if (frame)
+		buffer_manager.unfix_page(*frame, true);
+
+	pages[tail_page].num_bytes += record_size;
+	log_bytes += record_size;
+	++stats.delta_log_appends;
+
+	return record;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::set_record(PageID page_id, Record record) {
+	drop_record(page_id);
+	records[page_id] = record;
+	pages.at(get_log_page(record.offset)).live_bytes += record.size;
+	live_bytes += record.size;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+void DeltaLog<KeyT, ValueT>::drop_record(PageID page_id) {
+	auto it = records.find(page_id);
+	if (it == records.end())
+		return;
+
+	auto &usage = pages.at(get_log_page(it->second.offset));
+	usage.live_bytes -= it->second.size;
+	live_bytes -= it->second.size;
+	records.erase(it);
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+PageID DeltaLog<KeyT, ValueT>::get_new_page() {
+	if (!free_pages.empty()) {
+		auto page_id = free_pages.back();
+		free_pages.pop_back();
+		return page_id;
+	}
+
+	++stats.pages_created;
+	++stats.delta_pages_created;
+	return next_page++;
+}
+// -----------------------------------------------------------------
+template <KeyIndexable KeyT, ValueIndexable ValueT>
+std::ostream &operator<<(std::ostream &os, const DeltaLog<KeyT, ValueT> &log) {
+	os << "Delta Log: " << log.records.size() << " records on "
+	   << log.pages.size() << " pages, " << log.get_live_bytes()
+	   << " live bytes, " << log.get_garbage_bytes() << " garbage bytes"
+	   << std::endl;
+
+	return os;
+}
+// -----------------------------------------------------------------
+// Explicit instantiations
+template class DeltaLog<UInt64, TID>;
+template class DeltaLog<String, TID>;
+template std::ostream &operator<<(std::ostream &,
+								  const DeltaLog<UInt64, TID> &);
+template std::ostream &operator<<(std::ostream &,
+								  const DeltaLog<String, TID> &);
+// -----------------------------------------------------------------
+} // namespace bbbtree
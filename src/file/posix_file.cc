@@ -129,6 +129,14 @@ namespace bbbtree
         }
     }
 
+    void PosixFile::sync()
+    {
+        if (::fdatasync(fd) < 0)
+        {
+            throw_errno();
+        }
+    }
+
     std::unique_ptr<File> File::open_file(const char *filename, Mode mode)
     {
         return std::make_unique<PosixFile>(filename, mode);
@@ -0,0 +1,141 @@
+#include "bbbtree/journal.h"
+#include "bbbtree/buffer_manager.h"
+#include "bbbtree/stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+PageJournal::PageJournal(SegmentID segment_id, BufferManager &buffer_manager,
+						 std::vector<SegmentID> segment_ids, uint64_t version,
+						 bool reset)
+	: file(File::open_file(std::to_string(segment_id).c_str(),
+						   File::Mode::WRITE)),
+	  buffer_manager(buffer_manager), segment_ids(std::move(segment_ids)),
+	  version(version) {
+	// A reset database has no checkpoint to roll back to.
+	if (reset)
+		file->resize(0);
+	else
+		stats.journal_pages_rolled_back += roll_back(version);
+	buffer_manager.set_page_journal(this);
+}
+// -----------------------------------------------------------------
+PageJournal::~PageJournal() { buffer_manager.set_page_journal(nullptr); }
+// -----------------------------------------------------------------
+void PageJournal::before_write(SegmentID segment_id, PageID page_id,
+							   File &segment) {
+	if (std::find(segment_ids.begin(), segment_ids.end(), segment_id) ==
+		segment_ids.end())
+		return;
+
+	// Only the buffer manager grows a segment, so its first write since the
+	// checkpoint finds it as of the checkpoint.
+	auto [size_it, is_first_write] =
+		segment_sizes.try_emplace(segment_id, segment.size());
+	const auto page_size = buffer_manager.page_size;
+	// Pages allocated since the checkpoint are cut off instead.
+	bool has_image = (page_id + 1) * page_size <= size_it->second &&
+					 journaled_pages
+						 .insert(page_id ^
+								 (static_cast<uint64_t>(segment_id) << 48))
+						 .second;
+	if (!has_image && !is_first_write)
+		return;
+
+	// Padding is part of the checksum.
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	header.version = version;
+	header.segment_size = size_it->second;
+	header.page_id = page_id;
+	header.image_size = has_image ? page_size : 0;
+	header.segment_id = segment_id;
+	auto size = sizeof(Header) + header.image_size;
+	buffer.resize(size);
+	std::memcpy(buffer.data(), &header, sizeof(header));
+	if (has_image)
+		segment.read_block(page_id * page_size, page_size,
+						   buffer.data() + sizeof(Header));
+	header.checksum = get_checksum(buffer.data(), size);
+	std::memcpy(buffer.data(), &header.checksum, sizeof(header.checksum));
+
+	// The image must be durable before the page is overwritten.
+	file->resize(file_end + size);
+	file->write_block(buffer.data(), file_end, size);
+	file->sync();
+	file_end += size;
+	stats.bytes_written_physically += size;
+	if (has_image)
+		++stats.journal_pages_written;
+}
+// -----------------------------------------------------------------
+void PageJournal::truncate(uint64_t version) {
+	// Entries left behind by a crash belong to an older version and are
+	// skipped.
+	file->resize(0);
+	file_end = 0;
+	segment_sizes.clear();
+	journaled_pages.clear();
+	this->version = version;
+}
+// -----------------------------------------------------------------
+size_t PageJournal::roll_back(uint64_t version) {
+	const auto page_size = buffer_manager.page_size;
+	auto size = file->size();
+	buffer.resize(size);
+	if (size > 0)
+		file->read_block(0, size, buffer.data());
+
+	// Entries of older versions were left behind by a crash after their
+	// checkpoint. Valid entries follow each other.
+	std::map<SegmentID, std::unique_ptr<File>> segments;
+	size_t num_restored = 0;
+	size_t offset = 0;
+	while (offset + sizeof(Header) <= size) {
+		Header header;
+		std::memcpy(&header, buffer.data() + offset, sizeof(header));
+		auto end = offset + sizeof(Header) + header.image_size;
+		if ((header.image_size != 0 && header.image_size != page_size) ||
+			end > size)
+			break;
+		auto checksum = header.checksum;
+		std::memset(buffer.data() + offset, 0, sizeof(header.checksum));
+		if (get_checksum(buffer.data() + offset, end - offset) != checksum)
+			break;
+
+		if (header.version == version) {
+			// Cut off the pages allocated since the checkpoint first.
+			auto &segment = segments[header.segment_id];
+			if (!segment) {
+				segment = File::open_file(
+					std::to_string(header.segment_id).c_str(),
+					File::Mode::WRITE);
+				segment->resize(header.segment_size);
+			}
+			if (header.image_size > 0) {
+				assert((header.page_id + 1) * page_size <=
+					   header.segment_size);
+				segment->write_block(buffer.data() + offset + sizeof(Header),
+									 header.page_id * page_size, page_size);
+				++num_restored;
+			}
+		}
+		offset = end;
+	}
+
+	// The segments must be durable as of the checkpoint before the entries
+	// are dropped.
+	for (auto &[segment_id, segment] : segments)
+		segment->sync();
+	truncate(version);
+
+	return num_restored;
+}
+// -----------------------------------------------------------------
+} // namespace bbbtree
@@ -14,6 +14,11 @@ set(
     src/slotted_page.cpp
     src/btree.cpp
     src/bbbtree.cpp
+    src/delta_log.cpp
+    src/delta_cache.cpp
+    src/record_delta_tree.cpp
+    src/wal.cpp
+    src/journal.cpp
     src/btree_with_tracking.cpp
     src/delta.cpp
     src/map.cpp
@@ -33,9 +38,12 @@ endif()
 # Library
 # ---------------------------------------------------------------------------
 
+find_package(Threads REQUIRED)
+
 add_library(bbbtree STATIC ${SRC_CC} ${INCLUDE_H})
 target_link_libraries(
     bbbtree 
+    Threads::Threads
 )
 
 # Pass project root as a macro to your benchmark code
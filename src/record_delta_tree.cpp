@@ -0,0 +1,242 @@
+#include "bbbtree/record_delta_tree.h"
+#include "bbbtree/logger.h"
+#include "bbbtree/stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+bool RecordDeltaTree::before_unload(char *data, const State &state,
+									PageID page_id, size_t page_size) {
+#ifndef NDEBUG
+	logger.log("RecordDeltaTree::before_unload(): page " +
+			   std::to_string(page_id));
+#endif
+	const auto &page = *reinterpret_cast<const SlottedPage *>(data);
+	auto it = pages.find(page_id);
+
+	// New pages and pages that changed a lot are always written out. While the
+	// tree is modified, evicted pages are written out as well.
+	bool force_write_out = !buffering_enabled || state == State::NEW ||
+						   is_locked || it == pages.end() ||
+						   it->second.is_changed_entirely ||
+						   get_num_bytes_changed(page, it->second) >
+							   wa_threshold * page_size;
+	if (!force_write_out) {
+		serialize(page, it->second);
+		force_write_out = buffer.size() > max_delta_fraction * page_size;
+	}
+
+	// Buffered records are superseded by the written out page.
+	if (force_write_out) {
+		if (it != pages.end()) {
+			if (it->second.is_buffered) {
+				if (is_locked) {
+					deferred_deletions.push_back(page_id);
+				} else {
+					is_locked = true;
+					erase_deltas(page_id);
+					erase_deferred_deletions();
+					is_locked = false;
+				}
+			}
+			pages.erase(page_id);
+		}
+		return true;
+	}
+
+	is_locked = true;
+
+	// Replaces the records buffered for the page before.
+	it->second.is_buffered = true;
+	this->upsert(page_id,
+				 String({reinterpret_cast<const char *>(buffer.data()),
+						 buffer.size()}));
+	++stats.record_pages_write_deferred;
+
+	erase_deferred_deletions();
+
+	is_locked = false;
+
+	return false;
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::after_load(char *data, PageID page_id) {
+	assert(!is_locked);
+	// Pages without buffered records are up to date on disk.
+	if (!has_deltas(page_id))
+		return;
+
+	is_locked = true;
+
+	// The changed slots stay tracked until the page is written out.
+	auto maybe_deltas = this->lookup(page_id);
+	assert(maybe_deltas.has_value());
+	apply(*reinterpret_cast<SlottedPage *>(data), maybe_deltas.value());
+	++stats.record_deltas_applied;
+
+	erase_deferred_deletions();
+
+	is_locked = false;
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::track(PageID page_id, SlotID slot_id) {
+	auto &slots = pages[page_id].slots;
+	auto it = std::lower_bound(slots.begin(), slots.end(), slot_id);
+	if (it == slots.end() || *it != slot_id)
+		slots.insert(it, slot_id);
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::track_page(PageID page_id) {
+	pages[page_id].is_changed_entirely = true;
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::write_back(SegmentID segment_id) {
+	assert(!is_locked);
+	disable_buffering();
+
+	std::vector<PageID> buffered;
+	for (const auto &[page_id, changes] : pages)
+		if (changes.is_buffered)
+			buffered.push_back(page_id);
+
+	// Loading a page replays its records. Writing it out erases them.
+	for (auto page_id : buffered) {
+		auto &frame =
+			buffer_manager.fix_page(segment_id, page_id, true, this, false);
+		buffer_manager.unfix_page(frame, true);
+		buffer_manager.flush_page(frame);
+		assert(!has_deltas(page_id));
+	}
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::clear() {
+	pages.clear();
+	deferred_deletions.clear();
+	BTree<PID, String>::clear();
+}
+// -----------------------------------------------------------------
+size_t RecordDeltaTree::validate_deltas(PageID num_pages) {
+	assert(!is_locked);
+	pages.clear();
+	deferred_deletions.clear();
+
+	// Pages evicted while scanning are written out.
+	is_locked = true;
+	std::vector<PageID> invalid;
+	std::vector<SlotID> slots;
+	this->for_each([&](const PID &pid, const String &deltas) {
+		PageID page_id = pid;
+		if (page_id >= num_pages ||
+			!parse(deltas, buffer_manager.page_size, slots)) {
+			invalid.push_back(page_id);
+			return;
+		}
+		auto &changes = pages[page_id];
+		changes.slots = slots;
+		changes.is_buffered = true;
+	});
+	for (auto page_id : invalid) {
+		erase_deltas(page_id);
+		++stats.deltas_dropped_on_recovery;
+	}
+	erase_deferred_deletions();
+	is_locked = false;
+
+	return invalid.size();
+}
+// -----------------------------------------------------------------
+size_t RecordDeltaTree::get_num_bytes_changed(const SlottedPage &page,
+											  const ChangedPage &changes) {
+	size_t num_bytes = sizeof(SlottedPage::Header);
+	for (auto slot_id : changes.slots)
+		num_bytes += sizeof(SlottedPage::Slot) +
+					 page.get_slots()[slot_id].get_size();
+	return num_bytes;
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::serialize(const SlottedPage &page,
+								const ChangedPage &changes) {
+	// The header, then each changed slot's ID, slot and record.
+	buffer.resize(sizeof(SlottedPage::Header));
+	std::memcpy(buffer.data(), &page.header, sizeof(SlottedPage::Header));
+	for (auto slot_id : changes.slots) {
+		const auto &slot = page.get_slots()[slot_id];
+		auto pos = buffer.size();
+		buffer.resize(pos + sizeof(slot_id) + sizeof(slot) + slot.get_size());
+		std::memcpy(buffer.data() + pos, &slot_id, sizeof(slot_id));
+		pos += sizeof(slot_id);
+		std::memcpy(buffer.data() + pos, &slot, sizeof(slot));
+		pos += sizeof(slot);
+		std::memcpy(buffer.data() + pos, page.get_data() + slot.get_offset(),
+					slot.get_size());
+	}
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::apply(SlottedPage &page, const String &deltas) {
+	auto view = deltas.get_view();
+	const auto *src = reinterpret_cast<const std::byte *>(view.data());
+	const auto *end = src + view.size();
+
+	std::memcpy(&page.header, src, sizeof(SlottedPage::Header));
+	src += sizeof(SlottedPage::Header);
+	while (src < end) {
+		SlotID slot_id;
+		std::memcpy(&slot_id, src, sizeof(slot_id));
+		src += sizeof(slot_id);
+		auto &slot = page.get_slots()[slot_id];
+		std::memcpy(&slot, src, sizeof(slot));
+		src += sizeof(slot);
+		std::memcpy(page.get_data() + slot.get_offset(), src, slot.get_size());
+		src += slot.get_size();
+	}
+	assert(src == end);
+}
+// -----------------------------------------------------------------
+bool RecordDeltaTree::parse(const String &deltas, size_t page_size,
+							std::vector<SlotID> &slots) {
+	auto view = deltas.get_view();
+	const auto *src = reinterpret_cast<const std::byte *>(view.data());
+	const auto *end = src + view.size();
+
+	slots.clear();
+	if (view.size() < sizeof(SlottedPage::Header))
+		return false;
+	SlottedPage::Header header(page_size);
+	std::memcpy(&header, src, sizeof(header));
+	src += sizeof(header);
+	while (end - src >=
+		   static_cast<ptrdiff_t>(sizeof(SlotID) + sizeof(SlottedPage::Slot))) {
+		SlotID slot_id;
+		std::memcpy(&slot_id, src, sizeof(slot_id));
+		src += sizeof(slot_id);
+		SlottedPage::Slot slot;
+		std::memcpy(&slot, src, sizeof(slot));
+		src += sizeof(slot);
+		if (slot_id >= header.slot_count ||
+			slot.get_offset() + slot.get_size() > page_size ||
+			end - src < static_cast<ptrdiff_t>(slot.get_size()))
+			return false;
+		src += slot.get_size();
+		slots.push_back(slot_id);
+	}
+	return src == end;
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::erase_deltas(PageID page_id) {
+	assert(is_locked);
+	this->erase(page_id, buffer_manager.page_size);
+}
+// -----------------------------------------------------------------
+void RecordDeltaTree::erase_deferred_deletions() {
+	assert(is_locked);
+	while (!deferred_deletions.empty()) {
+		auto page_id = deferred_deletions.back();
+		deferred_deletions.pop_back();
+		erase_deltas(page_id);
+	}
+}
+// -----------------------------------------------------------------
+} // namespace bbbtree
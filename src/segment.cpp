@@ -1,48 +1,116 @@
 #include "bbbtree/segment.h"
+#include "bbbtree/record_delta_tree.h"
 #include "bbbtree/stats.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <stdexcept>
 
 namespace bbbtree {
 FSISegment::FSISegment(SegmentID segment_id, BufferManager &buffer_manager)
-	: Segment(segment_id, buffer_manager) {}
+	: Segment(segment_id, buffer_manager),
+	  entries_per_page(buffer_manager.page_size * 2) {
+	if (sizeof(Header) > buffer_manager.page_size)
+		throw std::logic_error(
+			"FSISegment::FSISegment(): Page too small for the header.");
+
+	// Class c > 0 guarantees max_free * 2^((c - 15) / 2) bytes, so that the
+	// highest class is an empty page and each second class halves the space.
+	auto max_free = SlottedPage::get_initial_free_space(buffer_manager.page_size);
+	lower_bounds[0] = 0;
+	for (uint8_t c = 1; c < num_classes; ++c) {
+		auto bound = static_cast<size_t>(
+			max_free * std::pow(2.0, (c - (num_classes - 1)) / 2.0));
+		lower_bounds[c] = std::max(bound, lower_bounds[c - 1] + 1);
+	}
+	lower_bounds[num_classes - 1] = max_free;
 
-std::optional<PageID> FSISegment::find(uint32_t required_space) {
-	auto &frame = buffer_manager.fix_page(segment_id, 0, false, nullptr, false);
-	auto &header = *(reinterpret_cast<FSISegment::Header *>(frame.get_data()));
+	auto &frame = buffer_manager.fix_page(segment_id, 0, true, nullptr, false);
+	bool is_new = frame.is_new();
+	buffer_manager.unfix_page(frame, is_new);
+	if (is_new)
+		clear();
+}
 
-	// Enough space?
-	if (header.free_space < required_space) {
-		buffer_manager.unfix_page(frame, false);
+std::optional<PageID> FSISegment::find(uint32_t required_space) {
+	auto min_class = get_min_class(required_space);
+	if (min_class == num_classes)
 		return {};
+
+	auto &frame = buffer_manager.fix_page(segment_id, 0, true, nullptr, false);
+	auto &header = *(reinterpret_cast<FSISegment::Header *>(frame.get_data()));
+	PageID num_pages = header.allocated_pages;
+	PageID page_id = header.first_pages[min_class];
+
+	// Scan the classes from the lowest page that may fit.
+	std::optional<PageID> found;
+	while (!found && page_id < num_pages) {
+		auto &fsi_frame = buffer_manager.fix_page(
+			segment_id, 1 + page_id / entries_per_page, false, nullptr, false);
+		const auto *entries =
+			reinterpret_cast<const uint8_t *>(fsi_frame.get_data());
+		PageID end = std::min<PageID>(
+			num_pages, (page_id / entries_per_page + 1) * entries_per_page);
+		for (; page_id < end; ++page_id) {
+			auto entry = page_id % entries_per_page;
+			// Skip bytes of two full pages at once.
+			if (entry % 2 == 0 && entries[entry / 2] == 0 && page_id + 1 < end) {
+				++page_id;
+				continue;
+			}
+			auto free_space_class = (entries[entry / 2] >> (entry % 2 * 4)) & 0xF;
+			if (free_space_class >= min_class) {
+				found = page_id;
+				break;
+			}
+		}
+		buffer_manager.unfix_page(fsi_frame, false);
 	}
 
-	auto page_id = header.allocated_pages - 1;
-	buffer_manager.unfix_page(frame, false);
+	// No page below has a class this high or higher.
+	bool is_dirty = false;
+	for (auto c = min_class; c < num_classes; ++c) {
+		if (header.first_pages[c] < page_id) {
+			header.first_pages[c] = page_id;
+			is_dirty = true;
+		}
+	}
+	buffer_manager.unfix_page(frame, is_dirty);
 
-	return {page_id};
+	return found;
 }
 
 void FSISegment::update(PageID target_page, uint32_t new_free_space) {
 	auto &frame = buffer_manager.fix_page(segment_id, 0, true, nullptr, false);
 	auto &header = *(reinterpret_cast<FSISegment::Header *>(frame.get_data()));
 
-	if (target_page != (header.allocated_pages - 1)) {
-		buffer_manager.unfix_page(frame, true);
+	if (target_page >= header.allocated_pages) {
+		buffer_manager.unfix_page(frame, false);
 		throw std::logic_error("FSISegment::update(): Cannot update a page's "
-							   "free space which is not the last.");
+							   "free space which is not allocated.");
 	}
 
-	if (header.free_space < new_free_space) {
-		buffer_manager.unfix_page(frame, true);
+	if (new_free_space > lower_bounds[num_classes - 1]) {
+		buffer_manager.unfix_page(frame, false);
 		throw std::logic_error("FSISegment::update(): Free space on a slotted "
-							   "page can only shrink.");
+							   "page cannot exceed the page.");
 	}
 
-	header.free_space = new_free_space;
-	buffer_manager.unfix_page(frame, true);
+	// Searches for the lower classes start at the page again, if its class
+	// grew.
+	auto free_space_class = get_class(new_free_space);
+	bool is_dirty = false;
+	if (set_class(target_page, free_space_class) < free_space_class) {
+		for (uint8_t c = 0; c <= free_space_class; ++c) {
+			if (header.first_pages[c] > target_page) {
+				header.first_pages[c] = target_page;
+				is_dirty = true;
+			}
+		}
+	}
+	buffer_manager.unfix_page(frame, is_dirty);
 }
 
 PageID FSISegment::create_new_page(size_t initial_free_space) {
@@ -50,11 +118,19 @@ PageID FSISegment::create_new_page(size_t initial_free_space) {
 	auto &header = *(reinterpret_cast<FSISegment::Header *>(frame.get_data()));
 
 	// TODO: Synchronize this when multi-threading.
+	auto page_id = header.allocated_pages;
 	++header.allocated_pages;
-	header.free_space = initial_free_space;
-	auto page_id = header.allocated_pages - 1;
 	buffer_manager.unfix_page(frame, true);
 
+	// A new FSI page starts without free space.
+	if (page_id % entries_per_page == 0) {
+		auto &fsi_frame = buffer_manager.fix_page(
+			segment_id, 1 + page_id / entries_per_page, true, nullptr, false);
+		std::memset(fsi_frame.get_data(), 0, buffer_manager.page_size);
+		buffer_manager.unfix_page(fsi_frame, true);
+	}
+	update(page_id, initial_free_space);
+
 	++stats.pages_created;
 	++stats.slotted_pages_created;
 
@@ -65,59 +141,193 @@ void FSISegment::clear() {
 	auto &header = *(reinterpret_cast<FSISegment::Header *>(frame.get_data()));
 
 	header.allocated_pages = 0;
-	header.free_space = 0;
+	for (auto &first_page : header.first_pages)
+		first_page = 0;
+
+	buffer_manager.unfix_page(frame, true);
+}
+PageID FSISegment::get_num_pages() {
+	auto &frame = buffer_manager.fix_page(segment_id, 0, false, nullptr, false);
+	auto &header = *(reinterpret_cast<FSISegment::Header *>(frame.get_data()));
+	auto num_pages = header.allocated_pages;
+	buffer_manager.unfix_page(frame, false);
+	return num_pages;
+}
+void FSISegment::checkpoint(MetadataSegment &metadata) {
+	// The inventory is no tree. Only its number of pages is kept.
+	metadata.set(segment_id, {0, get_num_pages(), 0});
+}
+void FSISegment::recover(const MetadataSegment &metadata) {
+	auto maybe_metadata = metadata.get(segment_id);
+	if (!maybe_metadata.has_value())
+		return;
 
+	auto &frame = buffer_manager.fix_page(segment_id, 0, true, nullptr, false);
+	auto &header = *(reinterpret_cast<FSISegment::Header *>(frame.get_data()));
+	header.allocated_pages = maybe_metadata->next_free_page;
+	// Searches start at the first page again.
+	for (auto &first_page : header.first_pages)
+		first_page = 0;
 	buffer_manager.unfix_page(frame, true);
 }
-TID SPSegment::allocate(uint32_t size) {
+uint8_t FSISegment::get_class(size_t free_space) const {
+	auto *bound = std::upper_bound(lower_bounds, lower_bounds + num_classes,
+								   free_space);
+	return bound - lower_bounds - 1;
+}
+uint8_t FSISegment::get_min_class(size_t required_space) const {
+	auto *bound = std::lower_bound(lower_bounds, lower_bounds + num_classes,
+								   required_space);
+	return bound - lower_bounds;
+}
+uint8_t FSISegment::set_class(PageID target_page, uint8_t free_space_class) {
+	auto &frame = buffer_manager.fix_page(
+		segment_id, 1 + target_page / entries_per_page, true, nullptr, false);
+	auto *entries = reinterpret_cast<uint8_t *>(frame.get_data());
+	auto entry = target_page % entries_per_page;
+	auto shift = entry % 2 * 4;
+	auto &byte = entries[entry / 2];
+	uint8_t old_class = (byte >> shift) & 0xF;
+	byte = (byte & ~(0xF << shift)) | (free_space_class << shift);
+	buffer_manager.unfix_page(frame, old_class != free_space_class);
+	return old_class;
+}
+MetadataSegment::MetadataSegment(SegmentID segment_id,
+								 BufferManager &buffer_manager)
+	: Segment(segment_id, buffer_manager) {
+	read(0);
+	read(1);
+}
+std::optional<TreeMetadata>
+MetadataSegment::get(SegmentID tree_segment_id) const {
+	auto it = trees.find(tree_segment_id);
+	if (it == trees.end())
+		return {};
+	return it->second;
+}
+void MetadataSegment::set(SegmentID tree_segment_id,
+						  const TreeMetadata &metadata) {
+	trees[tree_segment_id] = metadata;
+}
+void MetadataSegment::write() {
+	auto size = sizeof(Header) + trees.size() * sizeof(Tree);
+	if (size > buffer_manager.page_size)
+		throw std::logic_error("MetadataSegment::write(): Too many trees.");
+
+	// Overwrites the older version. The last one stays intact.
+	auto &frame = buffer_manager.fix_page(segment_id, (version + 1) % 2, true,
+										  nullptr, false);
+	auto *data = frame.get_data();
+	std::memset(data, 0, buffer_manager.page_size);
+	auto &header = *reinterpret_cast<Header *>(data);
+	header = {magic, version + 1, 0, trees.size(), lsn};
+	auto *tree = reinterpret_cast<Tree *>(data + sizeof(Header));
+	for (const auto &[tree_segment_id, metadata] : trees)
+		*(tree++) = {tree_segment_id, metadata};
+	header.checksum = get_checksum(data, size);
+	buffer_manager.unfix_page(frame, true);
+	buffer_manager.flush_page(frame);
+
+	++version;
+	++stats.checkpoints_written;
+}
+void MetadataSegment::read(PageID page_id) {
+	auto &frame =
+		buffer_manager.fix_page(segment_id, page_id, false, nullptr, false);
+	auto *data = frame.get_data();
+	auto header = *reinterpret_cast<const Header *>(data);
+
+	// Skips pages that were never written, torn writes and older versions.
+	auto size = sizeof(Header) + header.num_trees * sizeof(Tree);
+	bool is_valid = header.magic == magic && header.version > version &&
+					size <= buffer_manager.page_size;
+	if (is_valid) {
+		reinterpret_cast<Header *>(data)->checksum = 0;
+		is_valid = get_checksum(data, size) == header.checksum;
+		reinterpret_cast<Header *>(data)->checksum = header.checksum;
+	}
+	if (is_valid) {
+		version = header.version;
+		lsn = header.lsn;
+		trees.clear();
+		const auto *tree =
+			reinterpret_cast<const Tree *>(data + sizeof(Header));
+		for (size_t i = 0; i < header.num_trees; ++i, ++tree)
+			trees[tree->segment_id] = tree->metadata;
+	}
+
+	buffer_manager.unfix_page(frame, false);
+}
+TID SPSegment::allocate(uint32_t size, bool is_moved) {
 	auto create_new_slotted_page = [&]() {
 		// Create new page in Free-Space Inventory
 		auto new_page_id = space_inventory.create_new_page(
 			SlottedPage::get_initial_free_space(buffer_manager.page_size));
 		// Create new Slotted Page
-		auto &frame = buffer_manager.fix_page(segment_id, new_page_id, true,
-											  nullptr, false);
+		auto &frame = fix_page(new_page_id, true);
 		auto &slotted_page = this->get_slotted_page(frame);
 		slotted_page.header = SlottedPage::Header{
 			static_cast<uint32_t>(buffer_manager.page_size)};
+		if (record_deltas)
+			record_deltas->track_page(new_page_id);
 		buffer_manager.unfix_page(frame, true);
 
 		return new_page_id;
 	};
 
 	// Tuple must be smaller than page
-	auto max_size = buffer_manager.page_size - sizeof(SlottedPage::Slot) -
-					sizeof(SlottedPage::Header);
-	if (size > max_size)
+	if (size > get_max_size())
 		throw std::logic_error("SPSegment::allocate(): Cannot allocate tuples "
 							   "bigger than the page.");
 
-	// Find page with enough space (last page or new page)
-	auto optional_page_id =
-		space_inventory.find(size + sizeof(SlottedPage::Slot));
+	// Find the lowest page with enough space or create a new one. Classes
+	// recovered from disk may be stale. Correct them and search again.
+	auto required_space = size + sizeof(SlottedPage::Slot);
+	auto optional_page_id = space_inventory.find(required_space);
 	PageID page_id = optional_page_id.has_value() ? optional_page_id.value()
 												  : create_new_slotted_page();
-	auto &page =
-		buffer_manager.fix_page(segment_id, page_id, true, nullptr, false);
-	auto &slotted_page = get_slotted_page(page);
+	auto *page = &fix_page(page_id, true);
+	while (get_free_space(get_slotted_page(*page)) < required_space) {
+		space_inventory.update(page_id,
+							   get_free_space(get_slotted_page(*page)));
+		buffer_manager.unfix_page(*page, false);
+		optional_page_id = space_inventory.find(required_space);
+		page_id = optional_page_id.has_value() ? optional_page_id.value()
+											   : create_new_slotted_page();
+		page = &fix_page(page_id, true);
+	}
+	auto &slotted_page = get_slotted_page(*page);
+
+	// The free space includes the holes. Reclaim them if needed.
+	if (slotted_page.get_free_space() < required_space) {
+		slotted_page.compactify(buffer_manager.page_size);
+		if (record_deltas)
+			record_deltas->track_page(page_id);
+		++stats.slotted_pages_compacted;
+	}
 
 	// Allocate a new slot on that page
-	auto slot_id = slotted_page.allocate(size);
-	space_inventory.update(page_id, slotted_page.get_free_space());
+	auto slot_id = slotted_page.allocate(size, is_moved);
+	space_inventory.update(page_id, get_free_space(slotted_page));
+	track({page_id, slot_id});
 
-	buffer_manager.unfix_page(page, true);
+	buffer_manager.unfix_page(*page, true);
 
 	return TID{page_id, slot_id};
 }
 
 uint32_t SPSegment::read(TID tid, std::byte *record, uint32_t capacity) const {
 	// Get Slot
-	auto &frame = buffer_manager.fix_page(segment_id, tid.get_page_id(), false,
-										  nullptr, false);
+	auto &frame = fix_page(tid.get_page_id(), false);
 	auto &slotted_page = get_slotted_page(frame);
 	auto &slot = *(slotted_page.get_slots() + tid.get_slot_id());
 
-	// TODO: Allow redirects
+	// Moved records are read on their page
+	if (slot.is_redirect()) {
+		auto target = slot.get_redirect();
+		buffer_manager.unfix_page(frame, false);
+		return read(target, record, capacity);
+	}
 
 	// Read
 	const auto *data = slotted_page.get_data() + slot.get_offset();
@@ -131,33 +341,226 @@ uint32_t SPSegment::read(TID tid, std::byte *record, uint32_t capacity) const {
 
 uint32_t SPSegment::write(TID tid, const std::byte *record,
 						  uint32_t record_size) {
+	// Enough size allocated?
+	if (!write_if_sized(tid, record, record_size))
+		throw std::logic_error(
+			"SPSegment::write(): Size of record to be written must be the size "
+			"allocated for the given tuple ID (TID).");
+
+	return record_size;
+}
+
+uint32_t SPSegment::update(TID tid, const std::byte *record,
+						   uint32_t record_size) {
+	// Most updates keep the size. Resize only if they do not.
+	if (!write_if_sized(tid, record, record_size)) {
+		resize(tid, record_size);
+		write(tid, record, record_size);
+	}
+	return record_size;
+}
+
+bool SPSegment::write_if_sized(TID tid, const std::byte *record,
+							   uint32_t record_size) {
 	// Get Slot
-	auto &frame = buffer_manager.fix_page(segment_id, tid.get_page_id(), true,
-										  nullptr, false);
+	auto &frame = fix_page(tid.get_page_id(), true);
 	auto &slotted_page = get_slotted_page(frame);
 	auto &slot = *(slotted_page.get_slots() + tid.get_slot_id());
 
-	// TODO: Allow redirects
+	// Moved records are written on their page
+	if (slot.is_redirect()) {
+		auto target = slot.get_redirect();
+		buffer_manager.unfix_page(frame, false);
+		return write_if_sized(target, record, record_size);
+	}
 
-	// Enough size allocated?
-	// TODO: Allow Resize
 	if (slot.get_size() != record_size) {
 		buffer_manager.unfix_page(frame, false);
-		throw std::logic_error(
-			"SPSegment::write(): Size of record to be written must be the size "
-			"allocated for the given tuple ID (TID).");
+		return false;
 	}
 
 	// Write
 	auto *data = slotted_page.get_data() + slot.get_offset();
 	std::memcpy(data, record, record_size);
+	track(tid);
 	buffer_manager.unfix_page(frame, true);
 
-	return record_size;
+	return true;
+}
+
+void SPSegment::resize(TID tid, uint32_t new_length) {
+	if (new_length > get_max_size())
+		throw std::logic_error("SPSegment::resize(): Cannot resize tuples "
+							   "bigger than the page.");
+
+	// Get Slot
+	auto &frame = fix_page(tid.get_page_id(), true);
+	auto &slotted_page = get_slotted_page(frame);
+	auto &slot = *(slotted_page.get_slots() + tid.get_slot_id());
+
+	// Resize the record where it is if it fits. Otherwise, take it out.
+	std::vector<std::byte> record;
+	if (slot.is_redirect()) {
+		auto target = slot.get_redirect();
+		auto &target_frame = fix_page(target.get_page_id(), true);
+		if (resize_on_page(target_frame, target, new_length)) {
+			buffer_manager.unfix_page(target_frame, true);
+			buffer_manager.unfix_page(frame, false);
+			return;
+		}
+		take_out(target_frame, target, new_length, record);
+		buffer_manager.unfix_page(target_frame, true);
+		slot.clear();
+	} else {
+		if (resize_on_page(frame, tid, new_length)) {
+			buffer_manager.unfix_page(frame, true);
+			return;
+		}
+		take_out(frame, tid, new_length, record);
+	}
+
+	// A moved record returns to its own page if it fits there again.
+	if (resize_on_page(frame, tid, new_length)) {
+		std::memcpy(slotted_page.get_data() + slot.get_offset(), record.data(),
+					record.size());
+		buffer_manager.unfix_page(frame, true);
+		return;
+	}
+
+	// Move it to another page. Its own page is not found, as it lacks space.
+	auto new_tid = allocate(new_length, true);
+	auto &new_frame = fix_page(new_tid.get_page_id(), true);
+	auto &new_page = get_slotted_page(new_frame);
+	std::memcpy(new_page.get_data() +
+					new_page.get_slots()[new_tid.get_slot_id()].get_offset(),
+				record.data(), record.size());
+	buffer_manager.unfix_page(new_frame, true);
+	++stats.records_moved;
+
+	// The slot redirects there. The TID stays the same.
+	slot.set_redirect(new_tid);
+	track(tid);
+	buffer_manager.unfix_page(frame, true);
+}
+
+bool SPSegment::resize_on_page(BufferFrame &frame, TID tid,
+							   uint32_t new_length) {
+	auto &slotted_page = get_slotted_page(frame);
+	auto size = slotted_page.get_slots()[tid.get_slot_id()].get_size();
+
+	// Growing beyond the free space compacts the page.
+	bool is_compacting =
+		new_length > size && slotted_page.get_free_space() < new_length;
+	if (!slotted_page.resize(tid.get_slot_id(), new_length,
+							 buffer_manager.page_size)) {
+		space_inventory.update(tid.get_page_id(),
+							   get_free_space(slotted_page));
+		return false;
+	}
+
+	if (is_compacting) {
+		if (record_deltas)
+			record_deltas->track_page(tid.get_page_id());
+		++stats.slotted_pages_compacted;
+	} else {
+		track(tid);
+	}
+	space_inventory.update(tid.get_page_id(), get_free_space(slotted_page));
+	return true;
+}
+
+void SPSegment::take_out(BufferFrame &frame, TID tid, uint32_t new_length,
+						 std::vector<std::byte> &record) {
+	auto &slotted_page = get_slotted_page(frame);
+	auto &slot = slotted_page.get_slots()[tid.get_slot_id()];
+	const auto *data = slotted_page.get_data() + slot.get_offset();
+	record.assign(data, data + std::min(slot.get_size(), new_length));
+	record.resize(new_length);
+	slotted_page.erase(tid.get_slot_id());
+	track(tid);
+}
+
+void SPSegment::erase(TID tid) {
+	// Get Slot
+	auto &frame = fix_page(tid.get_page_id(), true);
+	auto &slotted_page = get_slotted_page(frame);
+	if (tid.get_slot_id() >= slotted_page.header.slot_count) {
+		buffer_manager.unfix_page(frame, false);
+		throw std::logic_error("SPSegment::erase(): Slot ID not valid.");
+	}
+	auto &slot = *(slotted_page.get_slots() + tid.get_slot_id());
+
+	// Moved records are erased on their page as well
+	if (slot.is_redirect()) {
+		auto target = slot.get_redirect();
+		auto &target_frame = fix_page(target.get_page_id(), true);
+		auto &target_page = get_slotted_page(target_frame);
+		target_page.erase(target.get_slot_id());
+		track(target);
+		space_inventory.update(target.get_page_id(),
+							   get_free_space(target_page));
+		buffer_manager.unfix_page(target_frame, true);
+	}
+
+	// The record becomes a hole. The slot is reused.
+	slotted_page.erase(tid.get_slot_id());
+	track(tid);
+	space_inventory.update(tid.get_page_id(), get_free_space(slotted_page));
+	buffer_manager.unfix_page(frame, true);
+}
+
+void SPSegment::scan(
+	const std::function<void(std::span<const std::byte>)> &visit,
+	bool bypass_buffer) const {
+	auto num_pages = space_inventory.get_num_pages();
+	auto page_size = buffer_manager.page_size;
+
+	if (bypass_buffer) {
+		std::vector<char> pages(read_ahead * page_size);
+		for (PageID page_id = 0; page_id < num_pages; page_id += read_ahead) {
+			auto num_read = std::min<size_t>(read_ahead, num_pages - page_id);
+			buffer_manager.read_pages(segment_id, page_id, num_read,
+									  pages.data(), record_deltas);
+			for (size_t i = 0; i < num_read; ++i)
+				visit_records(*reinterpret_cast<const SlottedPage *>(
+								  pages.data() + i * page_size),
+							  visit);
+		}
+		return;
+	}
+
+	for (PageID page_id = 0; page_id < num_pages;) {
+		auto num_ahead = std::min<size_t>(read_ahead, num_pages - page_id);
+		auto end = page_id + buffer_manager.prefetch(segment_id, page_id,
+													 num_ahead, record_deltas);
+		for (; page_id < end; ++page_id) {
+			auto &frame = fix_page(page_id, false, AccessHint::SEQUENTIAL);
+			visit_records(get_slotted_page(frame), visit);
+			buffer_manager.unfix_page(frame, false);
+		}
+	}
+}
+
+void SPSegment::visit_records(
+	const SlottedPage &page,
+	const std::function<void(std::span<const std::byte>)> &visit) {
+	auto *slots = page.get_slots();
+	for (SlotID slot_id = 0; slot_id < page.header.slot_count; ++slot_id) {
+		auto &slot = slots[slot_id];
+		if (slot.is_empty() || slot.is_redirect())
+			continue;
+		visit({page.get_data() + slot.get_offset(), slot.get_size()});
+	}
+}
+
+BufferFrame &SPSegment::fix_page(PageID page_id, bool exclusive,
+								 AccessHint hint) const {
+	return buffer_manager.fix_page(segment_id, page_id, exclusive,
+								   record_deltas, false, hint);
 }
 
-void SPSegment::erase(TID /*tid*/) {
-	// TODO
-	throw std::logic_error("Database::erase(): Not implemented yet.");
+void SPSegment::track(TID tid) {
+	if (record_deltas)
+		record_deltas->track(tid.get_page_id(), tid.get_slot_id());
 }
 } // namespace bbbtree
\ No newline at end of file
@@ -1,12 +1,16 @@
 #include "bbbtree/slotted_page.h"
 
+#include <algorithm>
 #include <cstring>
+#include <functional>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace bbbtree {
 
 SlottedPage::Header::Header(uint32_t page_size)
-	: slot_count(0), data_start(page_size) {}
+	: slot_count(0), first_free_slot(0), data_start(page_size) {}
 
 SlottedPage::SlottedPage(uint32_t page_size) : header(page_size) {
 	// Set all bytes after the header to 0
@@ -14,32 +18,106 @@ SlottedPage::SlottedPage(uint32_t page_size) : header(page_size) {
 				page_size - sizeof(SlottedPage));
 }
 
-SlotID SlottedPage::allocate(uint32_t data_size) {
+size_t SlottedPage::get_compacted_free_space(uint32_t page_size) const {
+	size_t used = sizeof(SlottedPage) + header.slot_count * sizeof(Slot);
+	for (const auto *slot = get_slots(); slot < get_slots() + header.slot_count;
+		 ++slot)
+		used += slot->get_size();
+	return page_size - used;
+}
+
+SlotID SlottedPage::allocate(uint32_t data_size, bool is_moved) {
 	// Pre-requisite: Caller must ensure that there is enough space on this page
 	// to allocate, will throw otherwise
 
+	// Reuse the first erased slot. Otherwise, append a new one.
+	SlotID slot_id = header.first_free_slot;
+	while (slot_id < header.slot_count && !get_slots()[slot_id].is_empty())
+		++slot_id;
+
 	// Enough space?
-	auto total_size = data_size + sizeof(Slot);
+	auto total_size =
+		data_size + (slot_id == header.slot_count ? sizeof(Slot) : 0);
 	if (get_free_space() < total_size)
 		throw std::logic_error(
 			"SlottedPage::allocate(): not enough space on page to allocate");
 
-	// Get a free Slot
-	auto *slot = get_slots() + header.slot_count;
-	auto slot_id = header.slot_count;
-	slot->set_slot(header.data_start - data_size, data_size);
-
 	// Update Header accordingly
-	++header.slot_count;
+	if (slot_id == header.slot_count)
+		++header.slot_count;
+	header.first_free_slot = slot_id + 1;
 	header.data_start -= data_size;
 
+	get_slots()[slot_id].set_slot(header.data_start, data_size, is_moved);
+
 	return slot_id;
 }
 
+bool SlottedPage::resize(SlotID slot_id, uint32_t data_size,
+						 uint32_t page_size) {
+	if (header.slot_count <= slot_id)
+		throw std::logic_error("SlottedPage::resize(): Slot ID not valid");
+	auto &slot = get_slots()[slot_id];
+	assert(!slot.is_redirect());
+	auto size = slot.get_size();
+	auto offset = slot.get_offset();
+
+	// Shrink in place. The rest becomes a hole.
+	if (data_size <= size) {
+		slot.set_slot(offset, data_size, slot.is_moved());
+		return true;
+	}
+
+	// Move the record into the free space. Its old place becomes a hole.
+	if (get_free_space() >= data_size) {
+		std::memmove(get_data() + header.data_start - data_size,
+					 get_data() + offset, size);
+		header.data_start -= data_size;
+		slot.set_slot(header.data_start, data_size, slot.is_moved());
+		return true;
+	}
+
+	// Reclaim the holes, including the record's old place.
+	if (get_compacted_free_space(page_size) + size < data_size)
+		return false;
+	std::vector<std::byte> record(get_data() + offset,
+								  get_data() + offset + size);
+	bool is_moved = slot.is_moved();
+	slot.set_slot(0, 0);
+	compactify(page_size);
+	header.data_start -= data_size;
+	std::memcpy(get_data() + header.data_start, record.data(), size);
+	slot.set_slot(header.data_start, data_size, is_moved);
+	return true;
+}
+
+void SlottedPage::compactify(uint32_t page_size) {
+	// Move records in descending order of their offsets. None is overwritten
+	// before it is moved.
+	std::vector<std::pair<uint32_t, SlotID>> records;
+	for (SlotID slot_id = 0; slot_id < header.slot_count; ++slot_id) {
+		const auto &slot = get_slots()[slot_id];
+		if (slot.get_size() > 0)
+			records.emplace_back(slot.get_offset(), slot_id);
+	}
+	std::sort(records.begin(), records.end(), std::greater<>());
+
+	uint32_t data_start = page_size;
+	for (auto [offset, slot_id] : records) {
+		auto &slot = get_slots()[slot_id];
+		data_start -= slot.get_size();
+		std::memmove(get_data() + data_start, get_data() + offset,
+					 slot.get_size());
+		slot.set_slot(data_start, slot.get_size(), slot.is_moved());
+	}
+	header.data_start = data_start;
+}
+
 void SlottedPage::erase(uint16_t slot_id) {
 	if (header.slot_count <= slot_id)
 		throw std::logic_error("SlottedPage::erase(): Slot ID not valid");
 	auto *slot = get_slots() + slot_id;
 	slot->clear();
+	header.first_free_slot = std::min(header.first_free_slot, slot_id);
 }
 } // namespace bbbtree
\ No newline at end of file
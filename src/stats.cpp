@@ -8,16 +8,49 @@ Stats stats{};
 void Stats::clear() {
 	inner_node_splits = 0;
 	leaf_node_splits = 0;
+	append_splits = 0;
+	node_merges = 0;
 	bytes_written_logically = 0;
 	bytes_written_physically = 0;
 	pages_evicted = 0;
 	pages_written = 0;
 	btree_pages_write_deferred = 0;
+	delta_log_appends = 0;
+	delta_log_pages_cleaned = 0;
+	delta_groups_written = 0;
+	delta_cache_hits = 0;
+	delta_cache_misses = 0;
+	delta_cache_evictions = 0;
+	delta_filter_skips = 0;
+	delta_filter_false_positives = 0;
+	delta_merges = 0;
+	delta_loads_deferred = 0;
+	deferred_deltas_applied = 0;
+	record_pages_write_deferred = 0;
+	record_deltas_applied = 0;
+	records_moved = 0;
+	slotted_pages_compacted = 0;
+	checkpoints_written = 0;
+	checkpoint_pages_written = 0;
+	checkpoint_pages_deferred = 0;
+	deltas_dropped_on_recovery = 0;
+	log_records_appended = 0;
+	log_groups_written = 0;
+	log_bytes_written = 0;
+	log_records_replayed = 0;
+	journal_pages_written = 0;
+	journal_pages_rolled_back = 0;
+	wa_threshold_adaptions = 0;
 	b_tree_height = 0;
 	delta_tree_height = 0;
 	pages_created = 0;
+	pages_freed = 0;
+	pages_reused = 0;
 	slotted_pages_created = 0;
 	pages_loaded = 0;
+	pages_prefetched = 0;
+	pages_read_unbuffered = 0;
+	cold_pages_evicted = 0;
 	num_insertions_db = 0;
 	num_insertions_index = 0;
 	num_deletions_index = 0;
@@ -27,6 +60,7 @@ void Stats::clear() {
 	num_lookups_db = 0;
 	num_lookups_index = 0;
 	num_updates_index = 0;
+	num_upserts_index = 0;
 	num_deletions_db = 0;
 	max_bytes_changed = 0;
 	delta_pages_created = 0;
@@ -45,6 +79,8 @@ std::unordered_map<std::string, size_t> Stats::get_stats() const {
 	return {{"inner_node_splits", inner_node_splits},
 			{"leaf_node_splits", leaf_node_splits},
 			{"node_splits", inner_node_splits + leaf_node_splits},
+			{"append_splits", append_splits},
+			{"node_merges", node_merges},
 			{"bytes_written_logically", bytes_written_logically},
 			{"bytes_written_physically", bytes_written_physically},
 			{"write_amplification",
@@ -56,18 +92,50 @@ std::unordered_map<std::string, size_t> Stats::get_stats() const {
 			{"pages_written", pages_written},
 			{"total_page_io", pages_written + pages_loaded},
 			{"btree_pages_write_deferred", btree_pages_write_deferred},
+			{"delta_log_appends", delta_log_appends},
+			{"delta_log_pages_cleaned", delta_log_pages_cleaned},
+			{"delta_groups_written", delta_groups_written},
+			{"delta_cache_hits", delta_cache_hits},
+			{"delta_cache_misses", delta_cache_misses},
+			{"delta_cache_evictions", delta_cache_evictions},
+			{"delta_filter_skips", delta_filter_skips},
+			{"delta_filter_false_positives", delta_filter_false_positives},
+			{"delta_merges", delta_merges},
+			{"delta_loads_deferred", delta_loads_deferred},
+			{"deferred_deltas_applied", deferred_deltas_applied},
+			{"record_pages_write_deferred", record_pages_write_deferred},
+			{"record_deltas_applied", record_deltas_applied},
+			{"records_moved", records_moved},
+			{"slotted_pages_compacted", slotted_pages_compacted},
+			{"checkpoints_written", checkpoints_written},
+			{"checkpoint_pages_written", checkpoint_pages_written},
+			{"checkpoint_pages_deferred", checkpoint_pages_deferred},
+			{"deltas_dropped_on_recovery", deltas_dropped_on_recovery},
+			{"log_records_appended", log_records_appended},
+			{"log_groups_written", log_groups_written},
+			{"log_bytes_written", log_bytes_written},
+			{"log_records_replayed", log_records_replayed},
+			{"journal_pages_written", journal_pages_written},
+			{"journal_pages_rolled_back", journal_pages_rolled_back},
 			{"b_tree_height", b_tree_height},
 			{"delta_tree_height", delta_tree_height},
 			{"pages_created", pages_created},
+			{"pages_freed", pages_freed},
+			{"pages_reused", pages_reused},
 			{"slotted_pages_created", slotted_pages_created},
 			{"pages_loaded", pages_loaded},
+			{"pages_prefetched", pages_prefetched},
+			{"pages_read_unbuffered", pages_read_unbuffered},
+			{"cold_pages_evicted", cold_pages_evicted},
 			{"wa_threshold", wa_threshold * 100},
+			{"wa_threshold_adaptions", wa_threshold_adaptions},
 			{"max_bytes_changed", max_bytes_changed},
 			{"page_size", page_size},
 			{"num_pages", num_pages},
 			{"num_insertions_db", num_insertions_db},
 			{"num_insertions_index", num_insertions_index},
 			{"num_deletions_index", num_deletions_index},
+			{"num_upserts_index", num_upserts_index},
 			{"buffer_accesses", buffer_hits + buffer_misses},
 			{"buffer_hits", std::round(static_cast<double>(buffer_hits) /
 									   (buffer_hits + buffer_misses) * 100)},
@@ -2,6 +2,16 @@
 
 namespace bbbtree {
 
+uint64_t get_checksum(const void *data, size_t size) {
+	const auto *bytes = static_cast<const uint8_t *>(data);
+	uint64_t checksum = 0xcbf29ce484222325;
+	for (size_t i = 0; i < size; ++i) {
+		checksum ^= bytes[i];
+		checksum *= 0x100000001b3;
+	}
+	return checksum;
+}
+
 std::ostream &operator<<(std::ostream &os, const UInt64 &type) {
 	os << type.value;
 	return os;
@@ -0,0 +1,193 @@
+#include "bbbtree/wal.h"
+#include "bbbtree/stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace bbbtree {
+// -----------------------------------------------------------------
+WriteAheadLog::WriteAheadLog(SegmentID segment_id, bool reset)
+	: file(File::open_file(std::to_string(segment_id).c_str(),
+						   File::Mode::WRITE)) {
+	if (reset)
+		file->resize(0);
+	file_end = file->size();
+	flusher = std::thread(&WriteAheadLog::run_flusher, this);
+}
+// -----------------------------------------------------------------
+WriteAheadLog::~WriteAheadLog() {
+	{
+		std::unique_lock lock(mutex);
+		is_stopped = true;
+	}
+	flusher_wakeup.notify_one();
+	// The flusher writes the remaining records before it stops.
+	flusher.join();
+	update_stats();
+}
+// -----------------------------------------------------------------
+LSN WriteAheadLog::append(LogRecordType type,
+						  std::span<const std::byte> payload) {
+	std::unique_lock lock(mutex);
+
+	// Padding is part of the checksum.
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	header.lsn = last_lsn + 1;
+	header.payload_size = payload.size();
+	header.type = type;
+
+	auto pos = buffer.size();
+	auto size = sizeof(Header) + payload.size();
+	buffer.resize(pos + size);
+	std::memcpy(buffer.data() + pos, &header, sizeof(header));
+	std::memcpy(buffer.data() + pos + sizeof(header), payload.data(),
+				payload.size());
+	header.checksum = get_checksum(buffer.data() + pos, size);
+	std::memcpy(buffer.data() + pos, &header.checksum, sizeof(header.checksum));
+
+	last_lsn = header.lsn;
+	++stats.log_records_appended;
+	update_stats();
+
+	if (buffer.size() >= group_size)
+		flusher_wakeup.notify_one();
+
+	return header.lsn;
+}
+// -----------------------------------------------------------------
+void WriteAheadLog::flush(LSN lsn) {
+	if (flushed_lsn >= lsn)
+		return;
+
+	std::unique_lock lock(mutex);
+	is_flush_requested = true;
+	flusher_wakeup.notify_one();
+	group_written.wait(lock, [&] { return flushed_lsn >= lsn; });
+	update_stats();
+}
+// -----------------------------------------------------------------
+void WriteAheadLog::discard() {
+	std::unique_lock lock(mutex);
+	group_written.wait(lock, [&] { return !is_writing; });
+	buffer.clear();
+	last_lsn = flushed_lsn.load();
+}
+// -----------------------------------------------------------------
+size_t WriteAheadLog::replay(
+	LSN lsn,
+	const std::function<void(LogRecordType, std::span<const std::byte>)>
+		&redo) {
+	std::vector<std::byte> bytes;
+	std::vector<std::pair<LogRecordType, std::span<const std::byte>>> records;
+	{
+		std::unique_lock lock(mutex);
+		group_written.wait(lock, [&] { return !is_writing; });
+		assert(buffer.empty());
+
+		auto size = file->size();
+		bytes.resize(size);
+		if (size > 0)
+			file->read_block(0, size, reinterpret_cast<char *>(bytes.data()));
+
+		// Valid records follow each other with increasing LSNs.
+		size_t offset = 0;
+		LSN previous = 0;
+		while (offset + sizeof(Header) <= size) {
+			Header header;
+			std::memcpy(&header, bytes.data() + offset, sizeof(header));
+			auto end = offset + sizeof(Header) + header.payload_size;
+			if (end > size || header.lsn <= previous)
+				break;
+			auto checksum = header.checksum;
+			std::memset(bytes.data() + offset, 0, sizeof(header.checksum));
+			if (get_checksum(bytes.data() + offset, end - offset) != checksum)
+				break;
+
+			if (header.lsn > lsn)
+				records.emplace_back(
+					header.type,
+					std::span(bytes.data() + offset + sizeof(Header),
+							  header.payload_size));
+			previous = header.lsn;
+			offset = end;
+		}
+
+		// Cut off a torn tail.
+		if (offset < size)
+			file->resize(offset);
+		file_end = offset;
+		last_lsn = std::max(lsn, previous);
+		flushed_lsn = last_lsn.load();
+	}
+
+	// Redoing may write out pages, which flushes the log.
+	for (const auto &[type, payload] : records)
+		redo(type, payload);
+	stats.log_records_replayed += records.size();
+
+	return records.size();
+}
+// -----------------------------------------------------------------
+void WriteAheadLog::truncate() {
+	std::unique_lock lock(mutex);
+	group_written.wait(lock, [&] { return !is_writing; });
+	// Buffered records are reflected by the checkpoint as well.
+	buffer.clear();
+	flushed_lsn = last_lsn.load();
+	file->resize(0);
+	file_end = 0;
+}
+// -----------------------------------------------------------------
+void WriteAheadLog::run_flusher() {
+	std::unique_lock lock(mutex);
+	while (true) {
+		flusher_wakeup.wait_for(lock, flush_interval, [&] {
+			return is_stopped || is_flush_requested ||
+				   buffer.size() >= group_size;
+		});
+		is_flush_requested = false;
+		if (!buffer.empty())
+			write_group(lock);
+		if (is_stopped && buffer.empty())
+			break;
+	}
+}
+// -----------------------------------------------------------------
+void WriteAheadLog::write_group(std::unique_lock<std::mutex> &lock) {
+	// Appends hold the lock. The group holds all records up to the last LSN.
+	group.swap(buffer);
+	buffer.clear();
+	LSN lsn = last_lsn;
+	auto offset = file_end;
+	is_writing = true;
+
+	lock.unlock();
+	file->resize(offset + group.size());
+	file->write_block(reinterpret_cast<const char *>(group.data()), offset,
+					  group.size());
+	// The records count as flushed only once they are on stable storage.
+	file->sync();
+	lock.lock();
+
+	is_writing = false;
+	file_end = offset + group.size();
+	++num_groups_written;
+	num_bytes_written += group.size();
+	group.clear();
+	flushed_lsn = lsn;
+	group_written.notify_all();
+}
+// -----------------------------------------------------------------
+void WriteAheadLog::update_stats() {
+	stats.log_groups_written += num_groups_written - num_groups_counted;
+	stats.log_bytes_written += num_bytes_written - num_bytes_counted;
+	stats.bytes_written_physically += num_bytes_written - num_bytes_counted;
+	num_groups_counted = num_groups_written;
+	num_bytes_counted = num_bytes_written;
+}
+// -----------------------------------------------------------------
+} // namespace bbbtree
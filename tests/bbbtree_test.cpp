@@ -1,13 +1,18 @@
 #include "bbbtree/bbbtree.h"
 #include "bbbtree/btree.h"
 #include "bbbtree/buffer_manager.h"
+#include "bbbtree/delta_log.h"
 #include "bbbtree/logger.h"
 #include "bbbtree/stats.h"
 #include "bbbtree/types.h"
 
 #include <cstdint>
 #include <gtest/gtest.h>
+#include <limits>
+#include <map>
 #include <memory>
+#include <numeric>
+#include <optional>
 #include <random>
 
 using namespace bbbtree;
@@ -17,6 +22,8 @@ namespace {
 using BBBTreeInt = BBBTree<UInt64, TID>;
 using BTreeInt = BTree<UInt64, TID, true>;
 using DeltaTreeInt = DeltaTree<UInt64, TID>;
+using DeltaLogInt = DeltaLog<UInt64, TID>;
+using BBBTreeLogInt = BBBTree<UInt64, TID, false, DeltaLogInt>;
 // -----------------------------------------------------------------
 static const constexpr SegmentID TEST_SEGMENT_ID = 834;
 static const constexpr size_t TEST_PAGE_SIZE = 128;
@@ -208,6 +215,19 @@ TEST_F(BBBTreeTest, DeltaTree) {
 	// After applying deltas, the page's state is still clean.
 }
 // -----------------------------------------------------------------
+/// The meta-data and root pages of a new delta tree are delta tree pages.
+TEST_F(BBBTreeTest, DeltaTreeTracksItsOwnPages) {
+	stats.clear();
+	BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	DeltaTreeInt delta_tree(TEST_SEGMENT_ID, buffer_manager, TEST_WA_THRESHOLD);
+	EXPECT_EQ(stats.delta_pages_missed, 2);
+	EXPECT_EQ(stats.btree_pages_missed, 0);
+
+	buffer_manager.clear_all();
+	EXPECT_EQ(stats.delta_pages_written, 2);
+	EXPECT_EQ(stats.btree_pages_written, 0);
+}
+// -----------------------------------------------------------------
 /// When a leaf of the BBBTree is evicted, its deltas are stored in the delta
 /// tree and not on disk.
 /// TODO: Later only when write amplification was high.
@@ -267,6 +287,665 @@ TEST_F(BBBTreeTest, BufferLeafDeltasInDeltaTree) {
 	bbbtree_int.reset();
 }
 // -----------------------------------------------------------------
+/// Erases are buffered as tombstones and replayed on load.
+TEST_F(BBBTreeTest, BufferDeletesInDeltaTree) {
+	stats.clear();
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeInt> bbbtree_int = std::make_unique<BBBTreeInt>(
+		TEST_SEGMENT_ID, *buffer_manager, TEST_WA_THRESHOLD);
+
+	for (uint64_t i = 1; i <= 3; ++i)
+		EXPECT_TRUE(bbbtree_int->insert(i, i));
+	buffer_manager->clear_all();
+
+	// Erase an entry on disk. The node is not written out.
+	auto write_deferred_before = stats.btree_pages_write_deferred;
+	bbbtree_int->erase(2, TEST_PAGE_SIZE);
+	EXPECT_FALSE(bbbtree_int->lookup(2).has_value());
+	EXPECT_EQ(bbbtree_int->size(), 2);
+	buffer_manager->clear_all();
+	EXPECT_GT(stats.btree_pages_write_deferred, write_deferred_before);
+
+	{
+		// The erased entry is still on disk.
+		TestPageLogic<false> non_applying_page_logic;
+		BTreeInt btree_int{TEST_SEGMENT_ID, *buffer_manager,
+						   &non_applying_page_logic};
+		EXPECT_EQ(btree_int.lookup(2), 2);
+		buffer_manager->clear_all();
+	}
+
+	// Loading the node replays the delete.
+	EXPECT_FALSE(bbbtree_int->lookup(2).has_value());
+	EXPECT_EQ(bbbtree_int->lookup(1), 1);
+	EXPECT_EQ(bbbtree_int->lookup(3), 3);
+	EXPECT_EQ(bbbtree_int->size(), 2);
+
+	// Re-inserting the key revives it.
+	EXPECT_TRUE(bbbtree_int->insert(2, 20));
+	EXPECT_FALSE(bbbtree_int->insert(2, 21));
+	buffer_manager->clear_all();
+	EXPECT_EQ(bbbtree_int->lookup(2), 20);
+	EXPECT_EQ(bbbtree_int->size(), 3);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+/// Interleaved inserts, updates and erases survive evictions.
+template <typename IndexT, typename... Args>
+static void RunMixedOperations(Args... args) {
+	static const constexpr float wa_threshold = 0.2;
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<IndexT> bbbtree_int = std::make_unique<IndexT>(
+		TEST_SEGMENT_ID, *buffer_manager, wa_threshold, args...);
+
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<uint64_t> key_dist(0, 999);
+	std::uniform_int_distribution<uint8_t> op_dist(0, 2);
+	std::map<uint64_t, uint64_t> expected;
+	for (uint64_t i = 0; i < 10'000; ++i) {
+		auto key = key_dist(gen);
+		auto found = expected.find(key);
+		switch (op_dist(gen)) {
+		case 0:
+			EXPECT_EQ(bbbtree_int->insert(key, i), found == expected.end());
+			expected.try_emplace(key, i);
+			break;
+		case 1:
+			if (found == expected.end())
+				break;
+			bbbtree_int->update(key, i);
+			found->second = i;
+			break;
+		case 2:
+			bbbtree_int->erase(key, TEST_PAGE_SIZE);
+			expected.erase(key);
+			break;
+		}
+		if (i % 1'000 == 0)
+			buffer_manager->clear_all();
+	}
+	buffer_manager->clear_all();
+
+	EXPECT_EQ(bbbtree_int->size(), expected.size());
+	for (uint64_t key = 0; key < 1'000; ++key) {
+		auto found = expected.find(key);
+		if (found == expected.end())
+			EXPECT_FALSE(bbbtree_int->lookup(key).has_value());
+		else
+			EXPECT_EQ(bbbtree_int->lookup(key), found->second);
+	}
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+/// A BBBTree that applies the deltas of loaded leaves lazily.
+class LazyBBBTreeInt : public BBBTreeInt {
+  public:
+	LazyBBBTreeInt(SegmentID segment_id, BufferManager &buffer_manager,
+				   float wa_threshold)
+		: BBBTreeInt(segment_id, buffer_manager, wa_threshold) {
+		enable_lazy_apply();
+	}
+};
+// -----------------------------------------------------------------
+/// A BBBTree whose delta log packs the deltas of many nodes into one page.
+class GroupedBBBTreeLogInt : public BBBTreeLogInt {
+  public:
+	GroupedBBBTreeLogInt(SegmentID segment_id, BufferManager &buffer_manager,
+						 float wa_threshold)
+		: BBBTreeLogInt(segment_id, buffer_manager, wa_threshold) {
+		enable_delta_grouping();
+	}
+	DeltaLogInt *get_delta_log() { return &(this->delta_store); }
+};
+// -----------------------------------------------------------------
+TEST_F(BBBTreeTest, MixedOperations) { RunMixedOperations<BBBTreeInt>(); }
+// -----------------------------------------------------------------
+TEST_F(BBBTreeTest, ZZSweep) {
+	unsigned seed = std::atoi(std::getenv("SEED_FIRST"));
+	unsigned check_every = std::atoi(std::getenv("CHECK_EVERY"));
+	std::srand(seed);
+	static const constexpr float wa_threshold = 0.2;
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeInt> bbbtree_int = std::make_unique<BBBTreeInt>(
+		TEST_SEGMENT_ID, *buffer_manager, wa_threshold);
+
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<uint64_t> key_dist(0, 999);
+	std::uniform_int_distribution<uint8_t> op_dist(0, 2);
+	std::map<uint64_t, uint64_t> expected;
+	for (uint64_t i = 0; i < 10'000; ++i) {
+		auto key = key_dist(gen);
+		auto found = expected.find(key);
+		auto op = op_dist(gen);
+		if (std::getenv("TRACE") && i >= (uint64_t)std::atoi(std::getenv("TRACE")))
+			std::cout << "op " << i << " " << (int)op << " key " << key << " in " << (found != expected.end()) << std::endl;
+		switch (op) {
+		case 0:
+			EXPECT_EQ(bbbtree_int->insert(key, i), found == expected.end());
+			expected.try_emplace(key, i);
+			break;
+		case 1:
+			if (found == expected.end())
+				break;
+			bbbtree_int->update(key, i);
+			found->second = i;
+			break;
+		case 2:
+			bbbtree_int->erase(key, TEST_PAGE_SIZE);
+			expected.erase(key);
+			break;
+		}
+		if (i % 1'000 == 0)
+			buffer_manager->clear_all();
+		if (check_every && i % check_every == 0) {
+			for (uint64_t k = 0; k < 1'000; ++k) {
+				auto f = expected.find(k);
+				auto l = bbbtree_int->lookup(k);
+				bool ok = f == expected.end() ? !l.has_value() : (l.has_value() && *l == f->second);
+				if (!ok) {
+					std::cout << "MISMATCH after op " << i << " key " << k << std::endl;
+					FAIL();
+				}
+			}
+		}
+	}
+}
+TEST_F(BBBTreeTest, MixedOperationsWithLazyDeltas) {
+	stats.clear();
+	RunMixedOperations<LazyBBBTreeInt>();
+	EXPECT_GT(stats.delta_loads_deferred, 0);
+}
+// -----------------------------------------------------------------
+/// Lookups read the pending deltas of loaded leaves. They are applied only
+/// once the leaf is modified.
+TEST_F(BBBTreeTest, LazyDeltaApplication) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<LazyBBBTreeInt> bbbtree_int =
+		std::make_unique<LazyBBBTreeInt>(TEST_SEGMENT_ID, *buffer_manager,
+										 wa_threshold);
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+
+	// Defer an update and an erase on every leaf.
+	stats.clear();
+	for (uint64_t key = 0; key < num_keys; key += 5) {
+		bbbtree_int->update(key, key + 1);
+		bbbtree_int->erase(key + 1, TEST_PAGE_SIZE);
+	}
+	buffer_manager->clear_all();
+	EXPECT_GT(stats.btree_pages_write_deferred, 0);
+
+	auto expected = [](uint64_t key) -> std::optional<TID> {
+		if (key % 5 == 1)
+			return std::nullopt;
+		return key % 5 ? key : key + 1;
+	};
+
+	// Lookups leave the deltas pending.
+	stats.clear();
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), expected(key));
+	EXPECT_GT(stats.delta_loads_deferred, 0);
+	EXPECT_EQ(stats.deferred_deltas_applied, 0);
+
+	// Modifying the leaves applies them first.
+	for (uint64_t key = 0; key < num_keys; key += 5)
+		bbbtree_int->update(key + 2, key + 3);
+	EXPECT_GT(stats.deferred_deltas_applied, 0);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key),
+				  key % 5 == 2 ? std::optional<TID>(key + 1) : expected(key));
+	EXPECT_EQ(bbbtree_int->size(), num_keys - num_keys / 5);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+TEST_F(BBBTreeTest, MixedOperationsInDeltaLog) {
+	stats.clear();
+	RunMixedOperations<BBBTreeLogInt>();
+	EXPECT_GT(stats.delta_log_appends, 0);
+}
+// -----------------------------------------------------------------
+TEST_F(BBBTreeTest, MixedOperationsInGroupedDeltaLog) {
+	stats.clear();
+	RunMixedOperations<GroupedBBBTreeLogInt>();
+	EXPECT_GT(stats.delta_groups_written, 0);
+}
+// -----------------------------------------------------------------
+/// Values that grow and shrink survive evictions. Replaying the deltas frees
+/// space before inserts and growing updates take it.
+TEST_F(BBBTreeTest, MixedOperationsWithVariableSizeValues) {
+	using BBBTreeString = BBBTree<String, String>;
+	static const constexpr size_t page_size = 1024;
+	for (unsigned seed : {1, 2, 3}) {
+		auto buffer_manager =
+			std::make_unique<BufferManager>(page_size, 10, true);
+		auto tree = std::make_unique<BBBTreeString>(TEST_SEGMENT_ID,
+													*buffer_manager, 0.3);
+
+		std::mt19937 gen(seed);
+		std::uniform_int_distribution<int> key_dist(0, 499);
+		std::uniform_int_distribution<size_t> size_dist(1, 100);
+		std::uniform_int_distribution<uint8_t> op_dist(0, 3);
+		std::map<std::string, std::string> expected;
+		for (size_t i = 0; i < 20'000; ++i) {
+			auto key = "key" + std::to_string(key_dist(gen));
+			auto value = std::string(size_dist(gen), 'a' + i % 26);
+			auto found = expected.find(key);
+			switch (op_dist(gen)) {
+			case 0:
+				EXPECT_EQ(tree->insert(String(key), String(value)),
+						  found == expected.end());
+				expected.try_emplace(key, value);
+				break;
+			case 1:
+				tree->upsert(String(key), String(value));
+				expected[key] = value;
+				break;
+			case 2:
+				tree->erase(String(key), page_size);
+				expected.erase(key);
+				break;
+			case 3:
+				if (found == expected.end())
+					EXPECT_FALSE(tree->lookup(String(key)).has_value());
+				else
+					EXPECT_EQ(tree->lookup(String(key)), String(found->second));
+				break;
+			}
+		}
+		buffer_manager->clear_all();
+
+		EXPECT_EQ(tree->size(), expected.size());
+		for (const auto &[key, value] : expected)
+			EXPECT_EQ(tree->lookup(String(key)), String(value));
+
+		buffer_manager.reset();
+		tree.reset();
+	}
+}
+// -----------------------------------------------------------------
+TEST_F(BBBTreeTest, MixedOperationsWithDeltaCache) {
+	stats.clear();
+	RunMixedOperations<BBBTreeInt>(size_t{2});
+	EXPECT_GT(stats.delta_cache_hits, 0);
+	EXPECT_GT(stats.delta_cache_evictions, 0);
+}
+// -----------------------------------------------------------------
+/// Deltas of nodes bouncing in and out of the buffer stay in the delta cache
+/// and never reach the delta tree.
+TEST_F(BBBTreeTest, DeltaCacheAbsorbsDeltaTreeTraffic) {
+	class BBBTreeCacheTest : public BBBTreeInt {
+	  public:
+		using BBBTreeInt::BBBTreeInt;
+		DeltaTreeInt *get_delta_tree() { return &(this->delta_store); }
+	};
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	static const constexpr size_t cache_pages = 10;
+	stats.clear();
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeCacheTest> bbbtree_int =
+		std::make_unique<BBBTreeCacheTest>(TEST_SEGMENT_ID, *buffer_manager,
+										   wa_threshold, cache_pages);
+	auto *delta_tree = bbbtree_int->get_delta_tree();
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+
+	// Update a few leaves repeatedly. Their deltas fit into the cache.
+	for (uint64_t round = 1; round <= 10; ++round) {
+		for (uint64_t key = 0; key < 40; key += 10)
+			bbbtree_int->update(key, key + round);
+		buffer_manager->clear_all();
+	}
+	EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	EXPECT_GT(delta_tree->get_cache().size(), 0);
+	EXPECT_LE(delta_tree->get_cache().get_num_bytes(),
+			  cache_pages * TEST_PAGE_SIZE);
+	EXPECT_EQ(stats.delta_cache_evictions, 0);
+	EXPECT_TRUE(delta_tree->empty());
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key),
+				  key < 40 && key % 10 == 0 ? key + 10 : key);
+	EXPECT_GT(stats.delta_cache_hits, 0);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+/// Deltas that are only cached are stored when the tree is destroyed.
+TEST_F(BBBTreeTest, DeltaCacheIsStoredOnDestruction) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	static const constexpr size_t cache_pages = 10;
+	{
+		BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+		BBBTreeInt bbbtree_int(TEST_SEGMENT_ID, buffer_manager, wa_threshold,
+							   cache_pages);
+		for (uint64_t key = 0; key < num_keys; ++key)
+			EXPECT_TRUE(bbbtree_int.insert(key, key));
+		buffer_manager.clear_all();
+		stats.clear();
+		for (uint64_t key = 0; key < 40; key += 10)
+			bbbtree_int.update(key, key + 1);
+		buffer_manager.clear_all();
+		EXPECT_GT(stats.btree_pages_write_deferred, 0);
+		EXPECT_EQ(stats.delta_cache_evictions, 0);
+	}
+
+	BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, false);
+	BBBTreeInt bbbtree_int(TEST_SEGMENT_ID, buffer_manager, wa_threshold,
+						   cache_pages);
+	EXPECT_EQ(bbbtree_int.size(), num_keys);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int.lookup(key),
+				  key < 40 && key % 10 == 0 ? key + 1 : key);
+}
+// -----------------------------------------------------------------
+/// Deltas in the delta log are written back into their nodes when the tree is
+/// destroyed.
+TEST_F(BBBTreeTest, DeltaLogIsWrittenBackOnDestruction) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	{
+		BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+		BBBTreeLogInt bbbtree_int(TEST_SEGMENT_ID, buffer_manager,
+								  wa_threshold);
+		for (uint64_t key = 0; key < num_keys; ++key)
+			EXPECT_TRUE(bbbtree_int.insert(key, key));
+		buffer_manager.clear_all();
+		stats.clear();
+		for (uint64_t key = 0; key < num_keys; key += 10)
+			bbbtree_int.update(key, key + 1);
+		buffer_manager.clear_all();
+		EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	}
+
+	BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, false);
+	BBBTreeLogInt bbbtree_int(TEST_SEGMENT_ID, buffer_manager, wa_threshold);
+	EXPECT_EQ(bbbtree_int.size(), num_keys);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int.lookup(key), key % 10 ? key : key + 1);
+}
+// -----------------------------------------------------------------
+/// Deltas that are only cached are stored when the buffer manager is
+/// destroyed before the tree.
+TEST_F(BBBTreeTest, DeltaCacheIsStoredWhenBufferIsDestroyedFirst) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	static const constexpr size_t cache_pages = 10;
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeInt> bbbtree_int = std::make_unique<BBBTreeInt>(
+		TEST_SEGMENT_ID, *buffer_manager, wa_threshold, cache_pages);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+	for (uint64_t key = 0; key < 40; key += 10)
+		bbbtree_int->update(key, key + 1);
+	buffer_manager->clear_all();
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+
+	BufferManager reopened_buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES,
+										  false);
+	BBBTreeInt reopened(TEST_SEGMENT_ID, reopened_buffer_manager, wa_threshold,
+						cache_pages);
+	EXPECT_EQ(reopened.size(), num_keys);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(reopened.lookup(key),
+				  key < 40 && key % 10 == 0 ? key + 1 : key);
+}
+// -----------------------------------------------------------------
+/// Destroying a tree writes back its own pages only. The pages of other trees
+/// sharing the buffer stay buffered.
+TEST_F(BBBTreeTest, DestructionKeepsOtherTreesBuffered) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 20;
+	static const constexpr SegmentID other_segment_id = TEST_SEGMENT_ID + 2;
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeInt> bbbtree_int = std::make_unique<BBBTreeInt>(
+		TEST_SEGMENT_ID, *buffer_manager, wa_threshold);
+	std::unique_ptr<BBBTreeInt> other = std::make_unique<BBBTreeInt>(
+		other_segment_id, *buffer_manager, wa_threshold);
+	for (uint64_t key = 0; key < num_keys; ++key) {
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+		EXPECT_TRUE(other->insert(key, key));
+	}
+
+	auto other_page_io = buffer_manager->get_page_io(other_segment_id) +
+						 buffer_manager->get_page_io(other_segment_id + 1);
+	bbbtree_int.reset();
+	EXPECT_EQ(buffer_manager->get_page_io(other_segment_id) +
+				  buffer_manager->get_page_io(other_segment_id + 1),
+			  other_page_io);
+	EXPECT_GT(buffer_manager->get_page_io(TEST_SEGMENT_ID), 0);
+
+	// The destroyed tree can be opened again.
+	bbbtree_int = std::make_unique<BBBTreeInt>(TEST_SEGMENT_ID,
+											   *buffer_manager, wa_threshold);
+	EXPECT_EQ(bbbtree_int->size(), num_keys);
+	EXPECT_EQ(other->size(), num_keys);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+	other.reset();
+}
+// -----------------------------------------------------------------
+/// Loading nodes without deltas does not touch the delta tree.
+TEST_F(BBBTreeTest, PidFilterSkipsDeltaTreeLookups) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeInt> bbbtree_int = std::make_unique<BBBTreeInt>(
+		TEST_SEGMENT_ID, *buffer_manager, wa_threshold);
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+
+	stats.clear();
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), key);
+	EXPECT_GT(stats.delta_filter_skips, 0);
+	EXPECT_EQ(stats.delta_pages_hit + stats.delta_pages_missed, 0);
+	buffer_manager->clear_all();
+
+	// Only the updated leaf looks up its deltas.
+	bbbtree_int->update(0, 1);
+	buffer_manager->clear_all();
+	EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	stats.clear();
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), key ? key : 1);
+	EXPECT_GT(stats.delta_filter_skips, 0);
+	EXPECT_GT(stats.delta_pages_hit + stats.delta_pages_missed, 0);
+	EXPECT_EQ(stats.delta_filter_false_positives, 0);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+/// Deltas buffered in the delta tree are applied after the tree was opened
+/// again without recovering it.
+TEST_F(BBBTreeTest, ReopenedTreeAppliesStoredDeltas) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	{
+		BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+		BBBTreeInt bbbtree_int(TEST_SEGMENT_ID, buffer_manager, wa_threshold);
+		for (uint64_t key = 0; key < num_keys; ++key)
+			EXPECT_TRUE(bbbtree_int.insert(key, key));
+		buffer_manager.clear_all();
+		stats.clear();
+		for (uint64_t key = 0; key < num_keys; key += 10)
+			bbbtree_int.update(key, key + 1);
+		buffer_manager.clear_all();
+		EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	}
+
+	BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, false);
+	BBBTreeInt bbbtree_int(TEST_SEGMENT_ID, buffer_manager, wa_threshold);
+	EXPECT_EQ(bbbtree_int.size(), num_keys);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int.lookup(key), key % 10 ? key : key + 1);
+}
+// -----------------------------------------------------------------
+/// An adaptive threshold moves in steps within its bounds and is reported.
+TEST_F(BBBTreeTest, AdaptiveWriteAmplificationThreshold) {
+	static const constexpr float wa_threshold = 0.2;
+	static const constexpr size_t num_keys = 1'000;
+	stats.clear();
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeInt> bbbtree_int = std::make_unique<BBBTreeInt>(
+		TEST_SEGMENT_ID, *buffer_manager, wa_threshold);
+	bbbtree_int->enable_adaptive_threshold();
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<uint64_t> key_dist(0, num_keys - 1);
+	std::vector<uint64_t> expected(num_keys);
+	std::iota(expected.begin(), expected.end(), 0);
+	for (uint64_t i = 0; i < 20'000; ++i) {
+		auto key = key_dist(gen);
+		bbbtree_int->update(key, i);
+		expected[key] = i;
+	}
+	buffer_manager->clear_all();
+
+	EXPECT_GT(stats.wa_threshold_adaptions, 0);
+	EXPECT_EQ(stats.wa_threshold, bbbtree_int->get_wa_threshold());
+	EXPECT_GE(bbbtree_int->get_wa_threshold(), 0.0);
+	EXPECT_LE(bbbtree_int->get_wa_threshold(), 1.0);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), expected[key]);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+/// Merging folds the deltas back into their nodes within an I/O budget.
+TEST_F(BBBTreeTest, MergeDeltasIntoNodes) {
+	class BBBTreeMergeTest : public BBBTreeInt {
+	  public:
+		using BBBTreeInt::BBBTreeInt;
+		DeltaTreeInt *get_delta_tree() { return &(this->delta_store); }
+	};
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	stats.clear();
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeMergeTest> bbbtree_int =
+		std::make_unique<BBBTreeMergeTest>(TEST_SEGMENT_ID, *buffer_manager,
+										   wa_threshold);
+	auto *delta_tree = bbbtree_int->get_delta_tree();
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+
+	// Defer a small update on every leaf.
+	for (uint64_t key = 0; key < num_keys; key += 5)
+		bbbtree_int->update(key, key + 1);
+	buffer_manager->clear_all();
+	EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	EXPECT_FALSE(delta_tree->empty());
+
+	// A small budget merges some nodes only.
+	auto num_merged = bbbtree_int->merge_deltas(2);
+	EXPECT_GT(num_merged, 0);
+	EXPECT_EQ(stats.delta_merges, num_merged);
+	EXPECT_FALSE(delta_tree->empty());
+
+	// A large budget merges all of them.
+	bbbtree_int->merge_deltas(std::numeric_limits<size_t>::max());
+	EXPECT_TRUE(delta_tree->empty());
+	buffer_manager->clear_all();
+
+	{
+		// The merged values are on disk.
+		TestPageLogic<false> non_applying_page_logic;
+		BTreeInt btree_int{TEST_SEGMENT_ID, *buffer_manager,
+						   &non_applying_page_logic};
+		for (uint64_t key = 0; key < num_keys; ++key)
+			EXPECT_EQ(btree_int.lookup(key), key % 5 ? key : key + 1);
+		buffer_manager->clear_all();
+	}
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), key % 5 ? key : key + 1);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+/// Superseded records in the delta log are collected and their pages re-used.
+TEST_F(BBBTreeTest, DeltaLogCollectsGarbage) {
+	class BBBTreeLogTest : public BBBTreeLogInt {
+	  public:
+		using BBBTreeLogInt::BBBTreeLogInt;
+		DeltaLogInt *get_delta_log() { return &(this->delta_store); }
+	};
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	stats.clear();
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeLogTest> bbbtree_int =
+		std::make_unique<BBBTreeLogTest>(TEST_SEGMENT_ID, *buffer_manager,
+										 wa_threshold);
+	auto *delta_log = bbbtree_int->get_delta_log();
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+	EXPECT_EQ(delta_log->get_live_bytes(), 0);
+
+	// Each round defers a small update per leaf. Earlier records are garbage.
+	for (uint64_t round = 1; round <= 50; ++round) {
+		for (uint64_t key = 0; key < num_keys; key += 10)
+			bbbtree_int->update(key, key + round);
+		buffer_manager->clear_all();
+	}
+	EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	EXPECT_GT(stats.delta_log_pages_cleaned, 0);
+	EXPECT_LE(delta_log->get_garbage_bytes(),
+			  DeltaLogInt::gc_threshold * (delta_log->get_live_bytes() +
+										  delta_log->get_garbage_bytes()) +
+				  TEST_PAGE_SIZE);
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), key % 10 ? key : key + 50);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
 /// Load a node from the disk.
 TEST_F(BBBTreeTest, LeafSplitsInDeltaTree) {
 	stats.clear();
@@ -312,8 +991,8 @@ TEST_F(BBBTreeTest, LeafSplitsInDeltaTree) {
 		auto &frame1 = buffer_manager->fix_page(
 			TEST_SEGMENT_ID, 1, true, &non_applying_page_logic, false);
 		auto *node1 = reinterpret_cast<BTreeInt::LeafNode *>(frame1.get_data());
-		// Node 1 does not have its node split on disk. So all keys are still
-		// present.
+		// Sequential inserts leave node 1 unchanged by the split. So all keys
+		// are still present.
 		EXPECT_EQ(node1->slot_count, tuples_per_leaf);
 		for (size_t j = 1; j < tuples_per_leaf; j++) {
 			EXPECT_TRUE(bbbtree_int->lookup(j).has_value());
@@ -325,10 +1004,11 @@ TEST_F(BBBTreeTest, LeafSplitsInDeltaTree) {
 			TEST_SEGMENT_ID, 2, true, &non_applying_page_logic, false);
 		auto *node2 = reinterpret_cast<BTreeInt::LeafNode *>(frame2.get_data());
 		// Node 2 was created newly so all its inserted keys are also on disk.
+		// Appending moved no keys from node 1.
 		EXPECT_FALSE(node2->lookup(UInt64{1}).has_value());
 		EXPECT_FALSE(node2->lookup(UInt64{2}).has_value());
-		EXPECT_TRUE(node2->lookup(UInt64{3}).has_value());
-		EXPECT_TRUE(node2->lookup(UInt64{4}).has_value());
+		EXPECT_FALSE(node2->lookup(UInt64{3}).has_value());
+		EXPECT_FALSE(node2->lookup(UInt64{4}).has_value());
 		EXPECT_TRUE(node2->lookup(UInt64{5}).has_value());
 		buffer_manager->unfix_page(frame2, false);
 	}
@@ -341,7 +1021,7 @@ TEST_F(BBBTreeTest, SplitAndInserts) {
 		TestBBBTree(SegmentID segment_id, BufferManager &buffer_manager)
 			: BBBTreeInt(segment_id, buffer_manager, TEST_WA_THRESHOLD) {}
 
-		DeltaTreeInt *get_delta_tree() { return &(this->delta_tree); }
+		DeltaTreeInt *get_delta_tree() { return &(this->delta_store); }
 	};
 
 	size_t page_size = TEST_PAGE_SIZE;
@@ -425,7 +1105,7 @@ TEST_F(BBBTreeTest, InnerNodeInsert) {
 		TestBBBTree(SegmentID segment_id, BufferManager &buffer_manager)
 			: BBBTreeInt(segment_id, buffer_manager, TEST_WA_THRESHOLD) {}
 
-		DeltaTreeInt *get_delta_tree() { return &(this->delta_tree); }
+		DeltaTreeInt *get_delta_tree() { return &(this->delta_store); }
 
 		BTreeInt *get_btree() { return &this->btree; }
 	};
@@ -487,7 +1167,7 @@ TEST_F(BBBTreeTest, InnerNodeUpdate) {
 		TestBBBTree(SegmentID segment_id, BufferManager &buffer_manager)
 			: BBBTreeInt(segment_id, buffer_manager, TEST_WA_THRESHOLD) {}
 
-		DeltaTreeInt *get_delta_tree() { return &(this->delta_tree); }
+		DeltaTreeInt *get_delta_tree() { return &(this->delta_store); }
 
 		BTreeInt *get_btree() { return &this->btree; }
 	};
@@ -551,7 +1231,7 @@ TEST_F(BBBTreeTest, UpdatingDeltaTreeEntries) {
 		TestBBBTree(SegmentID segment_id, BufferManager &buffer_manager)
 			: BBBTreeInt(segment_id, buffer_manager, TEST_WA_THRESHOLD) {}
 
-		DeltaTreeInt *get_delta_tree() { return &(this->delta_tree); }
+		DeltaTreeInt *get_delta_tree() { return &(this->delta_store); }
 
 		BTreeInt *get_btree() { return &this->btree; }
 	};
@@ -579,12 +1259,16 @@ TEST_F(BBBTreeTest, UpdatingDeltaTreeEntries) {
 	buffer_manager->clear_all();
 
 	// Dirtier the node and buffer in delta tree. Should update the entry for
-	// the node to both deltas.
+	// the node to both deltas. The entry is replaced without erasing it.
 	EXPECT_TRUE(bbbtree_int->insert(i, i + 2));
 	EXPECT_TRUE(bbbtree_int->lookup(i).has_value());
 	EXPECT_EQ(bbbtree_int->lookup(i), i + 2);
 	++i;
+	auto num_deletions_before = stats.num_deletions_index;
+	auto num_upserts_before = stats.num_upserts_index;
 	buffer_manager->clear_all();
+	EXPECT_EQ(stats.num_deletions_index, num_deletions_before);
+	EXPECT_EQ(stats.num_upserts_index, num_upserts_before + 1);
 
 	// In memory, all keys are found.
 	for (size_t j = 0; j < i; ++j) {
@@ -787,6 +1471,36 @@ struct SeedableTree : public IndexT<KeyT, ValueT> {
 	/// The key/value pairs that are expected to live in the tree.
 	std::unordered_map<KeyT, ValueT> expected_map;
 };
+// A bulk loaded tree buffers deltas of later inserts.
+TEST_F(BBBTreeTest, BulkLoad) {
+	std::srand(42);
+	static const constexpr size_t page_size = 128;
+	static const constexpr float wa_threshold = 0.2;
+
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(page_size, TEST_NUM_PAGES, true);
+	std::unique_ptr<BBBTreeInt> bbbtree_int = std::make_unique<BBBTreeInt>(
+		TEST_SEGMENT_ID, *buffer_manager, wa_threshold);
+
+	const uint64_t num_entries = 1'000;
+	std::vector<std::pair<UInt64, TID>> entries;
+	for (uint64_t i = 0; i < num_entries; ++i)
+		entries.emplace_back(2 * i, i);
+	bbbtree_int->bulk_load(entries, 0.75);
+	buffer_manager->clear_all();
+
+	for (uint64_t i = 0; i < num_entries; ++i)
+		EXPECT_TRUE(bbbtree_int->insert(2 * i + 1, i));
+	buffer_manager->clear_all();
+
+	EXPECT_EQ(bbbtree_int->size(), 2 * num_entries);
+	for (uint64_t i = 0; i < 2 * num_entries; ++i)
+		EXPECT_EQ(bbbtree_int->lookup(i), TID(i / 2));
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// ----------------------------------------------------------------
 // A large tree can handle all kinds of deltas.
 TEST_F(BBBTreeTest, LargeIntTree) {
 	std::srand(42);
@@ -802,5 +1516,105 @@ TEST_F(BBBTreeTest, LargeIntTree) {
 	// logger.log(tree);
 	EXPECT_TRUE(tree.validate());
 }
+// -----------------------------------------------------------------
+/// A grouped delta log writes each of its pages once it is full. Partially
+/// filled tails are not written out when the buffer is cleared.
+TEST_F(BBBTreeTest, GroupedDeltaLogWritesWholePages) {
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	stats.clear();
+	std::unique_ptr<BufferManager> buffer_manager =
+		std::make_unique<BufferManager>(TEST_PAGE_SIZE, TEST_NUM_PAGES, true);
+	std::unique_ptr<GroupedBBBTreeLogInt> bbbtree_int =
+		std::make_unique<GroupedBBBTreeLogInt>(TEST_SEGMENT_ID,
+											   *buffer_manager, wa_threshold);
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_TRUE(bbbtree_int->insert(key, key));
+	buffer_manager->clear_all();
+
+	for (uint64_t round = 1; round <= 20; ++round) {
+		for (uint64_t key = 0; key < num_keys; key += 10)
+			bbbtree_int->update(key, key + round);
+		buffer_manager->clear_all();
+	}
+	EXPECT_GT(stats.delta_log_appends, 0);
+	EXPECT_GT(stats.delta_groups_written, 0);
+	EXPECT_EQ(stats.delta_pages_written, stats.delta_groups_written);
+
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), key % 10 ? key : key + 20);
+
+	// Flushing writes the partial group. Its records are still found.
+	bbbtree_int->get_delta_log()->flush();
+	buffer_manager->clear_all();
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int->lookup(key), key % 10 ? key : key + 20);
+
+	buffer_manager.reset();
+	bbbtree_int.reset();
+}
+// -----------------------------------------------------------------
+/// After a crash, a tree is opened as of its last checkpoint. The deltas
+/// buffered for its nodes are tracked again and those of unallocated nodes are
+/// dropped.
+TEST_F(BBBTreeTest, RecoverFromCheckpoint) {
+	class BBBTreeRecoveryTest : public BBBTreeInt {
+	  public:
+		using BBBTreeInt::BBBTreeInt;
+		DeltaTreeInt *get_delta_tree() { return &(this->delta_store); }
+	};
+	static const constexpr SegmentID metadata_segment_id = 832;
+	static const constexpr float wa_threshold = 0.5;
+	static const constexpr size_t num_keys = 200;
+	// Changes after the checkpoint are not evicted.
+	static const constexpr size_t num_pages = 1000;
+	stats.clear();
+	{
+		BufferManager buffer_manager(TEST_PAGE_SIZE, num_pages, true);
+		MetadataSegment metadata(metadata_segment_id, buffer_manager);
+		BBBTreeRecoveryTest bbbtree_int(TEST_SEGMENT_ID, buffer_manager,
+										wa_threshold);
+		for (uint64_t key = 0; key < num_keys; ++key)
+			EXPECT_TRUE(bbbtree_int.insert(key, key));
+		buffer_manager.clear_all();
+		for (uint64_t key = 0; key < num_keys; key += 5)
+			bbbtree_int.update(key, key + 1);
+
+		// Deltas of a node that was never allocated.
+		std::vector<std::byte> bytes{std::byte{1}};
+		bbbtree_int.get_delta_tree()->upsert(PID{100000},
+											 DeltasView<UInt64, TID>(bytes));
+
+		buffer_manager.flush_all();
+		bbbtree_int.flush_deltas();
+		buffer_manager.flush_all();
+		bbbtree_int.checkpoint(metadata);
+		metadata.write();
+		EXPECT_GT(stats.btree_pages_write_deferred, 0);
+		EXPECT_EQ(stats.checkpoints_written, 1);
+
+		// Lost in the crash.
+		for (uint64_t key = num_keys; key < 2 * num_keys; ++key)
+			EXPECT_TRUE(bbbtree_int.insert(key, key));
+		for (uint64_t key = 0; key < num_keys; key += 5)
+			bbbtree_int.update(key, key + 2);
+		buffer_manager.discard_all();
+	}
+
+	BufferManager buffer_manager(TEST_PAGE_SIZE, TEST_NUM_PAGES, false);
+	MetadataSegment metadata(metadata_segment_id, buffer_manager);
+	EXPECT_EQ(metadata.get_version(), 1);
+	BBBTreeRecoveryTest bbbtree_int(TEST_SEGMENT_ID, buffer_manager,
+									wa_threshold);
+	bbbtree_int.recover(metadata);
+	EXPECT_EQ(stats.deltas_dropped_on_recovery, 1);
+	EXPECT_FALSE(bbbtree_int.get_delta_tree()->lookup(PID{100000}));
+
+	EXPECT_EQ(bbbtree_int.size(), num_keys);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(bbbtree_int.lookup(key), key % 5 ? key : key + 1);
+	EXPECT_FALSE(bbbtree_int.lookup(num_keys).has_value());
+}
 // ----------------------------------------------------------------
 } // namespace
\ No newline at end of file
@@ -3,11 +3,14 @@
 #include "bbbtree/stats.h"
 #include "bbbtree/types.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <memory>
+#include <numeric>
 #include <random>
+#include <string>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
@@ -294,5 +297,227 @@ TEST_F(BTreeTest, VariableSizeValues) {
 	std::cout << "Tree height: " << btree_str_to_str_->height() << std::endl;
 	EXPECT_TRUE(btree_str_->validate());
 }
+/// Upserts insert new keys and replace values of existing keys with values
+/// of any size.
+TEST_F(BTreeTest, Upsert) {
+	const size_t num_keys = 100;
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<size_t> size_dist(1, 60);
+
+	std::vector<std::string> keys;
+	std::vector<std::string> values(num_keys);
+	for (size_t i = 0; i < num_keys; ++i)
+		keys.push_back("key" + std::to_string(i));
+
+	for (char round = 0; round < 5; ++round) {
+		for (size_t i = 0; i < num_keys; ++i) {
+			values[i] = std::string(size_dist(gen), 'a' + round);
+			btree_str_to_str_->upsert(String{keys[i]}, String{values[i]});
+		}
+		EXPECT_EQ(btree_str_to_str_->size(), num_keys);
+		for (size_t i = 0; i < num_keys; ++i)
+			EXPECT_EQ(btree_str_to_str_->lookup(String{keys[i]}),
+					  String{values[i]});
+	}
+
+	btree_int_->upsert(1, 1);
+	btree_int_->upsert(1, 2);
+	EXPECT_FALSE(btree_int_->insert(1, 3));
+	EXPECT_EQ(btree_int_->lookup(1), UInt64(2));
+}
+/// A tree can be bulk loaded from sorted entries.
+TEST_F(BTreeTest, BulkLoad) {
+	const size_t num_entries = 10'000;
+	std::vector<std::pair<UInt64, UInt64>> entries;
+	for (uint64_t i = 0; i < num_entries; ++i)
+		entries.emplace_back(2 * i, i);
+
+	auto pages_before = stats.btree_pages_created;
+	btree_int_->bulk_load(entries);
+	auto pages_bulk_loaded = stats.btree_pages_created - pages_before;
+
+	EXPECT_EQ(btree_int_->size(), num_entries);
+	for (auto &[key, value] : entries)
+		EXPECT_EQ(btree_int_->lookup(key).value(), value);
+	EXPECT_FALSE(btree_int_->lookup(1).has_value());
+
+	// Packed leaves need fewer pages than inserting one by one.
+	Reset(true);
+	auto shuffled = entries;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+	pages_before = stats.btree_pages_created;
+	for (auto &[key, value] : shuffled)
+		EXPECT_TRUE(btree_int_->insert(key, value));
+	EXPECT_LT(pages_bulk_loaded, stats.btree_pages_created - pages_before);
+
+	// A bulk loaded tree can be modified further and persisted.
+	Reset(true);
+	btree_int_->bulk_load(entries, 0.5);
+	for (uint64_t i = 0; i < num_entries; ++i)
+		EXPECT_TRUE(btree_int_->insert(2 * i + 1, i));
+	Reset(false);
+	EXPECT_EQ(btree_int_->size(), 2 * num_entries);
+	for (uint64_t i = 0; i < 2 * num_entries; ++i)
+		EXPECT_EQ(btree_int_->lookup(i).value(), UInt64(i / 2));
+}
+/// A tree is only bulk loaded from unique, sorted keys when empty.
+TEST_F(BTreeTest, BulkLoadInvalid) {
+	std::vector<std::pair<UInt64, UInt64>> unsorted{{2, 1}, {1, 1}};
+	std::vector<std::pair<UInt64, UInt64>> duplicates{{1, 1}, {1, 2}};
+	std::vector<std::pair<UInt64, UInt64>> sorted{{1, 1}, {2, 2}};
+
+	EXPECT_THROW(btree_int_->bulk_load(unsorted), std::logic_error);
+	EXPECT_THROW(btree_int_->bulk_load(duplicates), std::logic_error);
+	EXPECT_THROW(btree_int_->bulk_load(sorted, 0), std::logic_error);
+	EXPECT_TRUE(btree_int_->empty());
+
+	btree_int_->bulk_load(sorted);
+	EXPECT_FALSE(btree_int_->empty());
+	EXPECT_THROW(btree_int_->bulk_load(sorted), std::logic_error);
+}
+/// Ascending inserts keep the left nodes full on splits.
+TEST_F(BTreeTest, SequentialInserts) {
+	const size_t num_entries = 10'000;
+	std::vector<std::pair<UInt64, UInt64>> entries;
+	for (uint64_t i = 0; i < num_entries; ++i)
+		entries.emplace_back(i, i);
+
+	auto pages_before = stats.btree_pages_created;
+	btree_int_->bulk_load(entries);
+	auto pages_bulk_loaded = stats.btree_pages_created - pages_before;
+	auto height_bulk_loaded = btree_int_->height();
+
+	// Appending results in a tree as compact as a fully packed bulk load.
+	Reset(true);
+	auto append_splits_before = stats.append_splits;
+	pages_before = stats.btree_pages_created;
+	for (auto &[key, value] : entries)
+		EXPECT_TRUE(btree_int_->insert(key, value));
+	auto pages_appended = stats.btree_pages_created - pages_before;
+	EXPECT_GT(stats.append_splits, append_splits_before);
+	EXPECT_EQ(pages_appended, pages_bulk_loaded);
+	EXPECT_EQ(btree_int_->height(), height_bulk_loaded);
+	EXPECT_EQ(btree_int_->size(), num_entries);
+	for (auto &[key, value] : entries)
+		EXPECT_EQ(btree_int_->lookup(key).value(), value);
+
+	// Descending inserts still split in the middle.
+	Reset(true);
+	append_splits_before = stats.append_splits;
+	pages_before = stats.btree_pages_created;
+	for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+		EXPECT_TRUE(btree_int_->insert(it->first, it->second));
+	EXPECT_EQ(stats.append_splits, append_splits_before);
+	EXPECT_LT(pages_appended, stats.btree_pages_created - pages_before);
+	EXPECT_EQ(btree_int_->size(), num_entries);
+}
+/// Batches of lookups and updates share their traversals.
+TEST_F(BTreeTest, Batches) {
+	const size_t num_entries = 5'000;
+	std::vector<UInt64> keys;
+	for (uint64_t i = 0; i < num_entries; ++i)
+		keys.push_back(2 * i);
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	for (auto &key : keys)
+		EXPECT_TRUE(btree_int_->insert(key, key));
+
+	// Include missing and duplicate keys.
+	keys.push_back(1);
+	keys.push_back(keys.front());
+
+	auto fixes_before = stats.buffer_hits + stats.buffer_misses;
+	auto results = btree_int_->lookup_batch(keys);
+	auto fixes_batched = stats.buffer_hits + stats.buffer_misses - fixes_before;
+	ASSERT_EQ(results.size(), keys.size());
+	for (size_t i = 0; i < keys.size(); ++i) {
+		if (keys[i] == UInt64(1))
+			EXPECT_FALSE(results[i].has_value());
+		else
+			EXPECT_EQ(results[i].value(), keys[i]);
+	}
+
+	// Fixes fewer pages than looking up one by one.
+	fixes_before = stats.buffer_hits + stats.buffer_misses;
+	for (auto &key : keys)
+		btree_int_->lookup(key);
+	EXPECT_LT(fixes_batched,
+			  stats.buffer_hits + stats.buffer_misses - fixes_before);
+
+	// Updates are persisted.
+	std::vector<std::pair<UInt64, UInt64>> entries;
+	for (uint64_t i = 0; i < num_entries; i += 3)
+		entries.emplace_back(2 * (num_entries - i - 1), i);
+	btree_int_->update_batch(entries);
+	Reset(false);
+	for (auto &[key, value] : entries)
+		EXPECT_EQ(btree_int_->lookup(key).value(), value);
+	EXPECT_EQ(btree_int_->lookup(0).value(), UInt64(0));
+}
+/// Erased entries free their nodes for re-use.
+TEST_F(BTreeTest, Erase) {
+	const size_t num_entries = 5'000;
+	std::vector<uint64_t> keys(num_entries);
+	std::iota(keys.begin(), keys.end(), 0);
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	for (auto key : keys)
+		EXPECT_TRUE(btree_int_->insert(key, key));
+	auto height = btree_int_->height();
+	auto next_free_page = btree_int_->next_free_page;
+
+	// Erase every other key.
+	for (auto key : keys)
+		if (key % 2)
+			btree_int_->erase(key, TEST_PAGE_SIZE);
+	EXPECT_EQ(btree_int_->size(), num_entries / 2);
+	for (uint64_t key = 0; key < num_entries; ++key)
+		EXPECT_EQ(btree_int_->lookup(key).has_value(), key % 2 == 0);
+
+	// Erasing missing keys changes nothing.
+	btree_int_->erase(1, TEST_PAGE_SIZE);
+	EXPECT_EQ(btree_int_->size(), num_entries / 2);
+
+	// An emptied tree shrinks to a single leaf.
+	auto pages_freed_before = stats.pages_freed;
+	for (auto key : keys)
+		if (key % 2 == 0)
+			btree_int_->erase(key, TEST_PAGE_SIZE);
+	EXPECT_TRUE(btree_int_->empty());
+	EXPECT_EQ(btree_int_->height(), 1);
+	EXPECT_GT(stats.pages_freed, pages_freed_before);
+
+	// Freed pages are persisted and re-used.
+	Reset(false);
+	auto pages_reused_before = stats.pages_reused;
+	for (auto key : keys)
+		EXPECT_TRUE(btree_int_->insert(key, key));
+	EXPECT_GT(stats.pages_reused, pages_reused_before);
+	EXPECT_EQ(btree_int_->next_free_page, next_free_page);
+	EXPECT_EQ(btree_int_->height(), height);
+	for (auto key : keys)
+		EXPECT_EQ(btree_int_->lookup(key).value(), UInt64(key));
+}
+/// Inserting new and erasing old keys keeps the tree's size stable.
+TEST_F(BTreeTest, Churn) {
+	const uint64_t window = 2'000;
+	const uint64_t batch = 500;
+	uint64_t next_key = 0;
+	for (; next_key < window; ++next_key)
+		EXPECT_TRUE(btree_int_->insert(next_key, next_key));
+
+	std::vector<size_t> heights;
+	std::vector<PageID> next_free_pages;
+	for (size_t round = 0; round < 50; ++round) {
+		for (uint64_t i = 0; i < batch; ++i, ++next_key) {
+			btree_int_->erase(next_key - window, TEST_PAGE_SIZE);
+			EXPECT_TRUE(btree_int_->insert(next_key, next_key));
+		}
+		heights.push_back(btree_int_->height());
+		next_free_pages.push_back(btree_int_->next_free_page);
+	}
+	EXPECT_EQ(btree_int_->size(), window);
+	// Freed pages are re-used, so neither file nor tree keep growing.
+	EXPECT_EQ(heights.front(), heights.back());
+	EXPECT_LE(next_free_pages.back(), next_free_pages.front() + 5);
+}
 /// A tree can handle thousands of variable sized keys and values. TODO.
 } // namespace
\ No newline at end of file
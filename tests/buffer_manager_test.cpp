@@ -1,4 +1,5 @@
 #include "bbbtree/buffer_manager.h"
+#include "bbbtree/stats.h"
 
 #include <cstring>
 #include <gtest/gtest.h>
@@ -97,5 +98,110 @@ TEST(BufferManager, BufferFull) {
 				 bbbtree::buffer_full_error);
 	buffer_manager.unfix_page(page, false);
 }
+/// Pages are prefetched with a single read. They are not fixed.
+TEST(BufferManager, Prefetch) {
+	size_t page_size = 1024;
+	{
+		bbbtree::BufferManager buffer_manager{page_size, 40, true};
+		for (uint64_t page_id = 0; page_id < 8; ++page_id) {
+			auto &frame =
+				buffer_manager.fix_page(348, page_id, true, nullptr, false);
+			*frame.get_data() = 'a' + page_id;
+			buffer_manager.unfix_page(frame, true);
+		}
+	}
+	bbbtree::BufferManager buffer_manager{page_size, 40};
+	bbbtree::stats.clear();
+	// At most a quarter of the frames are prefetched at once.
+	EXPECT_EQ(buffer_manager.prefetch(348, 0, 20, nullptr), 10);
+	EXPECT_EQ(bbbtree::stats.pages_prefetched, 8);
+	for (uint64_t page_id = 0; page_id < 8; ++page_id) {
+		auto &frame =
+			buffer_manager.fix_page(348, page_id, false, nullptr, false);
+		EXPECT_EQ(*frame.get_data(), static_cast<char>('a' + page_id));
+		buffer_manager.unfix_page(frame, false);
+	}
+	EXPECT_EQ(bbbtree::stats.buffer_hits, 8);
+}
+/// Pages can be read without buffering them. Buffered pages are read from their
+/// frames.
+TEST(BufferManager, ReadPages) {
+	size_t page_size = 1024;
+	bbbtree::BufferManager buffer_manager{page_size, 2, true};
+	for (uint64_t page_id = 0; page_id < 8; ++page_id) {
+		auto &frame =
+			buffer_manager.fix_page(348, page_id, true, nullptr, false);
+		*frame.get_data() = 'a' + page_id;
+		buffer_manager.unfix_page(frame, true);
+	}
+	auto &frame = buffer_manager.fix_page(348, 0, true, nullptr, false);
+	*frame.get_data() = 'z';
+	buffer_manager.unfix_page(frame, true);
+	bbbtree::stats.clear();
+
+	std::vector<char> pages(10 * page_size, 'x');
+	buffer_manager.read_pages(348, 0, 10, pages.data(), nullptr);
+	EXPECT_EQ(pages[0], 'z');
+	for (uint64_t page_id = 1; page_id < 8; ++page_id)
+		EXPECT_EQ(pages[page_id * page_size], static_cast<char>('a' + page_id));
+	// Pages that do not exist are zeroed.
+	EXPECT_EQ(pages[8 * page_size], 0);
+	EXPECT_EQ(bbbtree::stats.pages_evicted, 0);
+	EXPECT_GE(bbbtree::stats.pages_read_unbuffered, 6);
+}
+/// Pages loaded by scans or one-time traversals are evicted before the others.
+/// A cold page that is fixed normally stays.
+TEST(BufferManager, ColdPages) {
+	using bbbtree::AccessHint;
+	bbbtree::BufferManager buffer_manager{1024, 10, true};
+	auto fix = [&](uint64_t page_id, AccessHint hint) {
+		auto &frame =
+			buffer_manager.fix_page(348, page_id, false, nullptr, false, hint);
+		buffer_manager.unfix_page(frame, false);
+	};
+	for (uint64_t page_id = 0; page_id < 8; ++page_id)
+		fix(page_id, AccessHint::NORMAL);
+
+	bbbtree::stats.clear();
+	for (uint64_t page_id = 100; page_id < 200; ++page_id)
+		fix(page_id, AccessHint::SEQUENTIAL);
+	for (uint64_t page_id = 300; page_id < 400; ++page_id)
+		fix(page_id, AccessHint::ONCE);
+	EXPECT_GT(bbbtree::stats.cold_pages_evicted, 0);
+	EXPECT_EQ(bbbtree::stats.cold_pages_evicted, bbbtree::stats.pages_evicted);
+
+	fix(500, AccessHint::SEQUENTIAL);
+	fix(500, AccessHint::NORMAL);
+	for (uint64_t page_id = 600; page_id < 700; ++page_id)
+		fix(page_id, AccessHint::ONCE);
+
+	bbbtree::stats.clear();
+	for (uint64_t page_id = 0; page_id < 8; ++page_id)
+		fix(page_id, AccessHint::NORMAL);
+	fix(500, AccessHint::NORMAL);
+	EXPECT_EQ(bbbtree::stats.buffer_hits, 9);
+}
+/// Loaded and written pages are counted per segment.
+TEST(BufferManager, PageIOPerSegment) {
+	bbbtree::BufferManager buffer_manager{1024, 10, true};
+	auto fix = [&](bbbtree::SegmentID segment_id, uint64_t page_id,
+				   bool is_dirty) {
+		auto &frame =
+			buffer_manager.fix_page(segment_id, page_id, true, nullptr, false);
+		buffer_manager.unfix_page(frame, is_dirty);
+	};
+	for (uint64_t page_id = 0; page_id < 4; ++page_id)
+		fix(348, page_id, true);
+	buffer_manager.clear_all();
+	EXPECT_EQ(buffer_manager.get_page_io(348), 4);
+	EXPECT_EQ(buffer_manager.get_page_io(169), 0);
+
+	for (uint64_t page_id = 0; page_id < 4; ++page_id)
+		fix(348, page_id, false);
+	fix(169, 0, true);
+	buffer_manager.clear_all();
+	EXPECT_EQ(buffer_manager.get_page_io(348), 8);
+	EXPECT_EQ(buffer_manager.get_page_io(169), 1);
+}
 
 } // namespace
\ No newline at end of file
@@ -1,10 +1,15 @@
+#include "bbbtree/bbbtree.h"
 #include "bbbtree/btree.h"
 #include "bbbtree/database.h"
+#include "bbbtree/stats.h"
 #include "bbbtree/types.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <gtest/gtest.h>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <random>
 #include <string>
 #include <unordered_map>
@@ -15,6 +20,10 @@ using namespace bbbtree;
 namespace {
 using IntDatabase = Database<BTree, UInt64>;
 using StringDatabase = Database<BTree, String>;
+using BufferedIntDatabase = Database<BBBTree, UInt64>;
+using ClusteredIntDatabase = Database<BTree, UInt64, true>;
+using ClusteredStringDatabase = Database<BTree, String, true>;
+using BufferedClusteredIntDatabase = Database<BBBTree, UInt64, true>;
 
 static const constexpr size_t TEST_PAGE_SIZE = 1024;
 static const constexpr size_t TEST_NUM_PAGES = 10;
@@ -122,7 +131,9 @@ class StringDatabaseTest : public ::testing::Test {
 				auto value = dist(rng);
 				StringDatabase::Tuple t{{key}, value};
 				db_->insert(t);
-				expected_map.emplace(std::move(key), t);
+				// The expected tuple's key refers to the map's key.
+				auto it = expected_map.emplace(std::move(key), t).first;
+				it->second.key = {it->first};
 			}
 		};
 	}
@@ -151,7 +162,7 @@ class StringDatabaseTest : public ::testing::Test {
 TEST_F(IntDatabaseTest, InMemory) {
 	// Calculate the number of tuples that fit into the buffer.
 	const size_t num_tuples =
-		TEST_PAGE_SIZE * TEST_NUM_PAGES / sizeof(IntDatabase::Tuple) / 2;
+		TEST_PAGE_SIZE * TEST_NUM_PAGES / IntDatabase::Tuple{}.size() / 2;
 
 	Seed(num_tuples);
 	EXPECT_EQ(db_->size(), expected_map.size());
@@ -172,7 +183,7 @@ TEST_F(IntDatabaseTest, DuplicateKeys) {
 TEST_F(IntDatabaseTest, OutOfMemory) {
 	// Calculate the number of tuples that overflow  the buffer.
 	const size_t num_tuples =
-		TEST_PAGE_SIZE * TEST_NUM_PAGES / sizeof(IntDatabase::Tuple) * 10;
+		TEST_PAGE_SIZE * TEST_NUM_PAGES / IntDatabase::Tuple{}.size() * 10;
 
 	Seed(num_tuples);
 	EXPECT_EQ(db_->size(), expected_map.size());
@@ -182,6 +193,29 @@ TEST_F(IntDatabaseTest, OutOfMemory) {
 		EXPECT_EQ(expectedTuple, db_->get(key));
 	}
 }
+// Tuples can be read and updated in batches.
+TEST_F(IntDatabaseTest, Batches) {
+	Seed(1000);
+
+	std::vector<UInt64> keys;
+	std::vector<IntDatabase::Tuple> updated;
+	for (const auto &[key, tuple] : expected_map) {
+		keys.push_back(key);
+		updated.push_back({key, tuple.value + 1});
+	}
+
+	auto tuples = db_->get(keys);
+	ASSERT_EQ(tuples.size(), keys.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+		EXPECT_EQ(tuples[i], expected_map[keys[i]]);
+
+	db_->update(updated);
+	for (auto &tuple : updated)
+		expected_map[tuple.key] = tuple;
+	Validate();
+
+	EXPECT_THROW(db_->get(std::vector<UInt64>{0}), std::logic_error);
+}
 // A tuple inserted can be read again, also after destroying the database.
 TEST_F(IntDatabaseTest, Persistency) {
 	// Calculate the number of tuples that overflow the buffer.
@@ -192,6 +226,546 @@ TEST_F(IntDatabaseTest, Persistency) {
 	Destroy(false);
 	Validate();
 }
+// Updated records of evicted pages are buffered and survive a restart.
+TEST_F(IntDatabaseTest, BufferedRecords) {
+	db_.reset();
+	db_ = std::make_unique<IntDatabase>(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0.5,
+										true);
+	Seed(1000);
+	stats.clear();
+
+	std::mt19937_64 rng(7);
+	std::vector<UInt64> keys;
+	for (const auto &[key, tuple] : expected_map)
+		keys.push_back(key);
+	for (size_t i = 0; i < 1000; ++i) {
+		auto &tuple = expected_map[keys[rng() % keys.size()]];
+		tuple.value = tuple.value + 1;
+		db_->update(tuple);
+	}
+	Validate();
+	EXPECT_GT(stats.record_pages_write_deferred, 0);
+	EXPECT_GT(stats.record_deltas_applied, 0);
+
+	Destroy(false);
+	Validate();
+}
+// Deltas buffered for index nodes are found again after a restart, since the
+// delta tree is opened as of the last checkpoint.
+TEST_F(IntDatabaseTest, BufferedDeltasSurviveRestart) {
+	db_.reset();
+	std::unordered_map<UInt64, BufferedIntDatabase::Tuple> expected;
+	std::mt19937_64 rng(42);
+	auto db = std::make_unique<BufferedIntDatabase>(
+		TEST_PAGE_SIZE, TEST_NUM_PAGES, 0.5, true);
+	for (uint64_t key = 0; key < 1000; ++key) {
+		expected[key] = {key, rng()};
+		db->insert(expected[key]);
+	}
+	stats.clear();
+
+	for (uint64_t key = 0; key < 1000; key += 7) {
+		auto &tuple = expected[key];
+		tuple.value = tuple.value + 1;
+		db->update(tuple);
+	}
+	db->checkpoint();
+	EXPECT_EQ(stats.checkpoints_written, 1);
+
+	db.reset();
+	EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	db = std::make_unique<BufferedIntDatabase>(TEST_PAGE_SIZE, TEST_NUM_PAGES,
+											   0.5, false);
+	EXPECT_EQ(stats.deltas_dropped_on_recovery, 0);
+	EXPECT_EQ(db->size(), expected.size());
+	for (const auto &[key, expected_tuple] : expected)
+		EXPECT_EQ(db->get(key).value, expected_tuple.value);
+}
+// A checkpoint buffers the changes of pages with few changes as deltas. All
+// pages stay buffered.
+TEST_F(IntDatabaseTest, CheckpointKeepsPagesBuffered) {
+	db_.reset();
+	// All pages fit into the buffer.
+	auto db = std::make_unique<BufferedIntDatabase>(TEST_PAGE_SIZE, 100, 0.5,
+													true);
+	for (uint64_t key = 0; key < 1000; ++key)
+		db->insert({key, key});
+	db->checkpoint();
+
+	db->update({500, 0});
+	stats.clear();
+	db->checkpoint();
+	EXPECT_EQ(stats.checkpoints_written, 1);
+	EXPECT_GT(stats.checkpoint_pages_deferred, 0);
+
+	stats.clear();
+	EXPECT_EQ(db->get(500).value, 0);
+	EXPECT_EQ(stats.pages_loaded, 0);
+
+	db.reset();
+	db = std::make_unique<BufferedIntDatabase>(TEST_PAGE_SIZE, 100, 0.5, false);
+	EXPECT_EQ(db->get(500).value, 0);
+	EXPECT_EQ(db->get(501).value, 501);
+}
+// Committed operations of a logged database survive a crash, even though their
+// pages were never written out.
+TEST_F(IntDatabaseTest, CommittedOperationsSurviveCrash) {
+	db_.reset();
+	std::unordered_map<UInt64, BufferedIntDatabase::Tuple> expected;
+	std::mt19937_64 rng(42);
+	auto db = std::make_unique<BufferedIntDatabase>(
+		TEST_PAGE_SIZE, TEST_NUM_PAGES, 0.5, true, true);
+	for (uint64_t key = 0; key < 500; ++key) {
+		expected[key] = {key, rng()};
+		db->insert(expected[key]);
+	}
+	db->checkpoint();
+
+	for (uint64_t key = 0; key < 500; key += 3) {
+		auto &tuple = expected[key];
+		tuple.value = tuple.value + 1;
+		db->update(tuple);
+	}
+	for (uint64_t key = 500; key < 600; ++key) {
+		expected[key] = {key, rng()};
+		db->insert(expected[key]);
+	}
+	db->commit();
+	// An uncommitted operation is lost, unless the flusher happened to write
+	// its record before the crash.
+	db->update({0, 0});
+	db->crash();
+
+	db.reset();
+	stats.clear();
+	db = std::make_unique<BufferedIntDatabase>(TEST_PAGE_SIZE, TEST_NUM_PAGES,
+											   0.5, false, true);
+	bool is_flushed = db->get(0).value == 0;
+	if (is_flushed)
+		expected[0].value = 0;
+	EXPECT_EQ(stats.log_records_replayed, 167 + 100 + is_flushed);
+	EXPECT_EQ(db->size(), expected.size());
+	for (const auto &[key, expected_tuple] : expected)
+		EXPECT_EQ(db->get(key).value, expected_tuple.value);
+}
+// Committed erases are redone after a crash. Inserts redone after them reuse
+// the slots.
+TEST_F(IntDatabaseTest, CommittedErasesSurviveCrash) {
+	db_.reset();
+	auto db = std::make_unique<IntDatabase>(TEST_PAGE_SIZE, 100, 0, true, true);
+	for (uint64_t key = 0; key < 300; ++key)
+		db->insert({key, key});
+	db->checkpoint();
+
+	for (uint64_t key = 0; key < 300; key += 2)
+		db->erase(key);
+	for (uint64_t key = 300; key < 400; ++key)
+		db->insert({key, key, "inserted"});
+	db->commit();
+	db->crash();
+
+	db.reset();
+	stats.clear();
+	db = std::make_unique<IntDatabase>(TEST_PAGE_SIZE, 100, 0, false, true);
+	EXPECT_EQ(stats.log_records_replayed, 150 + 100);
+	EXPECT_EQ(stats.slotted_pages_created, 0);
+	EXPECT_EQ(db->size(), 250);
+	EXPECT_THROW(db->get(0), std::logic_error);
+	EXPECT_EQ(db->get(1).value, 1);
+	EXPECT_EQ(db->get(399).payload, "inserted");
+}
+// Tuples have payloads of variable size. Updates change their size and move
+// them to other pages.
+TEST_F(IntDatabaseTest, VariableSizedPayloads) {
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<size_t> size(0, TEST_PAGE_SIZE / 2);
+	auto make_payload = [&]() {
+		auto bytes = get_random_bytes(size(rng));
+		return std::string(reinterpret_cast<const char *>(bytes.data()),
+						   bytes.size());
+	};
+
+	for (uint64_t key = 0; key < 300; ++key) {
+		expected_map[key] = {key, key, make_payload()};
+		db_->insert(expected_map[key]);
+	}
+	stats.clear();
+	for (uint64_t key = 0; key < 300; key += 2) {
+		auto &tuple = expected_map[key];
+		tuple.payload = make_payload();
+		db_->update(tuple);
+	}
+	EXPECT_GT(stats.records_moved, 0);
+
+	// Tuples larger than a page are rejected.
+	EXPECT_THROW(db_->update({0, 0, std::string(TEST_PAGE_SIZE, 'a')}),
+				 std::logic_error);
+
+	Destroy(false);
+	ASSERT_EQ(db_->size(), expected_map.size());
+	for (const auto &[key, expected_tuple] : expected_map)
+		EXPECT_EQ(db_->get(key), expected_tuple);
+}
+// Erased tuples free their space for later inserts, so that the records stay
+// within the same pages.
+TEST_F(IntDatabaseTest, EraseReusesSpace) {
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<size_t> size(0, 100);
+	auto make_payload = [&]() { return std::string(size(rng), 'x'); };
+
+	uint64_t next_key = 0;
+	auto insert = [&]() {
+		auto key = next_key++;
+		expected_map[key] = {key, key, make_payload()};
+		db_->insert(expected_map[key]);
+	};
+	for (size_t i = 0; i < 500; ++i)
+		insert();
+	stats.clear();
+
+	// Replace the oldest tuples.
+	for (uint64_t key = 0; key < 2000; ++key) {
+		db_->erase(key);
+		expected_map.erase(key);
+		insert();
+	}
+	EXPECT_THROW(db_->erase(0), std::logic_error);
+	EXPECT_THROW(db_->get(0), std::logic_error);
+	EXPECT_EQ(stats.num_deletions_db, 2000);
+	EXPECT_GT(stats.slotted_pages_compacted, 0);
+	EXPECT_LE(stats.slotted_pages_created, 5);
+
+	Destroy(false);
+	ASSERT_EQ(db_->size(), expected_map.size());
+	for (const auto &[key, expected_tuple] : expected_map)
+		EXPECT_EQ(db_->get(key), expected_tuple);
+}
+// A scan visits each tuple once without using the index, also tuples that were
+// moved. Scans that bypass the buffer do not evict buffered pages.
+TEST_F(IntDatabaseTest, Scan) {
+	Seed(1000);
+	size_t num_updated = 0;
+	for (auto &[key, tuple] : expected_map) {
+		if (num_updated++ == 50)
+			break;
+		tuple.payload = std::string(300, 'p');
+		db_->update(tuple);
+	}
+
+	for (bool bypass_buffer : {false, true}) {
+		std::unordered_map<UInt64, IntDatabase::Tuple> scanned;
+		stats.clear();
+		db_->scan(
+			[&](const IntDatabase::Tuple &tuple) {
+				EXPECT_TRUE(scanned.emplace(tuple.key, tuple).second);
+			},
+			bypass_buffer);
+		EXPECT_EQ(scanned, expected_map);
+		EXPECT_EQ(stats.num_lookups_index, 0);
+		if (bypass_buffer) {
+			// Only the page of the free-space inventory is buffered.
+			EXPECT_GT(stats.pages_read_unbuffered, 0);
+			EXPECT_LE(stats.pages_evicted, 1);
+		} else {
+			EXPECT_GT(stats.pages_prefetched, 0);
+		}
+	}
+
+	// A clustered database scans its leaves in key order.
+	ClusteredIntDatabase db(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0, true);
+	for (uint64_t key = 1000; key > 0; --key)
+		db.insert({key, key});
+	uint64_t next_key = 1;
+	db.scan([&](const ClusteredIntDatabase::Tuple &tuple) {
+		EXPECT_EQ(tuple.key, UInt64(next_key++));
+	});
+	EXPECT_EQ(next_key, 1001);
+}
+// Scans and statistics traversals load their pages as cold pages. They do not
+// evict the pages that lookups keep using.
+TEST_F(IntDatabaseTest, ScansKeepWorkingSet) {
+	db_.reset();
+	IntDatabase db(TEST_PAGE_SIZE, 40, 0, true);
+	for (uint64_t key = 0; key < 2000; ++key)
+		db.insert({key, key});
+	auto scan = [&]() { db.scan([](const IntDatabase::Tuple &) {}); };
+	auto lookup = [&]() {
+		auto num_misses = stats.buffer_misses;
+		for (uint64_t key : {0, 1000, 1999})
+			EXPECT_EQ(db.get(key).value, key);
+		return stats.buffer_misses - num_misses;
+	};
+	// Load the working set, including the page of the free-space inventory.
+	for (size_t i = 0; i < 20; ++i) {
+		scan();
+		if (lookup() == 0)
+			break;
+	}
+
+	stats.clear();
+	EXPECT_EQ(db.size(), 2000);
+	scan();
+	EXPECT_EQ(lookup(), 0);
+	EXPECT_GT(stats.cold_pages_evicted, 0);
+}
+// A clustered index stores the tuples in its leaves. Payloads change their size
+// and the slotted pages stay empty.
+TEST_F(IntDatabaseTest, ClusteredTuples) {
+	db_.reset();
+	std::unordered_map<UInt64, ClusteredIntDatabase::Tuple> expected;
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<size_t> size(0, 200);
+	auto make_payload = [&]() { return std::string(size(rng), 'x'); };
+	auto db = std::make_unique<ClusteredIntDatabase>(
+		TEST_PAGE_SIZE, TEST_NUM_PAGES, 0, true);
+	stats.clear();
+
+	// Bulk load, then insert single tuples.
+	std::vector<ClusteredIntDatabase::Tuple> tuples;
+	for (uint64_t key = 0; key < 500; ++key) {
+		expected[key] = {key, rng(), make_payload()};
+		tuples.push_back(expected[key]);
+	}
+	db->insert(tuples);
+	for (uint64_t key = 500; key < 1000; ++key) {
+		expected[key] = {key, rng(), make_payload()};
+		db->insert(expected[key]);
+	}
+	EXPECT_THROW(db->insert({0, 0}), std::logic_error);
+
+	for (uint64_t key = 0; key < 1000; key += 3) {
+		auto &tuple = expected[key];
+		tuple.value = tuple.value + 1;
+		tuple.payload = make_payload();
+		db->update(tuple);
+	}
+	for (uint64_t key = 1; key < 1000; key += 3) {
+		db->erase(key);
+		expected.erase(key);
+	}
+	EXPECT_THROW(db->get(1), std::logic_error);
+	EXPECT_THROW(db->update({1, 0}), std::logic_error);
+	EXPECT_THROW(db->erase(1), std::logic_error);
+	// Tuples larger than a quarter of a page are rejected.
+	EXPECT_THROW(db->update({0, 0, std::string(TEST_PAGE_SIZE / 4, 'a')}),
+				 std::logic_error);
+	EXPECT_EQ(stats.slotted_pages_created, 0);
+
+	std::vector<UInt64> keys;
+	for (const auto &[key, tuple] : expected)
+		keys.push_back(key);
+	auto read = db->get(keys);
+	ASSERT_EQ(read.size(), keys.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+		EXPECT_EQ(read[i], expected[keys[i]]);
+
+	db.reset();
+	db = std::make_unique<ClusteredIntDatabase>(TEST_PAGE_SIZE, TEST_NUM_PAGES,
+												0, false);
+	ASSERT_EQ(db->size(), expected.size());
+	for (const auto &[key, expected_tuple] : expected)
+		EXPECT_EQ(db->get(key), expected_tuple);
+}
+// Point lookups of a clustered database fix only the index's pages.
+TEST_F(IntDatabaseTest, ClusteredLookupsFixFewerPages) {
+	db_.reset();
+	auto count_fixes = [](auto &db) {
+		for (uint64_t key = 0; key < 1000; ++key)
+			db.insert({key, key, "payload"});
+		stats.clear();
+		for (uint64_t key = 0; key < 1000; key += 7)
+			EXPECT_EQ(db.get(key).value, key);
+		return stats.buffer_hits + stats.buffer_misses;
+	};
+	size_t unclustered_fixes;
+	{
+		IntDatabase db(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0, true);
+		unclustered_fixes = count_fixes(db);
+	}
+	ClusteredIntDatabase db(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0, true);
+	EXPECT_LT(count_fixes(db), unclustered_fixes);
+}
+// Payload updates of a clustered database are buffered as deltas of the index
+// leaves and survive a restart.
+TEST_F(IntDatabaseTest, ClusteredUpdatesAreBufferedAsDeltas) {
+	db_.reset();
+	std::unordered_map<UInt64, BufferedClusteredIntDatabase::Tuple> expected;
+	auto db = std::make_unique<BufferedClusteredIntDatabase>(
+		TEST_PAGE_SIZE, TEST_NUM_PAGES, 0.5, true);
+	for (uint64_t key = 0; key < 1000; ++key) {
+		expected[key] = {key, key, "payload"};
+		db->insert(expected[key]);
+	}
+	stats.clear();
+
+	for (uint64_t key = 0; key < 1000; key += 7) {
+		auto &tuple = expected[key];
+		tuple.payload = "updated payload";
+		db->update(tuple);
+	}
+	db.reset();
+	EXPECT_GT(stats.btree_pages_write_deferred, 0);
+	EXPECT_EQ(stats.record_pages_write_deferred, 0);
+
+	db = std::make_unique<BufferedClusteredIntDatabase>(
+		TEST_PAGE_SIZE, TEST_NUM_PAGES, 0.5, false);
+	EXPECT_EQ(stats.deltas_dropped_on_recovery, 0);
+	ASSERT_EQ(db->size(), expected.size());
+	for (const auto &[key, expected_tuple] : expected)
+		EXPECT_EQ(db->get(key), expected_tuple);
+}
+// Payloads of a clustered database that grow and shrink are buffered as deltas
+// and read back after their leaves were evicted.
+TEST_F(IntDatabaseTest, ClusteredPayloadsChangeTheirSize) {
+	db_.reset();
+	std::map<uint64_t, BufferedClusteredIntDatabase::Tuple> expected;
+	BufferedClusteredIntDatabase db(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0.3, true);
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<uint64_t> key_dist(0, 499);
+	std::uniform_int_distribution<size_t> size_dist(0, 200);
+	for (size_t i = 0; i < 10'000; ++i) {
+		uint64_t key = key_dist(rng);
+		BufferedClusteredIntDatabase::Tuple tuple{
+			key, i, std::string(size_dist(rng), 'x')};
+		if (!expected.contains(key)) {
+			db.insert(tuple);
+			expected[key] = tuple;
+		} else if (i % 3 == 0) {
+			db.erase(key);
+			expected.erase(key);
+		} else {
+			db.update(tuple);
+			expected[key] = tuple;
+		}
+	}
+
+	EXPECT_EQ(db.size(), expected.size());
+	for (const auto &[key, expected_tuple] : expected)
+		EXPECT_EQ(db.get(key), expected_tuple);
+}
+// Committed operations of a logged clustered database are redone in its
+// index after a crash.
+TEST_F(IntDatabaseTest, ClusteredOperationsSurviveCrash) {
+	db_.reset();
+	auto db = std::make_unique<ClusteredIntDatabase>(TEST_PAGE_SIZE, 100, 0,
+													 true, true);
+	for (uint64_t key = 0; key < 300; ++key)
+		db->insert({key, key});
+	db->checkpoint();
+
+	for (uint64_t key = 0; key < 300; key += 2)
+		db->erase(key);
+	for (uint64_t key = 1; key < 300; key += 2)
+		db->update({key, key + 1, "updated"});
+	for (uint64_t key = 300; key < 400; ++key)
+		db->insert({key, key, "inserted"});
+	db->commit();
+	db->crash();
+
+	db.reset();
+	stats.clear();
+	db = std::make_unique<ClusteredIntDatabase>(TEST_PAGE_SIZE, 100, 0, false,
+												true);
+	EXPECT_EQ(stats.log_records_replayed, 150 + 150 + 100);
+	EXPECT_EQ(db->size(), 250);
+	EXPECT_THROW(db->get(0), std::logic_error);
+	EXPECT_EQ(db->get(1), (ClusteredIntDatabase::Tuple{1, 2, "updated"}));
+	EXPECT_EQ(db->get(399).payload, "inserted");
+}
+// Inserts tuples in random order, checkpoints after the first ones and
+// crashes after the others split nodes and overwrote pages as of the
+// checkpoint. The database is opened as of the checkpoint again, and with the
+// committed inserts if logged.
+template <typename DatabaseT>
+static void RunCrashAfterSplits(float wa_threshold, bool is_logged) {
+	static const constexpr size_t num_checkpointed = 299;
+	static const constexpr size_t num_keys = 3250;
+	std::vector<uint64_t> keys(num_keys);
+	std::iota(keys.begin(), keys.end(), 0);
+	std::shuffle(keys.begin(), keys.end(), std::mt19937_64(42));
+
+	auto db = std::make_unique<DatabaseT>(TEST_PAGE_SIZE, TEST_NUM_PAGES,
+										  wa_threshold, true, is_logged);
+	for (size_t i = 0; i < num_checkpointed; ++i)
+		db->insert({keys[i], keys[i]});
+	db->checkpoint();
+	for (size_t i = num_checkpointed; i < num_keys; ++i)
+		db->insert({keys[i], keys[i]});
+	db->commit();
+	db->crash();
+
+	db.reset();
+	stats.clear();
+	db = std::make_unique<DatabaseT>(TEST_PAGE_SIZE, TEST_NUM_PAGES,
+									 wa_threshold, false, is_logged);
+	EXPECT_GT(stats.journal_pages_rolled_back, 0);
+	auto num_expected = is_logged ? num_keys : num_checkpointed;
+	EXPECT_EQ(db->size(), num_expected);
+	for (size_t i = 0; i < num_keys; ++i) {
+		if (i < num_expected)
+			EXPECT_EQ(db->get(keys[i]).value, keys[i]);
+		else
+			EXPECT_THROW(db->get(keys[i]), std::logic_error);
+	}
+}
+// Nodes split after a checkpoint are rolled back after a crash, so that the
+// index matches the checkpoint again.
+TEST_F(IntDatabaseTest, CheckpointSurvivesSplitsAndCrash) {
+	db_.reset();
+	RunCrashAfterSplits<IntDatabase>(0, false);
+	RunCrashAfterSplits<BufferedIntDatabase>(0.5, false);
+}
+// Committed inserts are redone on the state as of the checkpoint, even though
+// they split nodes that were written out before the crash.
+TEST_F(IntDatabaseTest, CommittedSplitsSurviveCrash) {
+	db_.reset();
+	RunCrashAfterSplits<IntDatabase>(0, true);
+	RunCrashAfterSplits<BufferedIntDatabase>(0.5, true);
+	RunCrashAfterSplits<ClusteredIntDatabase>(0, true);
+}
+// Records erased and nodes merged after a checkpoint are restored after a
+// crash, even though their pages were compacted and written out.
+TEST_F(IntDatabaseTest, CheckpointSurvivesErasesAndCrash) {
+	db_.reset();
+	static const constexpr uint64_t num_keys = 3000;
+	auto db = std::make_unique<IntDatabase>(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0,
+											true, false);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		db->insert({key, key});
+	db->checkpoint();
+	for (uint64_t key = 0; key < num_keys; ++key)
+		if (key % 10 != 0)
+			db->erase(key);
+	db->crash();
+
+	db.reset();
+	stats.clear();
+	db = std::make_unique<IntDatabase>(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0, false,
+									   false);
+	EXPECT_GT(stats.journal_pages_rolled_back, 0);
+	EXPECT_EQ(db->size(), num_keys);
+	for (uint64_t key = 0; key < num_keys; ++key)
+		EXPECT_EQ(db->get(key).value, key);
+}
+// A clustered database can store variable sized keys.
+TEST_F(StringDatabaseTest, ClusteredKeys) {
+	db_.reset();
+	std::unordered_map<std::string, ClusteredStringDatabase::Tuple> expected;
+	ClusteredStringDatabase db(TEST_PAGE_SIZE, TEST_NUM_PAGES, 0, true);
+	std::vector<ClusteredStringDatabase::Tuple> tuples;
+	for (size_t i = 0; i < 1000; ++i) {
+		auto key = std::to_string(i * 7919 % 1000) + std::string(i % 50, 'k');
+		// The expected tuple's key refers to the map's key.
+		auto it = expected.emplace(key, ClusteredStringDatabase::Tuple{}).first;
+		it->second = {{it->first}, i, std::string(i % 100, 'p')};
+		tuples.push_back(it->second);
+	}
+	db.insert(tuples);
+
+	ASSERT_EQ(db.size(), expected.size());
+	for (const auto &[key, expected_tuple] : expected)
+		EXPECT_EQ(db.get({key}), expected_tuple);
+}
 // A database can store variable sized keys.
 TEST_F(StringDatabaseTest, VariableSizedKeys) {
 	Seed(1000);
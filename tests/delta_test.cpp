@@ -1,6 +1,7 @@
 #include "bbbtree/delta.h"
 #include "bbbtree/types.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <gtest/gtest.h>
 #include <random>
@@ -47,6 +48,19 @@ TEST_F(DeltaTest, DeltaSerialization) {
 		EXPECT_EQ(expected_delta, deserialized);
 		EXPECT_EQ(expected_delta.size(), deserialized.size());
 	}
+
+	// Deletes only store the key.
+	{
+		IntDelta expected_delta{OperationType::Deleted, 42};
+		std::vector<std::byte> buffer(expected_delta.size());
+		expected_delta.serialize(buffer.data());
+		IntDelta deserialized{};
+		deserialized.deserialize(buffer.data());
+		EXPECT_EQ(expected_delta, deserialized);
+		EXPECT_EQ(expected_delta.size(), deserialized.size());
+		EXPECT_EQ(expected_delta.size() + TID{}.size(),
+				  IntDelta(OperationType::Inserted, 42, 1001).size());
+	}
 }
 /// Deltas are serialized and deserialized correctly.
 TEST_F(DeltaTest, DeltasSerialization) {
@@ -66,7 +80,7 @@ TEST_F(DeltaTest, DeltasSerialization) {
 	{
 		IntDeltas::LeafDeltas values = {{OperationType::Inserted, 42, 1001},
 										{OperationType::Updated, 43, 1002},
-										{OperationType::Deleted, 44, 1003}};
+										{OperationType::Deleted, 44}};
 		IntDeltas deltas{std::move(values), 10};
 
 		std::vector<std::byte> buffer(deltas.size());
@@ -84,7 +98,7 @@ TEST_F(DeltaTest, DeltasSerialization) {
 		IntDeltas::InnerNodeDeltas values = {
 			{OperationType::Inserted, 42, 1001},
 			{OperationType::Updated, 43, 1002},
-			{OperationType::Deleted, 44, 1003}};
+			{OperationType::Deleted, 44}};
 		IntDeltas deltas{std::move(values), 4534, 10};
 
 		std::vector<std::byte> buffer(deltas.size());
@@ -102,7 +116,7 @@ TEST_F(DeltaTest, DeltasSerialization) {
 		StringDeltas::LeafDeltas values = {
 			{OperationType::Inserted, {"Hello"}, 1001},
 			{OperationType::Updated, {"World"}, 1002},
-			{OperationType::Deleted, {"!"}, 1003}};
+			{OperationType::Deleted, {"!"}}};
 		StringDeltas deltas{std::move(values), 30};
 
 		std::vector<std::byte> buffer(deltas.size());
@@ -114,6 +128,89 @@ TEST_F(DeltaTest, DeltasSerialization) {
 		EXPECT_EQ(deltas, deserialized);
 	}
 }
+/// Deltas are encoded compactly and own their strings once deserialized.
+TEST_F(DeltaTest, CompactEncoding) {
+	// Close integer keys and small values take a few bytes per delta.
+	{
+		IntDeltas::LeafDeltas values;
+		for (uint64_t key = 1000; key < 1100; ++key)
+			values.emplace_back(OperationType::Updated, key, key % 100);
+		IntDeltas deltas{std::move(values), 100};
+		EXPECT_LE(deltas.size(), 100 * 3 + 8);
+
+		std::vector<std::byte> buffer(deltas.size());
+		deltas.serialize(buffer.data());
+		EXPECT_EQ(IntDeltas::deserialize(buffer.data(), buffer.size()),
+				  deltas);
+	}
+	// String keys share prefixes with their predecessor.
+	{
+		std::vector<std::string> keys = {"prefix_a", "prefix_b", "prefix_bb",
+										 "prefix_c"};
+		StringDeltas::LeafDeltas values;
+		for (auto &key : keys)
+			values.emplace_back(OperationType::Inserted, String{key}, 1);
+		StringDeltas deltas{std::move(values), 4};
+		EXPECT_LT(deltas.size(), keys[0].size() + 4 * 4 + 8);
+
+		std::vector<std::byte> buffer(deltas.size());
+		deltas.serialize(buffer.data());
+		auto deserialized =
+			StringDeltas::deserialize(buffer.data(), buffer.size());
+		std::fill(buffer.begin(), buffer.end(), std::byte{0});
+		EXPECT_EQ(deserialized, deltas);
+	}
+}
+/// Deltas are encoded one at a time and decoded in place from their bytes.
+TEST_F(DeltaTest, DeltasView) {
+	std::vector<std::string> keys = {"prefix_a", "prefix_b", "prefix_bb",
+									 "other"};
+	StringDeltas::LeafDeltas values;
+	values.emplace_back(OperationType::Inserted, String{keys[0]}, 1);
+	values.emplace_back(OperationType::Updated, String{keys[1]}, 2);
+	values.emplace_back(OperationType::Deleted, String{keys[2]});
+	values.emplace_back(OperationType::Inserted, String{keys[3]}, 4);
+	auto expected = values;
+	StringDeltas deltas{std::move(values), 7};
+
+	// The encoder produces the same bytes as serializing the deltas.
+	DeltasHeader header{static_cast<uint16_t>(expected.size()), 7, true};
+	auto encode = [&](std::byte *dst) {
+		DeltaEncoder<String, TID> encoder(dst, header);
+		for (const auto &[entry, op] : expected)
+			encoder.add(op, entry.key, entry.value);
+		return encoder.size();
+	};
+	std::vector<std::byte> buffer(encode(nullptr));
+	encode(buffer.data());
+	std::vector<std::byte> serialized(deltas.size());
+	deltas.serialize(serialized.data());
+	EXPECT_EQ(buffer, serialized);
+
+	// The view decodes the deltas without copying them.
+	auto view = DeltasView<String, TID>::deserialize(buffer.data(),
+													 buffer.size());
+	EXPECT_EQ(view.size(), deltas.size());
+	EXPECT_EQ(view.get_bytes().data(), buffer.data());
+	auto decoded_header = view.get_header();
+	EXPECT_EQ(decoded_header.num_deltas, expected.size());
+	EXPECT_EQ(decoded_header.slot_count, 7);
+	EXPECT_TRUE(decoded_header.is_leaf);
+
+	const auto *src = view.get_bytes().data();
+	DeltasHeader::decode(src);
+	std::string key_buffer;
+	DeltaDecoder<String, TID> decoder(src, decoded_header.num_deltas,
+									  key_buffer);
+	EXPECT_EQ(decoder.count(OperationType::Inserted), 2);
+	EXPECT_EQ(decoder.count(OperationType::Deleted), 1);
+	for (const auto &delta : expected) {
+		ASSERT_FALSE(decoder.done());
+		EXPECT_EQ(decoder.next(), delta);
+	}
+	EXPECT_TRUE(decoder.done());
+	EXPECT_EQ(decoder.get_position(), buffer.data() + buffer.size());
+}
 /// Deltas can be stored in a BTree.
 TEST_F(DeltaTest, DeltaTree) {
 	IntDeltaTree delta_tree{342, *buffer_manager_, 100};
@@ -121,7 +218,7 @@ TEST_F(DeltaTest, DeltaTree) {
 	std::vector<IntDelta> values1 = {{OperationType::Inserted, 42, 1001},
 									 {OperationType::Updated, 45, 1004}};
 	std::vector<IntDelta> values2 = {};
-	std::vector<IntDelta> values3 = {{OperationType::Deleted, 44, 1003},
+	std::vector<IntDelta> values3 = {{OperationType::Deleted, 44},
 									 {OperationType::Updated, 43, 1002},
 									 {OperationType::Inserted, 46, 1003}};
 
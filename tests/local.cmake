@@ -15,6 +15,7 @@ set(TEST_CC
     tests/bbbtree_test.cpp
     tests/delta_test.cpp
     tests/map_test.cpp
+    tests/wal_test.cpp
 )
 
 # ---------------------------------------------------------------------------
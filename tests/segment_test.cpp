@@ -1,13 +1,17 @@
 #include "bbbtree/buffer_manager.h"
 #include "bbbtree/segment.h"
+#include "bbbtree/slotted_page.h"
+#include "bbbtree/stats.h"
 #include "bbbtree/types.h"
 
 #include <cstring>
 #include <gtest/gtest.h>
+#include <vector>
 
 namespace {
 static const constexpr size_t FSI_SEGMENT_ID = 534;
 static const constexpr size_t SP_SEGMENT_ID = 321;
+static const constexpr size_t METADATA_SEGMENT_ID = 322;
 
 class SegmentTest : public ::testing::Test {
   protected:
@@ -36,6 +40,9 @@ class SegmentTest : public ::testing::Test {
 };
 
 TEST_F(SegmentTest, Empty) {
+	auto page_free_space =
+		bbbtree::SlottedPage::get_initial_free_space(buffer_manager->page_size);
+
 	// Empty FSI cannot find/update anything.
 	{
 		EXPECT_FALSE(fsi->find(1).has_value());
@@ -44,34 +51,79 @@ TEST_F(SegmentTest, Empty) {
 
 	// Can find/update page after creating one.
 	{
-		EXPECT_EQ(fsi->create_new_page(buffer_manager->page_size), (size_t)0);
-		auto page_id = fsi->find(1024);
+		EXPECT_EQ(fsi->create_new_page(page_free_space), (size_t)0);
+		auto page_id = fsi->find(page_free_space);
 		EXPECT_TRUE(page_id.has_value());
 		EXPECT_EQ(page_id.value(), (bbbtree::PageID)0);
+		EXPECT_FALSE(fsi->find(page_free_space + 1).has_value());
 		fsi->update(0, 0);
 
 		EXPECT_FALSE(fsi->find(1).has_value());
 	}
 
-	// Can append to last page only.
+	// Can update any page.
 	{
-		EXPECT_EQ(fsi->create_new_page(buffer_manager->page_size),
-				  (bbbtree::PageID)1);
+		EXPECT_EQ(fsi->create_new_page(page_free_space), (bbbtree::PageID)1);
 		EXPECT_EQ(fsi->find(10).value(), (bbbtree::PageID)1);
-		// Cannot udpate non-last page
-		EXPECT_THROW(fsi->update(0, 0), std::logic_error);
-		// Cannot update to more space
-		EXPECT_THROW(fsi->update(1, 1025), std::logic_error);
+		// Freed space is found again.
+		fsi->update(0, 100);
+		EXPECT_EQ(fsi->find(10).value(), (bbbtree::PageID)0);
+		EXPECT_EQ(fsi->find(200).value(), (bbbtree::PageID)1);
+		// Cannot update to more space than a page has.
+		EXPECT_THROW(fsi->update(1, page_free_space + 1), std::logic_error);
+		// Cannot update pages that are not allocated.
+		EXPECT_THROW(fsi->update(2, 0), std::logic_error);
 	}
 }
 
 TEST_F(SegmentTest, Persistency) {
-	// TODO: Destroy FSI segment and create one again. The data should be
-	// persisted.
-	fsi->create_new_page(buffer_manager->page_size);
+	fsi->create_new_page(
+		bbbtree::SlottedPage::get_initial_free_space(buffer_manager->page_size));
 	Destroy(false);
 
 	EXPECT_TRUE(fsi->find(buffer_manager->page_size / 2));
+	EXPECT_EQ(fsi->get_num_pages(), 1);
+}
+
+// The FSI finds the lowest page with enough space across several FSI pages.
+// Classes guarantee at least the space that was found.
+TEST_F(SegmentTest, FreeSpaceClasses) {
+	auto page_free_space =
+		bbbtree::SlottedPage::get_initial_free_space(buffer_manager->page_size);
+	// Two classes per byte on each FSI page.
+	const size_t num_pages = buffer_manager->page_size * 2 + 500;
+	for (size_t i = 0; i < num_pages; ++i) {
+		EXPECT_EQ(fsi->create_new_page(page_free_space), i);
+		fsi->update(i, i % 7);
+	}
+	EXPECT_FALSE(fsi->find(7).has_value());
+
+	fsi->update(num_pages - 10, 500);
+	fsi->update(10, 50);
+	EXPECT_EQ(fsi->find(40).value(), 10);
+	EXPECT_EQ(fsi->find(300).value(), num_pages - 10);
+	EXPECT_FALSE(fsi->find(501).has_value());
+
+	// Filling the hole moves on to the next page with enough space.
+	fsi->update(10, 0);
+	EXPECT_EQ(fsi->find(40).value(), num_pages - 10);
+	fsi->update(5, page_free_space);
+	EXPECT_EQ(fsi->find(40).value(), 5);
+
+	Destroy(false);
+	EXPECT_EQ(fsi->get_num_pages(), num_pages);
+	EXPECT_EQ(fsi->find(300).value(), 5);
+	fsi->update(5, 0);
+	EXPECT_EQ(fsi->find(300).value(), num_pages - 10);
+
+	// Classes are spaced by a factor of at most sqrt(2). A page is found for
+	// requests of up to 70% of its free space, but never for more than it has.
+	for (uint32_t free_space = 600; free_space <= page_free_space;
+		 ++free_space) {
+		fsi->update(num_pages - 1, free_space);
+		EXPECT_EQ(fsi->find(free_space * 7 / 10).value(), num_pages - 1);
+		EXPECT_FALSE(fsi->find(free_space + 1).has_value());
+	}
 }
 
 TEST_F(SegmentTest, Allocate) {
@@ -116,8 +168,173 @@ TEST_F(SegmentTest, WriteDifferentSize) {
 				 std::logic_error);
 }
 
+// Records grow on their page while it has space. Otherwise, they are moved and
+// keep their TID.
+TEST_F(SegmentTest, Resize) {
+	auto read = [&](bbbtree::TID tid) {
+		std::vector<std::byte> record(buffer_manager->page_size);
+		record.resize(sp_segment->read(tid, record.data(), record.size()));
+		return record;
+	};
+	auto write = [&](bbbtree::TID tid, size_t size, uint8_t value) {
+		std::vector<std::byte> record(size, std::byte{value});
+		sp_segment->update(tid, record.data(), record.size());
+	};
+	bbbtree::stats.clear();
+
+	// Three records fill the first page.
+	std::vector<bbbtree::TID> tids;
+	for (uint8_t i = 0; i < 3; ++i) {
+		tids.push_back(sp_segment->allocate(300));
+		write(tids.back(), 300, i);
+	}
+
+	// Growing into the free space and the holes keeps the record on its page.
+	write(tids[0], 100, 0);
+	sp_segment->resize(tids[1], 450);
+	auto record = read(tids[1]);
+	ASSERT_EQ(record.size(), 450);
+	EXPECT_EQ(record[299], std::byte{1});
+	EXPECT_EQ(bbbtree::stats.records_moved, 0);
+
+	// Growing beyond the page moves the record and keeps its first bytes.
+	sp_segment->resize(tids[1], 600);
+	EXPECT_EQ(bbbtree::stats.records_moved, 1);
+	record = read(tids[1]);
+	ASSERT_EQ(record.size(), 600);
+	EXPECT_EQ(record[0], std::byte{1});
+	EXPECT_EQ(read(tids[2])[299], std::byte{2});
+
+	// Moved records are written, resized on their page and moved again.
+	write(tids[1], 600, 3);
+	EXPECT_EQ(read(tids[1])[599], std::byte{3});
+	write(tids[1], 900, 4);
+	EXPECT_EQ(bbbtree::stats.records_moved, 1);
+	write(tids[2], 900, 5);
+	EXPECT_EQ(bbbtree::stats.records_moved, 2);
+	write(tids[1], 100, 6);
+	EXPECT_THROW(sp_segment->resize(tids[1], buffer_manager->page_size),
+				 std::logic_error);
+
+	// Redirects are persisted.
+	Destroy(false);
+	std::vector<std::pair<size_t, uint8_t>> expected{
+		{100, 0}, {100, 6}, {900, 5}};
+	for (size_t i = 0; i < tids.size(); ++i) {
+		record = read(tids[i]);
+		ASSERT_EQ(record.size(), expected[i].first);
+		EXPECT_EQ(record.back(), std::byte{expected[i].second});
+	}
+}
+
+// Erased records free their space and slots for new ones, also when they were
+// moved to another page.
+TEST_F(SegmentTest, Erase) {
+	// Fill 11 pages.
+	std::vector<bbbtree::TID> tids;
+	for (size_t i = 0; i < 99; ++i)
+		tids.push_back(sp_segment->allocate(100));
+	auto num_pages = fsi->get_num_pages();
+	sp_segment->resize(tids[0], 900);
+	EXPECT_EQ(fsi->get_num_pages(), num_pages + 1);
+
+	EXPECT_THROW(sp_segment->erase(bbbtree::TID(0, 50)), std::logic_error);
+	for (auto tid : tids)
+		sp_segment->erase(tid);
+
+	// The holes are reclaimed. The slots are reused.
+	for (size_t i = 0; i < tids.size(); ++i) {
+		auto tid = sp_segment->allocate(100);
+		EXPECT_EQ(tid, tids[i]);
+	}
+	sp_segment->allocate(700);
+	EXPECT_EQ(fsi->get_num_pages(), num_pages + 1);
+}
+
+// A scan visits each record once in page order, moved records on the page they
+// were moved to. Unbuffered scans leave the buffered pages alone.
+TEST_F(SegmentTest, Scan) {
+	std::vector<bbbtree::TID> tids;
+	for (uint8_t i = 0; i < 100; ++i) {
+		tids.push_back(sp_segment->allocate(100));
+		std::vector<std::byte> record(100, std::byte{i});
+		sp_segment->write(tids.back(), record.data(), record.size());
+	}
+	sp_segment->erase(tids[1]);
+	sp_segment->resize(tids[2], 900);
+
+	auto scan = [&](bool bypass_buffer) {
+		std::vector<uint8_t> values;
+		sp_segment->scan(
+			[&](std::span<const std::byte> record) {
+				values.push_back(static_cast<uint8_t>(record[0]));
+			},
+			bypass_buffer);
+		return values;
+	};
+	auto values = scan(false);
+	ASSERT_EQ(values.size(), 99);
+	// The moved record is stored on the last page.
+	EXPECT_EQ(values[0], 0);
+	EXPECT_EQ(values[1], 3);
+	EXPECT_EQ(values.back(), 2);
+
+	// The scan looks up the number of pages in the FSI first. Its page is
+	// buffered beforehand, so that the scan needs no frame.
+	fsi->get_num_pages();
+	bbbtree::stats.clear();
+	EXPECT_EQ(scan(true), values);
+	EXPECT_GT(bbbtree::stats.pages_read_unbuffered, 0);
+	EXPECT_EQ(bbbtree::stats.pages_evicted, 0);
+
+	Destroy(false);
+	bbbtree::stats.clear();
+	EXPECT_EQ(scan(false), values);
+	EXPECT_GT(bbbtree::stats.pages_prefetched, 0);
+}
+
 TEST_F(SegmentTest, SPPersistency) {
 	// TODO: Destroy SPSegment and create one again. The data should be
 	// persisted.
 }
+
+// The last valid version of the metadata is read again. A torn write of the
+// newest version falls back to the one before.
+TEST_F(SegmentTest, MetadataVersions) {
+	{
+		bbbtree::MetadataSegment metadata(METADATA_SEGMENT_ID,
+										  *buffer_manager);
+		EXPECT_EQ(metadata.get_version(), 0);
+		EXPECT_FALSE(metadata.get(1).has_value());
+
+		metadata.set(1, {1, 2, 0});
+		metadata.set(2, {3, 4, 5});
+		metadata.write();
+		metadata.set(1, {6, 7, 0});
+		metadata.write();
+		EXPECT_EQ(metadata.get_version(), 2);
+	}
+	Destroy(false);
+	{
+		bbbtree::MetadataSegment metadata(METADATA_SEGMENT_ID,
+										  *buffer_manager);
+		EXPECT_EQ(metadata.get_version(), 2);
+		EXPECT_EQ(metadata.get(1)->root, 6);
+		EXPECT_EQ(metadata.get(2)->first_free_page, 5);
+
+		// Tear the newest version on page 0.
+		auto &frame = buffer_manager->fix_page(METADATA_SEGMENT_ID, 0, true,
+											   nullptr, false);
+		frame.get_data()[sizeof(uint64_t) * 4] ^= 1;
+		buffer_manager->unfix_page(frame, true);
+	}
+	Destroy(false);
+	{
+		bbbtree::MetadataSegment metadata(METADATA_SEGMENT_ID,
+										  *buffer_manager);
+		EXPECT_EQ(metadata.get_version(), 1);
+		EXPECT_EQ(metadata.get(1)->root, 1);
+		EXPECT_EQ(metadata.get(2)->next_free_page, 4);
+	}
+}
 } // namespace
\ No newline at end of file
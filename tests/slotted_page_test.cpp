@@ -1,5 +1,6 @@
 #include "bbbtree/slotted_page.h"
 
+#include <cstring>
 #include <gtest/gtest.h>
 #include <vector>
 
@@ -83,4 +84,118 @@ TEST(SlottedPage, Erase) {
 	// Erase non-existing slot ID
 	EXPECT_THROW(page->erase(52345), std::logic_error);
 	EXPECT_EQ(page->header.slot_count, 3);
-}
\ No newline at end of file
+}
+/// Slots redirect to TIDs and keep offset and length otherwise.
+TEST(SlottedPage, Redirect) {
+	bbbtree::SlottedPage::Slot slot;
+	slot.set_slot(1000, 24, true);
+	EXPECT_FALSE(slot.is_redirect());
+	EXPECT_TRUE(slot.is_moved());
+	EXPECT_EQ(slot.get_offset(), 1000);
+	EXPECT_EQ(slot.get_size(), 24);
+
+	bbbtree::TID tid{(1ull << 40) - 1, 65535};
+	slot.set_redirect(tid);
+	EXPECT_TRUE(slot.is_redirect());
+	EXPECT_FALSE(slot.is_moved());
+	EXPECT_EQ(slot.get_redirect(), tid);
+	// Redirects have no data on the page.
+	EXPECT_EQ(slot.get_size(), 0);
+}
+
+/// Slotted Page resizes records and compacts the page for growing ones.
+TEST(SlottedPage, Resize) {
+	static constexpr uint32_t page_size = 1024;
+	std::vector<std::byte> buffer;
+	buffer.resize(page_size);
+	auto *page = new (&buffer[0]) bbbtree::SlottedPage(page_size);
+
+	auto first = page->allocate(100);
+	auto second = page->allocate(100);
+	std::memset(page->get_data() + page->get_slots()[second].get_offset(), 7,
+				100);
+	auto free_space = page->get_free_space();
+
+	// Shrinking leaves a hole.
+	EXPECT_TRUE(page->resize(first, 10, page_size));
+	EXPECT_EQ(page->get_slots()[first].get_size(), 10);
+	EXPECT_EQ(page->get_free_space(), free_space);
+	EXPECT_EQ(page->get_compacted_free_space(page_size), free_space + 90);
+
+	// Growing within the free space moves the record there.
+	EXPECT_TRUE(page->resize(second, 200, page_size));
+	EXPECT_EQ(page->get_free_space(), free_space - 200);
+	EXPECT_EQ(page->get_compacted_free_space(page_size), free_space - 10);
+	const auto *data =
+		page->get_data() + page->get_slots()[second].get_offset();
+	EXPECT_EQ(data[0], std::byte{7});
+	EXPECT_EQ(data[99], std::byte{7});
+
+	// Growing beyond the free space reclaims the holes.
+	auto compacted = page->get_compacted_free_space(page_size);
+	EXPECT_TRUE(page->resize(second, 200 + compacted, page_size));
+	EXPECT_EQ(page->get_free_space(), 0);
+	EXPECT_EQ(page->get_compacted_free_space(page_size), 0);
+	data = page->get_data() + page->get_slots()[second].get_offset();
+	EXPECT_EQ(data[0], std::byte{7});
+	EXPECT_EQ(data[99], std::byte{7});
+	EXPECT_EQ(page->get_slots()[first].get_offset(), page_size - 10);
+
+	// Records that do not fit are left alone.
+	EXPECT_FALSE(page->resize(first, 11, page_size));
+	EXPECT_EQ(page->get_slots()[first].get_size(), 10);
+}
+
+/// Compaction moves all records to the end of the page.
+TEST(SlottedPage, Compactify) {
+	static constexpr uint32_t page_size = 1024;
+	std::vector<std::byte> buffer;
+	buffer.resize(page_size);
+	auto *page = new (&buffer[0]) bbbtree::SlottedPage(page_size);
+
+	for (uint8_t i = 0; i < 5; ++i) {
+		auto slot_id = page->allocate(50);
+		std::memset(page->get_data() + page->get_slots()[slot_id].get_offset(),
+					i, 50);
+	}
+	page->erase(1);
+	page->resize(3, 20, page_size);
+	page->compactify(page_size);
+
+	EXPECT_EQ(page->get_free_space(),
+			  page->get_compacted_free_space(page_size));
+	EXPECT_EQ(page->header.data_start, page_size - 4 * 50 + 30);
+	for (uint8_t i : {0, 2, 3, 4}) {
+		const auto &slot = page->get_slots()[i];
+		const auto *data = page->get_data() + slot.get_offset();
+		EXPECT_EQ(data[0], std::byte{i});
+		EXPECT_EQ(data[slot.get_size() - 1], std::byte{i});
+	}
+}
+
+/// Slotted Page reuses erased slots.
+TEST(SlottedPage, ReuseSlots) {
+	static constexpr uint32_t page_size = 1024;
+	std::vector<std::byte> buffer;
+	buffer.resize(page_size);
+	auto *page = new (&buffer[0]) bbbtree::SlottedPage(page_size);
+
+	for (size_t i = 0; i < 3; ++i)
+		page->allocate(10);
+	page->erase(1);
+	EXPECT_EQ(page->allocate(10), 1);
+	EXPECT_EQ(page->header.slot_count, 3);
+
+	page->erase(2);
+	page->erase(0);
+	EXPECT_EQ(page->allocate(10), 0);
+	EXPECT_EQ(page->allocate(10), 2);
+	EXPECT_EQ(page->allocate(10), 3);
+	EXPECT_EQ(page->header.slot_count, 4);
+
+	// Reused slots need no space for themselves.
+	page->erase(3);
+	auto free_space = page->get_free_space();
+	page->allocate(free_space);
+	EXPECT_EQ(page->get_free_space(), 0);
+}
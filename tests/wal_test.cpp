@@ -0,0 +1,122 @@
+#include "bbbtree/file.h"
+#include "bbbtree/stats.h"
+#include "bbbtree/wal.h"
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+using bbbtree::LogRecordType;
+using bbbtree::LSN;
+using bbbtree::WriteAheadLog;
+
+static const constexpr size_t LOG_SEGMENT_ID = 735;
+
+/// The records replayed from a log.
+struct Record {
+	LogRecordType type;
+	std::string payload;
+};
+
+std::span<const std::byte> AsBytes(const std::string &payload) {
+	return {reinterpret_cast<const std::byte *>(payload.data()),
+			payload.size()};
+}
+
+std::vector<Record> Replay(WriteAheadLog &log, LSN lsn) {
+	std::vector<Record> records;
+	log.replay(lsn,
+			   [&](LogRecordType type, std::span<const std::byte> payload) {
+				   records.push_back(
+					   {type, std::string(reinterpret_cast<const char *>(
+											  payload.data()),
+										  payload.size())});
+			   });
+	return records;
+}
+
+// Flushed records are replayed in order after a restart.
+TEST(WriteAheadLogTest, ReplayFlushedRecords) {
+	bbbtree::stats.clear();
+	{
+		WriteAheadLog log(LOG_SEGMENT_ID, true);
+		for (size_t i = 0; i < 100; ++i) {
+			auto lsn = log.append(i % 2 ? LogRecordType::Update
+										: LogRecordType::Insert,
+								  AsBytes(std::to_string(i)));
+			EXPECT_EQ(lsn, i + 1);
+		}
+		log.flush();
+		EXPECT_EQ(log.get_flushed_lsn(), 100);
+	}
+	EXPECT_EQ(bbbtree::stats.log_records_appended, 100);
+	// Records are written in groups.
+	EXPECT_GT(bbbtree::stats.log_groups_written, 0);
+	EXPECT_LT(bbbtree::stats.log_groups_written, 100);
+
+	WriteAheadLog log(LOG_SEGMENT_ID, false);
+	auto records = Replay(log, 40);
+	ASSERT_EQ(records.size(), 60);
+	for (size_t i = 0; i < records.size(); ++i) {
+		EXPECT_EQ(records[i].payload, std::to_string(i + 40));
+		EXPECT_EQ(records[i].type,
+				  (i + 40) % 2 ? LogRecordType::Update : LogRecordType::Insert);
+	}
+	EXPECT_EQ(bbbtree::stats.log_records_replayed, 60);
+
+	// Appending continues after the replayed records.
+	EXPECT_EQ(log.get_last_lsn(), 100);
+	EXPECT_EQ(log.append(LogRecordType::Insert, AsBytes("next")), 101);
+}
+// Records that were not flushed are lost. A torn record ends the log.
+TEST(WriteAheadLogTest, TornTail) {
+	{
+		WriteAheadLog log(LOG_SEGMENT_ID, true);
+		log.append(LogRecordType::Insert, AsBytes("first"));
+		log.append(LogRecordType::Insert, AsBytes("second"));
+		log.flush();
+		log.append(LogRecordType::Insert, AsBytes("lost"));
+		log.discard();
+	}
+	{
+		// Tear the second record.
+		auto file = bbbtree::File::open_file(
+			std::to_string(LOG_SEGMENT_ID).c_str(), bbbtree::File::Mode::WRITE);
+		auto size = file->size();
+		std::vector<char> bytes(size);
+		file->read_block(0, size, bytes.data());
+		bytes[size - 1] ^= 1;
+		file->write_block(bytes.data(), 0, size);
+	}
+
+	WriteAheadLog log(LOG_SEGMENT_ID, false);
+	auto records = Replay(log, 0);
+	ASSERT_EQ(records.size(), 1);
+	EXPECT_EQ(records[0].payload, "first");
+
+	// The torn record is overwritten.
+	EXPECT_EQ(log.append(LogRecordType::Update, AsBytes("third")), 2);
+	log.flush();
+	records = Replay(log, 0);
+	ASSERT_EQ(records.size(), 2);
+	EXPECT_EQ(records[1].payload, "third");
+	EXPECT_EQ(records[1].type, LogRecordType::Update);
+}
+// Truncating drops all records but LSNs keep counting.
+TEST(WriteAheadLogTest, Truncate) {
+	WriteAheadLog log(LOG_SEGMENT_ID, true);
+	log.append(LogRecordType::Insert, AsBytes("first"));
+	log.flush();
+	log.append(LogRecordType::Insert, AsBytes("second"));
+	log.truncate();
+	EXPECT_EQ(log.get_flushed_lsn(), 2);
+
+	EXPECT_EQ(log.append(LogRecordType::Insert, AsBytes("third")), 3);
+	log.flush();
+	auto records = Replay(log, 2);
+	ASSERT_EQ(records.size(), 1);
+	EXPECT_EQ(records[0].payload, "third");
+}
+} // namespace